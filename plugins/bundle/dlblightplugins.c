@@ -0,0 +1,83 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* All the elements in one plugin, built with the bundle option. The
+ * element sources leave out their own plugin definition when built with
+ * DLB_PLUGINS_BUNDLE and only the enabled plugin directories are in. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightplugins.h"
+
+#ifdef DLB_BUNDLE_LSM
+#include "lsm/dlblsmparse.h"
+#include "lsm/dlblightning.h"
+#include "lsm/dlblightbin.h"
+#endif
+#ifdef DLB_BUNDLE_LSM_SINK
+#include "lsm_sink/dlblighttextsink.h"
+#include "lsm_sink/dlblightdemux.h"
+#include "lsm_sink/dlblightmixer.h"
+#include "lsm_sink/dlblightappsink.h"
+#endif
+#ifdef DLB_BUNDLE_LSM_RTP
+#include "lsm_rtp/dlblightrtppay.h"
+#include "lsm_rtp/dlblightrtpdepay.h"
+#endif
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  gboolean ret = FALSE;
+
+#ifdef DLB_BUNDLE_LSM
+  ret |= GST_ELEMENT_REGISTER (dlblsmparse, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightning, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightbin, plugin);
+#endif
+#ifdef DLB_BUNDLE_LSM_SINK
+  ret |= GST_ELEMENT_REGISTER (dlblighttextsink, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightdemux, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightmixer, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightappsink, plugin);
+#endif
+#ifdef DLB_BUNDLE_LSM_RTP
+  ret |= GST_ELEMENT_REGISTER (dlblightrtppay, plugin);
+  ret |= GST_ELEMENT_REGISTER (dlblightrtpdepay, plugin);
+#endif
+
+  return ret;
+}
+
+gboolean
+dlb_light_plugins_register (void)
+{
+  return gst_plugin_register_static (GST_VERSION_MAJOR, GST_VERSION_MINOR,
+      "dlblightplugins", "Dolby Lightscapes elements", plugin_init, VERSION,
+      LICENSE, PACKAGE, PACKAGE, ORIGIN);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightplugins,
+    "Dolby Lightscapes elements",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
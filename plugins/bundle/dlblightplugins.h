@@ -0,0 +1,42 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_PLUGINS_H_
+#define _DLB_LIGHT_PLUGINS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * dlb_light_plugins_register:
+ *
+ * Registers every element of the plugin bundle with GStreamer, for
+ * applications linking the bundle directly instead of loading it from the
+ * plugin path. Call it once after gst_init().
+ *
+ * Returns: %TRUE if the elements were registered.
+ */
+GST_API_EXPORT
+gboolean dlb_light_plugins_register (void);
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_PLUGINS_H_
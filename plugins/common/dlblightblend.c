@@ -0,0 +1,240 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Blend kernels for light values. Frames are a few hundred to a few
+ * thousand bytes per strip and a mixer blends every input into every
+ * output frame, so the kernels work on 16 bytes at once with the compiler's
+ * generic vector extensions, which map to SSE2 and NEON without a source
+ * file per instruction set. The few bytes at the end of a strip, and
+ * compilers without the extensions, use the scalar version. Both give the
+ * same result to the bit. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "dlblightblend.h"
+
+GType
+dlb_light_blend_mode_get_type (void)
+{
+  static gsize mode_type = 0;
+  static const GEnumValue modes[] = {
+    {DLB_LIGHT_BLEND_ALPHA, "Cross-fade by the alpha", "alpha"},
+    {DLB_LIGHT_BLEND_MAX, "Brightest of the layers", "max"},
+    {DLB_LIGHT_BLEND_ADD, "Sum of the layers, saturated", "add"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&mode_type)) {
+    /* several plugins link this code statically, only register once */
+    GType tmp = g_type_from_name ("DlbLightBlendMode");
+
+    if (tmp == 0)
+      tmp = g_enum_register_static ("DlbLightBlendMode", modes);
+    g_once_init_leave (&mode_type, tmp);
+  }
+
+  return (GType) mode_type;
+}
+
+/* (v * alpha) / 256, rounded */
+static inline guint
+scale (guint v, guint alpha)
+{
+  return (v * alpha + 128) >> 8;
+}
+
+static void
+blend_alpha_scalar (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  for (gsize i = 0; i < size; i++)
+    dst[i] = (dst[i] * (256 - alpha) + src[i] * alpha + 128) >> 8;
+}
+
+static void
+blend_max_scalar (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  for (gsize i = 0; i < size; i++)
+    dst[i] = MAX (dst[i], scale (src[i], alpha));
+}
+
+static void
+blend_add_scalar (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  for (gsize i = 0; i < size; i++)
+    dst[i] = MIN (dst[i] + scale (src[i], alpha), 255);
+}
+
+#ifdef HAVE_VECTOR_EXTENSIONS
+/* Eight 16 bit lanes. Each lane carries two light values, which are
+ * blended in the low and high byte halves separately so that the products
+ * fit into 16 bits. Loading through memcpy copes with any alignment and the
+ * byte order does not matter since the halves are put back the same way. */
+typedef guint16 DlbLightVec __attribute__ ((vector_size (16)));
+
+#define VEC_SIZE (sizeof (DlbLightVec))
+
+static inline DlbLightVec
+vec_splat (guint16 x)
+{
+  DlbLightVec v = { x, x, x, x, x, x, x, x };
+
+  return v;
+}
+
+static inline DlbLightVec
+vec_max (DlbLightVec x, DlbLightVec y)
+{
+  DlbLightVec gt = (DlbLightVec) (x > y);
+
+  return (x & gt) | (y & ~gt);
+}
+
+static inline DlbLightVec
+vec_add_sat (DlbLightVec x, DlbLightVec y, DlbLightVec limit)
+{
+  DlbLightVec sum = x + y;
+  DlbLightVec over = (DlbLightVec) (sum > limit);
+
+  return (sum & ~over) | (limit & over);
+}
+
+/* The vector loops return how many bytes they did, the rest is left to
+ * the scalar ones */
+static gsize
+blend_alpha_vec (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  const DlbLightVec low = vec_splat (0xff);
+  const DlbLightVec half = vec_splat (128);
+  const DlbLightVec a = vec_splat (alpha);
+  const DlbLightVec inv = vec_splat (256 - alpha);
+  gsize i;
+
+  for (i = 0; i + VEC_SIZE <= size; i += VEC_SIZE) {
+    DlbLightVec d, s, lo, hi;
+
+    memcpy (&d, dst + i, VEC_SIZE);
+    memcpy (&s, src + i, VEC_SIZE);
+    lo = ((d & low) * inv + (s & low) * a + half) >> 8;
+    hi = ((d >> 8) * inv + (s >> 8) * a + half) >> 8;
+    d = lo | (hi << 8);
+    memcpy (dst + i, &d, VEC_SIZE);
+  }
+
+  return i;
+}
+
+static gsize
+blend_max_vec (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  const DlbLightVec low = vec_splat (0xff);
+  const DlbLightVec half = vec_splat (128);
+  const DlbLightVec a = vec_splat (alpha);
+  gsize i;
+
+  for (i = 0; i + VEC_SIZE <= size; i += VEC_SIZE) {
+    DlbLightVec d, s, lo, hi;
+
+    memcpy (&d, dst + i, VEC_SIZE);
+    memcpy (&s, src + i, VEC_SIZE);
+    lo = vec_max (d & low, ((s & low) * a + half) >> 8);
+    hi = vec_max (d >> 8, ((s >> 8) * a + half) >> 8);
+    d = lo | (hi << 8);
+    memcpy (dst + i, &d, VEC_SIZE);
+  }
+
+  return i;
+}
+
+static gsize
+blend_add_vec (guint8 * dst, const guint8 * src, gsize size, guint alpha)
+{
+  const DlbLightVec low = vec_splat (0xff);
+  const DlbLightVec half = vec_splat (128);
+  const DlbLightVec a = vec_splat (alpha);
+  gsize i;
+
+  for (i = 0; i + VEC_SIZE <= size; i += VEC_SIZE) {
+    DlbLightVec d, s, lo, hi;
+
+    memcpy (&d, dst + i, VEC_SIZE);
+    memcpy (&s, src + i, VEC_SIZE);
+    lo = vec_add_sat (d & low, ((s & low) * a + half) >> 8, low);
+    hi = vec_add_sat (d >> 8, ((s >> 8) * a + half) >> 8, low);
+    d = lo | (hi << 8);
+    memcpy (dst + i, &d, VEC_SIZE);
+  }
+
+  return i;
+}
+#endif
+
+/**
+ * dlb_light_blend_values:
+ * @mode: how to combine the values
+ * @dst: (inout): light values of the layers below, updated in place
+ * @src: light values of the layer on top
+ * @size: number of values, in bytes
+ * @alpha: opacity of the layer on top, from 0 to
+ *   %DLB_LIGHT_BLEND_ALPHA_OPAQUE
+ *
+ * Blends one layer of light values into another. All colour channels are
+ * blended alike, so this works on whole strips or frames of any format.
+ */
+void
+dlb_light_blend_values (DlbLightBlendMode mode, guint8 * dst,
+    const guint8 * src, gsize size, guint alpha)
+{
+  gsize done = 0;
+
+  alpha = MIN (alpha, DLB_LIGHT_BLEND_ALPHA_OPAQUE);
+  if (alpha == 0)
+    return;
+
+  switch (mode) {
+    case DLB_LIGHT_BLEND_ALPHA:
+      if (alpha == DLB_LIGHT_BLEND_ALPHA_OPAQUE) {
+        memcpy (dst, src, size);
+        return;
+      }
+#ifdef HAVE_VECTOR_EXTENSIONS
+      done = blend_alpha_vec (dst, src, size, alpha);
+#endif
+      blend_alpha_scalar (dst + done, src + done, size - done, alpha);
+      break;
+    case DLB_LIGHT_BLEND_MAX:
+#ifdef HAVE_VECTOR_EXTENSIONS
+      done = blend_max_vec (dst, src, size, alpha);
+#endif
+      blend_max_scalar (dst + done, src + done, size - done, alpha);
+      break;
+    case DLB_LIGHT_BLEND_ADD:
+#ifdef HAVE_VECTOR_EXTENSIONS
+      done = blend_add_vec (dst, src, size, alpha);
+#endif
+      blend_add_scalar (dst + done, src + done, size - done, alpha);
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+}
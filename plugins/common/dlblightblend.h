@@ -0,0 +1,56 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_BLEND_H_
+#define _DLB_LIGHT_BLEND_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * DlbLightBlendMode:
+ * @DLB_LIGHT_BLEND_ALPHA: cross-fade from the lights below by the alpha
+ * @DLB_LIGHT_BLEND_MAX: keep the brighter of the two, after scaling by the
+ *   alpha
+ * @DLB_LIGHT_BLEND_ADD: add to the lights below, after scaling by the
+ *   alpha, saturating at full intensity
+ *
+ * How a layer of light values is combined with the layers below it.
+ */
+typedef enum {
+  DLB_LIGHT_BLEND_ALPHA,
+  DLB_LIGHT_BLEND_MAX,
+  DLB_LIGHT_BLEND_ADD,
+} DlbLightBlendMode;
+
+#define DLB_TYPE_LIGHT_BLEND_MODE               (dlb_light_blend_mode_get_type())
+
+GType dlb_light_blend_mode_get_type (void);
+
+/* alpha of a fully opaque layer, alphas go from 0 to this */
+#define DLB_LIGHT_BLEND_ALPHA_OPAQUE (256)
+
+void dlb_light_blend_values (DlbLightBlendMode mode, guint8 * dst,
+    const guint8 * src, gsize size, guint alpha);
+
+G_END_DECLS
+
+#endif /* _DLB_LIGHT_BLEND_H_ */
@@ -0,0 +1,161 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_LAYOUT_H_
+#define _DLB_LIGHT_LAYOUT_H_
+
+#include <glib.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Layout of an application/x-lights, format=DLB frame (little endian):
+ *
+ *   uint16 num_strips
+ *   num_strips times:
+ *     uint8  strip_id
+ *     uint16 num_lights
+ *     uint8  format
+ *     num_lights * bytes_per_light(format) bytes of light values
+ */
+
+/* light output formats, same values as LS_OUTPUT_COLOR_FORMAT_* */
+#define DLB_LIGHT_FORMAT_RGB      (0)
+#define DLB_LIGHT_FORMAT_RGBW     (10)
+#define DLB_LIGHT_FORMAT_RGBWW    (11)
+
+#define DLB_LIGHT_FRAME_HEADER_SIZE (2)
+#define DLB_LIGHT_STRIP_HEADER_SIZE (4)
+
+typedef struct _DlbLightStrip DlbLightStrip;
+typedef struct _DlbLightLayoutReader DlbLightLayoutReader;
+
+/**
+ * DlbLightStrip:
+ * @strip_id: id of the strip
+ * @format: light output format, one of DLB_LIGHT_FORMAT_*
+ * @num_lights: number of lights on the strip
+ * @header_offset: offset of the strip header in the frame
+ * @offset: offset of the first light value in the frame
+ * @size: size of the light values in bytes
+ */
+struct _DlbLightStrip
+{
+  guint8 strip_id;
+  guint8 format;
+  guint16 num_lights;
+  gsize header_offset;
+  gsize offset;
+  gsize size;
+};
+
+/**
+ * DlbLightLayoutReader:
+ *
+ * Bounds-checked iterator over the strips of a light frame. Stays valid in
+ * release builds, unlike reads wrapped in assert().
+ */
+struct _DlbLightLayoutReader
+{
+  const guint8 *data;
+  gsize size;
+  gsize pos;
+  guint16 num_strips;
+  guint16 index;
+};
+
+static inline guint
+dlb_light_format_bytes_per_light (guint8 format)
+{
+  switch (format) {
+    case DLB_LIGHT_FORMAT_RGB:
+      return 3;
+    case DLB_LIGHT_FORMAT_RGBW:
+      return 4;
+    case DLB_LIGHT_FORMAT_RGBWW:
+      return 5;
+    default:
+      return 0;
+  }
+}
+
+/* Returns FALSE when @size cannot even hold the strip count. */
+static inline gboolean
+dlb_light_layout_reader_init (DlbLightLayoutReader * reader, const guint8 * data,
+    gsize size)
+{
+  reader->data = data;
+  reader->size = size;
+  reader->pos = DLB_LIGHT_FRAME_HEADER_SIZE;
+  reader->index = 0;
+  reader->num_strips = 0;
+
+  if (data == NULL || size < DLB_LIGHT_FRAME_HEADER_SIZE)
+    return FALSE;
+
+  reader->num_strips = GST_READ_UINT16_LE (data);
+  return TRUE;
+}
+
+/* Fills @strip with the next strip of the frame. Returns FALSE after the last
+ * strip, or when the frame is truncated or uses an unknown format; use
+ * dlb_light_layout_reader_is_complete() to tell the two apart. */
+static inline gboolean
+dlb_light_layout_reader_next (DlbLightLayoutReader * reader, DlbLightStrip * strip)
+{
+  const guint8 *header;
+  guint bpp;
+
+  if (reader->index >= reader->num_strips ||
+      reader->size - reader->pos < DLB_LIGHT_STRIP_HEADER_SIZE)
+    return FALSE;
+
+  header = reader->data + reader->pos;
+  strip->strip_id = header[0];
+  strip->num_lights = GST_READ_UINT16_LE (header + 1);
+  strip->format = header[3];
+
+  bpp = dlb_light_format_bytes_per_light (strip->format);
+  if (bpp == 0)
+    return FALSE;
+
+  strip->header_offset = reader->pos;
+  strip->offset = reader->pos + DLB_LIGHT_STRIP_HEADER_SIZE;
+  strip->size = (gsize) strip->num_lights * bpp;
+
+  if (reader->size - strip->offset < strip->size)
+    return FALSE;
+
+  reader->pos = strip->offset + strip->size;
+  reader->index++;
+
+  return TRUE;
+}
+
+static inline gboolean
+dlb_light_layout_reader_is_complete (const DlbLightLayoutReader * reader)
+{
+  return reader->index == reader->num_strips;
+}
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_LAYOUT_H_
@@ -0,0 +1,224 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightmeta.h"
+
+/* Layout */
+
+/**
+ * dlb_light_layout_new_from_data:
+ * @data: a light frame
+ * @size: size of @data
+ *
+ * Returns: (transfer full) (nullable): the strip table of the frame, or
+ * %NULL when the frame is malformed.
+ */
+DlbLightLayout *
+dlb_light_layout_new_from_data (const guint8 * data, gsize size)
+{
+  DlbLightLayoutReader reader;
+  DlbLightLayout *layout;
+  DlbLightStrip strip;
+
+  if (!dlb_light_layout_reader_init (&reader, data, size))
+    return NULL;
+
+  /* the strip count is untrusted, every strip needs at least its header */
+  if ((gsize) reader.num_strips * DLB_LIGHT_STRIP_HEADER_SIZE >
+      size - DLB_LIGHT_FRAME_HEADER_SIZE)
+    return NULL;
+
+  layout = g_malloc (sizeof (DlbLightLayout) +
+      reader.num_strips * sizeof (DlbLightStrip));
+  layout->refcount = 1;
+  layout->frame_size = size;
+  layout->num_strips = reader.num_strips;
+  for (guint i = 0; i < G_N_ELEMENTS (layout->index_of_strip); i++)
+    layout->index_of_strip[i] = -1;
+
+  while (dlb_light_layout_reader_next (&reader, &strip)) {
+    guint16 index = reader.index - 1;
+
+    layout->strips[index] = strip;
+    if (layout->index_of_strip[strip.strip_id] < 0)
+      layout->index_of_strip[strip.strip_id] = index;
+  }
+
+  if (!dlb_light_layout_reader_is_complete (&reader)) {
+    g_free (layout);
+    return NULL;
+  }
+
+  return layout;
+}
+
+DlbLightLayout *
+dlb_light_layout_ref (DlbLightLayout * layout)
+{
+  g_atomic_int_inc (&layout->refcount);
+  return layout;
+}
+
+void
+dlb_light_layout_unref (DlbLightLayout * layout)
+{
+  if (g_atomic_int_dec_and_test (&layout->refcount))
+    g_free (layout);
+}
+
+/**
+ * dlb_light_layout_matches:
+ *
+ * Checks whether @data has the same layout as @layout by comparing the frame
+ * size and the strip headers at their known offsets, without walking the
+ * frame.
+ */
+gboolean
+dlb_light_layout_matches (const DlbLightLayout * layout, const guint8 * data,
+    gsize size)
+{
+  if (layout->frame_size != size || size < DLB_LIGHT_FRAME_HEADER_SIZE ||
+      GST_READ_UINT16_LE (data) != layout->num_strips)
+    return FALSE;
+
+  for (guint i = 0; i < layout->num_strips; i++) {
+    const DlbLightStrip *strip = &layout->strips[i];
+    const guint8 *header = data + strip->header_offset;
+
+    if (header[0] != strip->strip_id ||
+        GST_READ_UINT16_LE (header + 1) != strip->num_lights ||
+        header[3] != strip->format)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * dlb_light_layout_find_strip:
+ *
+ * Returns: (nullable): the first strip with id @strip_id.
+ */
+const DlbLightStrip *
+dlb_light_layout_find_strip (const DlbLightLayout * layout, guint8 strip_id)
+{
+  gint16 index = layout->index_of_strip[strip_id];
+
+  return index < 0 ? NULL : &layout->strips[index];
+}
+
+/* Meta */
+
+static gboolean
+dlb_light_layout_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  DlbLightLayoutMeta *lmeta = (DlbLightLayoutMeta *) meta;
+
+  lmeta->layout = NULL;
+  return TRUE;
+}
+
+static void
+dlb_light_layout_meta_free (GstMeta * meta, GstBuffer * buffer)
+{
+  DlbLightLayoutMeta *lmeta = (DlbLightLayoutMeta *) meta;
+
+  if (lmeta->layout)
+    dlb_light_layout_unref (lmeta->layout);
+}
+
+static gboolean
+dlb_light_layout_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  DlbLightLayoutMeta *lmeta = (DlbLightLayoutMeta *) meta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  /* offsets are only valid for a copy of the whole frame */
+  if (!((GstMetaTransformCopy *) data)->region)
+    return dlb_buffer_add_light_layout_meta (dest, lmeta->layout) != NULL;
+
+  return TRUE;
+}
+
+GType
+dlb_light_layout_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    /* several plugins link this code statically, only register once */
+    GType _type = g_type_from_name ("DlbLightLayoutMetaAPI");
+
+    if (_type == 0)
+      _type = gst_meta_api_type_register ("DlbLightLayoutMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+
+  return (GType) type;
+}
+
+const GstMetaInfo *
+dlb_light_layout_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_get_info ("DlbLightLayoutMeta");
+
+    if (mi == NULL)
+      mi = gst_meta_register (DLB_LIGHT_LAYOUT_META_API_TYPE, "DlbLightLayoutMeta",
+          sizeof (DlbLightLayoutMeta), dlb_light_layout_meta_init,
+          dlb_light_layout_meta_free, dlb_light_layout_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+
+  return meta_info;
+}
+
+/**
+ * dlb_buffer_add_light_layout_meta:
+ * @buffer: a light frame
+ * @layout: (transfer none): the layout of @buffer
+ *
+ * Returns: (transfer none): the added meta.
+ */
+DlbLightLayoutMeta *
+dlb_buffer_add_light_layout_meta (GstBuffer * buffer, DlbLightLayout * layout)
+{
+  DlbLightLayoutMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (layout != NULL, NULL);
+
+  meta = (DlbLightLayoutMeta *) gst_buffer_add_meta (buffer,
+      DLB_LIGHT_LAYOUT_META_INFO, NULL);
+  if (meta)
+    meta->layout = dlb_light_layout_ref (layout);
+
+  return meta;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_META_H_
+#define _DLB_LIGHT_META_H_
+
+#include <gst/gst.h>
+#include "dlblightlayout.h"
+
+G_BEGIN_DECLS
+
+typedef struct _DlbLightLayout DlbLightLayout;
+typedef struct _DlbLightLayoutMeta DlbLightLayoutMeta;
+
+/**
+ * DlbLightLayout:
+ * @frame_size: size of the frame the layout was computed from
+ * @num_strips: number of strips in the frame
+ * @strips: (array length=num_strips): the strips, in frame order
+ *
+ * Reference counted strip table of a light frame. Immutable once created,
+ * so it can be shared between all frames with the same layout.
+ */
+struct _DlbLightLayout
+{
+  /*< private >*/
+  gint refcount;
+  gint16 index_of_strip[256];
+
+  /*< public >*/
+  gsize frame_size;
+  guint16 num_strips;
+  DlbLightStrip strips[];
+};
+
+/**
+ * DlbLightLayoutMeta:
+ * @meta: parent #GstMeta
+ * @layout: the layout of the buffer contents
+ *
+ * Strip table of an application/x-lights buffer, so consumers can jump
+ * straight to their strips instead of walking the frame.
+ */
+struct _DlbLightLayoutMeta
+{
+  GstMeta meta;
+
+  DlbLightLayout *layout;
+};
+
+DlbLightLayout *        dlb_light_layout_new_from_data  (const guint8 * data, gsize size);
+DlbLightLayout *        dlb_light_layout_ref            (DlbLightLayout * layout);
+void                    dlb_light_layout_unref          (DlbLightLayout * layout);
+gboolean                dlb_light_layout_matches        (const DlbLightLayout * layout,
+                                                         const guint8 * data, gsize size);
+const DlbLightStrip *   dlb_light_layout_find_strip     (const DlbLightLayout * layout,
+                                                         guint8 strip_id);
+
+#define DLB_LIGHT_LAYOUT_META_API_TYPE (dlb_light_layout_meta_api_get_type())
+#define DLB_LIGHT_LAYOUT_META_INFO (dlb_light_layout_meta_get_info())
+
+#define dlb_buffer_get_light_layout_meta(b) \
+  ((DlbLightLayoutMeta*)gst_buffer_get_meta((b),DLB_LIGHT_LAYOUT_META_API_TYPE))
+
+GType                   dlb_light_layout_meta_api_get_type (void);
+const GstMetaInfo *     dlb_light_layout_meta_get_info     (void);
+DlbLightLayoutMeta *    dlb_buffer_add_light_layout_meta   (GstBuffer * buffer,
+                                                            DlbLightLayout * layout);
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_META_H_
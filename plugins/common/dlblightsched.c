@@ -0,0 +1,217 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(HAVE_PTHREAD_SETSCHEDPARAM) || defined(HAVE_PTHREAD_SETAFFINITY_NP)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef HAVE_MLOCKALL
+#include <sys/mman.h>
+#endif
+
+#include "dlblightsched.h"
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category ()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat = 0;
+
+  if (g_once_init_enter (&cat)) {
+    gsize _cat = (gsize) _gst_debug_category_new ("dlblightsched", 0,
+        "light thread scheduling");
+    g_once_init_leave (&cat, _cat);
+  }
+
+  return (GstDebugCategory *) cat;
+}
+#endif
+
+GType
+dlb_light_thread_policy_get_type (void)
+{
+  static gsize policy_type = 0;
+  static const GEnumValue policies[] = {
+    {DLB_LIGHT_THREAD_POLICY_OTHER, "Default time-sharing scheduling", "other"},
+    {DLB_LIGHT_THREAD_POLICY_FIFO, "Real-time FIFO scheduling", "fifo"},
+    {DLB_LIGHT_THREAD_POLICY_RR, "Real-time round-robin scheduling", "rr"},
+    {0, NULL, NULL},
+  };
+
+  if (g_once_init_enter (&policy_type)) {
+    /* several plugins link this code statically, only register once */
+    GType tmp = g_type_from_name ("DlbLightThreadPolicy");
+
+    if (tmp == 0)
+      tmp = g_enum_register_static ("DlbLightThreadPolicy", policies);
+    g_once_init_leave (&policy_type, tmp);
+  }
+
+  return (GType) policy_type;
+}
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+static gboolean
+parse_cpu_list (const gchar * list, cpu_set_t * set)
+{
+  gchar **ranges;
+  gboolean ret = TRUE;
+
+  CPU_ZERO (set);
+  ranges = g_strsplit (list, ",", -1);
+
+  for (guint i = 0; ranges[i] != NULL && ret; i++) {
+    gchar *end = NULL;
+    guint64 first, last;
+
+    first = g_ascii_strtoull (ranges[i], &end, 10);
+    if (end == ranges[i]) {
+      ret = FALSE;
+      break;
+    }
+    last = first;
+    if (*end == '-') {
+      const gchar *second = end + 1;
+      last = g_ascii_strtoull (second, &end, 10);
+      if (end == second)
+        ret = FALSE;
+    }
+    if (*end != '\0' || last < first || last >= CPU_SETSIZE) {
+      ret = FALSE;
+      break;
+    }
+    for (guint64 cpu = first; cpu <= last; cpu++)
+      CPU_SET ((int) cpu, set);
+  }
+
+  g_strfreev (ranges);
+  return ret && CPU_COUNT (set) > 0;
+}
+#endif
+
+/**
+ * dlb_light_thread_settings_apply:
+ * @settings: the settings to apply
+ * @object: object to log against
+ * @thread_name: name of the thread in log messages
+ *
+ * Apply @settings to the calling thread. Settings that cannot be applied,
+ * typically for lack of privileges, are logged and otherwise ignored, so
+ * the thread keeps running with its current scheduling.
+ */
+void
+dlb_light_thread_settings_apply (const DlbLightThreadSettings * settings,
+    GstObject * object, const gchar * thread_name)
+{
+#ifdef HAVE_PTHREAD_SETSCHEDPARAM
+  if (settings->policy != DLB_LIGHT_THREAD_POLICY_OTHER) {
+    struct sched_param param;
+    int sched_policy, ret;
+
+    sched_policy =
+        (settings->policy == DLB_LIGHT_THREAD_POLICY_FIFO) ? SCHED_FIFO : SCHED_RR;
+    memset (&param, 0, sizeof (param));
+    param.sched_priority = CLAMP (settings->priority,
+        sched_get_priority_min (sched_policy), sched_get_priority_max (sched_policy));
+
+    ret = pthread_setschedparam (pthread_self (), sched_policy, &param);
+    if (ret != 0) {
+      GST_WARNING_OBJECT (object, "could not set real-time scheduling for the "
+          "%s thread (%s), keeping the default policy", thread_name,
+          g_strerror (ret));
+    } else {
+      GST_INFO_OBJECT (object, "%s thread running with real-time priority %d",
+          thread_name, param.sched_priority);
+    }
+  }
+#else
+  if (settings->policy != DLB_LIGHT_THREAD_POLICY_OTHER)
+    GST_WARNING_OBJECT (object, "real-time scheduling is not supported on this platform");
+#endif
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  if (settings->affinity != NULL) {
+    cpu_set_t set;
+    int ret;
+
+    if (!parse_cpu_list (settings->affinity, &set)) {
+      GST_WARNING_OBJECT (object, "invalid CPU list '%s', ignoring",
+          settings->affinity);
+    } else if ((ret = pthread_setaffinity_np (pthread_self (), sizeof (set), &set)) != 0) {
+      GST_WARNING_OBJECT (object, "could not pin the %s thread to CPUs %s (%s)",
+          thread_name, settings->affinity, g_strerror (ret));
+    } else {
+      GST_INFO_OBJECT (object, "%s thread pinned to CPUs %s", thread_name,
+          settings->affinity);
+    }
+  }
+#else
+  if (settings->affinity != NULL)
+    GST_WARNING_OBJECT (object, "CPU affinity is not supported on this platform");
+#endif
+}
+
+/**
+ * dlb_light_lock_memory:
+ * @object: object to log against
+ *
+ * Lock the current and future pages of the process into memory, so buffer
+ * pools and thread stacks are faulted in when they are allocated instead of
+ * when a frame is due. This is process-wide and done at most once.
+ *
+ * Returns: %TRUE if the memory of the process is locked.
+ */
+gboolean
+dlb_light_lock_memory (GstObject * object)
+{
+#ifdef HAVE_MLOCKALL
+  static gint locked = FALSE;
+
+  if (g_atomic_int_get (&locked))
+    return TRUE;
+
+  if (mlockall (MCL_CURRENT | MCL_FUTURE) != 0) {
+    GST_WARNING_OBJECT (object, "could not lock memory (%s), pages stay "
+        "pageable", g_strerror (errno));
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (object, "process memory locked");
+  g_atomic_int_set (&locked, TRUE);
+  return TRUE;
+#else
+  GST_WARNING_OBJECT (object, "memory locking is not supported on this platform");
+  return FALSE;
+#endif
+}
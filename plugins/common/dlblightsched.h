@@ -0,0 +1,68 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_SCHED_H_
+#define _DLB_LIGHT_SCHED_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * DlbLightThreadPolicy:
+ * @DLB_LIGHT_THREAD_POLICY_OTHER: default time-sharing scheduling
+ * @DLB_LIGHT_THREAD_POLICY_FIFO: real-time first-in, first-out scheduling
+ * @DLB_LIGHT_THREAD_POLICY_RR: real-time round-robin scheduling
+ *
+ * Scheduling policy requested for a thread driven by a light element.
+ */
+typedef enum {
+  DLB_LIGHT_THREAD_POLICY_OTHER,
+  DLB_LIGHT_THREAD_POLICY_FIFO,
+  DLB_LIGHT_THREAD_POLICY_RR,
+} DlbLightThreadPolicy;
+
+#define DLB_TYPE_LIGHT_THREAD_POLICY            (dlb_light_thread_policy_get_type())
+
+GType dlb_light_thread_policy_get_type (void);
+
+/**
+ * DlbLightThreadSettings:
+ * @policy: scheduling policy
+ * @priority: real-time priority, only used by the real-time policies
+ * @affinity: CPU list such as "0,2-3", or %NULL to keep the affinity
+ *
+ * Scheduling settings applied to the calling thread by
+ * dlb_light_thread_settings_apply().
+ */
+typedef struct {
+  DlbLightThreadPolicy policy;
+  gint priority;
+  gchar *affinity;
+} DlbLightThreadSettings;
+
+void dlb_light_thread_settings_apply (const DlbLightThreadSettings * settings,
+    GstObject * object, const gchar * thread_name);
+
+gboolean dlb_light_lock_memory (GstObject * object);
+
+G_END_DECLS
+
+#endif /* _DLB_LIGHT_SCHED_H_ */
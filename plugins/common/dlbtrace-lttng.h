@@ -0,0 +1,102 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* LTTng-UST provider of the tracepoints in dlbtrace.h */
+
+#undef TRACEPOINT_PROVIDER
+#define TRACEPOINT_PROVIDER dlb_light
+
+#undef TRACEPOINT_INCLUDE
+#define TRACEPOINT_INCLUDE "./dlbtrace-lttng.h"
+
+#if !defined (_DLB_TRACE_LTTNG_H_) || defined (TRACEPOINT_HEADER_MULTI_READ)
+#define _DLB_TRACE_LTTNG_H_
+
+#include <stdint.h>
+#include <lttng/tracepoint.h>
+
+TRACEPOINT_EVENT (dlb_light, parse_frame_entry,
+    TP_ARGS (const char *, element, uint64_t, pts, uint64_t, size),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (uint64_t, size, size)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, parse_frame_exit,
+    TP_ARGS (const char *, element, uint64_t, pts, int, flow),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (int, flow, flow)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, render_start,
+    TP_ARGS (const char *, element, uint64_t, pts, uint64_t, size),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (uint64_t, size, size)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, render_end,
+    TP_ARGS (const char *, element, uint64_t, pts, uint64_t, size),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (uint64_t, size, size)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, show_frame_start,
+    TP_ARGS (const char *, element, uint64_t, pts, uint64_t, size),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (uint64_t, size, size)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, show_frame_end,
+    TP_ARGS (const char *, element, uint64_t, pts, int, flow),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (int, flow, flow)
+    )
+)
+
+TRACEPOINT_EVENT (dlb_light, clock_wait,
+    TP_ARGS (const char *, element, uint64_t, pts, uint64_t, target,
+        int64_t, lateness),
+    TP_FIELDS (
+        ctf_string (element, element)
+        ctf_integer (uint64_t, pts, pts)
+        ctf_integer (uint64_t, target, target)
+        ctf_integer (int64_t, lateness, lateness)
+    )
+)
+
+#endif /* _DLB_TRACE_LTTNG_H_ */
+
+#include <lttng/tracepoint-event.h>
@@ -0,0 +1,76 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_TRACE_H_
+#define _DLB_TRACE_H_
+
+#include <gst/gst.h>
+
+/**
+ * SECTION:dlbtrace
+ *
+ * Static tracepoints on the per-frame paths, built in with
+ * `-Dtracing=sdt` (systemtap, perf, bpftrace) or `-Dtracing=lttng`
+ * (LTTng-UST). An SDT probe is a nop until a tracer attaches to it and an
+ * LTTng tracepoint a predicted branch until its event is enabled. Without
+ * the option DLB_TRACE() compiles to nothing.
+ *
+ * Every probe starts with the element name and the buffer PTS, the
+ * remaining arguments are:
+ *
+ *   parse_frame_entry   size of the input
+ *   parse_frame_exit    GstFlowReturn
+ *   render_start        size of the renderer input
+ *   render_end          size of the renderer output
+ *   show_frame_start    size of the frame
+ *   show_frame_end      GstFlowReturn
+ *   clock_wait          target time, lateness (negative when early)
+ *
+ * The probes are in the dlb_light provider, for example
+ * `lttng enable-event -u 'dlb_light:*'` or the `usdt:*:dlb_light:*` probes
+ * of bpftrace on the plugin library.
+ */
+
+#if defined (DLB_TRACE_SDT)
+#include <sys/sdt.h>
+#define _DLB_TRACE(probe, ...) STAP_PROBEV (dlb_light, probe, __VA_ARGS__)
+#elif defined (DLB_TRACE_LTTNG)
+#include "dlbtrace-lttng.h"
+#define _DLB_TRACE(probe, ...) tracepoint (dlb_light, probe, __VA_ARGS__)
+#endif
+
+#ifdef _DLB_TRACE
+#define DLB_TRACE(probe, obj, pts, ...) \
+  _DLB_TRACE (probe, GST_OBJECT_NAME (obj), (guint64) (pts), __VA_ARGS__)
+#else
+/* never evaluated, only keeps values computed for the probes used */
+static inline void
+dlb_trace_unused (G_GNUC_UNUSED gconstpointer obj, ...)
+{
+}
+
+#define DLB_TRACE(probe, obj, pts, ...) \
+  G_STMT_START { \
+    if (0) \
+      dlb_trace_unused (obj, pts, __VA_ARGS__); \
+  } G_STMT_END
+#endif
+
+#endif /* _DLB_TRACE_H_ */
@@ -0,0 +1,594 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightbin
+ *
+ * Plays a demuxed LSM light stream on a light output. The bin contains
+ * dlblsmparse and dlblightning, an optional #DlbLightBin:light-filter such
+ * as a converter, and the #DlbLightBin:light-sink, which is a
+ * dlblighttextsink unless set.
+ *
+ * Queues split the pipeline into three threads: the upstream demuxer, the
+ * parser and renderer, and the light output. The renderer therefore never
+ * blocks the demuxer and a slow device never stalls rendering. The queues
+ * are sized in frames of the negotiated frame period, deep enough on the
+ * input to absorb demuxer bursts with #DlbLightBin:input-queue-frames, and
+ * shallow towards the device with #DlbLightBin:device-queue-frames to keep
+ * the latency low.
+ *
+ * The main parser and renderer properties are exposed on the bin, all
+ * others can be set on the "parse" and "lightning" children.
+ *
+ * ## Example launch line
+ * |[
+ * gst-launch-1.0 filesrc location=show.mp4 ! qtdemux ! \
+ *     dlblightbin config=/path/to/config.bin light-sink="dlblighttextsink sync=false"
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightbin.h"
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_bin_debug_category);
+#define GST_CAT_DEFAULT dlb_light_bin_debug_category
+
+enum
+{
+  PROP_0,
+  PROP_LIGHT_SINK,
+  PROP_LIGHT_FILTER,
+  PROP_INPUT_QUEUE_FRAMES,
+  PROP_DEVICE_QUEUE_FRAMES,
+  PROP_CONFIG,
+  PROP_LIGHTNESS,
+  PROP_RENDER_AHEAD,
+  PROP_DECIMATE,
+  PROP_GAP_THRESHOLD,
+};
+
+#define DEFAULT_INPUT_QUEUE_FRAMES 25
+#define DEFAULT_DEVICE_QUEUE_FRAMES 2
+#define MAX_QUEUE_FRAMES 1000
+/* until the parser negotiates, in microseconds like the caps */
+#define DEFAULT_FRAME_PERIOD_US 40000
+
+/* defaults of the proxied child properties */
+#define DEFAULT_LIGHTNESS 1.0
+#define DEFAULT_RENDER_AHEAD 0
+#define MAX_RENDER_AHEAD 250
+#define DEFAULT_DECIMATE TRUE
+#define DEFAULT_GAP_THRESHOLD (100 * GST_MSECOND)
+
+#define DEFAULT_LIGHT_SINK "dlblighttextsink"
+
+static GstStaticPadTemplate dlb_light_bin_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/octet-stream, uri = (string) { urn:oid:1.2.6.1.4.6729.1.3 }; ")
+    );
+
+G_DEFINE_TYPE_WITH_CODE (DlbLightBin, dlb_light_bin, GST_TYPE_BIN,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_bin_debug_category, "dlblightbin", 0,
+        "debug category for dlblightbin element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightbin, "dlblightbin", GST_RANK_NONE,
+                             DLB_TYPE_LIGHT_BIN);
+
+static void
+dlb_light_bin_update_queues (DlbLightBin * bin)
+{
+  guint input_frames, device_frames;
+  GstClockTime period;
+
+  GST_OBJECT_LOCK (bin);
+  input_frames = bin->input_queue_frames;
+  device_frames = bin->device_queue_frames;
+  period = bin->frame_period;
+  GST_OBJECT_UNLOCK (bin);
+
+  /* reported when going to READY */
+  if (bin->missing)
+    return;
+
+  GST_DEBUG_OBJECT (bin, "queues of %u and %u frames of %" GST_TIME_FORMAT,
+      input_frames, device_frames, GST_TIME_ARGS (period));
+
+  g_object_set (bin->input_queue, "max-size-buffers", input_frames,
+      "max-size-time", (guint64) (input_frames * period),
+      "max-size-bytes", 0, NULL);
+  g_object_set (bin->device_queue, "max-size-buffers", device_frames,
+      "max-size-time", (guint64) (device_frames * period),
+      "max-size-bytes", 0, NULL);
+}
+
+static GstPadProbeReturn
+dlb_light_bin_caps_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  DlbLightBin *bin = DLB_LIGHT_BIN (user_data);
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstStructure *s;
+  GstCaps *caps;
+  gint period;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS)
+    return GST_PAD_PROBE_OK;
+
+  gst_event_parse_caps (event, &caps);
+  s = gst_caps_get_structure (caps, 0);
+
+  if (!gst_structure_get_int (s, "frame-period", &period) || period <= 0)
+    return GST_PAD_PROBE_OK;
+
+  GST_OBJECT_LOCK (bin);
+  bin->frame_period = period * GST_USECOND;
+  GST_OBJECT_UNLOCK (bin);
+
+  dlb_light_bin_update_queues (bin);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+dlb_light_bin_add_tail (DlbLightBin * bin)
+{
+  GstElement *filter, *sink;
+  gboolean linked;
+
+  GST_OBJECT_LOCK (bin);
+  filter = bin->filter ? gst_object_ref (bin->filter) : NULL;
+  sink = bin->sink ? gst_object_ref (bin->sink) : NULL;
+  GST_OBJECT_UNLOCK (bin);
+
+  if (!sink) {
+    sink = gst_element_factory_make (DEFAULT_LIGHT_SINK, NULL);
+    if (!sink) {
+      GST_ELEMENT_ERROR (bin, CORE, MISSING_PLUGIN, (NULL),
+          ("no light-sink set and no %s element", DEFAULT_LIGHT_SINK));
+      gst_clear_object (&filter);
+      return FALSE;
+    }
+    gst_object_ref_sink (sink);
+  }
+
+  if (!gst_bin_add (GST_BIN (bin), sink))
+    goto add_failed;
+  bin->tail_sink = sink;
+
+  if (filter) {
+    if (!gst_bin_add (GST_BIN (bin), filter))
+      goto add_failed;
+    bin->tail_filter = filter;
+    linked = gst_element_link_many (bin->lightning, filter,
+        bin->device_queue, sink, NULL);
+  } else {
+    linked = gst_element_link_many (bin->lightning, bin->device_queue, sink,
+        NULL);
+  }
+
+  if (!linked) {
+    GST_ELEMENT_ERROR (bin, CORE, NEGOTIATION, (NULL),
+        ("could not link %s to the renderer",
+            filter ? "light-filter and light-sink" : "light-sink"));
+    return FALSE;
+  }
+
+  return TRUE;
+
+add_failed:
+  GST_ELEMENT_ERROR (bin, CORE, FAILED, (NULL),
+      ("could not add %s, is it in another bin?",
+          bin->tail_sink ? "light-filter" : "light-sink"));
+  if (!bin->tail_sink)
+    gst_object_unref (sink);
+  gst_clear_object (&filter);
+  return FALSE;
+}
+
+static void
+dlb_light_bin_remove_tail (DlbLightBin * bin)
+{
+  if (bin->tail_filter) {
+    gst_element_unlink_many (bin->lightning, bin->tail_filter,
+        bin->device_queue, NULL);
+    gst_bin_remove (GST_BIN (bin), bin->tail_filter);
+  } else {
+    gst_element_unlink (bin->lightning, bin->device_queue);
+  }
+
+  if (bin->tail_sink) {
+    gst_element_unlink (bin->device_queue, bin->tail_sink);
+    gst_bin_remove (GST_BIN (bin), bin->tail_sink);
+  }
+
+  gst_clear_object (&bin->tail_filter);
+  gst_clear_object (&bin->tail_sink);
+}
+
+static void
+dlb_light_bin_set_child (GstElement * child, GParamSpec * pspec,
+    const GValue * value)
+{
+  if (child)
+    g_object_set_property (G_OBJECT (child), pspec->name, value);
+}
+
+static void
+dlb_light_bin_get_child (GstElement * child, GParamSpec * pspec,
+    GValue * value)
+{
+  if (child)
+    g_object_get_property (G_OBJECT (child), pspec->name, value);
+  else
+    g_param_value_set_default (pspec, value);
+}
+
+static void
+dlb_light_bin_replace_element (DlbLightBin * bin, GstElement ** element,
+    const GValue * value)
+{
+  GstElement *new_element = g_value_get_object (value);
+  GstElement *old_element;
+
+  if (new_element)
+    gst_object_ref_sink (new_element);
+
+  GST_OBJECT_LOCK (bin);
+  old_element = *element;
+  *element = new_element;
+  GST_OBJECT_UNLOCK (bin);
+
+  if (old_element)
+    gst_object_unref (old_element);
+}
+
+static void
+dlb_light_bin_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightBin *bin = DLB_LIGHT_BIN (object);
+
+  switch (property_id) {
+    case PROP_LIGHT_SINK:
+      dlb_light_bin_replace_element (bin, &bin->sink, value);
+      break;
+    case PROP_LIGHT_FILTER:
+      dlb_light_bin_replace_element (bin, &bin->filter, value);
+      break;
+    case PROP_INPUT_QUEUE_FRAMES:
+      GST_OBJECT_LOCK (bin);
+      bin->input_queue_frames = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (bin);
+      dlb_light_bin_update_queues (bin);
+      break;
+    case PROP_DEVICE_QUEUE_FRAMES:
+      GST_OBJECT_LOCK (bin);
+      bin->device_queue_frames = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (bin);
+      dlb_light_bin_update_queues (bin);
+      break;
+    case PROP_CONFIG:
+    case PROP_LIGHTNESS:
+    case PROP_RENDER_AHEAD:
+      dlb_light_bin_set_child (bin->lightning, pspec, value);
+      break;
+    case PROP_DECIMATE:
+    case PROP_GAP_THRESHOLD:
+      dlb_light_bin_set_child (bin->parse, pspec, value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_bin_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightBin *bin = DLB_LIGHT_BIN (object);
+
+  switch (property_id) {
+    case PROP_LIGHT_SINK:
+      GST_OBJECT_LOCK (bin);
+      g_value_set_object (value, bin->sink);
+      GST_OBJECT_UNLOCK (bin);
+      break;
+    case PROP_LIGHT_FILTER:
+      GST_OBJECT_LOCK (bin);
+      g_value_set_object (value, bin->filter);
+      GST_OBJECT_UNLOCK (bin);
+      break;
+    case PROP_INPUT_QUEUE_FRAMES:
+      GST_OBJECT_LOCK (bin);
+      g_value_set_uint (value, bin->input_queue_frames);
+      GST_OBJECT_UNLOCK (bin);
+      break;
+    case PROP_DEVICE_QUEUE_FRAMES:
+      GST_OBJECT_LOCK (bin);
+      g_value_set_uint (value, bin->device_queue_frames);
+      GST_OBJECT_UNLOCK (bin);
+      break;
+    case PROP_CONFIG:
+    case PROP_LIGHTNESS:
+    case PROP_RENDER_AHEAD:
+      dlb_light_bin_get_child (bin->lightning, pspec, value);
+      break;
+    case PROP_DECIMATE:
+    case PROP_GAP_THRESHOLD:
+      dlb_light_bin_get_child (bin->parse, pspec, value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static GstStateChangeReturn
+dlb_light_bin_change_state (GstElement * element, GstStateChange transition)
+{
+  DlbLightBin *bin = DLB_LIGHT_BIN (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (bin->missing) {
+        GST_ELEMENT_ERROR (bin, CORE, MISSING_PLUGIN, (NULL),
+            ("no %s element", bin->missing));
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      if (!dlb_light_bin_add_tail (bin)) {
+        dlb_light_bin_remove_tail (bin);
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (dlb_light_bin_parent_class)->change_state (element,
+      transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (ret == GST_STATE_CHANGE_FAILURE)
+        dlb_light_bin_remove_tail (bin);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      dlb_light_bin_remove_tail (bin);
+      GST_OBJECT_LOCK (bin);
+      bin->frame_period = DEFAULT_FRAME_PERIOD_US * GST_USECOND;
+      GST_OBJECT_UNLOCK (bin);
+      dlb_light_bin_update_queues (bin);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+dlb_light_bin_dispose (GObject * object)
+{
+  DlbLightBin *bin = DLB_LIGHT_BIN (object);
+
+  gst_clear_object (&bin->tail_filter);
+  gst_clear_object (&bin->tail_sink);
+  gst_clear_object (&bin->filter);
+  gst_clear_object (&bin->sink);
+
+  G_OBJECT_CLASS (dlb_light_bin_parent_class)->dispose (object);
+}
+
+static void
+dlb_light_bin_class_init (DlbLightBinClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_bin_sink_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "Dolby Lightscapes bin",
+      "Generic/Bin/Light",
+      "Parse, render and output an LSM light stream",
+      "Dolby Support <support@dolby.com>");
+
+  gobject_class->set_property = dlb_light_bin_set_property;
+  gobject_class->get_property = dlb_light_bin_get_property;
+  gobject_class->dispose = dlb_light_bin_dispose;
+  element_class->change_state = GST_DEBUG_FUNCPTR (dlb_light_bin_change_state);
+
+  /**
+   * DlbLightBin:light-sink:
+   *
+   * Element the rendered frames are sent to, a dlblighttextsink when not
+   * set. Used from the next time the bin goes to READY.
+   */
+  g_object_class_install_property (gobject_class, PROP_LIGHT_SINK,
+      g_param_spec_object ("light-sink", "Light sink",
+          "Light output element (NULL = " DEFAULT_LIGHT_SINK ")",
+          GST_TYPE_ELEMENT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBin:light-filter:
+   *
+   * Optional element between the renderer and the device queue, for example
+   * to convert the rendered frames for the light-sink. It runs on the
+   * renderer thread.
+   */
+  g_object_class_install_property (gobject_class, PROP_LIGHT_FILTER,
+      g_param_spec_object ("light-filter", "Light filter",
+          "Element run on the rendered frames before the light sink",
+          GST_TYPE_ELEMENT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBin:input-queue-frames:
+   *
+   * Frames buffered between the upstream demuxer and the parser. The queue
+   * also holds at most this many frame periods of data.
+   */
+  g_object_class_install_property (gobject_class, PROP_INPUT_QUEUE_FRAMES,
+      g_param_spec_uint ("input-queue-frames", "Input queue frames",
+          "Frames buffered before the parser",
+          1, MAX_QUEUE_FRAMES, DEFAULT_INPUT_QUEUE_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightBin:device-queue-frames:
+   *
+   * Rendered frames buffered before the light-sink. Each frame adds a frame
+   * period of latency when the device is slow.
+   */
+  g_object_class_install_property (gobject_class, PROP_DEVICE_QUEUE_FRAMES,
+      g_param_spec_uint ("device-queue-frames", "Device queue frames",
+          "Rendered frames buffered before the light sink",
+          1, MAX_QUEUE_FRAMES, DEFAULT_DEVICE_QUEUE_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /* proxies of dlblightning and dlblsmparse properties */
+  g_object_class_install_property (gobject_class, PROP_CONFIG,
+      g_param_spec_string ("config", "Lightscapes configuration",
+          "Serialized Lightscapes configuration file", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_LIGHTNESS,
+      g_param_spec_float ("lightness", "Global lightness",
+          "Global lightness value", 0.0, 1.0, DEFAULT_LIGHTNESS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_AHEAD,
+      g_param_spec_uint ("render-ahead", "Render ahead",
+          "Number of frames to render ahead of the sink (0 = disabled)",
+          0, MAX_RENDER_AHEAD, DEFAULT_RENDER_AHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DECIMATE,
+      g_param_spec_boolean ("decimate", "Decimate",
+          "Drop frames that cannot be presented at high rates and in trick mode",
+          DEFAULT_DECIMATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_GAP_THRESHOLD,
+      g_param_spec_uint64 ("gap-threshold", "Gap threshold",
+          "Longest hole in the stream not signalled with a GAP event "
+          "(0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_GAP_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+}
+
+/* Releases a stage that was created but never added to the bin */
+static void
+dlb_light_bin_drop_stage (GstElement ** stage)
+{
+  if (*stage == NULL)
+    return;
+
+  gst_object_ref_sink (*stage);
+  gst_clear_object (stage);
+}
+
+static void
+dlb_light_bin_init (DlbLightBin * bin)
+{
+  GstPadTemplate *templ;
+  GstPad *target, *pad;
+
+  bin->input_queue_frames = DEFAULT_INPUT_QUEUE_FRAMES;
+  bin->device_queue_frames = DEFAULT_DEVICE_QUEUE_FRAMES;
+  bin->frame_period = DEFAULT_FRAME_PERIOD_US * GST_USECOND;
+  bin->missing = NULL;
+
+  /* the queues are the thread boundaries, parse and render share one */
+  bin->input_queue = gst_element_factory_make ("queue", "input-queue");
+  bin->parse = gst_element_factory_make ("dlblsmparse", "parse");
+  bin->lightning = gst_element_factory_make ("dlblightning", "lightning");
+  bin->device_queue = gst_element_factory_make ("queue", "device-queue");
+
+  if (!bin->input_queue || !bin->device_queue)
+    bin->missing = "queue";
+  else if (!bin->parse)
+    bin->missing = "dlblsmparse";
+  else if (!bin->lightning)
+    bin->missing = "dlblightning";
+
+  templ = gst_static_pad_template_get (&dlb_light_bin_sink_template);
+
+  if (bin->missing) {
+    /* reported when going to READY */
+    GST_WARNING_OBJECT (bin, "no %s element", bin->missing);
+    dlb_light_bin_drop_stage (&bin->input_queue);
+    dlb_light_bin_drop_stage (&bin->parse);
+    dlb_light_bin_drop_stage (&bin->lightning);
+    dlb_light_bin_drop_stage (&bin->device_queue);
+
+    pad = gst_ghost_pad_new_no_target_from_template ("sink", templ);
+    gst_element_add_pad (GST_ELEMENT (bin), pad);
+    gst_object_unref (templ);
+    return;
+  }
+
+  gst_bin_add_many (GST_BIN (bin), bin->input_queue, bin->parse,
+      bin->lightning, bin->device_queue, NULL);
+  gst_element_link_many (bin->input_queue, bin->parse, bin->lightning, NULL);
+  dlb_light_bin_update_queues (bin);
+
+  pad = gst_element_get_static_pad (bin->parse, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      dlb_light_bin_caps_probe, bin, NULL);
+  gst_object_unref (pad);
+
+  target = gst_element_get_static_pad (bin->input_queue, "sink");
+  pad = gst_ghost_pad_new_from_template ("sink", target, templ);
+  gst_element_add_pad (GST_ELEMENT (bin), pad);
+  gst_object_unref (target);
+  gst_object_unref (templ);
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightbin, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightbin,
+    "Dolby Lightscapes bin",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -0,0 +1,70 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_BIN_H_
+#define _DLB_LIGHT_BIN_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define DLB_TYPE_LIGHT_BIN   (dlb_light_bin_get_type())
+#define DLB_LIGHT_BIN(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),DLB_TYPE_LIGHT_BIN,DlbLightBin))
+#define DLB_LIGHT_BIN_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),DLB_TYPE_LIGHT_BIN,DlbLightBinClass))
+#define DLB_IS_LIGHT_BIN(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),DLB_TYPE_LIGHT_BIN))
+#define DLB_IS_LIGHT_BIN_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),DLB_TYPE_LIGHT_BIN))
+typedef struct _DlbLightBin DlbLightBin;
+typedef struct _DlbLightBinClass DlbLightBinClass;
+
+struct _DlbLightBin
+{
+    GstBin          parent;
+
+    /* fixed stages, owned by the bin */
+    GstElement     *input_queue;
+    GstElement     *parse;
+    GstElement     *lightning;
+    GstElement     *device_queue;
+    /* factory of the first stage that could not be created, NULL if none */
+    const gchar    *missing;
+
+    /* configured tail, protected by OBJECT_LOCK */
+    GstElement     *filter;
+    GstElement     *sink;
+
+    /* tail linked in the bin between READY and NULL */
+    GstElement     *tail_filter;
+    GstElement     *tail_sink;
+
+    /* queue sizing, protected by OBJECT_LOCK */
+    guint           input_queue_frames;
+    guint           device_queue_frames;
+    GstClockTime    frame_period;
+};
+
+struct _DlbLightBinClass
+{
+    GstBinClass     parent_class;
+};
+
+GType dlb_light_bin_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightbin);
+
+G_END_DECLS
+#endif // _DLB_LIGHT_BIN_H_
@@ -23,17 +23,20 @@
 #endif
 
 #include <assert.h>
+#include <string.h>
 #include <gst/gst.h>
 #include <gst/base/base.h>
 #include <gst/base/gstbasetransform.h>
 
 #include "dlblightning.h"
 #include "dlb_lightscapes.h"
+#include "dlbtrace.h"
 
 GST_DEBUG_CATEGORY_STATIC (dlb_lightning_debug_category);
 #define GST_CAT_DEFAULT dlb_lightning_debug_category
 
 /* prototypes */
+static void dlb_lightning_finalize (GObject * object);
 static void dlb_lightning_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 static void dlb_lightning_get_property (GObject * object,
@@ -45,16 +48,51 @@ static gboolean dlb_lightning_set_caps (GstBaseTransform * trans,
 static gboolean dlb_lightning_transform_size (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, gsize size, GstCaps * othercaps,
     gsize * othersize);
+static GstStateChangeReturn dlb_lightning_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean dlb_lightning_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
 static gboolean dlb_lightning_start (GstBaseTransform * trans);
 static gboolean dlb_lightning_stop (GstBaseTransform * trans);
+static GstFlowReturn dlb_lightning_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer ** outbuf);
 static GstFlowReturn dlb_lightning_transform (GstBaseTransform * trans,
     GstBuffer * inbuf, GstBuffer * outbuf); /* Lightning process */
+static GstFlowReturn dlb_lightning_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input);
+static GstFlowReturn dlb_lightning_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf);
+static GstFlowReturn dlb_lightning_chain_list (GstPad * pad,
+    GstObject * parent, GstBufferList * list);
+static gboolean dlb_lightning_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
 
 /* helper functions definitions */
+static gboolean lightning_load_library (DlbLightning * lightning);
 static gboolean lightning_open (DlbLightning * lightning);
 static void lightning_close (DlbLightning * lightning);
 static gboolean lightning_restart (DlbLightning * lightning);
 static gboolean lightning_is_opened (DlbLightning * lightning);
+static void lightning_reset (DlbLightning * lightning);
+static void lightning_attach_layout (DlbLightning * lightning, GstBuffer * outbuf,
+    const guint8 * data, gsize size);
+static void lightning_apply_thread_settings (DlbLightning * lightning);
+static GstClockTime lightning_get_deadline (DlbLightning * lightning,
+    GstBuffer * inbuf);
+static void lightning_render (gpointer user_data);
+static void lightning_begin_frame (DlbLightning * lightning, GstBuffer * inbuf);
+static void lightning_report_load (DlbLightning * lightning,
+    GstClockTime render_time, GstClockTime frame_period);
+static void lightning_update_position (GstBaseTransform * trans,
+    GstBuffer * inbuf);
+static GstFlowReturn lightning_render_buffer (GstBuffer * inbuf,
+    GstBuffer ** outbuf, gpointer user_data);
+static GstFlowReturn lightning_render_ahead (GstBuffer * inbuf,
+    GstBuffer * outbuf, gpointer user_data);
+static GstFlowReturn lightning_drain (DlbLightning * lightning);
+static void lightning_prewarm_config (DlbLightning * lightning);
+static void lightning_prewarm_renderer (DlbLightning * lightning);
+static void lightning_prewarm_stop (DlbLightning * lightning);
 
 enum
 {
@@ -63,8 +101,57 @@ enum
   PROP_LIGHTNESS,
   PROP_ZONE_IMMERSION_LEVEL,
   PROP_ZONE_LOW_IMMERSION,
+  PROP_THREAD_POLICY,
+  PROP_THREAD_PRIORITY,
+  PROP_THREAD_AFFINITY,
+  PROP_LOCK_MEMORY,
+  PROP_SHARED_RENDER_POOL,
+  PROP_SEEK_RECOVERY_TIME,
+  PROP_RENDER_CACHE_SIZE,
+  PROP_RENDER_CACHE_HITS,
+  PROP_RENDER_CACHE_MISSES,
+  PROP_RENDER_AHEAD,
+  PROP_RENDER_AHEAD_LEVEL,
+  PROP_RENDER_AHEAD_TIME,
+  PROP_PREWARM,
+  PROP_PREWARM_HINT,
+  PROP_EXPECTED_MAX_OBJECTS,
+  PROP_EXPECTED_COLOR_SPACE,
+  PROP_EXPECTED_FRAME_PERIOD,
+  PROP_RENDERER_PREWARMED,
+  PROP_STARTUP_TIME_SAVED,
 };
 
+#define DEFAULT_THREAD_POLICY DLB_LIGHT_THREAD_POLICY_OTHER
+#define DEFAULT_THREAD_PRIORITY 0
+#define DEFAULT_THREAD_AFFINITY NULL
+#define DEFAULT_LOCK_MEMORY FALSE
+#define DEFAULT_SHARED_RENDER_POOL FALSE
+#define DEFAULT_RENDER_CACHE_SIZE 0
+#define DEFAULT_RENDER_AHEAD 0
+#define MAX_RENDER_AHEAD 250
+#define DEFAULT_PREWARM FALSE
+#define DEFAULT_PREWARM_HINT NULL
+#define DEFAULT_EXPECTED -1
+
+/* frames rendered without a load report after upstream refused one */
+#define LOAD_REPORT_RETRY 50
+
+/* group of the prewarm hint file, keys are named after the caps fields */
+#define PREWARM_HINT_GROUP "stream"
+
+typedef struct
+{
+  DlbLightning *lightning;
+  guint8 *in;
+  gsize in_size;
+  guint8 *out;
+  gsize out_size;
+  GstClockTime pts;
+  /* copied, so that rendering needs no object lock */
+  DlbLightningParams *params;
+} LightningFrame;
+
 /* pad templates */
 static GstStaticPadTemplate dlb_lightning_src_template =
     GST_STATIC_PAD_TEMPLATE ("src",
@@ -90,11 +177,14 @@ static GstStaticPadTemplate dlb_lightning_sink_template =
 G_DEFINE_TYPE_WITH_CODE (DlbLightning, dlb_lightning, GST_TYPE_BASE_TRANSFORM,
     GST_DEBUG_CATEGORY_INIT (dlb_lightning_debug_category, "dlblightning", 0,
         "debug category for lightning element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightning, "dlblightning", GST_RANK_PRIMARY,
+                             DLB_TYPE_LIGHTNING);
 
 static void
 dlb_lightning_class_init (DlbLightningClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
 
@@ -110,14 +200,24 @@ dlb_lightning_class_init (DlbLightningClass * klass)
       "Plugin for rendering of Dolby Lightscapes",
       "Dolby Support <support@dolby.com>");
 
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (dlb_lightning_finalize);
   gobject_class->set_property = GST_DEBUG_FUNCPTR (dlb_lightning_set_property);
   gobject_class->get_property = GST_DEBUG_FUNCPTR (dlb_lightning_get_property);
+  element_class->change_state = GST_DEBUG_FUNCPTR (dlb_lightning_change_state);
   base_transform_class->transform_caps = GST_DEBUG_FUNCPTR (dlb_lightning_transform_caps);
   base_transform_class->set_caps = GST_DEBUG_FUNCPTR (dlb_lightning_set_caps);
   base_transform_class->transform_size = GST_DEBUG_FUNCPTR (dlb_lightning_transform_size);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (dlb_lightning_sink_event);
   base_transform_class->start = GST_DEBUG_FUNCPTR (dlb_lightning_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (dlb_lightning_stop);
+  base_transform_class->prepare_output_buffer =
+      GST_DEBUG_FUNCPTR (dlb_lightning_prepare_output_buffer);
   base_transform_class->transform = GST_DEBUG_FUNCPTR (dlb_lightning_transform);
+  base_transform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (dlb_lightning_submit_input_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (dlb_lightning_generate_output);
+  base_transform_class->query = GST_DEBUG_FUNCPTR (dlb_lightning_query);
 
   /* install properties */
   g_object_class_install_property (gobject_class, PROP_CONFIG,
@@ -144,6 +244,232 @@ dlb_lightning_class_init (DlbLightningClass * klass)
           g_param_spec_int ("zone-low-immersions", "zones", "zones", 0, 1, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS),
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT |
           GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightning:thread-policy:
+   *
+   * Scheduling policy applied to the streaming thread that renders the
+   * light frames. The thread belongs to the upstream task, so the setting
+   * stays with it until it is changed again. Falls back to the current
+   * policy with a warning when the privilege is missing.
+   */
+  g_object_class_install_property (gobject_class, PROP_THREAD_POLICY,
+      g_param_spec_enum ("thread-policy", "Thread policy",
+          "Scheduling policy of the rendering streaming thread",
+          DLB_TYPE_LIGHT_THREAD_POLICY, DEFAULT_THREAD_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_THREAD_PRIORITY,
+      g_param_spec_int ("thread-priority", "Thread priority",
+          "Real-time priority of the rendering streaming thread (fifo and rr policies only)",
+          0, 99, DEFAULT_THREAD_PRIORITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_THREAD_AFFINITY,
+      g_param_spec_string ("thread-affinity", "Thread affinity",
+          "CPU list the rendering streaming thread is pinned to (e.g. \"0,2-3\")",
+          DEFAULT_THREAD_AFFINITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_LOCK_MEMORY,
+      g_param_spec_boolean ("lock-memory", "Lock memory",
+          "Lock process memory on start to avoid page faults while rendering",
+          DEFAULT_LOCK_MEMORY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightning:shared-render-pool:
+   *
+   * Whether to render frames on the process-wide render pool instead of
+   * the streaming thread. The pool has one worker per core and is shared by
+   * every element with this property set, frames being rendered
+   * earliest-deadline-first by running time. Meant for processes running
+   * many light pipelines at once.
+   */
+  g_object_class_install_property (gobject_class, PROP_SHARED_RENDER_POOL,
+      g_param_spec_boolean ("shared-render-pool", "Shared render pool",
+          "Render on the process-wide worker pool",
+          DEFAULT_SHARED_RENDER_POOL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightning:seek-recovery-time:
+   *
+   * Time between the last flush and the first frame rendered at the new
+   * position, including the warm-up frames supplied by the parser (see
+   * #DlbLsmParse:warmup-frames).
+   */
+  g_object_class_install_property (gobject_class, PROP_SEEK_RECOVERY_TIME,
+      g_param_spec_uint64 ("seek-recovery-time", "Seek recovery time",
+          "Time from the last flush to the first output frame in nanoseconds",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightning:render-cache-size:
+   *
+   * Size in bytes of a cache of rendered frames, keyed by the LSM frame,
+   * the runtime parameters and the configuration. A cached frame is pushed
+   * again without rendering when the same input shows up, e.g. when a clip
+   * is looped, with the least recently used frames evicted first. 0
+   * disables the cache.
+   *
+   * A cache hit skips the renderer entirely, so its temporal state is not
+   * updated. The renderer is reset after a hit, so the next rendered frame
+   * is not blended with the frames before it, but cached frames still carry
+   * the state they were rendered with. Only enable this for content and
+   * configurations where the output of a frame does not depend on the
+   * previous ones. The cache is not used with #DlbLightning:render-ahead.
+   */
+  g_object_class_install_property (gobject_class, PROP_RENDER_CACHE_SIZE,
+      g_param_spec_uint64 ("render-cache-size", "Render cache size",
+          "Size of the cache of rendered frames in bytes (0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_RENDER_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_CACHE_HITS,
+      g_param_spec_uint64 ("render-cache-hits", "Render cache hits",
+          "Number of frames served from the render cache",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_CACHE_MISSES,
+      g_param_spec_uint64 ("render-cache-misses", "Render cache misses",
+          "Number of frames rendered because they were not cached",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightning:render-ahead:
+   *
+   * Number of frames to render ahead on a dedicated thread. Incoming frames
+   * are rendered as soon as they arrive and pushed once this many newer
+   * frames are queued behind them, so a slow frame is absorbed by the ones
+   * rendered before it instead of arriving late at the sink. Changes to the
+   * lightness or the zone settings apply from the next frame to be
+   * rendered, so frames rendered ahead already keep the old settings. Adds
+   * as many frame periods of latency, so it is meant for file playback.
+   * 0 renders every frame on the streaming thread.
+   */
+  g_object_class_install_property (gobject_class, PROP_RENDER_AHEAD,
+      g_param_spec_uint ("render-ahead", "Render ahead",
+          "Number of frames to render ahead of the sink (0 = disabled)",
+          0, MAX_RENDER_AHEAD, DEFAULT_RENDER_AHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightning:render-ahead-level:
+   *
+   * Number of frames rendered ahead and ready to be pushed.
+   */
+  g_object_class_install_property (gobject_class, PROP_RENDER_AHEAD_LEVEL,
+      g_param_spec_uint ("render-ahead-level", "Render-ahead level",
+          "Number of frames rendered and ready to be pushed",
+          0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightning:render-ahead-time:
+   *
+   * Duration of the frames rendered ahead and ready to be pushed, i.e. how
+   * long rendering could stall without a frame arriving late.
+   */
+  g_object_class_install_property (gobject_class, PROP_RENDER_AHEAD_TIME,
+      g_param_spec_uint64 ("render-ahead-time", "Render-ahead time",
+          "Duration of the frames rendered and ready to be pushed in nanoseconds",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightning:prewarm:
+   *
+   * Get the renderer ready before the stream starts. The configuration file
+   * is read on a helper thread as soon as #DlbLightning:config is set, and
+   * on the NULL to READY transition a renderer is created for the expected
+   * stream parameters (#DlbLightning:expected-max-objects,
+   * #DlbLightning:expected-color-space, #DlbLightning:expected-frame-period,
+   * or #DlbLightning:prewarm-hint). When the negotiated caps match, that
+   * renderer is used right away; otherwise a new one is created as usual.
+   */
+  g_object_class_install_property (gobject_class, PROP_PREWARM,
+      g_param_spec_boolean ("prewarm", "Prewarm",
+          "Load the configuration and create the renderer before caps arrive",
+          DEFAULT_PREWARM,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightning:prewarm-hint:
+   *
+   * Key file with the expected stream parameters, for when they are not
+   * set as properties. The keys of its "stream" group are named after the
+   * caps fields:
+   *
+   * |[
+   * [stream]
+   * max-objects=16
+   * color-space=0
+   * frame-period=40000
+   * ]|
+   */
+  g_object_class_install_property (gobject_class, PROP_PREWARM_HINT,
+      g_param_spec_string ("prewarm-hint", "Prewarm hint",
+          "Key file with the expected stream parameters", DEFAULT_PREWARM_HINT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_EXPECTED_MAX_OBJECTS,
+      g_param_spec_int ("expected-max-objects", "Expected max objects",
+          "Expected max-objects of the stream for prewarm (-1 = from the hint)",
+          -1, G_MAXINT, DEFAULT_EXPECTED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_EXPECTED_COLOR_SPACE,
+      g_param_spec_int ("expected-color-space", "Expected color space",
+          "Expected color-space of the stream for prewarm (-1 = from the hint)",
+          -1, G_MAXINT, DEFAULT_EXPECTED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_EXPECTED_FRAME_PERIOD,
+      g_param_spec_int ("expected-frame-period", "Expected frame period",
+          "Expected frame-period of the stream in microseconds for prewarm "
+          "(-1 = from the hint)",
+          -1, G_MAXINT, DEFAULT_EXPECTED,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightning:renderer-prewarmed:
+   *
+   * Whether the current renderer was created ahead by
+   * #DlbLightning:prewarm.
+   */
+  g_object_class_install_property (gobject_class, PROP_RENDERER_PREWARMED,
+      g_param_spec_boolean ("renderer-prewarmed", "Renderer prewarmed",
+          "Whether the current renderer was created before caps arrived",
+          FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightning:startup-time-saved:
+   *
+   * Time the configuration load and renderer creation would have added to
+   * caps negotiation without #DlbLightning:prewarm, i.e. the part of that
+   * work that was done before it was needed.
+   */
+  g_object_class_install_property (gobject_class, PROP_STARTUP_TIME_SAVED,
+      g_param_spec_uint64 ("startup-time-saved", "Startup time saved",
+          "Startup work done ahead by prewarm in nanoseconds",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -152,18 +478,71 @@ dlb_lightning_init (DlbLightning * lightning)
     GST_DEBUG_OBJECT (lightning, "lightning_init");
   lightning->config_path = NULL;
   lightning->renderer_instance = NULL;
+  g_mutex_init (&lightning->render_lock);
   lightning->renderer_config.serialized_conf = NULL;
   lightning->renderer_config.serialized_conf_size = 0;
   lightning->renderer_config.color_space = 0;
   lightning->renderer_config.max_num_objs = 0;
   lightning->renderer_config.max_num_md = 0;
   lightning->max_output_size = 0;
+  lightning->layout = NULL;
+  lightning->thread_settings.policy = DEFAULT_THREAD_POLICY;
+  lightning->thread_settings.priority = DEFAULT_THREAD_PRIORITY;
+  lightning->thread_settings.affinity = NULL;
+  lightning->lock_memory = DEFAULT_LOCK_MEMORY;
+  lightning->streaming_thread = NULL;
+  lightning->shared_render_pool = DEFAULT_SHARED_RENDER_POOL;
+  lightning->render_stream = NULL;
+  lightning->state_clean = TRUE;
+  lightning->flush_time = GST_CLOCK_TIME_NONE;
+  lightning->warmup_count = 0;
+  lightning->seek_recovery_time = 0;
+  lightning->load_report_skip = 0;
+  lightning->in_list = FALSE;
+  lightning->list_render_time = 0;
+  lightning->list_frames = 0;
+  lightning->render_cache_size = DEFAULT_RENDER_CACHE_SIZE;
+  lightning->render_cache = NULL;
+  lightning->config_id = 0;
+  lightning->cache_miss = FALSE;
+  lightning->cache_hit = FALSE;
+  lightning->cache_hits = 0;
+  lightning->cache_misses = 0;
+  lightning->render_ahead_depth = DEFAULT_RENDER_AHEAD;
+  lightning->render_ahead = NULL;
+  lightning->prewarm = DEFAULT_PREWARM;
+  lightning->prewarm_hint = DEFAULT_PREWARM_HINT;
+  lightning->expected_max_objects = DEFAULT_EXPECTED;
+  lightning->expected_color_space = DEFAULT_EXPECTED;
+  lightning->expected_frame_period = DEFAULT_EXPECTED;
+  g_mutex_init (&lightning->prewarm_lock);
+  lightning->renderer_prewarm = NULL;
+  lightning->renderer_prewarmed = FALSE;
+  lightning->startup_time_saved = 0;
   
   lightning->global_lightness = 1.0f;
   for (unsigned i = 0; i < MAX_NUM_PERSONALIZATION_ZONES; i++) {
     lightning->a_zone_immersion_levels[i] = 1.0f;
     lightning->a_zone_low_immersion[i] = 0;
   }
+
+  gst_pad_set_chain_list_function (GST_BASE_TRANSFORM_SINK_PAD (lightning),
+      GST_DEBUG_FUNCPTR (dlb_lightning_chain_list));
+}
+
+static void
+dlb_lightning_finalize (GObject * object)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (object);
+
+  g_free (lightning->thread_settings.affinity);
+  g_free (lightning->config_path);
+  g_free (lightning->prewarm_hint);
+  lightning_prewarm_stop (lightning);
+  g_mutex_clear (&lightning->prewarm_lock);
+  g_mutex_clear (&lightning->render_lock);
+
+  G_OBJECT_CLASS (dlb_lightning_parent_class)->finalize (object);
 }
 
 static void
@@ -220,6 +599,44 @@ dlb_lightning_set_property (GObject * object, guint property_id,
     case PROP_ZONE_LOW_IMMERSION:
       dlb_lightning_set_low_immersion (lightning, value);
       break;
+    case PROP_THREAD_POLICY:
+      lightning->thread_settings.policy = g_value_get_enum (value);
+      break;
+    case PROP_THREAD_PRIORITY:
+      lightning->thread_settings.priority = g_value_get_int (value);
+      break;
+    case PROP_THREAD_AFFINITY:
+      g_free (lightning->thread_settings.affinity);
+      lightning->thread_settings.affinity = g_value_dup_string (value);
+      break;
+    case PROP_LOCK_MEMORY:
+      lightning->lock_memory = g_value_get_boolean (value);
+      break;
+    case PROP_SHARED_RENDER_POOL:
+      lightning->shared_render_pool = g_value_get_boolean (value);
+      break;
+    case PROP_RENDER_CACHE_SIZE:
+      lightning->render_cache_size = g_value_get_uint64 (value);
+      break;
+    case PROP_RENDER_AHEAD:
+      lightning->render_ahead_depth = g_value_get_uint (value);
+      break;
+    case PROP_PREWARM:
+      lightning->prewarm = g_value_get_boolean (value);
+      break;
+    case PROP_PREWARM_HINT:
+      g_free (lightning->prewarm_hint);
+      lightning->prewarm_hint = g_value_dup_string (value);
+      break;
+    case PROP_EXPECTED_MAX_OBJECTS:
+      lightning->expected_max_objects = g_value_get_int (value);
+      break;
+    case PROP_EXPECTED_COLOR_SPACE:
+      lightning->expected_color_space = g_value_get_int (value);
+      break;
+    case PROP_EXPECTED_FRAME_PERIOD:
+      lightning->expected_frame_period = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -227,6 +644,9 @@ dlb_lightning_set_property (GObject * object, guint property_id,
 
   GST_OBJECT_UNLOCK (lightning);
 
+  if (reneg)
+    lightning_prewarm_config (lightning);
+
   if (reneg && lightning_is_opened (lightning)) {
     lightning_restart (lightning);
     gst_base_transform_reconfigure_src (GST_BASE_TRANSFORM_CAST (lightning));
@@ -252,6 +672,70 @@ dlb_lightning_get_property (GObject * object, guint property_id,
     case PROP_ZONE_IMMERSION_LEVEL:
     case PROP_ZONE_LOW_IMMERSION:
       break;
+    case PROP_THREAD_POLICY:
+      g_value_set_enum (value, lightning->thread_settings.policy);
+      break;
+    case PROP_THREAD_PRIORITY:
+      g_value_set_int (value, lightning->thread_settings.priority);
+      break;
+    case PROP_THREAD_AFFINITY:
+      g_value_set_string (value, lightning->thread_settings.affinity);
+      break;
+    case PROP_LOCK_MEMORY:
+      g_value_set_boolean (value, lightning->lock_memory);
+      break;
+    case PROP_SHARED_RENDER_POOL:
+      g_value_set_boolean (value, lightning->shared_render_pool);
+      break;
+    case PROP_SEEK_RECOVERY_TIME:
+      g_value_set_uint64 (value, lightning->seek_recovery_time);
+      break;
+    case PROP_RENDER_CACHE_SIZE:
+      g_value_set_uint64 (value, lightning->render_cache_size);
+      break;
+    case PROP_RENDER_CACHE_HITS:
+      g_value_set_uint64 (value, lightning->cache_hits);
+      break;
+    case PROP_RENDER_CACHE_MISSES:
+      g_value_set_uint64 (value, lightning->cache_misses);
+      break;
+    case PROP_RENDER_AHEAD:
+      g_value_set_uint (value, lightning->render_ahead_depth);
+      break;
+    case PROP_RENDER_AHEAD_LEVEL:
+      g_value_set_uint (value, lightning->render_ahead ?
+          dlb_render_ahead_get_level (lightning->render_ahead, NULL) : 0);
+      break;
+    case PROP_RENDER_AHEAD_TIME:
+    {
+      GstClockTime time = 0;
+
+      if (lightning->render_ahead)
+        dlb_render_ahead_get_level (lightning->render_ahead, &time);
+      g_value_set_uint64 (value, time);
+      break;
+    }
+    case PROP_PREWARM:
+      g_value_set_boolean (value, lightning->prewarm);
+      break;
+    case PROP_PREWARM_HINT:
+      g_value_set_string (value, lightning->prewarm_hint);
+      break;
+    case PROP_EXPECTED_MAX_OBJECTS:
+      g_value_set_int (value, lightning->expected_max_objects);
+      break;
+    case PROP_EXPECTED_COLOR_SPACE:
+      g_value_set_int (value, lightning->expected_color_space);
+      break;
+    case PROP_EXPECTED_FRAME_PERIOD:
+      g_value_set_int (value, lightning->expected_frame_period);
+      break;
+    case PROP_RENDERER_PREWARMED:
+      g_value_set_boolean (value, lightning->renderer_prewarmed);
+      break;
+    case PROP_STARTUP_TIME_SAVED:
+      g_value_set_uint64 (value, lightning->startup_time_saved);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -322,12 +806,15 @@ dlb_lightning_set_caps (GstBaseTransform * trans, GstCaps * incaps, GstCaps * ou
 
   lightning->renderer_config.max_num_md = 1;
 
+  g_mutex_lock (&lightning->render_lock);
   if (!lightning_is_opened (lightning)) {
       if (lightning_open (lightning) == FALSE) {
           lightning_close(lightning);
+          g_mutex_unlock (&lightning->render_lock);
           return FALSE;
       }
   }
+  g_mutex_unlock (&lightning->render_lock);
   return TRUE;
 }
 
@@ -342,13 +829,136 @@ dlb_lightning_transform_size (GstBaseTransform * trans, GstPadDirection directio
   return TRUE;
 }
 
+/* events */
+static gboolean
+dlb_lightning_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (trans);
+
+  if (lightning->render_ahead) {
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_FLUSH_START:
+        /* does not wait for the frame being rendered, the flush is
+         * forwarded right away */
+        dlb_render_ahead_set_flushing (lightning->render_ahead, TRUE);
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        /* downstream stopped flushing too, so this wait is short */
+        dlb_render_ahead_set_flushing (lightning->render_ahead, FALSE);
+        break;
+      default:
+        /* keep serialized events in order with the frames ahead of them */
+        if (GST_EVENT_IS_SERIALIZED (event))
+          lightning_drain (lightning);
+        break;
+    }
+  }
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      lightning_reset (lightning);
+      GST_OBJECT_LOCK (lightning);
+      lightning->flush_time = gst_util_get_timestamp ();
+      lightning->warmup_count = 0;
+      GST_OBJECT_UNLOCK (lightning);
+      break;
+    case GST_EVENT_SEGMENT:
+      /* a new segment is not necessarily contiguous with the last one */
+      lightning_reset (lightning);
+      break;
+    case GST_EVENT_GAP:
+      /* a hole in the sparse light track: forwarded right away, after the
+       * frames rendered ahead, so the sink prerolls. The renderer state
+       * is kept and the lights hold the last frame. */
+      GST_LOG_OBJECT (lightning, "gap %" GST_PTR_FORMAT, event);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->sink_event (trans, event);
+}
+
 /* states */
+static GstStateChangeReturn
+dlb_lightning_change_state (GstElement * element, GstStateChange transition)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!lightning_load_library (lightning))
+        return GST_STATE_CHANGE_FAILURE;
+      lightning_prewarm_renderer (lightning);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (dlb_lightning_parent_class)->change_state (element,
+      transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      lightning_prewarm_stop (lightning);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
 static gboolean
 dlb_lightning_start (GstBaseTransform * trans)
 {
   DlbLightning *lightning = DLB_LIGHTNING (trans);
+  gboolean lock_memory, shared_render_pool;
+  guint64 render_cache_size;
+  guint render_ahead_depth;
   GST_DEBUG_OBJECT (lightning, "start");
 
+  GST_OBJECT_LOCK (lightning);
+  lock_memory = lightning->lock_memory;
+  shared_render_pool = lightning->shared_render_pool;
+  render_cache_size = lightning->render_cache_size;
+  render_ahead_depth = lightning->render_ahead_depth;
+  lightning->cache_hits = 0;
+  lightning->cache_misses = 0;
+  GST_OBJECT_UNLOCK (lightning);
+
+  lightning->streaming_thread = NULL;
+  lightning->load_report_skip = 0;
+  if (lock_memory)
+    dlb_light_lock_memory (GST_OBJECT_CAST (lightning));
+
+  if (shared_render_pool) {
+    lightning->render_stream = dlb_render_stream_new ();
+    if (lightning->render_stream == NULL)
+      GST_WARNING_OBJECT (lightning, "shared render pool unavailable, "
+          "rendering on the streaming thread");
+  }
+
+  if (render_ahead_depth > 0) {
+    DlbRenderAhead *ahead = dlb_render_ahead_new (render_ahead_depth,
+        lightning_render_ahead, lightning);
+
+    if (ahead == NULL)
+      GST_WARNING_OBJECT (lightning, "render-ahead unavailable, rendering "
+          "on the streaming thread");
+    GST_OBJECT_LOCK (lightning);
+    lightning->render_ahead = ahead;
+    GST_OBJECT_UNLOCK (lightning);
+  }
+
+  /* a hit replaces the output buffer, which render-ahead allocates before
+   * the frame reaches the renderer */
+  if (render_cache_size > 0 && lightning->render_ahead)
+    GST_WARNING_OBJECT (lightning, "render cache not used with render-ahead");
+  else if (render_cache_size > 0)
+    lightning->render_cache = dlb_render_cache_new (render_cache_size);
+
   return TRUE;
 }
 
@@ -356,12 +966,94 @@ static gboolean
 dlb_lightning_stop (GstBaseTransform * trans)
 {
   DlbLightning *lightning = DLB_LIGHTNING (trans);
+  DlbRenderAhead *ahead;
   GST_DEBUG_OBJECT (lightning, "stop");
 
+  /* stopped first, the thread renders with everything below */
+  GST_OBJECT_LOCK (lightning);
+  ahead = lightning->render_ahead;
+  lightning->render_ahead = NULL;
+  GST_OBJECT_UNLOCK (lightning);
+  if (ahead)
+    dlb_render_ahead_free (ahead);
+
+  if (lightning->render_stream) {
+    dlb_render_stream_free (lightning->render_stream);
+    lightning->render_stream = NULL;
+  }
+
+  if (lightning->render_cache) {
+    GST_DEBUG_OBJECT (lightning, "render cache: %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses, %" G_GSIZE_FORMAT " bytes",
+        lightning->cache_hits, lightning->cache_misses,
+        dlb_render_cache_get_size (lightning->render_cache));
+    dlb_render_cache_free (lightning->render_cache);
+    lightning->render_cache = NULL;
+  }
+  lightning->cache_miss = FALSE;
+  lightning->cache_hit = FALSE;
+
+  g_mutex_lock (&lightning->render_lock);
   lightning_close (lightning);
+  g_mutex_unlock (&lightning->render_lock);
   return TRUE;
 }
 
+/* On a render cache hit the cached frame becomes the output buffer and
+ * transform() has nothing left to do. On a miss it adds the rendered frame
+ * to the cache. */
+static GstFlowReturn
+dlb_lightning_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * inbuf, GstBuffer ** outbuf)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (trans);
+  DlbRenderCacheKey key;
+  GstBuffer *cached;
+  GstMapInfo map;
+
+  lightning->cache_miss = FALSE;
+  lightning->cache_hit = FALSE;
+
+  lightning_begin_frame (lightning, inbuf);
+
+  if (lightning->render_cache == NULL ||
+      GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_DECODE_ONLY) ||
+      gst_buffer_get_size (inbuf) == 0 ||
+      !gst_buffer_map (inbuf, &map, GST_MAP_READ))
+    goto render;
+
+  dlb_render_cache_key_init (&key, &lightning->params,
+      sizeof (lightning->params), map.data, map.size);
+  cached = dlb_render_cache_lookup (lightning->render_cache, &key);
+  gst_buffer_unmap (inbuf, &map);
+  if (cached == NULL) {
+    lightning->cache_miss = TRUE;
+    goto render;
+  }
+
+  *outbuf = gst_buffer_copy (cached);
+  gst_buffer_unref (cached);
+  GST_BUFFER_FLAGS (*outbuf) = 0;
+  gst_buffer_copy_into (*outbuf, inbuf,
+      GST_BUFFER_COPY_TIMESTAMPS | GST_BUFFER_COPY_FLAGS, 0, -1);
+
+  GST_OBJECT_LOCK (lightning);
+  lightning->cache_hits++;
+  GST_OBJECT_UNLOCK (lightning);
+
+  GST_LOG_OBJECT (lightning, "render cache hit, ts=%" GST_TIME_FORMAT,
+      GST_TIME_ARGS (GST_BUFFER_PTS (inbuf)));
+  /* the renderer does not see the frame, so its state no longer follows
+   * the stream */
+  lightning_reset (lightning);
+  lightning->cache_hit = TRUE;
+  return GST_FLOW_OK;
+
+render:
+  return GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->prepare_output_buffer
+      (trans, inbuf, outbuf);
+}
+
 /* transform */
 static GstFlowReturn
 dlb_lightning_transform (GstBaseTransform * trans, GstBuffer * inbuf,
@@ -369,8 +1061,20 @@ dlb_lightning_transform (GstBaseTransform * trans, GstBuffer * inbuf,
 {
   DlbLightning *lightning = DLB_LIGHTNING (trans);
   GstMapInfo outbuf_map, inbuf_map;
+  GstClockTime deadline = GST_CLOCK_TIME_NONE;
+  GstClockTime render_start, render_time, frame_period;
+  LightningFrame frame;
 
-  GST_OBJECT_LOCK (trans);
+  if (lightning->cache_hit) {
+    lightning->cache_hit = FALSE;
+    return GST_FLOW_OK;
+  }
+
+  lightning_apply_thread_settings (lightning);
+
+  /* takes the object lock, so done before the render lock */
+  if (lightning->render_stream)
+    deadline = lightning_get_deadline (lightning, inbuf);
 
   gst_buffer_map (inbuf, &inbuf_map, GST_MAP_READ);
   GST_DEBUG_OBJECT(lightning, "Input buffer size %ld", inbuf_map.size);
@@ -378,31 +1082,547 @@ dlb_lightning_transform (GstBaseTransform * trans, GstBuffer * inbuf,
   if (G_UNLIKELY(inbuf_map.size == 0)) {
       GST_LOG_OBJECT(lightning, "Input buffer empty, producing no output");
       gst_buffer_unmap (inbuf, &inbuf_map);
-      goto no_output;
+      return GST_BASE_TRANSFORM_FLOW_DROPPED;
   }
 
+  g_mutex_lock (&lightning->render_lock);
+
   gst_buffer_map (outbuf, &outbuf_map, GST_MAP_READWRITE);
-  gsize outsize = outbuf_map.size;
-  dlb_lsr_process (lightning->renderer_instance, inbuf_map.size, inbuf_map.data, &outsize, outbuf_map.data, lightning->a_zone_immersion_levels, lightning->a_zone_low_immersion, lightning->global_lightness);
+  frame.lightning = lightning;
+  frame.params = &lightning->params;
+  frame.in = inbuf_map.data;
+  frame.in_size = inbuf_map.size;
+  frame.out = outbuf_map.data;
+  frame.out_size = outbuf_map.size;
+  frame.pts = GST_BUFFER_PTS (inbuf);
+
+  render_start = gst_util_get_timestamp ();
+  if (lightning->render_stream)
+    dlb_render_stream_process (lightning->render_stream, deadline,
+        lightning_render, &frame);
+  else
+    lightning_render (&frame);
+  render_time = gst_util_get_timestamp () - render_start;
+  frame_period = lightning->renderer_config.frame_period_us * GST_USECOND;
+  lightning->state_clean = FALSE;
+
+  g_mutex_unlock (&lightning->render_lock);
+
+  gsize outsize = frame.out_size;
   GST_DEBUG_OBJECT(lightning, "Output buffer size %ld", outsize);
 
+  if (GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_DECODE_ONLY)) {
+    /* warm-up frame, only there to build up the renderer state */
+    gst_buffer_unmap (outbuf, &outbuf_map);
+    gst_buffer_unmap (inbuf, &inbuf_map);
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  lightning_attach_layout (lightning, outbuf, outbuf_map.data, outsize);
+
   gst_buffer_resize (outbuf, 0, outsize);
   gst_buffer_unmap (outbuf, &outbuf_map);
+
+  if (lightning->cache_miss) {
+    DlbRenderCacheKey key;
+
+    GST_OBJECT_LOCK (trans);
+    lightning->cache_misses++;
+    GST_OBJECT_UNLOCK (trans);
+    dlb_render_cache_key_init (&key, &lightning->params,
+        sizeof (lightning->params), inbuf_map.data, inbuf_map.size);
+    dlb_render_cache_insert (lightning->render_cache, &key, outbuf);
+    lightning->cache_miss = FALSE;
+  }
   gst_buffer_unmap (inbuf, &inbuf_map);
 
-  GST_OBJECT_UNLOCK (trans);
+  if (lightning->in_list) {
+    lightning->list_render_time += render_time;
+    lightning->list_frames++;
+  } else {
+    lightning_report_load (lightning, render_time, frame_period);
+  }
   return GST_FLOW_OK;
+}
+
+/* Render-ahead mode: the output buffer is allocated here, on the streaming
+ * thread that negotiated the caps and the pool, and handed to the
+ * render-ahead thread with the input. The oldest rendered frame, if it is
+ * due, is pushed instead. */
+static GstFlowReturn
+dlb_lightning_submit_input_buffer (GstBaseTransform * trans, gboolean is_discont,
+    GstBuffer * input)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (trans);
+  GstBuffer *inbuf, *outbuf = NULL;
+  GstFlowReturn ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->submit_input_buffer
+      (trans, is_discont, input);
 
-no_output:
+  if (ret != GST_FLOW_OK || lightning->render_ahead == NULL ||
+      trans->queued_buf == NULL)
+    return ret;
+
+  inbuf = trans->queued_buf;
+  trans->queued_buf = NULL;
+
+  if (!gst_pad_has_current_caps (GST_BASE_TRANSFORM_SRC_PAD (trans))) {
+    GST_ELEMENT_WARNING (trans, STREAM, FORMAT, ("not negotiated"),
+        ("not negotiated"));
+    gst_buffer_unref (inbuf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  ret = GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->prepare_output_buffer
+      (trans, inbuf, &outbuf);
+  if (ret != GST_FLOW_OK || outbuf == NULL) {
+    GST_DEBUG_OBJECT (lightning, "could not get an output buffer: %s",
+        gst_flow_get_name (ret));
+    gst_buffer_unref (inbuf);
+    return ret == GST_FLOW_OK ? GST_FLOW_ERROR : ret;
+  }
+
+  dlb_render_ahead_push (lightning->render_ahead, inbuf, outbuf);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+dlb_lightning_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (trans);
+
+  if (lightning->render_ahead == NULL)
+    return GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->generate_output
+        (trans, outbuf);
+
+  return dlb_render_ahead_pop (lightning->render_ahead, FALSE, outbuf);
+}
+
+/* Buffer lists, as pushed by the parser when upstream is not live, are
+ * rendered in one pass and pushed on as one list, with a single load
+ * report, updating the segment position like the base class does. Render-
+ * ahead, QoS, renegotiation and discontinuities need the per-buffer path of
+ * the base class, which then handles every buffer of the list. Downstream,
+ * the light sinks only show a list at once when they do not sync and have
+ * no device thread (see #DlbLightBaseSink:async-device-write). */
+static GstFlowReturn
+dlb_lightning_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM_CAST (parent);
+  DlbLightning *lightning = DLB_LIGHTNING (parent);
+  GstPad *srcpad = GST_BASE_TRANSFORM_SRC_PAD (trans);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBufferList *outlist;
+  GstPadChainFunction chain;
+  guint len, i;
+
+  len = gst_buffer_list_length (list);
+
+  if (lightning->render_ahead || gst_base_transform_is_qos_enabled (trans) ||
+      !gst_pad_has_current_caps (srcpad) || gst_pad_needs_reconfigure (srcpad))
+    goto per_buffer;
+
+  for (i = 0; i < len; i++) {
+    if (GST_BUFFER_IS_DISCONT (gst_buffer_list_get (list, i)))
+      goto per_buffer;
+  }
+
+  GST_LOG_OBJECT (lightning, "rendering a list of %u frames", len);
+
+  outlist = gst_buffer_list_new_sized (len);
+  lightning->in_list = TRUE;
+  lightning->list_render_time = 0;
+  lightning->list_frames = 0;
+
+  for (i = 0; i < len && ret == GST_FLOW_OK; i++) {
+    GstBuffer *inbuf = gst_buffer_list_get (list, i);
+    GstBuffer *outbuf;
+
+    ret = lightning_render_buffer (inbuf, &outbuf, lightning);
+    if (outbuf)
+      gst_buffer_list_add (outlist, outbuf);
+    if (ret == GST_FLOW_OK)
+      lightning_update_position (trans, inbuf);
+  }
+
+  lightning->in_list = FALSE;
+  gst_buffer_list_unref (list);
+
+  if (lightning->list_frames > 0)
+    lightning_report_load (lightning,
+        lightning->list_render_time / lightning->list_frames,
+        lightning->renderer_config.frame_period_us * GST_USECOND);
+
+  if (ret != GST_FLOW_OK || gst_buffer_list_length (outlist) == 0) {
+    gst_buffer_list_unref (outlist);
+    return ret;
+  }
+
+  return gst_pad_push_list (srcpad, outlist);
+
+per_buffer:
+  chain = GST_PAD_CHAINFUNC (pad);
+  for (i = 0; i < len && ret == GST_FLOW_OK; i++)
+    ret = chain (pad, parent, gst_buffer_ref (gst_buffer_list_get (list, i)));
+  gst_buffer_list_unref (list);
+
+  return ret;
+}
+
+/* Frames are held back by the render-ahead depth */
+static gboolean
+dlb_lightning_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (trans);
+  GstClockTime min, max, delay;
+  gboolean live;
+
+  if (!GST_BASE_TRANSFORM_CLASS (dlb_lightning_parent_class)->query (trans,
+          direction, query))
+    return FALSE;
+
+  if (direction == GST_PAD_SRC && GST_QUERY_TYPE (query) == GST_QUERY_LATENCY &&
+      lightning->render_ahead) {
+    gst_query_parse_latency (query, &live, &min, &max);
+    delay = lightning->render_ahead_depth *
+        lightning->renderer_config.frame_period_us * GST_USECOND;
+    GST_DEBUG_OBJECT (lightning, "adding %" GST_TIME_FORMAT " of render-ahead "
+        "latency", GST_TIME_ARGS (delay));
+    min += delay;
+    if (GST_CLOCK_TIME_IS_VALID (max))
+      max += delay;
+    gst_query_set_latency (query, live, min, max);
+  }
+
+  return TRUE;
+}
+
+/* Segment position after @inbuf, as set by the base class chain function */
+static void
+lightning_update_position (GstBaseTransform * trans, GstBuffer * inbuf)
+{
+  GstClockTime position = GST_BUFFER_PTS (inbuf);
+
+  if (!GST_CLOCK_TIME_IS_VALID (position))
+    return;
+
+  if (trans->segment.rate >= 0.0 && GST_BUFFER_DURATION_IS_VALID (inbuf))
+    position += GST_BUFFER_DURATION (inbuf);
+
+  GST_OBJECT_LOCK (trans);
+  trans->segment.position = position;
   GST_OBJECT_UNLOCK (trans);
-  return GST_BASE_TRANSFORM_FLOW_DROPPED;
 }
 
+/* Renders one buffer of a list, outside of the base class chain function */
+static GstFlowReturn
+lightning_render_buffer (GstBuffer * inbuf, GstBuffer ** outbuf,
+    gpointer user_data)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM_CAST (user_data);
+  GstFlowReturn ret;
+
+  *outbuf = NULL;
+  ret = dlb_lightning_prepare_output_buffer (trans, inbuf, outbuf);
+  if (ret == GST_FLOW_OK)
+    ret = dlb_lightning_transform (trans, inbuf, *outbuf);
+
+  if (ret != GST_FLOW_OK && *outbuf) {
+    gst_buffer_unref (*outbuf);
+    *outbuf = NULL;
+  }
+
+  return ret == GST_BASE_TRANSFORM_FLOW_DROPPED ? GST_FLOW_OK : ret;
+}
+
+/* Runs on the render-ahead thread, in input order. Only renders into the
+ * output buffer allocated on the streaming thread. */
+static GstFlowReturn
+lightning_render_ahead (GstBuffer * inbuf, GstBuffer * outbuf,
+    gpointer user_data)
+{
+  DlbLightning *lightning = DLB_LIGHTNING (user_data);
+
+  lightning_begin_frame (lightning, inbuf);
+
+  return dlb_lightning_transform (GST_BASE_TRANSFORM_CAST (lightning), inbuf,
+      outbuf);
+}
+
+/* Push every frame rendered ahead, e.g. before EOS */
+static GstFlowReturn
+lightning_drain (DlbLightning * lightning)
+{
+  GstFlowReturn ret;
+  GstBuffer *outbuf;
+
+  while (TRUE) {
+    ret = dlb_render_ahead_pop (lightning->render_ahead, TRUE, &outbuf);
+    if (ret != GST_FLOW_OK || outbuf == NULL)
+      break;
+
+    ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (lightning), outbuf);
+    if (ret != GST_FLOW_OK)
+      break;
+  }
+
+  if (ret != GST_FLOW_OK)
+    GST_DEBUG_OBJECT (lightning, "drain stopped: %s", gst_flow_get_name (ret));
+
+  return ret;
+}
+
+/* Called with the render lock held by the rendering thread, possibly from a
+ * worker of the shared render pool. */
+static void
+lightning_render (gpointer user_data)
+{
+  LightningFrame *frame = user_data;
+  DlbLightning *lightning = frame->lightning;
+
+  DLB_TRACE (render_start, lightning, frame->pts, frame->in_size);
+  dlb_lsr_process (lightning->renderer_instance, frame->in_size, frame->in,
+      &frame->out_size, frame->out, frame->params->zone_immersion_levels,
+      frame->params->zone_low_immersion, frame->params->lightness);
+  DLB_TRACE (render_end, lightning, frame->pts, frame->out_size);
+}
+
+/* Copies the render parameters of the next frame */
+static void
+lightning_take_params (DlbLightning * lightning)
+{
+  DlbLightningParams *params = &lightning->params;
+
+  GST_OBJECT_LOCK (lightning);
+  /* zeroed first, the padding is hashed into render cache keys */
+  memset (params, 0, sizeof (*params));
+  params->config_id = lightning->config_id;
+  memcpy (params->zone_immersion_levels, lightning->a_zone_immersion_levels,
+      sizeof (params->zone_immersion_levels));
+  memcpy (params->zone_low_immersion, lightning->a_zone_low_immersion,
+      sizeof (params->zone_low_immersion));
+  params->lightness = lightning->global_lightness;
+  GST_OBJECT_UNLOCK (lightning);
+}
+
+/* Bookkeeping of every frame, whether it is then rendered or served from the
+ * render cache: takes the render parameters, resets the renderer on a
+ * discontinuity and accounts for warm-up and seek recovery. Runs on the
+ * rendering thread, in stream order. */
+static void
+lightning_begin_frame (DlbLightning * lightning, GstBuffer * inbuf)
+{
+  lightning_take_params (lightning);
+
+  GST_OBJECT_LOCK (lightning);
+  if (gst_buffer_get_size (inbuf) == 0) {
+    /* no output */
+  } else if (GST_BUFFER_FLAG_IS_SET (inbuf, GST_BUFFER_FLAG_DECODE_ONLY)) {
+    /* warm-up frame, only there to build up the renderer state */
+    lightning->warmup_count++;
+  } else if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (lightning->flush_time))) {
+    lightning->seek_recovery_time = gst_util_get_timestamp () - lightning->flush_time;
+    lightning->flush_time = GST_CLOCK_TIME_NONE;
+    GST_INFO_OBJECT (lightning, "recovered from flush in %" GST_TIME_FORMAT
+        " after %u warm-up frames", GST_TIME_ARGS (lightning->seek_recovery_time),
+        lightning->warmup_count);
+  }
+  GST_OBJECT_UNLOCK (lightning);
+
+  /* discontinuous input, e.g. reverse playback fragments or trick mode,
+   * must not be blended with the previous frames */
+  if (GST_BUFFER_IS_DISCONT (inbuf)) {
+    GST_DEBUG_OBJECT (lightning, "discontinuity");
+    lightning_reset (lightning);
+  }
+}
+
+/* Identifies the renderer configuration in render cache keys. */
+static guint64
+lightning_hash_config (const dlb_lsr_init_info * config)
+{
+  /* 64-bit FNV-1a */
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  const guint64 prime = G_GUINT64_CONSTANT (0x100000001b3);
+  const guint fields[] = { config->color_space, config->max_num_objs,
+    config->max_num_md, config->frame_period_us };
+
+  for (gsize i = 0; i < config->serialized_conf_size; i++)
+    hash = (hash ^ config->serialized_conf[i]) * prime;
+  for (gsize i = 0; i < sizeof (fields); i++)
+    hash = (hash ^ ((const guint8 *) fields)[i]) * prime;
+
+  return hash;
+}
+
+/* Tell upstream how long the frame took to render, so the parser can adapt
+ * the number of objects to the available CPU (see
+ * #DlbLsmParse:adaptive-quality). Upstream refuses the report while it is not
+ * adapting, it is then only tried again after LOAD_REPORT_RETRY frames, so
+ * enabling adaptive-quality in PLAYING is still picked up. */
+static void
+lightning_report_load (DlbLightning * lightning, GstClockTime render_time,
+    GstClockTime frame_period)
+{
+  GstStructure *s;
+
+  if (lightning->load_report_skip > 0) {
+    lightning->load_report_skip--;
+    return;
+  }
+
+  s = gst_structure_new ("dlb-render-load",
+      "render-time", G_TYPE_UINT64, render_time,
+      "frame-period", G_TYPE_UINT64, frame_period, NULL);
+  if (!gst_pad_push_event (GST_BASE_TRANSFORM_SINK_PAD (lightning),
+          gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM, s))) {
+    GST_LOG_OBJECT (lightning, "render load not handled upstream, "
+        "next report in %u frames", LOAD_REPORT_RETRY);
+    lightning->load_report_skip = LOAD_REPORT_RETRY;
+  }
+}
+
+/* Absolute clock time the frame is due, comparable across pipelines
+ * sharing the render pool. */
+static GstClockTime
+lightning_get_deadline (DlbLightning * lightning, GstBuffer * inbuf)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM_CAST (lightning);
+  GstClockTime running_time;
+
+  if (trans->segment.format != GST_FORMAT_TIME)
+    return GST_CLOCK_TIME_NONE;
+
+  running_time = gst_segment_to_running_time (&trans->segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (inbuf));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_CLOCK_TIME_NONE;
+
+  return gst_element_get_base_time (GST_ELEMENT_CAST (lightning)) + running_time;
+}
+
+/* The layout only changes with the renderer configuration, so the strip
+ * table is computed once and shared while the frames keep matching it. */
+static void
+lightning_attach_layout (DlbLightning * lightning, GstBuffer * outbuf,
+    const guint8 * data, gsize size)
+{
+  if (lightning->layout == NULL ||
+      !dlb_light_layout_matches (lightning->layout, data, size)) {
+    if (lightning->layout)
+      dlb_light_layout_unref (lightning->layout);
+
+    lightning->layout = dlb_light_layout_new_from_data (data, size);
+    if (lightning->layout == NULL) {
+      GST_WARNING_OBJECT (lightning, "malformed output frame (%zu bytes), no layout meta", size);
+      return;
+    }
+    GST_DEBUG_OBJECT (lightning, "output layout changed, %u strips",
+        lightning->layout->num_strips);
+  }
+
+  dlb_buffer_add_light_layout_meta (outbuf, lightning->layout);
+}
+
+/* The streaming thread is owned by upstream and can change across state
+ * changes, so the settings are (re)applied whenever a new one shows up. */
+static void
+lightning_apply_thread_settings (DlbLightning * lightning)
+{
+  DlbLightThreadSettings settings;
+
+  if (G_LIKELY (lightning->streaming_thread == g_thread_self ()))
+    return;
+
+  lightning->streaming_thread = g_thread_self ();
+
+  GST_OBJECT_LOCK (lightning);
+  settings = lightning->thread_settings;
+  settings.affinity = g_strdup (settings.affinity);
+  GST_OBJECT_UNLOCK (lightning);
+
+  if (settings.policy != DLB_LIGHT_THREAD_POLICY_OTHER || settings.affinity)
+    dlb_light_thread_settings_apply (&settings, GST_OBJECT_CAST (lightning),
+        "streaming");
+  g_free (settings.affinity);
+}
+
+/* The renderer library is only resolved when an element is first put to
+ * use, so registry scans and pipelines without a renderer never load it.
+ * Only success is kept, a failure is retried by the next element to start,
+ * so a library installed later is picked up without a restart. */
 static gboolean
-lightning_open (DlbLightning * lightning)
+lightning_load_library (DlbLightning * lightning)
+{
+  #ifdef DLB_LIGHTSCAPES_OPEN_DYNLIB
+  static GMutex dynlib_lock;
+  static gboolean dynlib_loaded = FALSE;
+  gchar *error = NULL;
+
+  g_mutex_lock (&dynlib_lock);
+  if (!dynlib_loaded) {
+    if (dlb_lightscapes_try_open_dynlib () == 0) {
+      dynlib_loaded = TRUE;
+      GST_CAT_INFO (dlb_lightning_debug_category, "using %s build of %s",
+          dlb_lightscapes_get_variant (), DLB_LIGHTSCAPES_LIBNAME);
+    } else {
+      error = g_strdup (dlb_lightscapes_get_error ());
+    }
+  }
+  g_mutex_unlock (&dynlib_lock);
+
+  if (error) {
+    GST_ELEMENT_ERROR (lightning, LIBRARY, INIT, (NULL),
+        ("could not load %s: %s", DLB_LIGHTSCAPES_LIBNAME, error));
+    g_free (error);
+    return FALSE;
+  }
+  #endif
+
+  return TRUE;
+}
+
+/* Reads the configuration file, unless the prewarm thread already did.
+ * Called with the prewarm lock held. */
+static GBytes *
+lightning_get_config (DlbLightning * lightning)
 {
   GError *error = NULL;
   gchar *conf = NULL;
+  gsize size;
+
+  if (lightning->renderer_prewarm &&
+      dlb_renderer_prewarm_has_config (lightning->renderer_prewarm,
+          lightning->config_path)) {
+    GBytes *config = dlb_renderer_prewarm_get_config (lightning->renderer_prewarm);
+
+    if (config)
+      return config;
+  }
+
+  GST_INFO("getting device config");
+  g_file_get_contents (lightning->config_path, &conf, &size, &error);
+  if (error != NULL)
+  {
+    GST_ELEMENT_ERROR (lightning, LIBRARY, INIT, (NULL), ("device-config could not be read"));
+    g_clear_error (&error);
+    return NULL;
+  }
+
+  return g_bytes_new_take (conf, size);
+}
+
+static gboolean
+lightning_open (DlbLightning * lightning)
+{
+  GBytes *config;
+  dlb_lsr *instance = NULL;
+  GstClockTime saved = 0;
+  gboolean prewarmed;
   GST_DEBUG_OBJECT (lightning, "open");
 
   GST_INFO("checking device config path");
@@ -412,29 +1632,58 @@ lightning_open (DlbLightning * lightning)
     return FALSE;
   }
 
-  GST_INFO("getting device config");
-  g_file_get_contents (lightning->config_path, &conf, &lightning->renderer_config.serialized_conf_size, &error);
-  if (error != NULL)
-  {
-    GST_ELEMENT_ERROR (lightning, LIBRARY, INIT, (NULL), ("device-config could not be read"));
+  g_mutex_lock (&lightning->prewarm_lock);
+  config = lightning_get_config (lightning);
+  if (config == NULL) {
+    g_mutex_unlock (&lightning->prewarm_lock);
     return FALSE;
   }
-  lightning->renderer_config.serialized_conf = (guint8*)conf;
+  lightning->renderer_config.serialized_conf = g_bytes_get_data (config,
+      &lightning->renderer_config.serialized_conf_size);
+
+  if (lightning->renderer_prewarm &&
+      dlb_renderer_prewarm_has_config (lightning->renderer_prewarm,
+          lightning->config_path)) {
+    instance = dlb_renderer_prewarm_take (lightning->renderer_prewarm,
+        &lightning->renderer_config);
+    saved = dlb_renderer_prewarm_get_time_saved (lightning->renderer_prewarm);
+  }
+  g_mutex_unlock (&lightning->prewarm_lock);
+
+  prewarmed = instance != NULL;
+  if (prewarmed) {
+    GST_INFO_OBJECT (lightning, "using the prewarmed renderer, %"
+        GST_TIME_FORMAT " of startup saved", GST_TIME_ARGS (saved));
+  } else {
+    GST_INFO("opening lightning");
+    instance = dlb_lsr_new (&lightning->renderer_config);
+  }
 
-  GST_INFO("opening lightning");
-  lightning->renderer_instance = dlb_lsr_new (&lightning->renderer_config);
+  GST_OBJECT_LOCK (lightning);
+  lightning->renderer_prewarmed = prewarmed;
+  lightning->startup_time_saved = saved;
+  GST_OBJECT_UNLOCK (lightning);
+
+  lightning->renderer_instance = instance;
   if (lightning->renderer_instance == NULL)
   {
     GST_ELEMENT_ERROR (lightning, LIBRARY, INIT, (NULL), ("lightning could not be created"));
-    g_free (conf);
+    lightning->renderer_config.serialized_conf = NULL;
+    g_bytes_unref (config);
 
     return FALSE;
   }
+  lightning->state_clean = TRUE;
+  /* frames cached for a previous configuration no longer match and age out */
+  GST_OBJECT_LOCK (lightning);
+  lightning->config_id = lightning_hash_config (&lightning->renderer_config);
+  GST_OBJECT_UNLOCK (lightning);
   lightning->max_output_size = dlb_lsr_get_max_output_size(lightning->renderer_instance);
   GST_DEBUG_OBJECT (lightning, "max output size %zu", lightning->max_output_size);
 
   GST_INFO("releasing memory");
-  g_free (conf);
+  lightning->renderer_config.serialized_conf = NULL;
+  g_bytes_unref (config);
 
   return TRUE;
 }
@@ -448,44 +1697,192 @@ lightning_close (DlbLightning * lightning)
     GST_INFO("free-ing lightning");
     dlb_lsr_free (lightning->renderer_instance);
   }
-  if (lightning->config_path){
-    GST_INFO("free-ing device config string %s", lightning->config_path);
-    g_free(lightning->config_path);
+
+  if (lightning->layout) {
+    dlb_light_layout_unref (lightning->layout);
+    lightning->layout = NULL;
   }
 
   lightning->renderer_instance = NULL;
-  lightning->config_path = NULL;
+}
+
+/* Drop the temporal state of the renderer, so nothing carries over from the
+ * previous position. */
+static void
+lightning_reset (DlbLightning * lightning)
+{
+  g_mutex_lock (&lightning->render_lock);
+  if (lightning_is_opened (lightning) && !lightning->state_clean) {
+    GST_DEBUG_OBJECT (lightning, "resetting renderer state");
+    dlb_lsr_reset (lightning->renderer_instance);
+    lightning->state_clean = TRUE;
+  }
+  g_mutex_unlock (&lightning->render_lock);
 }
 
 static gboolean
 lightning_restart (DlbLightning * lightning)
 {
+  gboolean ret;
   GST_DEBUG_OBJECT (lightning, "restart");
 
+  g_mutex_lock (&lightning->render_lock);
   if (lightning->renderer_instance) {
       GST_INFO("free-ing lightning");
       dlb_lsr_free(lightning->renderer_instance);
       lightning->renderer_instance = NULL;
   }
 
-  return lightning_open (lightning);
+  ret = lightning_open (lightning);
+  g_mutex_unlock (&lightning->render_lock);
+
+  return ret;
 }
 
+/* The configuration is read on a helper thread as soon as it is set */
+static void
+lightning_prewarm_config (DlbLightning * lightning)
+{
+  DlbRendererPrewarm *prewarm = NULL, *old;
+  gchar *config_path;
+
+  GST_OBJECT_LOCK (lightning);
+  config_path = lightning->prewarm ? g_strdup (lightning->config_path) : NULL;
+  GST_OBJECT_UNLOCK (lightning);
+
+  if (config_path)
+    prewarm = dlb_renderer_prewarm_new (config_path);
+
+  g_mutex_lock (&lightning->prewarm_lock);
+  old = lightning->renderer_prewarm;
+  lightning->renderer_prewarm = prewarm;
+  g_mutex_unlock (&lightning->prewarm_lock);
+
+  if (old)
+    dlb_renderer_prewarm_free (old);
+  g_free (config_path);
+}
+
+/* A negative property leaves the value to the hint file */
 static gboolean
-plugin_init (GstPlugin * plugin)
+lightning_get_expected (GKeyFile * hint, const gchar * key, gint prop,
+    guint * value)
 {
-  #ifdef DLB_LIGHTNING_OPEN_DYNLIB
-  if (dlb_lightning_try_open_dynlib ())
+  GError *error = NULL;
+  gint hinted;
+
+  if (prop >= 0) {
+    *value = prop;
+    return TRUE;
+  }
+
+  if (hint == NULL)
     return FALSE;
-  #endif
 
-  if (!gst_element_register (plugin, "dlblightning", GST_RANK_PRIMARY, DLB_TYPE_LIGHTNING))
+  hinted = g_key_file_get_integer (hint, PREWARM_HINT_GROUP, key, &error);
+  if (error || hinted < 0) {
+    g_clear_error (&error);
     return FALSE;
+  }
 
+  *value = hinted;
   return TRUE;
 }
 
+/* Creates a renderer for the expected stream parameters, so set_caps only
+ * has to adopt it */
+static void
+lightning_prewarm_renderer (DlbLightning * lightning)
+{
+  dlb_lsr_init_info expected = { 0 };
+  GKeyFile *hint = NULL;
+  GError *error = NULL;
+  gchar *config_path, *hint_path;
+  gint max_objects, color_space, frame_period;
+  gboolean complete;
+
+  GST_OBJECT_LOCK (lightning);
+  if (!lightning->prewarm || lightning->config_path == NULL) {
+    GST_OBJECT_UNLOCK (lightning);
+    return;
+  }
+  config_path = g_strdup (lightning->config_path);
+  hint_path = g_strdup (lightning->prewarm_hint);
+  max_objects = lightning->expected_max_objects;
+  color_space = lightning->expected_color_space;
+  frame_period = lightning->expected_frame_period;
+  GST_OBJECT_UNLOCK (lightning);
+
+  g_mutex_lock (&lightning->prewarm_lock);
+  if (lightning->renderer_prewarm == NULL ||
+      !dlb_renderer_prewarm_has_config (lightning->renderer_prewarm,
+          config_path)) {
+    g_mutex_unlock (&lightning->prewarm_lock);
+    /* prewarm was enabled after the configuration was set */
+    lightning_prewarm_config (lightning);
+    g_mutex_lock (&lightning->prewarm_lock);
+  }
+
+  if (hint_path) {
+    hint = g_key_file_new ();
+    if (!g_key_file_load_from_file (hint, hint_path, G_KEY_FILE_NONE, &error)) {
+      GST_WARNING_OBJECT (lightning, "could not read prewarm hint %s: %s",
+          hint_path, error->message);
+      g_clear_error (&error);
+      g_clear_pointer (&hint, g_key_file_free);
+    }
+  }
+
+  expected.max_num_md = 1;
+  complete = lightning_get_expected (hint, "max-objects", max_objects,
+      &expected.max_num_objs);
+  complete &= lightning_get_expected (hint, "color-space", color_space,
+      &expected.color_space);
+  complete &= lightning_get_expected (hint, "frame-period", frame_period,
+      &expected.frame_period_us);
+
+  if (lightning->renderer_prewarm == NULL) {
+    GST_WARNING_OBJECT (lightning, "prewarm unavailable");
+  } else if (complete) {
+    GST_DEBUG_OBJECT (lightning, "prewarming renderer for %u objects, color "
+        "space %u, frame period %u us", expected.max_num_objs,
+        expected.color_space, expected.frame_period_us);
+    dlb_renderer_prewarm_create (lightning->renderer_prewarm, &expected);
+  } else {
+    GST_INFO_OBJECT (lightning, "expected stream parameters unknown, only "
+        "loading the configuration ahead");
+  }
+  g_mutex_unlock (&lightning->prewarm_lock);
+
+  if (hint)
+    g_key_file_free (hint);
+  g_free (hint_path);
+  g_free (config_path);
+}
+
+static void
+lightning_prewarm_stop (DlbLightning * lightning)
+{
+  DlbRendererPrewarm *prewarm;
+
+  g_mutex_lock (&lightning->prewarm_lock);
+  prewarm = lightning->renderer_prewarm;
+  lightning->renderer_prewarm = NULL;
+  g_mutex_unlock (&lightning->prewarm_lock);
+
+  if (prewarm)
+    dlb_renderer_prewarm_free (prewarm);
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightning, plugin);
+}
+
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
     GST_VERSION_MINOR,
     dlblightning,
     "Lightscapes renderer implementation", plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -23,6 +23,12 @@
 
 #include <gst/base/gstbasetransform.h>
 #include "dlb_lightscapes.h"
+#include "dlblightmeta.h"
+#include "dlblightsched.h"
+#include "dlbrenderahead.h"
+#include "dlbrendercache.h"
+#include "dlbrendererprewarm.h"
+#include "dlbrenderpool.h"
 
 G_BEGIN_DECLS
 #define DLB_TYPE_LIGHTNING   (dlb_lightning_get_type())
@@ -35,15 +41,30 @@ typedef struct _DlbLightningClass DlbLightningClass;
 
 #define MAX_NUM_PERSONALIZATION_ZONES (8)
 
+/* render parameters of one frame, also part of its render cache key */
+typedef struct
+{
+  guint64 config_id;
+  float zone_immersion_levels[MAX_NUM_PERSONALIZATION_ZONES];
+  int zone_low_immersion[MAX_NUM_PERSONALIZATION_ZONES];
+  float lightness;
+} DlbLightningParams;
+
 struct _DlbLightning
 {
   GstBaseTransform base_lightning;
 
   /* Pointer to lightscapes state */
   dlb_lsr *renderer_instance;
+  /* held while the renderer is used, reset or replaced; protects
+   * renderer_instance and state_clean. Taken before OBJECT_LOCK. */
+  GMutex render_lock;
   dlb_lsr_init_info renderer_config;
   size_t max_output_size;
 
+  /* layout of the last output frame, attached to every output buffer */
+  DlbLightLayout *layout;
+
   /* config */
   gchar *config_path;
   
@@ -51,6 +72,59 @@ struct _DlbLightning
   float     a_zone_immersion_levels[MAX_NUM_PERSONALIZATION_ZONES];
   int       a_zone_low_immersion[MAX_NUM_PERSONALIZATION_ZONES];
   float     global_lightness;
+  /* parameters of the frame being rendered, rendering thread only */
+  DlbLightningParams params;
+
+  /* scheduling of the streaming thread */
+  DlbLightThreadSettings thread_settings;
+  gboolean lock_memory;
+  GThread *streaming_thread;
+
+  /* stream of the shared render pool, NULL when rendering in place */
+  gboolean shared_render_pool;
+  DlbRenderStream *render_stream;
+
+  /* whether the renderer has no temporal state, protected by render_lock */
+  gboolean state_clean;
+
+  /* flush and seek handling, protected by OBJECT_LOCK */
+  GstClockTime flush_time;
+  guint warmup_count;
+  GstClockTime seek_recovery_time;
+
+  /* frames left before the next render load report, streaming thread only */
+  guint load_report_skip;
+
+  /* buffer list being rendered, load is reported once per list */
+  gboolean in_list;
+  GstClockTime list_render_time;
+  guint list_frames;
+
+  /* render cache, only used from the streaming thread once started */
+  guint64 render_cache_size;    /* protected by OBJECT_LOCK */
+  DlbRenderCache *render_cache;
+  guint64 config_id;            /* protected by OBJECT_LOCK */
+  gboolean cache_miss;
+  gboolean cache_hit;
+  guint64 cache_hits;
+  guint64 cache_misses;
+
+  /* render-ahead queue, NULL when rendering on the streaming thread;
+   * the pointer is protected by OBJECT_LOCK */
+  guint render_ahead_depth;     /* protected by OBJECT_LOCK */
+  DlbRenderAhead *render_ahead;
+
+  /* pre-instantiation, protected by OBJECT_LOCK */
+  gboolean prewarm;
+  gchar *prewarm_hint;
+  gint expected_max_objects;
+  gint expected_color_space;
+  gint expected_frame_period;
+  gboolean renderer_prewarmed;
+  GstClockTime startup_time_saved;
+  /* helper loading the config and renderer ahead, held while it is used */
+  GMutex prewarm_lock;
+  DlbRendererPrewarm *renderer_prewarm;
 };
 
 struct _DlbLightningClass
@@ -59,6 +133,7 @@ struct _DlbLightningClass
 };
 
 GType dlb_lightning_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightning);
 
 G_END_DECLS
 #endif
@@ -24,19 +24,70 @@
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <gst/gst.h>
 #include <gst/base/gstbaseparse.h>
 #include <gst/base/base.h>
 
+#include "dlbtrace.h"
+
 GST_DEBUG_CATEGORY_STATIC (dlb_lsm_parse_debug_category);
 #define GST_CAT_DEFAULT dlb_lsm_parse_debug_category
 
 
 /* prototypes */
+static void dlb_lsm_parse_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void dlb_lsm_parse_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
 static gboolean dlb_lsm_parse_start (GstBaseParse * parse);
 static gboolean dlb_lsm_parse_stop (GstBaseParse * parse);
+static gboolean dlb_lsm_parse_set_sink_caps (GstBaseParse * parse,
+    GstCaps * caps);
 static GstFlowReturn dlb_lsm_parse_handle_frame (GstBaseParse * parse,
     GstBaseParseFrame * frame, gint * skipsize);
+static GstFlowReturn dlb_lsm_parse_pre_push_frame (GstBaseParse * parse,
+    GstBaseParseFrame * frame);
+static gboolean dlb_lsm_parse_sink_event (GstBaseParse * parse,
+    GstEvent * event);
+static gboolean dlb_lsm_parse_src_event (GstBaseParse * parse,
+    GstEvent * event);
+static void dlb_lsm_parse_finalize (GObject * object);
+
+enum
+{
+  PROP_0,
+  PROP_WARMUP_FRAMES,
+  PROP_DECIMATE,
+  PROP_ADAPTIVE_QUALITY,
+  PROP_MIN_OBJECTS,
+  PROP_RENDER_BUDGET,
+  PROP_OBJECT_LIMIT,
+  PROP_CULLED_OBJECTS,
+  PROP_FRAMES_PER_LIST,
+  PROP_GAP_THRESHOLD,
+};
+
+#define DEFAULT_WARMUP_FRAMES 0
+#define MAX_WARMUP_FRAMES 250
+#define DEFAULT_DECIMATE TRUE
+#define DEFAULT_ADAPTIVE_QUALITY FALSE
+#define DEFAULT_MIN_OBJECTS 1
+#define DEFAULT_RENDER_BUDGET 50
+#define NO_OBJECT_LIMIT 255
+#define DEFAULT_FRAMES_PER_LIST 1
+#define MAX_FRAMES_PER_LIST 250
+#define DEFAULT_GAP_THRESHOLD (100 * GST_MSECOND)
+
+#define LSM_FRAME_HEADER_SIZE 2
+/* object records start with their size in bytes, this header included, and
+ * the object gain, which ranks the objects by significance */
+#define LSM_OBJECT_HEADER_SIZE 2
+
+/* reports with headroom needed before restoring objects, about a second */
+#define RESTORE_REPORTS 25
+/* reports to wait after a change before reducing again */
+#define CULL_COOLDOWN 5
 
 /* pad templates */
 static GstStaticPadTemplate dlb_lsm_parse_src_template =
@@ -62,10 +113,13 @@ static GstStaticPadTemplate dlb_lsm_parse_sink_template =
 G_DEFINE_TYPE_WITH_CODE (DlbLsmParse, dlb_lsm_parse, GST_TYPE_BASE_PARSE,
     GST_DEBUG_CATEGORY_INIT (dlb_lsm_parse_debug_category, "dlblsmparse", 0,
         "debug category for lsmparse element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblsmparse, "dlblsmparse", GST_RANK_PRIMARY + 2,
+                             DLB_TYPE_LSM_PARSE);
 
 static void
 dlb_lsm_parse_class_init (DlbLsmParseClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseParseClass *base_parse_class = GST_BASE_PARSE_CLASS (klass);
 
   /* Setting up pads and setting metadata should be moved to
@@ -81,10 +135,137 @@ dlb_lsm_parse_class_init (DlbLsmParseClass * klass)
       "Parse LSM light stream",
       "Dolby Support <support@dolby.com>");
 
+  gobject_class->set_property = dlb_lsm_parse_set_property;
+  gobject_class->get_property = dlb_lsm_parse_get_property;
+  gobject_class->finalize = dlb_lsm_parse_finalize;
+
   base_parse_class->start = GST_DEBUG_FUNCPTR (dlb_lsm_parse_start);
   base_parse_class->stop = GST_DEBUG_FUNCPTR (dlb_lsm_parse_stop);
+  base_parse_class->set_sink_caps =
+      GST_DEBUG_FUNCPTR (dlb_lsm_parse_set_sink_caps);
   base_parse_class->handle_frame =
       GST_DEBUG_FUNCPTR (dlb_lsm_parse_handle_frame);
+  base_parse_class->pre_push_frame =
+      GST_DEBUG_FUNCPTR (dlb_lsm_parse_pre_push_frame);
+  base_parse_class->sink_event = GST_DEBUG_FUNCPTR (dlb_lsm_parse_sink_event);
+  base_parse_class->src_event = GST_DEBUG_FUNCPTR (dlb_lsm_parse_src_event);
+
+  /**
+   * DlbLsmParse:warmup-frames:
+   *
+   * Number of frames preceding the target of a flushing seek to supply
+   * downstream so the renderer can rebuild its temporal state. The seek
+   * sent upstream starts that much earlier and the extra frames are
+   * flagged %GST_BUFFER_FLAG_DECODE_ONLY, outside of the pushed segment.
+   *
+   * The earlier seek position applies to everything upstream of the
+   * parser, so this is meant for pipelines where the light stream is read
+   * on its own rather than demuxed together with audio or video.
+   */
+  g_object_class_install_property (gobject_class, PROP_WARMUP_FRAMES,
+      g_param_spec_uint ("warmup-frames", "Warm-up frames",
+          "Number of frames before a seek target to render without output",
+          0, MAX_WARMUP_FRAMES, DEFAULT_WARMUP_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLsmParse:decimate:
+   *
+   * Whether to drop the frames that cannot be presented when playing
+   * faster than real time or in trick mode. At most one frame per frame
+   * period of running time is pushed, so the rendering cost stays the same
+   * whatever the playback rate. Skip frames are dropped in trick mode.
+   */
+  g_object_class_install_property (gobject_class, PROP_DECIMATE,
+      g_param_spec_boolean ("decimate", "Decimate",
+          "Drop frames that cannot be presented at high rates and in trick mode",
+          DEFAULT_DECIMATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLsmParse:adaptive-quality:
+   *
+   * Whether to remove objects from the frames while the renderer runs over
+   * its budget (see #DlbLsmParse:render-budget) or the sink reports late
+   * frames through QoS. The render time is reported by a downstream
+   * dlblightning. Objects are restored gradually once there is headroom
+   * again for about a second.
+   *
+   * The objects with the lowest gain are removed first, the others keep
+   * their order. Frames whose object records cannot be walked are left
+   * untouched.
+   */
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE_QUALITY,
+      g_param_spec_boolean ("adaptive-quality", "Adaptive quality",
+          "Cull objects when rendering runs over budget",
+          DEFAULT_ADAPTIVE_QUALITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_OBJECTS,
+      g_param_spec_uint ("min-objects", "Minimum objects",
+          "Number of objects that are never culled",
+          1, NO_OBJECT_LIMIT, DEFAULT_MIN_OBJECTS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_RENDER_BUDGET,
+      g_param_spec_uint ("render-budget", "Render budget",
+          "Render time allowed per frame, in percent of the frame period",
+          1, 100, DEFAULT_RENDER_BUDGET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_OBJECT_LIMIT,
+      g_param_spec_uint ("object-limit", "Object limit",
+          "Current maximum number of objects per frame",
+          0, NO_OBJECT_LIMIT, NO_OBJECT_LIMIT,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CULLED_OBJECTS,
+      g_param_spec_uint64 ("culled-objects", "Culled objects",
+          "Total number of objects removed from frames",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLsmParse:frames-per-list:
+   *
+   * Number of frames to push downstream together in a #GstBufferList when
+   * upstream is not live, as when reading a file or rendering offline.
+   * Downstream elements then handle a whole batch per call. Frames are
+   * pushed one by one when upstream is live, in reverse playback, or when
+   * this is 1 or less, the default: batching delays the first frame of a
+   * batch by as many frame periods, so it is only worth enabling for
+   * offline rendering. A pending batch is always pushed before any
+   * serialized event, so events never overtake the frames preceding them.
+   */
+  g_object_class_install_property (gobject_class, PROP_FRAMES_PER_LIST,
+      g_param_spec_uint ("frames-per-list", "Frames per list",
+          "Number of frames to push together when upstream is not live",
+          0, MAX_FRAMES_PER_LIST, DEFAULT_FRAMES_PER_LIST,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLsmParse:gap-threshold:
+   *
+   * Longest hole in the light stream that is not signalled downstream. LSM
+   * is sparse and muxed next to audio and video, so the light track can go
+   * without frames for a while. Holes longer than this, between the
+   * timestamps of consecutive frames or up to the start of an updated
+   * segment, are sent downstream as GAP events so that sinks preroll and
+   * the other streams do not wait for the lights. 0 disables it.
+   */
+  g_object_class_install_property (gobject_class, PROP_GAP_THRESHOLD,
+      g_param_spec_uint64 ("gap-threshold", "Gap threshold",
+          "Longest hole in the stream not signalled with a GAP event "
+          "(0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_GAP_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
 }
 
 static void
@@ -95,6 +276,117 @@ dlb_lsm_parse_init (DlbLsmParse * lsm_parse)
 
   lsm_parse->caps_parsed = FALSE;
   lsm_parse->max_objects = 0;
+  lsm_parse->frame_period = GST_CLOCK_TIME_NONE;
+  lsm_parse->warmup_frames = DEFAULT_WARMUP_FRAMES;
+  lsm_parse->warmup_target = GST_CLOCK_TIME_NONE;
+  lsm_parse->warmup_end = GST_CLOCK_TIME_NONE;
+  lsm_parse->decimate = DEFAULT_DECIMATE;
+  lsm_parse->next_slot = GST_CLOCK_TIME_NONE;
+  lsm_parse->adaptive_quality = DEFAULT_ADAPTIVE_QUALITY;
+  lsm_parse->min_objects = DEFAULT_MIN_OBJECTS;
+  lsm_parse->render_budget = DEFAULT_RENDER_BUDGET;
+  lsm_parse->object_limit = NO_OBJECT_LIMIT;
+  lsm_parse->last_num_objects = 0;
+  lsm_parse->headroom_reports = 0;
+  lsm_parse->cooldown = 0;
+  lsm_parse->culled_objects = 0;
+  lsm_parse->frames_per_list = DEFAULT_FRAMES_PER_LIST;
+  lsm_parse->upstream_live = -1;
+  lsm_parse->pending = NULL;
+  lsm_parse->pending_flow = GST_FLOW_OK;
+  lsm_parse->gap_threshold = DEFAULT_GAP_THRESHOLD;
+  lsm_parse->next_pts = GST_CLOCK_TIME_NONE;
+}
+
+static void
+dlb_lsm_parse_finalize (GObject * object)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (object);
+
+  if (lsm_parse->pending)
+    gst_buffer_list_unref (lsm_parse->pending);
+
+  G_OBJECT_CLASS (dlb_lsm_parse_parent_class)->finalize (object);
+}
+
+static void
+dlb_lsm_parse_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (object);
+
+  GST_OBJECT_LOCK (lsm_parse);
+  switch (property_id) {
+    case PROP_WARMUP_FRAMES:
+      lsm_parse->warmup_frames = g_value_get_uint (value);
+      break;
+    case PROP_DECIMATE:
+      lsm_parse->decimate = g_value_get_boolean (value);
+      break;
+    case PROP_ADAPTIVE_QUALITY:
+      lsm_parse->adaptive_quality = g_value_get_boolean (value);
+      if (!lsm_parse->adaptive_quality)
+        lsm_parse->object_limit = NO_OBJECT_LIMIT;
+      break;
+    case PROP_MIN_OBJECTS:
+      lsm_parse->min_objects = g_value_get_uint (value);
+      break;
+    case PROP_RENDER_BUDGET:
+      lsm_parse->render_budget = g_value_get_uint (value);
+      break;
+    case PROP_FRAMES_PER_LIST:
+      lsm_parse->frames_per_list = g_value_get_uint (value);
+      break;
+    case PROP_GAP_THRESHOLD:
+      lsm_parse->gap_threshold = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (lsm_parse);
+}
+
+static void
+dlb_lsm_parse_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (object);
+
+  GST_OBJECT_LOCK (lsm_parse);
+  switch (property_id) {
+    case PROP_WARMUP_FRAMES:
+      g_value_set_uint (value, lsm_parse->warmup_frames);
+      break;
+    case PROP_DECIMATE:
+      g_value_set_boolean (value, lsm_parse->decimate);
+      break;
+    case PROP_ADAPTIVE_QUALITY:
+      g_value_set_boolean (value, lsm_parse->adaptive_quality);
+      break;
+    case PROP_MIN_OBJECTS:
+      g_value_set_uint (value, lsm_parse->min_objects);
+      break;
+    case PROP_RENDER_BUDGET:
+      g_value_set_uint (value, lsm_parse->render_budget);
+      break;
+    case PROP_OBJECT_LIMIT:
+      g_value_set_uint (value, lsm_parse->object_limit);
+      break;
+    case PROP_CULLED_OBJECTS:
+      g_value_set_uint64 (value, lsm_parse->culled_objects);
+      break;
+    case PROP_FRAMES_PER_LIST:
+      g_value_set_uint (value, lsm_parse->frames_per_list);
+      break;
+    case PROP_GAP_THRESHOLD:
+      g_value_set_uint64 (value, lsm_parse->gap_threshold);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (lsm_parse);
 }
 
 static gboolean
@@ -106,6 +398,21 @@ dlb_lsm_parse_start (GstBaseParse * parse)
 
   lsm_parse->caps_parsed = FALSE;
   lsm_parse->max_objects = 0;
+  lsm_parse->frame_period = GST_CLOCK_TIME_NONE;
+  lsm_parse->next_slot = GST_CLOCK_TIME_NONE;
+  lsm_parse->upstream_live = -1;
+  lsm_parse->pending_flow = GST_FLOW_OK;
+  lsm_parse->next_pts = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (lsm_parse);
+  lsm_parse->warmup_target = GST_CLOCK_TIME_NONE;
+  lsm_parse->warmup_end = GST_CLOCK_TIME_NONE;
+  lsm_parse->object_limit = NO_OBJECT_LIMIT;
+  lsm_parse->last_num_objects = 0;
+  lsm_parse->headroom_reports = 0;
+  lsm_parse->cooldown = 0;
+  lsm_parse->culled_objects = 0;
+  GST_OBJECT_UNLOCK (lsm_parse);
 
 //  gst_base_parse_set_min_frame_size(parse, 24);
 //  gst_base_parse_set_has_timing_info(parse, TRUE);
@@ -119,17 +426,17 @@ dlb_lsm_parse_stop (GstBaseParse * parse)
   DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
   GST_DEBUG_OBJECT (lsm_parse, "stop");
 
+  if (lsm_parse->pending) {
+    gst_buffer_list_unref (lsm_parse->pending);
+    lsm_parse->pending = NULL;
+  }
+
   return TRUE;
 }
 
-static int check_caps(GstBaseParse * parse)
+static int parse_caps(GstBaseParse * parse, GstCaps * sink_caps)
 {
     DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
-    if (lsm_parse->caps_parsed) {
-        return 0;
-    }
-
-    GstCaps *sink_caps = gst_pad_get_current_caps (GST_BASE_PARSE_SINK_PAD (parse));
 
     if (sink_caps) {
       GST_INFO_OBJECT (parse, "sink caps %" GST_PTR_FORMAT, sink_caps);
@@ -171,6 +478,7 @@ static int check_caps(GstBaseParse * parse)
 
                   GST_INFO_OBJECT (parse, "src caps %" GST_PTR_FORMAT, caps);
                   gst_base_parse_set_frame_rate(parse, 1000, frame_period_ms, 0, 0);
+                  lsm_parse->frame_period = frame_period_ms * GST_MSECOND;
                   gst_pad_set_caps (GST_BASE_PARSE_SRC_PAD (lsm_parse), caps);
                   gst_caps_unref (caps);
                   lsm_parse->caps_parsed = TRUE;
@@ -188,16 +496,48 @@ static int check_caps(GstBaseParse * parse)
     return 1;
 }
 
+static int check_caps(GstBaseParse * parse)
+{
+    DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+    if (lsm_parse->caps_parsed) {
+        return 0;
+    }
+
+    GstCaps *sink_caps = gst_pad_get_current_caps (GST_BASE_PARSE_SINK_PAD (parse));
+    int status = parse_caps (parse, sink_caps);
+
+    if (sink_caps)
+        gst_caps_unref (sink_caps);
+    return status;
+}
+
+/* The source caps only depend on the init box, so they are set as soon as
+ * it is known and events such as GAP can go out before the first frame. */
+static gboolean
+dlb_lsm_parse_set_sink_caps (GstBaseParse * parse, GstCaps * caps)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+
+  lsm_parse->caps_parsed = FALSE;
+  parse_caps (parse, caps);
+
+  /* missing or invalid init boxes are reported with the first frame */
+  return TRUE;
+}
+
 static GstFlowReturn
 dlb_lsm_parse_handle_frame (GstBaseParse * parse, GstBaseParseFrame * frame,
     gint * skipsize)
 {
   DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+  GstClockTime pts = GST_BUFFER_PTS (frame->buffer);
   GstMapInfo map;
   int status = 0;
 
   GstFlowReturn ret = GST_FLOW_OK;
   GST_LOG_OBJECT (lsm_parse, "handle_frame");
+  DLB_TRACE (parse_frame_entry, lsm_parse, pts,
+      gst_buffer_get_size (frame->buffer));
 
   int caps_error = check_caps(parse);
   if (caps_error) {
@@ -232,14 +572,598 @@ cleanup:
       ret = gst_base_parse_finish_frame (parse, frame, map.size);
   }
 
+  DLB_TRACE (parse_frame_exit, lsm_parse, pts, ret);
+
   return ret;
 }
 
+static gboolean
+dlb_lsm_parse_is_skip_frame (GstBuffer * buffer)
+{
+  guint8 do_skip = 0;
+
+  gst_buffer_extract (buffer, 0, &do_skip, 1);
+  return do_skip != 0;
+}
+
+/* Keep at most one frame per frame period of running time. Running time
+ * already accounts for the rate, in both directions, so this bounds the
+ * frame rate at the sink whatever the playback speed. */
+static gboolean
+dlb_lsm_parse_decimate (DlbLsmParse * lsm_parse, GstBuffer * buffer)
+{
+  GstBaseParse *parse = GST_BASE_PARSE_CAST (lsm_parse);
+  GstSegment *segment = &parse->segment;
+  GstClockTime period = lsm_parse->frame_period;
+  GstClockTime running_time;
+  gboolean trickmode;
+
+  trickmode = (segment->flags & GST_SEGMENT_FLAG_TRICKMODE) != 0;
+  if (!trickmode && ABS (segment->rate) <= 1.0)
+    return FALSE;
+
+  if (trickmode && dlb_lsm_parse_is_skip_frame (buffer))
+    return TRUE;
+
+  if (segment->format != GST_FORMAT_TIME || !GST_CLOCK_TIME_IS_VALID (period))
+    return FALSE;
+
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME,
+      GST_BUFFER_PTS (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (lsm_parse->next_slot) &&
+      running_time + period / 2 < lsm_parse->next_slot)
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (lsm_parse->next_slot))
+    lsm_parse->next_slot = running_time;
+  lsm_parse->next_slot = MAX (lsm_parse->next_slot, running_time) + period;
+
+  return FALSE;
+}
+
+/* Adjust the object limit to the load reported downstream. The limit drops
+ * by an eighth of the objects as soon as the budget is exceeded, and only
+ * grows back after RESTORE_REPORTS reports with comfortable headroom, so it
+ * does not oscillate around the budget. Call with the object lock held. */
+static void
+dlb_lsm_parse_adapt (DlbLsmParse * lsm_parse, gboolean over_budget,
+    gboolean headroom)
+{
+  guint current, step;
+
+  if (!lsm_parse->adaptive_quality)
+    return;
+
+  current = MIN (lsm_parse->object_limit, lsm_parse->last_num_objects);
+  step = MAX (current / 8, 1);
+
+  if (lsm_parse->cooldown > 0)
+    lsm_parse->cooldown--;
+
+  if (over_budget) {
+    lsm_parse->headroom_reports = 0;
+    if (lsm_parse->cooldown > 0 || current <= lsm_parse->min_objects)
+      return;
+
+    lsm_parse->object_limit = MAX (current - step, lsm_parse->min_objects);
+    lsm_parse->cooldown = CULL_COOLDOWN;
+    GST_DEBUG_OBJECT (lsm_parse, "over budget, limiting frames to %u objects",
+        lsm_parse->object_limit);
+  } else if (headroom && lsm_parse->object_limit < NO_OBJECT_LIMIT) {
+    if (++lsm_parse->headroom_reports < RESTORE_REPORTS)
+      return;
+
+    lsm_parse->headroom_reports = 0;
+    lsm_parse->object_limit += step;
+    if (lsm_parse->object_limit >= lsm_parse->last_num_objects)
+      lsm_parse->object_limit = NO_OBJECT_LIMIT;
+    lsm_parse->cooldown = CULL_COOLDOWN;
+    GST_DEBUG_OBJECT (lsm_parse, "headroom, limiting frames to %u objects",
+        lsm_parse->object_limit);
+  } else {
+    lsm_parse->headroom_reports = 0;
+  }
+}
+
+/* Walks the object records of a frame into @offsets and @sizes. FALSE if
+ * the records do not add up to the frame. */
+static gboolean
+dlb_lsm_parse_walk_objects (const guint8 * data, gsize size, guint num_objects,
+    gsize * offsets, gsize * sizes)
+{
+  gsize offset = LSM_FRAME_HEADER_SIZE;
+
+  for (guint i = 0; i < num_objects; i++) {
+    if (size - offset < LSM_OBJECT_HEADER_SIZE)
+      return FALSE;
+
+    sizes[i] = data[offset];
+    if (sizes[i] < LSM_OBJECT_HEADER_SIZE || sizes[i] > size - offset)
+      return FALSE;
+
+    offsets[i] = offset;
+    offset += sizes[i];
+  }
+
+  return offset == size;
+}
+
+/* Remove the least significant objects over the current limit from the
+ * frame, the remaining objects keep their order. */
+static void
+dlb_lsm_parse_cull (DlbLsmParse * lsm_parse, GstBaseParseFrame * frame)
+{
+  gsize offsets[NO_OBJECT_LIMIT], sizes[NO_OBJECT_LIMIT];
+  guint8 gains[NO_OBJECT_LIMIT];
+  guint8 header[LSM_FRAME_HEADER_SIZE];
+  GstMapInfo map;
+  gsize out;
+  guint limit;
+  guint8 num_objects;
+
+  if (gst_buffer_extract (frame->buffer, 0, header, sizeof (header)) != sizeof (header) ||
+      header[0] != 0)
+    return;
+
+  num_objects = header[1];
+
+  GST_OBJECT_LOCK (lsm_parse);
+  lsm_parse->last_num_objects = num_objects;
+  limit = lsm_parse->adaptive_quality ? lsm_parse->object_limit : NO_OBJECT_LIMIT;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  if (num_objects <= limit)
+    return;
+
+  if (!gst_buffer_map (frame->buffer, &map, GST_MAP_READ))
+    return;
+
+  if (!dlb_lsm_parse_walk_objects (map.data, map.size, num_objects, offsets,
+          sizes)) {
+    GST_LOG_OBJECT (lsm_parse, "object records do not add up, not culling");
+    gst_buffer_unmap (frame->buffer, &map);
+    return;
+  }
+
+  for (guint i = 0; i < num_objects; i++)
+    gains[i] = map.data[offsets[i] + 1];
+  gst_buffer_unmap (frame->buffer, &map);
+
+  frame->buffer = gst_buffer_make_writable (frame->buffer);
+  if (!gst_buffer_map (frame->buffer, &map, GST_MAP_WRITE))
+    return;
+
+  /* an object is kept if fewer than limit objects rank before it, ties
+   * going to the earlier object. Records only move towards the start. */
+  out = LSM_FRAME_HEADER_SIZE;
+  for (guint i = 0; i < num_objects; i++) {
+    guint rank = 0;
+
+    for (guint j = 0; j < num_objects && rank < limit; j++) {
+      if (gains[j] > gains[i] || (gains[j] == gains[i] && j < i))
+        rank++;
+    }
+    if (rank >= limit)
+      continue;
+
+    memmove (map.data + out, map.data + offsets[i], sizes[i]);
+    out += sizes[i];
+  }
+  map.data[1] = limit;
+  gst_buffer_unmap (frame->buffer, &map);
+  gst_buffer_resize (frame->buffer, 0, out);
+
+  GST_LOG_OBJECT (lsm_parse, "culled %u of %u objects", num_objects - limit,
+      num_objects);
+
+  GST_OBJECT_LOCK (lsm_parse);
+  lsm_parse->culled_objects += num_objects - limit;
+  GST_OBJECT_UNLOCK (lsm_parse);
+}
+
+static GstFlowReturn
+dlb_lsm_parse_prepare_frame (DlbLsmParse * lsm_parse, GstBaseParseFrame * frame)
+{
+  GstClockTime pts = GST_BUFFER_PTS (frame->buffer);
+  GstClockTime end;
+  gboolean decimate;
+
+  GST_OBJECT_LOCK (lsm_parse);
+  end = lsm_parse->warmup_end;
+  if (GST_CLOCK_TIME_IS_VALID (end) &&
+      (!GST_CLOCK_TIME_IS_VALID (pts) || pts >= end))
+    lsm_parse->warmup_end = end = GST_CLOCK_TIME_NONE;
+  decimate = lsm_parse->decimate;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  /* Frames before the seek target only feed the renderer state: flag them
+   * and keep baseparse from clipping them against the segment. */
+  if (GST_CLOCK_TIME_IS_VALID (end)) {
+    GST_LOG_OBJECT (lsm_parse, "warm-up frame, ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (pts));
+    frame->buffer = gst_buffer_make_writable (frame->buffer);
+    GST_BUFFER_FLAG_SET (frame->buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+    frame->flags &= ~GST_BASE_PARSE_FRAME_FLAG_CLIP;
+    dlb_lsm_parse_cull (lsm_parse, frame);
+    return GST_FLOW_OK;
+  }
+
+  if (decimate && dlb_lsm_parse_decimate (lsm_parse, frame->buffer)) {
+    GST_LOG_OBJECT (lsm_parse, "decimating frame, ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (pts));
+    return GST_BASE_PARSE_FLOW_DROPPED;
+  }
+
+  dlb_lsm_parse_cull (lsm_parse, frame);
+  return GST_FLOW_OK;
+}
+
+/* Frames are only held back for a list when upstream is not live, where
+ * nothing waits on them, and in forward playback, since baseparse queues
+ * the frames itself in reverse. */
+static guint
+dlb_lsm_parse_batch_size (DlbLsmParse * lsm_parse)
+{
+  GstBaseParse *parse = GST_BASE_PARSE_CAST (lsm_parse);
+  guint size;
+
+  GST_OBJECT_LOCK (lsm_parse);
+  size = lsm_parse->frames_per_list;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  if (size <= 1 || parse->segment.rate < 0.0 || GST_BASE_PARSE_DRAINING (parse))
+    return 1;
+
+  if (lsm_parse->upstream_live < 0) {
+    GstQuery *query = gst_query_new_latency ();
+    gboolean live = FALSE;
+
+    if (gst_pad_peer_query (GST_BASE_PARSE_SINK_PAD (parse), query))
+      gst_query_parse_latency (query, &live, NULL, NULL);
+    gst_query_unref (query);
+
+    GST_DEBUG_OBJECT (lsm_parse, "upstream is %slive", live ? "" : "not ");
+    lsm_parse->upstream_live = live;
+  }
+
+  return lsm_parse->upstream_live ? 1 : size;
+}
+
+static GstFlowReturn
+dlb_lsm_parse_push_pending (DlbLsmParse * lsm_parse)
+{
+  GstBufferList *list = lsm_parse->pending;
+
+  if (!list)
+    return GST_FLOW_OK;
+
+  lsm_parse->pending = NULL;
+  GST_LOG_OBJECT (lsm_parse, "pushing a list of %u frames",
+      gst_buffer_list_length (list));
+
+  return gst_pad_push_list (GST_BASE_PARSE_SRC_PAD (lsm_parse), list);
+}
+
+/* Hold the frame back for the next list. Frames that baseparse may still
+ * clip against the segment are left for it to push, after the pending
+ * list so the order is kept. */
+static GstFlowReturn
+dlb_lsm_parse_batch (DlbLsmParse * lsm_parse, GstBaseParseFrame * frame)
+{
+  GstSegment *segment = &GST_BASE_PARSE_CAST (lsm_parse)->segment;
+  GstClockTime pts = GST_BUFFER_PTS (frame->buffer);
+  GstFlowReturn ret;
+  guint size;
+
+  ret = lsm_parse->pending_flow;
+  lsm_parse->pending_flow = GST_FLOW_OK;
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  size = dlb_lsm_parse_batch_size (lsm_parse);
+  if (size <= 1 || ((frame->flags & GST_BASE_PARSE_FRAME_FLAG_CLIP) &&
+          (segment->format != GST_FORMAT_TIME || !GST_CLOCK_TIME_IS_VALID (pts) ||
+              pts < segment->start || (GST_CLOCK_TIME_IS_VALID (segment->stop) &&
+                  pts >= segment->stop))))
+    return dlb_lsm_parse_push_pending (lsm_parse);
+
+  if (!lsm_parse->pending)
+    lsm_parse->pending = gst_buffer_list_new_sized (size);
+  gst_buffer_list_add (lsm_parse->pending, gst_buffer_ref (frame->buffer));
+
+  if (gst_buffer_list_length (lsm_parse->pending) >= size)
+    ret = dlb_lsm_parse_push_pending (lsm_parse);
+
+  return ret == GST_FLOW_OK ? GST_BASE_PARSE_FLOW_DROPPED : ret;
+}
+
+/* Whether there is a hole worth a GAP event between @next, the end of what
+ * was pushed so far, and @start. */
+static gboolean
+dlb_lsm_parse_is_gap (DlbLsmParse * lsm_parse, GstClockTime next,
+    GstClockTime start)
+{
+  GstClockTime threshold;
+
+  GST_OBJECT_LOCK (lsm_parse);
+  threshold = lsm_parse->gap_threshold;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  return threshold > 0 && GST_CLOCK_TIME_IS_VALID (next) &&
+      GST_CLOCK_TIME_IS_VALID (start) && start > next + threshold;
+}
+
+/* Signal the hole in front of a frame, after the frames held back for a
+ * list. Also runs for frames dropped later on, which are not holes. */
+static GstFlowReturn
+dlb_lsm_parse_fill_gap (DlbLsmParse * lsm_parse, GstBuffer * buffer)
+{
+  GstBaseParse *parse = GST_BASE_PARSE_CAST (lsm_parse);
+  GstClockTime pts = GST_BUFFER_PTS (buffer);
+  GstClockTime next = lsm_parse->next_pts;
+  GstFlowReturn ret;
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts) || parse->segment.rate < 0.0)
+    return GST_FLOW_OK;
+
+  lsm_parse->next_pts = pts;
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    lsm_parse->next_pts += GST_BUFFER_DURATION (buffer);
+
+  if (!dlb_lsm_parse_is_gap (lsm_parse, next, pts))
+    return GST_FLOW_OK;
+
+  ret = dlb_lsm_parse_push_pending (lsm_parse);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  GST_DEBUG_OBJECT (lsm_parse, "no frames from %" GST_TIME_FORMAT " to %"
+      GST_TIME_FORMAT ", sending a gap", GST_TIME_ARGS (next),
+      GST_TIME_ARGS (pts));
+  gst_pad_push_event (GST_BASE_PARSE_SRC_PAD (parse),
+      gst_event_new_gap (next, pts - next));
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+dlb_lsm_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+  GstFlowReturn ret;
+
+  ret = dlb_lsm_parse_fill_gap (lsm_parse, frame->buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  ret = dlb_lsm_parse_prepare_frame (lsm_parse, frame);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  return dlb_lsm_parse_batch (lsm_parse, frame);
+}
+
+/* A new segment that continues the running time of the last one, as
+ * demuxers send for sparse streams, can skip ahead. The hole up to its
+ * start is signalled in the old segment, before the new one goes out. */
+static void
+dlb_lsm_parse_start_segment (DlbLsmParse * lsm_parse, GstEvent * event)
+{
+  GstBaseParse *parse = GST_BASE_PARSE_CAST (lsm_parse);
+  const GstSegment *segment;
+  GstClockTime next = lsm_parse->next_pts;
+  GstClockTime from, to, end;
+
+  gst_event_parse_segment (event, &segment);
+
+  lsm_parse->next_pts = GST_CLOCK_TIME_NONE;
+  if (segment->format != GST_FORMAT_TIME || segment->rate < 0.0)
+    return;
+  lsm_parse->next_pts = segment->start;
+
+  if (!GST_CLOCK_TIME_IS_VALID (next) ||
+      parse->segment.format != GST_FORMAT_TIME || parse->segment.rate < 0.0)
+    return;
+
+  from = gst_segment_to_running_time (&parse->segment, GST_FORMAT_TIME, next);
+  to = gst_segment_to_running_time (segment, GST_FORMAT_TIME, segment->start);
+  if (!dlb_lsm_parse_is_gap (lsm_parse, from, to))
+    return;
+
+  end = gst_segment_position_from_running_time (&parse->segment,
+      GST_FORMAT_TIME, to);
+  if (!GST_CLOCK_TIME_IS_VALID (end) || end <= next)
+    return;
+
+  GST_DEBUG_OBJECT (lsm_parse, "segment skips from %" GST_TIME_FORMAT " to %"
+      GST_TIME_FORMAT ", sending a gap", GST_TIME_ARGS (next),
+      GST_TIME_ARGS (end));
+
+  /* through baseparse, which pushes its pending events before the gap */
+  GST_BASE_PARSE_CLASS (dlb_lsm_parse_parent_class)->sink_event (parse,
+      gst_event_new_gap (next, end - next));
+}
+
+static gboolean
+dlb_lsm_parse_sink_event (GstBaseParse * parse, GstEvent * event)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+  GstClockTime target;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    lsm_parse->next_slot = GST_CLOCK_TIME_NONE;
+    lsm_parse->next_pts = GST_CLOCK_TIME_NONE;
+    lsm_parse->pending_flow = GST_FLOW_OK;
+    if (lsm_parse->pending) {
+      gst_buffer_list_unref (lsm_parse->pending);
+      lsm_parse->pending = NULL;
+    }
+  } else if (GST_EVENT_IS_SERIALIZED (event) && lsm_parse->pending) {
+    /* baseparse pushes the event before any later frame, the pending
+     * ones go first */
+    lsm_parse->pending_flow = dlb_lsm_parse_push_pending (lsm_parse);
+  }
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_GAP && parse->segment.rate > 0.0) {
+    GstClockTime timestamp, duration;
+
+    /* upstream already signals this hole */
+    gst_event_parse_gap (event, &timestamp, &duration);
+    if (GST_CLOCK_TIME_IS_VALID (timestamp) && GST_CLOCK_TIME_IS_VALID (duration) &&
+        (!GST_CLOCK_TIME_IS_VALID (lsm_parse->next_pts) ||
+            timestamp + duration > lsm_parse->next_pts))
+      lsm_parse->next_pts = timestamp + duration;
+  }
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_SEGMENT)
+    goto done;
+
+  lsm_parse->next_slot = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (lsm_parse);
+  target = lsm_parse->warmup_target;
+  lsm_parse->warmup_target = GST_CLOCK_TIME_NONE;
+  lsm_parse->warmup_end = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  if (GST_CLOCK_TIME_IS_VALID (target)) {
+    const GstSegment *in_segment;
+    GstSegment segment;
+    GstEvent *seg_event;
+
+    gst_event_parse_segment (event, &in_segment);
+    if (in_segment->format != GST_FORMAT_TIME || in_segment->start >= target ||
+        (GST_CLOCK_TIME_IS_VALID (in_segment->stop) && in_segment->stop <= target))
+      goto done;
+
+    /* push the segment the application asked for, the frames in front of
+     * it are only there to warm up */
+    gst_segment_copy_into (in_segment, &segment);
+    segment.time += target - segment.start;
+    segment.start = target;
+    segment.position = target;
+
+    GST_DEBUG_OBJECT (lsm_parse, "warming up from %" GST_TIME_FORMAT
+        " to %" GST_TIME_FORMAT, GST_TIME_ARGS (in_segment->start),
+        GST_TIME_ARGS (target));
+
+    seg_event = gst_event_new_segment (&segment);
+    gst_event_set_seqnum (seg_event, gst_event_get_seqnum (event));
+    gst_event_unref (event);
+    event = seg_event;
+
+    GST_OBJECT_LOCK (lsm_parse);
+    lsm_parse->warmup_end = target;
+    GST_OBJECT_UNLOCK (lsm_parse);
+  }
+
+done:
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+    dlb_lsm_parse_start_segment (lsm_parse, event);
+
+  return GST_BASE_PARSE_CLASS (dlb_lsm_parse_parent_class)->sink_event (parse, event);
+}
+
+static gboolean
+dlb_lsm_parse_src_event (GstBaseParse * parse, GstEvent * event)
+{
+  DlbLsmParse *lsm_parse = DLB_LSM_PARSE (parse);
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  GstFormat format;
+  GstEvent *warmup_seek;
+  GstClockTime lead;
+  gint64 start, stop;
+  gdouble rate;
+  guint frames;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM &&
+      gst_event_has_name (event, "dlb-render-load")) {
+    const GstStructure *s = gst_event_get_structure (event);
+    guint64 render_time = 0, frame_period = 0;
+    gboolean adaptive;
+
+    GST_OBJECT_LOCK (lsm_parse);
+    adaptive = lsm_parse->adaptive_quality;
+    if (adaptive &&
+        gst_structure_get_uint64 (s, "render-time", &render_time) &&
+        gst_structure_get_uint64 (s, "frame-period", &frame_period) &&
+        frame_period > 0) {
+      guint64 budget = frame_period * lsm_parse->render_budget / 100;
+      dlb_lsm_parse_adapt (lsm_parse, render_time > budget,
+          render_time < budget * 3 / 4);
+    }
+    GST_OBJECT_UNLOCK (lsm_parse);
+
+    /* it means nothing further upstream. Refused while not adapting, so
+     * the renderer backs off from reporting every frame. */
+    gst_event_unref (event);
+    return adaptive;
+  }
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS) {
+    GstClockTimeDiff diff;
+
+    gst_event_parse_qos (event, NULL, NULL, &diff, NULL);
+    if (diff > 0) {
+      GST_OBJECT_LOCK (lsm_parse);
+      dlb_lsm_parse_adapt (lsm_parse, TRUE, FALSE);
+      GST_OBJECT_UNLOCK (lsm_parse);
+    }
+    goto done;
+  }
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_SEEK)
+    goto done;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  GST_OBJECT_LOCK (lsm_parse);
+  frames = lsm_parse->warmup_frames;
+  lsm_parse->warmup_target = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  if (frames == 0 || !GST_CLOCK_TIME_IS_VALID (lsm_parse->frame_period) ||
+      format != GST_FORMAT_TIME || !(flags & GST_SEEK_FLAG_FLUSH) ||
+      rate <= 0.0 || start_type != GST_SEEK_TYPE_SET || start <= 0)
+    goto done;
+
+  lead = MIN ((GstClockTime) start, frames * lsm_parse->frame_period);
+  warmup_seek = gst_event_new_seek (rate, format, flags, start_type,
+      start - lead, stop_type, stop);
+  gst_event_set_seqnum (warmup_seek, gst_event_get_seqnum (event));
+
+  GST_OBJECT_LOCK (lsm_parse);
+  lsm_parse->warmup_target = start;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+  GST_DEBUG_OBJECT (lsm_parse, "seeking %" GST_TIME_FORMAT " early to warm up",
+      GST_TIME_ARGS (lead));
+
+  if (GST_BASE_PARSE_CLASS (dlb_lsm_parse_parent_class)->src_event (parse,
+          warmup_seek)) {
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT (lsm_parse, "warm-up seek failed, seeking without warm-up");
+  GST_OBJECT_LOCK (lsm_parse);
+  lsm_parse->warmup_target = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (lsm_parse);
+
+done:
+  return GST_BASE_PARSE_CLASS (dlb_lsm_parse_parent_class)->src_event (parse, event);
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
-  return gst_element_register (plugin, "dlblsmparse", GST_RANK_PRIMARY + 2,
-      DLB_TYPE_LSM_PARSE);
+  return GST_ELEMENT_REGISTER (dlblsmparse, plugin);
 }
 
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
@@ -247,3 +1171,4 @@ GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
     dlblsmparse,
     "Dolby LSM Parser",
     plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -37,6 +37,36 @@ struct _DlbLsmParse
     GstBaseParse    base_lsm_parse;
     gboolean        caps_parsed;
     guint8          max_objects;
+    GstClockTime    frame_period;
+
+    /* seek warm-up, protected by OBJECT_LOCK */
+    guint           warmup_frames;
+    GstClockTime    warmup_target;
+    GstClockTime    warmup_end;
+
+    /* high-rate and trick-mode decimation */
+    gboolean        decimate;       /* protected by OBJECT_LOCK */
+    GstClockTime    next_slot;      /* running time of the next output slot */
+
+    /* adaptive object culling, protected by OBJECT_LOCK */
+    gboolean        adaptive_quality;
+    guint           min_objects;
+    guint           render_budget;  /* percent of the frame period */
+    guint           object_limit;
+    guint           last_num_objects;
+    guint           headroom_reports;
+    guint           cooldown;
+    guint64         culled_objects;
+
+    /* buffer-list batching when upstream is not live */
+    guint           frames_per_list;  /* protected by OBJECT_LOCK */
+    gint            upstream_live;    /* -1 until queried */
+    GstBufferList  *pending;          /* streaming thread only */
+    GstFlowReturn   pending_flow;
+
+    /* sparse stream gaps */
+    GstClockTime    gap_threshold;    /* protected by OBJECT_LOCK */
+    GstClockTime    next_pts;         /* end of the last frame or gap */
 };
 
 struct _DlbLsmParseClass
@@ -45,6 +75,7 @@ struct _DlbLsmParseClass
 };
 
 GType dlb_lsm_parse_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblsmparse);
 
 G_END_DECLS
 #endif // _DLB_LSM_PARSE_H_
@@ -0,0 +1,339 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Render-ahead queue: input frames are queued and rendered by a dedicated
+ * thread as soon as they arrive, while the consumer only takes a frame out
+ * once more than `depth` frames are queued behind it. With a file source
+ * the streaming thread spends most of its time blocked in the sink waiting
+ * for the clock, so the queued frames are rendered during that wait and a
+ * slow frame is absorbed by the frames already rendered.
+ *
+ * The output buffers are allocated by the consumer when queueing a frame,
+ * so buffer pools and caps are only ever handled by the streaming thread;
+ * the render-ahead thread only renders into them. Every frame is rendered
+ * exactly once, so the renderer sees each frame once and in order. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlbrenderahead.h"
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category ()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat = 0;
+
+  if (g_once_init_enter (&cat)) {
+    gsize _cat = (gsize) _gst_debug_category_new ("dlbrenderahead", 0,
+        "light render-ahead queue");
+    g_once_init_leave (&cat, _cat);
+  }
+
+  return (GstDebugCategory *) cat;
+}
+#endif
+
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+  gboolean done;
+} DlbRenderAheadItem;
+
+struct _DlbRenderAhead
+{
+  guint depth;
+  DlbRenderAheadFunc func;
+  gpointer user_data;
+
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean running;
+  gboolean flushing;
+
+  /* oldest first */
+  GQueue items;
+  DlbRenderAheadItem *busy;
+};
+
+static void
+dlb_render_ahead_item_free (DlbRenderAheadItem * item)
+{
+  gst_buffer_unref (item->inbuf);
+  gst_buffer_unref (item->outbuf);
+  g_free (item);
+}
+
+/* call with the lock held */
+static void
+dlb_render_ahead_clear (DlbRenderAhead * ahead)
+{
+  DlbRenderAheadItem *item;
+
+  while ((item = g_queue_pop_head (&ahead->items)))
+    dlb_render_ahead_item_free (item);
+}
+
+/* call with the lock held */
+static DlbRenderAheadItem *
+dlb_render_ahead_next_job (DlbRenderAhead * ahead)
+{
+  if (ahead->flushing)
+    return NULL;
+
+  for (GList * l = ahead->items.head; l != NULL; l = l->next) {
+    DlbRenderAheadItem *item = l->data;
+
+    if (!item->done)
+      return item;
+  }
+
+  return NULL;
+}
+
+static gpointer
+dlb_render_ahead_thread (gpointer data)
+{
+  DlbRenderAhead *ahead = data;
+
+  g_mutex_lock (&ahead->lock);
+  while (ahead->running) {
+    DlbRenderAheadItem *item = dlb_render_ahead_next_job (ahead);
+    GstFlowReturn ret;
+
+    if (item == NULL) {
+      g_cond_wait (&ahead->cond, &ahead->lock);
+      continue;
+    }
+
+    ahead->busy = item;
+    g_mutex_unlock (&ahead->lock);
+
+    ret = ahead->func (item->inbuf, item->outbuf, ahead->user_data);
+
+    g_mutex_lock (&ahead->lock);
+    ahead->busy = NULL;
+    item->ret = ret;
+    item->done = TRUE;
+    g_cond_broadcast (&ahead->cond);
+  }
+  g_mutex_unlock (&ahead->lock);
+
+  return NULL;
+}
+
+/**
+ * dlb_render_ahead_new:
+ * @depth: number of frames to keep queued and rendered ahead
+ * @func: render function
+ * @user_data: data for @func
+ *
+ * Returns: a new render-ahead queue with its thread running, or NULL if the
+ * thread could not be started.
+ */
+DlbRenderAhead *
+dlb_render_ahead_new (guint depth, DlbRenderAheadFunc func, gpointer user_data)
+{
+  DlbRenderAhead *ahead = g_new0 (DlbRenderAhead, 1);
+  GError *error = NULL;
+
+  ahead->depth = depth;
+  ahead->func = func;
+  ahead->user_data = user_data;
+  g_mutex_init (&ahead->lock);
+  g_cond_init (&ahead->cond);
+  g_queue_init (&ahead->items);
+  ahead->running = TRUE;
+
+  ahead->thread = g_thread_try_new ("dlbrenderahead", dlb_render_ahead_thread,
+      ahead, &error);
+  if (ahead->thread == NULL) {
+    GST_WARNING ("could not start render-ahead thread: %s", error->message);
+    g_clear_error (&error);
+    g_mutex_clear (&ahead->lock);
+    g_cond_clear (&ahead->cond);
+    g_free (ahead);
+    return NULL;
+  }
+
+  GST_DEBUG ("rendering %u frames ahead", depth);
+
+  return ahead;
+}
+
+void
+dlb_render_ahead_free (DlbRenderAhead * ahead)
+{
+  g_mutex_lock (&ahead->lock);
+  ahead->running = FALSE;
+  g_cond_broadcast (&ahead->cond);
+  g_mutex_unlock (&ahead->lock);
+
+  g_thread_join (ahead->thread);
+
+  dlb_render_ahead_clear (ahead);
+  g_mutex_clear (&ahead->lock);
+  g_cond_clear (&ahead->cond);
+  g_free (ahead);
+}
+
+/* Queues @inbuf for rendering into @outbuf, taking ownership of both. Never
+ * blocks: the queue is bounded by the consumer taking a frame out after
+ * every push. */
+void
+dlb_render_ahead_push (DlbRenderAhead * ahead, GstBuffer * inbuf,
+    GstBuffer * outbuf)
+{
+  DlbRenderAheadItem *item = g_new0 (DlbRenderAheadItem, 1);
+
+  item->inbuf = inbuf;
+  item->outbuf = outbuf;
+
+  g_mutex_lock (&ahead->lock);
+  g_queue_push_tail (&ahead->items, item);
+  g_cond_broadcast (&ahead->cond);
+  g_mutex_unlock (&ahead->lock);
+}
+
+/**
+ * dlb_render_ahead_pop:
+ * @ahead: a #DlbRenderAhead
+ * @drain: take frames out even when no more than the depth is queued
+ * @outbuf: (out): the oldest rendered frame, NULL if there is none to take
+ *
+ * Takes the oldest frame out of the queue once more than the depth is
+ * queued, waiting for it to be rendered if needed. Frames without output
+ * are skipped and their output buffer released.
+ *
+ * Returns: the flow return of rendering the frame, or GST_FLOW_FLUSHING.
+ */
+GstFlowReturn
+dlb_render_ahead_pop (DlbRenderAhead * ahead, gboolean drain, GstBuffer ** outbuf)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  *outbuf = NULL;
+
+  g_mutex_lock (&ahead->lock);
+  while (TRUE) {
+    DlbRenderAheadItem *item = g_queue_peek_head (&ahead->items);
+
+    if (ahead->flushing) {
+      ret = GST_FLOW_FLUSHING;
+      break;
+    }
+
+    if (item == NULL || (!drain && ahead->items.length <= ahead->depth))
+      break;
+
+    if (!item->done) {
+      g_cond_wait (&ahead->cond, &ahead->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&ahead->items);
+    ret = item->ret;
+    if (ret == GST_FLOW_OK) {
+      *outbuf = item->outbuf;
+      item->outbuf = NULL;
+    }
+    if (item->outbuf)
+      gst_buffer_unref (item->outbuf);
+    gst_buffer_unref (item->inbuf);
+    g_free (item);
+
+    if (ret == GST_FLOW_CUSTOM_SUCCESS)
+      ret = GST_FLOW_OK;
+    else
+      break;
+  }
+  g_mutex_unlock (&ahead->lock);
+
+  return ret;
+}
+
+/* While flushing, waiting consumers return GST_FLOW_FLUSHING and nothing new
+ * is rendered. Starting to flush never blocks: the queued frames are
+ * dropped, releasing their output buffers to the pool the streaming thread
+ * may be waiting on, except the one being rendered. Stopping waits for that
+ * one and drops it too. */
+void
+dlb_render_ahead_set_flushing (DlbRenderAhead * ahead, gboolean flushing)
+{
+  g_mutex_lock (&ahead->lock);
+  if (flushing) {
+    GList *l = ahead->items.head;
+
+    ahead->flushing = TRUE;
+    while (l != NULL) {
+      GList *next = l->next;
+
+      if (l->data != ahead->busy) {
+        dlb_render_ahead_item_free (l->data);
+        g_queue_delete_link (&ahead->items, l);
+      }
+      l = next;
+    }
+  } else {
+    while (ahead->busy)
+      g_cond_wait (&ahead->cond, &ahead->lock);
+    dlb_render_ahead_clear (ahead);
+    ahead->flushing = FALSE;
+  }
+  g_cond_broadcast (&ahead->cond);
+  g_mutex_unlock (&ahead->lock);
+}
+
+/**
+ * dlb_render_ahead_get_level:
+ * @ahead: a #DlbRenderAhead
+ * @time: (out) (optional): total duration of the rendered frames
+ *
+ * Returns: the number of frames rendered and ready to be taken out.
+ */
+guint
+dlb_render_ahead_get_level (DlbRenderAhead * ahead, GstClockTime * time)
+{
+  GstClockTime total = 0;
+  guint level = 0;
+
+  g_mutex_lock (&ahead->lock);
+  for (GList * l = ahead->items.head; l != NULL; l = l->next) {
+    DlbRenderAheadItem *item = l->data;
+
+    if (!item->done)
+      continue;
+    level++;
+    if (GST_BUFFER_DURATION_IS_VALID (item->inbuf))
+      total += GST_BUFFER_DURATION (item->inbuf);
+  }
+  g_mutex_unlock (&ahead->lock);
+
+  if (time)
+    *time = total;
+
+  return level;
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_RENDER_AHEAD_H_
+#define _DLB_RENDER_AHEAD_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _DlbRenderAhead DlbRenderAhead;
+
+/**
+ * DlbRenderAheadFunc:
+ * @inbuf: the input frame
+ * @outbuf: the output buffer to render into, allocated by the consumer
+ * @user_data: data passed to dlb_render_ahead_new()
+ *
+ * Render one frame. Called from the render-ahead thread, in input order.
+ *
+ * Returns: a flow return, GST_FLOW_CUSTOM_SUCCESS if the frame has no
+ *     output.
+ */
+typedef GstFlowReturn (*DlbRenderAheadFunc) (GstBuffer * inbuf,
+    GstBuffer * outbuf, gpointer user_data);
+
+DlbRenderAhead *dlb_render_ahead_new (guint depth, DlbRenderAheadFunc func,
+    gpointer user_data);
+void dlb_render_ahead_free (DlbRenderAhead * ahead);
+void dlb_render_ahead_push (DlbRenderAhead * ahead, GstBuffer * inbuf,
+    GstBuffer * outbuf);
+GstFlowReturn dlb_render_ahead_pop (DlbRenderAhead * ahead, gboolean drain,
+    GstBuffer ** outbuf);
+void dlb_render_ahead_set_flushing (DlbRenderAhead * ahead, gboolean flushing);
+guint dlb_render_ahead_get_level (DlbRenderAhead * ahead, GstClockTime * time);
+
+G_END_DECLS
+
+#endif /* _DLB_RENDER_AHEAD_H_ */
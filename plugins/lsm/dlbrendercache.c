@@ -0,0 +1,264 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Byte-bounded LRU cache of rendered light frames. Lookups only hash the
+ * renderer input (configuration id, runtime parameters and LSM frame) in
+ * place. Each entry keeps a copy of the input it was rendered for, which a
+ * matching hash is compared with, so a hit is an exact match and not just a
+ * hash match. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "dlbrendercache.h"
+
+typedef struct _DlbRenderCacheEntry DlbRenderCacheEntry;
+
+struct _DlbRenderCacheEntry
+{
+  guint64 hash;
+  /* parameters followed by the data */
+  guint8 *input;
+  gsize params_size;
+  gsize input_size;
+  GstBuffer *buffer;
+  gsize size;
+  GList link;
+  /* next entry with the same hash */
+  DlbRenderCacheEntry *next;
+};
+
+struct _DlbRenderCache
+{
+  /* hash to the first entry with that hash */
+  GHashTable *entries;
+  GQueue lru;                   /* most recently used first */
+  gsize size;
+  gsize max_bytes;
+};
+
+/* 64-bit FNV-1a over words instead of bytes, the frames are hashed on
+ * every lookup */
+static guint64
+dlb_render_cache_hash (guint64 hash, const guint8 * data, gsize size)
+{
+  const guint64 prime = G_GUINT64_CONSTANT (0x100000001b3);
+  guint64 word;
+  gsize i;
+
+  for (i = 0; i + sizeof (word) <= size; i += sizeof (word)) {
+    memcpy (&word, data + i, sizeof (word));
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 32;
+  }
+  for (; i < size; i++)
+    hash = (hash ^ data[i]) * prime;
+
+  return hash;
+}
+
+/**
+ * dlb_render_cache_key_init:
+ * @key: the key to fill in
+ * @params: the runtime parameters and configuration id, without
+ *     uninitialized padding
+ * @params_size: size of @params
+ * @data: the renderer input
+ * @size: size of @data
+ *
+ * Hash the renderer input for a lookup, without copying it.
+ */
+void
+dlb_render_cache_key_init (DlbRenderCacheKey * key, gconstpointer params,
+    gsize params_size, gconstpointer data, gsize size)
+{
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+
+  hash = dlb_render_cache_hash (hash, params, params_size);
+  hash = dlb_render_cache_hash (hash, data, size);
+
+  key->hash = hash;
+  key->params = params;
+  key->params_size = params_size;
+  key->data = data;
+  key->size = size;
+}
+
+static gboolean
+dlb_render_cache_entry_matches (DlbRenderCacheEntry * entry,
+    const DlbRenderCacheKey * key)
+{
+  return entry->hash == key->hash &&
+      entry->params_size == key->params_size &&
+      entry->input_size == key->params_size + key->size &&
+      memcmp (entry->input, key->params, key->params_size) == 0 &&
+      memcmp (entry->input + key->params_size, key->data, key->size) == 0;
+}
+
+static void
+dlb_render_cache_entry_free (DlbRenderCacheEntry * entry)
+{
+  g_free (entry->input);
+  gst_buffer_unref (entry->buffer);
+  g_free (entry);
+}
+
+static DlbRenderCacheEntry *
+dlb_render_cache_find (DlbRenderCache * cache, const DlbRenderCacheKey * key)
+{
+  DlbRenderCacheEntry *entry = g_hash_table_lookup (cache->entries, &key->hash);
+
+  while (entry && !dlb_render_cache_entry_matches (entry, key))
+    entry = entry->next;
+
+  return entry;
+}
+
+static void
+dlb_render_cache_remove (DlbRenderCache * cache, DlbRenderCacheEntry * entry)
+{
+  DlbRenderCacheEntry *first = g_hash_table_lookup (cache->entries,
+      &entry->hash);
+
+  if (first == entry) {
+    /* the table key points into the entry, so it is replaced as well */
+    if (entry->next)
+      g_hash_table_replace (cache->entries, &entry->next->hash, entry->next);
+    else
+      g_hash_table_remove (cache->entries, &entry->hash);
+  } else {
+    while (first->next != entry)
+      first = first->next;
+    first->next = entry->next;
+  }
+
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->size -= entry->size;
+  dlb_render_cache_entry_free (entry);
+}
+
+DlbRenderCache *
+dlb_render_cache_new (gsize max_bytes)
+{
+  DlbRenderCache *cache = g_new0 (DlbRenderCache, 1);
+
+  cache->entries = g_hash_table_new (g_int64_hash, g_int64_equal);
+  g_queue_init (&cache->lru);
+  cache->max_bytes = max_bytes;
+
+  return cache;
+}
+
+void
+dlb_render_cache_free (DlbRenderCache * cache)
+{
+  dlb_render_cache_clear (cache);
+  g_hash_table_destroy (cache->entries);
+  g_free (cache);
+}
+
+void
+dlb_render_cache_clear (DlbRenderCache * cache)
+{
+  GList *link;
+
+  g_hash_table_remove_all (cache->entries);
+  while ((link = g_queue_pop_head_link (&cache->lru)))
+    dlb_render_cache_entry_free (link->data);
+  cache->size = 0;
+}
+
+/**
+ * dlb_render_cache_lookup:
+ * @cache: a #DlbRenderCache
+ * @key: the renderer input
+ *
+ * Returns: (transfer full) (nullable): the output rendered for @key, or
+ *     %NULL. The buffer is shared with the cache and must not be modified.
+ */
+GstBuffer *
+dlb_render_cache_lookup (DlbRenderCache * cache, const DlbRenderCacheKey * key)
+{
+  DlbRenderCacheEntry *entry = dlb_render_cache_find (cache, key);
+
+  if (entry == NULL)
+    return NULL;
+
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+
+  return gst_buffer_ref (entry->buffer);
+}
+
+/**
+ * dlb_render_cache_insert:
+ * @cache: a #DlbRenderCache
+ * @key: the renderer input
+ * @output: the output rendered for @key
+ *
+ * Store a copy of @output and of the input of @key, evicting the least
+ * recently used entries to stay within the size limit. Entries larger than
+ * the whole cache are not stored.
+ */
+void
+dlb_render_cache_insert (DlbRenderCache * cache, const DlbRenderCacheKey * key,
+    GstBuffer * output)
+{
+  DlbRenderCacheEntry *entry, *first;
+  gsize size;
+
+  size = key->params_size + key->size + gst_buffer_get_size (output);
+  if (size > cache->max_bytes || dlb_render_cache_find (cache, key))
+    return;
+
+  while (cache->size + size > cache->max_bytes)
+    dlb_render_cache_remove (cache, g_queue_peek_tail (&cache->lru));
+
+  entry = g_new0 (DlbRenderCacheEntry, 1);
+  entry->hash = key->hash;
+  entry->params_size = key->params_size;
+  entry->input_size = key->params_size + key->size;
+  entry->input = g_malloc (entry->input_size);
+  memcpy (entry->input, key->params, key->params_size);
+  memcpy (entry->input + key->params_size, key->data, key->size);
+  /* a deep copy, so the output buffer goes back to its pool */
+  entry->buffer = gst_buffer_copy_deep (output);
+  entry->size = size;
+  entry->link.data = entry;
+
+  first = g_hash_table_lookup (cache->entries, &entry->hash);
+  if (first) {
+    entry->next = first->next;
+    first->next = entry;
+  } else {
+    g_hash_table_insert (cache->entries, &entry->hash, entry);
+  }
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += size;
+}
+
+gsize
+dlb_render_cache_get_size (DlbRenderCache * cache)
+{
+  return cache->size;
+}
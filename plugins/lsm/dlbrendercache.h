@@ -0,0 +1,67 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_RENDER_CACHE_H_
+#define _DLB_RENDER_CACHE_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _DlbRenderCache DlbRenderCache;
+typedef struct _DlbRenderCacheKey DlbRenderCacheKey;
+
+/**
+ * DlbRenderCacheKey:
+ * @hash: hash of the parameters and the data
+ * @params: the runtime parameters and configuration id
+ * @params_size: size of @params
+ * @data: the renderer input, e.g. a mapped LSM frame
+ * @size: size of @data
+ *
+ * Renderer input the cache is looked up with. It only points to the input,
+ * which must stay valid while the key is used.
+ */
+struct _DlbRenderCacheKey
+{
+  guint64 hash;
+  gconstpointer params;
+  gsize params_size;
+  gconstpointer data;
+  gsize size;
+};
+
+void dlb_render_cache_key_init (DlbRenderCacheKey * key, gconstpointer params,
+    gsize params_size, gconstpointer data, gsize size);
+
+DlbRenderCache *dlb_render_cache_new (gsize max_bytes);
+void dlb_render_cache_free (DlbRenderCache * cache);
+void dlb_render_cache_clear (DlbRenderCache * cache);
+
+GstBuffer *dlb_render_cache_lookup (DlbRenderCache * cache,
+    const DlbRenderCacheKey * key);
+void dlb_render_cache_insert (DlbRenderCache * cache,
+    const DlbRenderCacheKey * key, GstBuffer * output);
+
+gsize dlb_render_cache_get_size (DlbRenderCache * cache);
+
+G_END_DECLS
+
+#endif /* _DLB_RENDER_CACHE_H_ */
@@ -0,0 +1,345 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Renderer pre-instantiation: the configuration file is read as soon as it
+ * is known and, once the stream parameters are expected, a renderer is
+ * created for them on a helper thread. The element adopts that renderer
+ * when the negotiated parameters turn out to match, so neither the file
+ * read nor dlb_lsr_new() are left for the first caps. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlbrendererprewarm.h"
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category ()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat = 0;
+
+  if (g_once_init_enter (&cat)) {
+    gsize _cat = (gsize) _gst_debug_category_new ("dlbrendererprewarm", 0,
+        "light renderer pre-instantiation");
+    g_once_init_leave (&cat, _cat);
+  }
+
+  return (GstDebugCategory *) cat;
+}
+#endif
+
+struct _DlbRendererPrewarm
+{
+  gchar *config_path;
+
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean stopping;
+
+  /* configuration file, NULL if it could not be used */
+  gboolean loaded;
+  GBytes *config;
+  GstClockTime load_time;
+  gboolean config_used;
+
+  /* renderer for the expected stream parameters */
+  gboolean create_requested;
+  dlb_lsr_init_info expected;
+  gboolean created;
+  dlb_lsr *instance;
+  GstClockTime create_time;
+
+  /* work done ahead that the element did not have to wait for */
+  GstClockTime time_saved;
+};
+
+static GBytes *
+dlb_renderer_prewarm_load (const gchar * config_path)
+{
+  GError *error = NULL;
+  gchar *contents;
+  gsize size;
+
+  if (!g_file_get_contents (config_path, &contents, &size, &error)) {
+    GST_WARNING ("could not read %s: %s", config_path, error->message);
+    g_clear_error (&error);
+    return NULL;
+  }
+
+  if (size == 0) {
+    GST_WARNING ("%s is empty", config_path);
+    g_free (contents);
+    return NULL;
+  }
+
+  return g_bytes_new_take (contents, size);
+}
+
+static gpointer
+dlb_renderer_prewarm_thread (gpointer data)
+{
+  DlbRendererPrewarm *prewarm = data;
+  GstClockTime start;
+  GBytes *config;
+  dlb_lsr_init_info info;
+  dlb_lsr *instance = NULL;
+
+  start = gst_util_get_timestamp ();
+  config = dlb_renderer_prewarm_load (prewarm->config_path);
+
+  g_mutex_lock (&prewarm->lock);
+  prewarm->config = config;
+  prewarm->load_time = gst_util_get_timestamp () - start;
+  prewarm->loaded = TRUE;
+  g_cond_broadcast (&prewarm->cond);
+  GST_DEBUG ("loaded %s in %" GST_TIME_FORMAT, prewarm->config_path,
+      GST_TIME_ARGS (prewarm->load_time));
+
+  while (!prewarm->stopping && !prewarm->create_requested)
+    g_cond_wait (&prewarm->cond, &prewarm->lock);
+
+  if (prewarm->stopping || config == NULL)
+    goto done;
+
+  info = prewarm->expected;
+  g_mutex_unlock (&prewarm->lock);
+
+  info.serialized_conf = g_bytes_get_data (config, &info.serialized_conf_size);
+  start = gst_util_get_timestamp ();
+  instance = dlb_lsr_new (&info);
+
+  g_mutex_lock (&prewarm->lock);
+  prewarm->instance = instance;
+  prewarm->create_time = gst_util_get_timestamp () - start;
+  if (instance)
+    GST_DEBUG ("renderer created in %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (prewarm->create_time));
+  else
+    GST_WARNING ("could not create renderer for the expected parameters");
+
+done:
+  prewarm->created = TRUE;
+  g_cond_broadcast (&prewarm->cond);
+  g_mutex_unlock (&prewarm->lock);
+
+  return NULL;
+}
+
+/**
+ * dlb_renderer_prewarm_new:
+ * @config_path: the renderer configuration file
+ *
+ * Starts reading @config_path on a helper thread.
+ *
+ * Returns: a new #DlbRendererPrewarm, or NULL if the thread could not be
+ * started.
+ */
+DlbRendererPrewarm *
+dlb_renderer_prewarm_new (const gchar * config_path)
+{
+  DlbRendererPrewarm *prewarm = g_new0 (DlbRendererPrewarm, 1);
+  GError *error = NULL;
+
+  prewarm->config_path = g_strdup (config_path);
+  g_mutex_init (&prewarm->lock);
+  g_cond_init (&prewarm->cond);
+
+  prewarm->thread = g_thread_try_new ("dlbprewarm",
+      dlb_renderer_prewarm_thread, prewarm, &error);
+  if (prewarm->thread == NULL) {
+    GST_WARNING ("could not start pre-instantiation thread: %s",
+        error->message);
+    g_clear_error (&error);
+    g_mutex_clear (&prewarm->lock);
+    g_cond_clear (&prewarm->cond);
+    g_free (prewarm->config_path);
+    g_free (prewarm);
+    return NULL;
+  }
+
+  return prewarm;
+}
+
+/* Waits for the helper thread, which may still be creating a renderer */
+void
+dlb_renderer_prewarm_free (DlbRendererPrewarm * prewarm)
+{
+  g_mutex_lock (&prewarm->lock);
+  prewarm->stopping = TRUE;
+  g_cond_broadcast (&prewarm->cond);
+  g_mutex_unlock (&prewarm->lock);
+
+  g_thread_join (prewarm->thread);
+
+  if (prewarm->instance)
+    dlb_lsr_free (prewarm->instance);
+  if (prewarm->config)
+    g_bytes_unref (prewarm->config);
+  g_mutex_clear (&prewarm->lock);
+  g_cond_clear (&prewarm->cond);
+  g_free (prewarm->config_path);
+  g_free (prewarm);
+}
+
+gboolean
+dlb_renderer_prewarm_has_config (DlbRendererPrewarm * prewarm,
+    const gchar * config_path)
+{
+  return g_strcmp0 (prewarm->config_path, config_path) == 0;
+}
+
+/**
+ * dlb_renderer_prewarm_create:
+ * @prewarm: a #DlbRendererPrewarm
+ * @expected: the expected stream parameters, the configuration fields are
+ *     ignored
+ *
+ * Creates a renderer for @expected once the configuration is loaded. Only
+ * the first request is honoured.
+ */
+void
+dlb_renderer_prewarm_create (DlbRendererPrewarm * prewarm,
+    const dlb_lsr_init_info * expected)
+{
+  g_mutex_lock (&prewarm->lock);
+  if (!prewarm->create_requested) {
+    prewarm->expected = *expected;
+    prewarm->expected.serialized_conf = NULL;
+    prewarm->expected.serialized_conf_size = 0;
+    prewarm->create_requested = TRUE;
+    g_cond_broadcast (&prewarm->cond);
+  }
+  g_mutex_unlock (&prewarm->lock);
+}
+
+/* Part of @work the caller did not have to wait for */
+static GstClockTime
+dlb_renderer_prewarm_saved (GstClockTime work, GstClockTime wait_start)
+{
+  GstClockTime waited = gst_util_get_timestamp () - wait_start;
+
+  return work > waited ? work - waited : 0;
+}
+
+/**
+ * dlb_renderer_prewarm_get_config:
+ * @prewarm: a #DlbRendererPrewarm
+ *
+ * Waits for the configuration file to be read.
+ *
+ * Returns: (transfer full) (nullable): the configuration, or NULL if it
+ * could not be read or is empty.
+ */
+GBytes *
+dlb_renderer_prewarm_get_config (DlbRendererPrewarm * prewarm)
+{
+  GstClockTime wait_start = gst_util_get_timestamp ();
+  GBytes *config = NULL;
+
+  g_mutex_lock (&prewarm->lock);
+  while (!prewarm->loaded)
+    g_cond_wait (&prewarm->cond, &prewarm->lock);
+
+  if (prewarm->config) {
+    config = g_bytes_ref (prewarm->config);
+    if (!prewarm->config_used) {
+      prewarm->time_saved +=
+          dlb_renderer_prewarm_saved (prewarm->load_time, wait_start);
+      prewarm->config_used = TRUE;
+    }
+  }
+  g_mutex_unlock (&prewarm->lock);
+
+  return config;
+}
+
+static gboolean
+dlb_renderer_prewarm_matches (const dlb_lsr_init_info * expected,
+    const dlb_lsr_init_info * info)
+{
+  return expected->color_space == info->color_space &&
+      expected->max_num_objs == info->max_num_objs &&
+      expected->max_num_md == info->max_num_md &&
+      expected->frame_period_us == info->frame_period_us;
+}
+
+/**
+ * dlb_renderer_prewarm_take:
+ * @prewarm: a #DlbRendererPrewarm
+ * @info: the negotiated stream parameters
+ *
+ * Takes the renderer created ahead, waiting for it if it is still being
+ * created. A renderer is only handed out once, and only if it was created
+ * for the parameters in @info.
+ *
+ * Returns: (transfer full) (nullable): the renderer, or NULL if there is
+ * none for @info.
+ */
+dlb_lsr *
+dlb_renderer_prewarm_take (DlbRendererPrewarm * prewarm,
+    const dlb_lsr_init_info * info)
+{
+  GstClockTime wait_start = gst_util_get_timestamp ();
+  dlb_lsr *instance = NULL;
+
+  g_mutex_lock (&prewarm->lock);
+  if (!prewarm->create_requested)
+    goto done;
+
+  if (!dlb_renderer_prewarm_matches (&prewarm->expected, info)) {
+    GST_INFO ("stream parameters differ from the expected ones (color space "
+        "%u/%u, %u/%u objects, frame period %u/%u us)",
+        info->color_space, prewarm->expected.color_space,
+        info->max_num_objs, prewarm->expected.max_num_objs,
+        info->frame_period_us, prewarm->expected.frame_period_us);
+    goto done;
+  }
+
+  while (!prewarm->created)
+    g_cond_wait (&prewarm->cond, &prewarm->lock);
+
+  instance = prewarm->instance;
+  prewarm->instance = NULL;
+  if (instance)
+    prewarm->time_saved +=
+        dlb_renderer_prewarm_saved (prewarm->create_time, wait_start);
+
+done:
+  g_mutex_unlock (&prewarm->lock);
+
+  return instance;
+}
+
+/* Returns: how much of the startup work was done before it was needed */
+GstClockTime
+dlb_renderer_prewarm_get_time_saved (DlbRendererPrewarm * prewarm)
+{
+  GstClockTime saved;
+
+  g_mutex_lock (&prewarm->lock);
+  saved = prewarm->time_saved;
+  g_mutex_unlock (&prewarm->lock);
+
+  return saved;
+}
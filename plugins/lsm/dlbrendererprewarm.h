@@ -0,0 +1,44 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_RENDERER_PREWARM_H_
+#define _DLB_RENDERER_PREWARM_H_
+
+#include <gst/gst.h>
+#include "dlb_lightscapes.h"
+
+G_BEGIN_DECLS
+
+typedef struct _DlbRendererPrewarm DlbRendererPrewarm;
+
+DlbRendererPrewarm *dlb_renderer_prewarm_new (const gchar * config_path);
+void dlb_renderer_prewarm_free (DlbRendererPrewarm * prewarm);
+gboolean dlb_renderer_prewarm_has_config (DlbRendererPrewarm * prewarm,
+    const gchar * config_path);
+void dlb_renderer_prewarm_create (DlbRendererPrewarm * prewarm,
+    const dlb_lsr_init_info * expected);
+GBytes *dlb_renderer_prewarm_get_config (DlbRendererPrewarm * prewarm);
+dlb_lsr *dlb_renderer_prewarm_take (DlbRendererPrewarm * prewarm,
+    const dlb_lsr_init_info * info);
+GstClockTime dlb_renderer_prewarm_get_time_saved (DlbRendererPrewarm * prewarm);
+
+G_END_DECLS
+
+#endif /* _DLB_RENDERER_PREWARM_H_ */
@@ -0,0 +1,352 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Process-wide render scheduler shared by all dlblightning instances that
+ * opt in. A fixed set of workers, one per core, runs the frames of every
+ * stream earliest-deadline-first. Each stream has a home worker so that its
+ * renderer state stays in that worker's cache; idle workers steal the most
+ * urgent job of the other workers. A stream never has more than one frame
+ * in flight, so its frames are rendered and returned in submission order. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlbrenderpool.h"
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category ()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat = 0;
+
+  if (g_once_init_enter (&cat)) {
+    gsize _cat = (gsize) _gst_debug_category_new ("dlbrenderpool", 0,
+        "shared light render pool");
+    g_once_init_leave (&cat, _cat);
+  }
+
+  return (GstDebugCategory *) cat;
+}
+#endif
+
+typedef struct _DlbRenderPool DlbRenderPool;
+typedef struct _DlbRenderWorker DlbRenderWorker;
+typedef struct _DlbRenderJob DlbRenderJob;
+
+struct _DlbRenderJob
+{
+  DlbRenderStream *stream;
+  GstClockTime deadline;
+  DlbRenderFunc func;
+  gpointer user_data;
+  gboolean done;
+};
+
+struct _DlbRenderWorker
+{
+  DlbRenderPool *pool;
+  guint index;
+  GThread *thread;
+  GCond cond;
+
+  /* jobs of the streams living on this worker, by deadline */
+  GQueue jobs;
+  guint n_streams;
+  gboolean waiting;
+
+  guint64 rendered;
+  guint64 stolen;
+};
+
+struct _DlbRenderStream
+{
+  DlbRenderPool *pool;
+  DlbRenderWorker *home;
+  GCond cond;
+};
+
+struct _DlbRenderPool
+{
+  GMutex lock;
+  gboolean running;
+  guint n_streams;
+  guint n_workers;
+  DlbRenderWorker *workers;
+};
+
+/* the default pool, created with the first stream and torn down with the
+ * last one */
+static GMutex default_pool_lock;
+static DlbRenderPool *default_pool;
+
+/* call with the pool lock held */
+static DlbRenderJob *
+dlb_render_pool_steal (DlbRenderPool * pool, DlbRenderWorker * thief)
+{
+  DlbRenderWorker *victim = NULL;
+  GstClockTime earliest = GST_CLOCK_TIME_NONE;
+
+  for (guint i = 0; i < pool->n_workers; i++) {
+    DlbRenderWorker *worker = &pool->workers[i];
+    DlbRenderJob *job;
+
+    if (worker == thief || (job = g_queue_peek_head (&worker->jobs)) == NULL)
+      continue;
+    if (victim == NULL || job->deadline < earliest) {
+      victim = worker;
+      earliest = job->deadline;
+    }
+  }
+
+  if (victim == NULL)
+    return NULL;
+
+  thief->stolen++;
+  return g_queue_pop_head (&victim->jobs);
+}
+
+static gpointer
+dlb_render_pool_worker (gpointer data)
+{
+  DlbRenderWorker *worker = data;
+  DlbRenderPool *pool = worker->pool;
+
+  g_mutex_lock (&pool->lock);
+  while (pool->running) {
+    DlbRenderJob *job = g_queue_pop_head (&worker->jobs);
+
+    if (job == NULL)
+      job = dlb_render_pool_steal (pool, worker);
+
+    if (job == NULL) {
+      worker->waiting = TRUE;
+      g_cond_wait (&worker->cond, &pool->lock);
+      worker->waiting = FALSE;
+      continue;
+    }
+
+    g_mutex_unlock (&pool->lock);
+    job->func (job->user_data);
+    g_mutex_lock (&pool->lock);
+
+    worker->rendered++;
+    job->done = TRUE;
+    g_cond_signal (&job->stream->cond);
+  }
+  g_mutex_unlock (&pool->lock);
+
+  return NULL;
+}
+
+static void
+dlb_render_pool_free (DlbRenderPool * pool)
+{
+  g_mutex_lock (&pool->lock);
+  pool->running = FALSE;
+  for (guint i = 0; i < pool->n_workers; i++)
+    g_cond_signal (&pool->workers[i].cond);
+  g_mutex_unlock (&pool->lock);
+
+  for (guint i = 0; i < pool->n_workers; i++) {
+    DlbRenderWorker *worker = &pool->workers[i];
+
+    g_thread_join (worker->thread);
+    g_cond_clear (&worker->cond);
+    GST_DEBUG ("worker %u rendered %" G_GUINT64_FORMAT " frames, %"
+        G_GUINT64_FORMAT " stolen", i, worker->rendered, worker->stolen);
+  }
+
+  g_free (pool->workers);
+  g_mutex_clear (&pool->lock);
+  g_free (pool);
+}
+
+static DlbRenderPool *
+dlb_render_pool_new (void)
+{
+  DlbRenderPool *pool = g_new0 (DlbRenderPool, 1);
+  guint n_workers = MAX (g_get_num_processors (), 1);
+
+  g_mutex_init (&pool->lock);
+  pool->running = TRUE;
+  pool->workers = g_new0 (DlbRenderWorker, n_workers);
+
+  /* Started workers wait on the pool lock until n_workers is final */
+  g_mutex_lock (&pool->lock);
+  for (guint i = 0; i < n_workers; i++) {
+    DlbRenderWorker *worker = &pool->workers[i];
+    GError *error = NULL;
+    gchar *name;
+
+    worker->pool = pool;
+    worker->index = i;
+    g_cond_init (&worker->cond);
+    g_queue_init (&worker->jobs);
+
+    name = g_strdup_printf ("lightrender%u", i);
+    worker->thread = g_thread_try_new (name, dlb_render_pool_worker, worker, &error);
+    g_free (name);
+
+    if (worker->thread == NULL) {
+      GST_WARNING ("could not create render worker %u: %s", i, error->message);
+      g_clear_error (&error);
+      g_cond_clear (&worker->cond);
+      break;
+    }
+    pool->n_workers++;
+  }
+  g_mutex_unlock (&pool->lock);
+
+  if (pool->n_workers == 0) {
+    dlb_render_pool_free (pool);
+    return NULL;
+  }
+
+  GST_INFO ("created render pool with %u workers", pool->n_workers);
+  return pool;
+}
+
+/**
+ * dlb_render_stream_new:
+ *
+ * Register a stream with the process-wide render pool, creating the pool
+ * if needed. The stream is homed on the worker serving the fewest streams.
+ *
+ * Returns: (transfer full) (nullable): a new stream, or %NULL if the pool
+ *     could not be created.
+ */
+DlbRenderStream *
+dlb_render_stream_new (void)
+{
+  DlbRenderStream *stream;
+  DlbRenderPool *pool;
+  DlbRenderWorker *home;
+
+  g_mutex_lock (&default_pool_lock);
+  if (default_pool == NULL)
+    default_pool = dlb_render_pool_new ();
+  pool = default_pool;
+  if (pool == NULL) {
+    g_mutex_unlock (&default_pool_lock);
+    return NULL;
+  }
+
+  g_mutex_lock (&pool->lock);
+  home = &pool->workers[0];
+  for (guint i = 1; i < pool->n_workers; i++) {
+    if (pool->workers[i].n_streams < home->n_streams)
+      home = &pool->workers[i];
+  }
+  home->n_streams++;
+  pool->n_streams++;
+  g_mutex_unlock (&pool->lock);
+  g_mutex_unlock (&default_pool_lock);
+
+  stream = g_new0 (DlbRenderStream, 1);
+  stream->pool = pool;
+  stream->home = home;
+  g_cond_init (&stream->cond);
+
+  GST_DEBUG ("new stream %p on worker %u", stream, home->index);
+  return stream;
+}
+
+/**
+ * dlb_render_stream_free:
+ * @stream: a #DlbRenderStream without a frame in flight
+ *
+ * Unregister @stream. The pool is destroyed with its last stream.
+ */
+void
+dlb_render_stream_free (DlbRenderStream * stream)
+{
+  DlbRenderPool *pool = stream->pool;
+  gboolean last;
+
+  g_mutex_lock (&default_pool_lock);
+  g_mutex_lock (&pool->lock);
+  stream->home->n_streams--;
+  last = (--pool->n_streams == 0);
+  g_mutex_unlock (&pool->lock);
+  if (last)
+    default_pool = NULL;
+  g_mutex_unlock (&default_pool_lock);
+
+  if (last)
+    dlb_render_pool_free (pool);
+
+  g_cond_clear (&stream->cond);
+  g_free (stream);
+}
+
+/**
+ * dlb_render_stream_process:
+ * @stream: a #DlbRenderStream
+ * @deadline: absolute clock time the frame is needed by, or
+ *     %GST_CLOCK_TIME_NONE to render it after all timed frames
+ * @func: function rendering the frame
+ * @user_data: data passed to @func
+ *
+ * Run @func on a worker of the pool and wait for it to complete. Calls for
+ * the same stream must not overlap.
+ */
+void
+dlb_render_stream_process (DlbRenderStream * stream, GstClockTime deadline,
+    DlbRenderFunc func, gpointer user_data)
+{
+  DlbRenderPool *pool = stream->pool;
+  DlbRenderWorker *home = stream->home;
+  DlbRenderJob job = { stream, deadline, func, user_data, FALSE };
+  GList *l;
+
+  g_mutex_lock (&pool->lock);
+
+  /* keep the home queue ordered by deadline, FIFO among equal deadlines */
+  for (l = home->jobs.tail; l != NULL; l = l->prev) {
+    if (((DlbRenderJob *) l->data)->deadline <= deadline)
+      break;
+  }
+  if (l != NULL)
+    g_queue_insert_after (&home->jobs, l, &job);
+  else
+    g_queue_push_head (&home->jobs, &job);
+
+  if (home->waiting) {
+    home->waiting = FALSE;
+    g_cond_signal (&home->cond);
+  } else {
+    /* the home worker is busy, let an idle one steal the job */
+    for (guint i = 0; i < pool->n_workers; i++) {
+      if (pool->workers[i].waiting) {
+        pool->workers[i].waiting = FALSE;
+        g_cond_signal (&pool->workers[i].cond);
+        break;
+      }
+    }
+  }
+
+  while (!job.done)
+    g_cond_wait (&stream->cond, &pool->lock);
+
+  g_mutex_unlock (&pool->lock);
+}
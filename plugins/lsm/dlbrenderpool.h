@@ -0,0 +1,45 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_RENDER_POOL_H_
+#define _DLB_RENDER_POOL_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _DlbRenderStream DlbRenderStream;
+
+/**
+ * DlbRenderFunc:
+ * @user_data: data passed to dlb_render_stream_process()
+ *
+ * Render one frame. Called from a worker of the shared render pool.
+ */
+typedef void (*DlbRenderFunc) (gpointer user_data);
+
+DlbRenderStream *dlb_render_stream_new (void);
+void dlb_render_stream_free (DlbRenderStream * stream);
+void dlb_render_stream_process (DlbRenderStream * stream, GstClockTime deadline,
+    DlbRenderFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* _DLB_RENDER_POOL_H_ */
@@ -0,0 +1,60 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_RTP_H_
+#define _DLB_LIGHT_RTP_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * RTP payload format of application/x-lights frames (encoding name
+ * X-DLB-LIGHTS, 90 kHz clock). A frame is sent as one or more packets with
+ * the same timestamp, the marker bit set on the last one. Every packet
+ * starts with a two byte payload header followed by a complete
+ * application/x-lights frame holding a subset of the strips, so strips are
+ * never split across packets:
+ *
+ *   uint8  flags (DLB_LIGHT_RTP_FLAG_*)
+ *   uint8  reserved, 0
+ *   uint16 num_strips (little endian), then num_strips strips
+ *
+ * A key frame carries every strip, in frame order. Other frames only carry
+ * the strips that changed since the previous frame; a receiver keeps the
+ * last state of every strip and fills in the rest.
+ */
+
+#define DLB_LIGHT_RTP_ENCODING_NAME "X-DLB-LIGHTS"
+#define DLB_LIGHT_RTP_CLOCK_RATE 90000
+
+#define DLB_LIGHT_RTP_HEADER_SIZE (2)
+
+/* first packet of a frame */
+#define DLB_LIGHT_RTP_FLAG_START (1 << 0)
+/* the frame carries every strip */
+#define DLB_LIGHT_RTP_FLAG_KEY   (1 << 1)
+
+/* custom upstream event name used by rtpsession for PLI/FIR */
+#define DLB_LIGHT_RTP_FORCE_KEY_UNIT "GstForceKeyUnit"
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_RTP_H_
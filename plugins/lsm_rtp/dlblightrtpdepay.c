@@ -0,0 +1,459 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightrtpdepay
+ *
+ * Depayloads rendered light frames from RTP packets made by
+ * #DlbLightRtpPay. The element keeps the last state of every strip: delta
+ * frames only update the strips they carry, and strips of lost packets keep
+ * their previous values, so losses show as a held light rather than a gap.
+ * After a loss, and until the first key frame has arrived, a GstForceKeyUnit
+ * event is sent upstream, which rtpsession turns into an RTCP PLI so a late
+ * joiner is in sync within a round trip.
+ *
+ * A frame is pushed as soon as its last packet arrives, so the element adds
+ * no latency of its own. Keep the jitter buffer below one frame period and
+ * let it drop what arrives later, which also bounds the receive buffer:
+ *
+ * |[
+ * gst-launch-1.0 udpsrc port=5004 caps="application/x-rtp, media=application, clock-rate=90000, encoding-name=X-DLB-LIGHTS" ! rtpjitterbuffer latency=20 drop-on-latency=true ! dlblightrtpdepay ! dlblighttextsink
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightrtpdepay.h"
+#include "dlblightrtp.h"
+#include "dlblightlayout.h"
+
+#include <string.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_rtp_depay_debug_category);
+#define GST_CAT_DEFAULT dlb_light_rtp_depay_debug_category
+
+enum
+{
+  PROP_0,
+  PROP_REQUEST_KEYFRAME,
+  PROP_CONCEALED_FRAMES,
+  PROP_KEYFRAME_REQUESTS,
+};
+
+#define DEFAULT_REQUEST_KEYFRAME TRUE
+
+/* minimum time between two key frame requests, in microseconds */
+#define KEYFRAME_REQUEST_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+
+static GstStaticPadTemplate dlb_light_rtp_depay_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+                     " media = (string) application, "
+                     " clock-rate = (int) 90000, "
+                     " encoding-name = (string) X-DLB-LIGHTS; ")
+    );
+
+static GstStaticPadTemplate dlb_light_rtp_depay_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+/* class initialization */
+G_DEFINE_TYPE_WITH_CODE (DlbLightRtpDepay, dlb_light_rtp_depay, GST_TYPE_RTP_BASE_DEPAYLOAD,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_rtp_depay_debug_category, "dlblightrtpdepay", 0,
+        "debug category for dlb_light_rtp_depay element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightrtpdepay, "dlblightrtpdepay", GST_RANK_SECONDARY,
+                             DLB_TYPE_LIGHT_RTP_DEPAY);
+
+static void dlb_light_rtp_depay_finalize (GObject * object);
+static void dlb_light_rtp_depay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void dlb_light_rtp_depay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn dlb_light_rtp_depay_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean dlb_light_rtp_depay_set_caps (GstRTPBaseDepayload * depayload,
+    GstCaps * caps);
+static gboolean dlb_light_rtp_depay_handle_event (GstRTPBaseDepayload * depayload,
+    GstEvent * event);
+static GstBuffer *dlb_light_rtp_depay_process (GstRTPBaseDepayload * depayload,
+    GstRTPBuffer * rtp);
+
+static void
+dlb_light_rtp_depay_class_init (DlbLightRtpDepayClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstRTPBaseDepayloadClass *depayload_class = GST_RTP_BASE_DEPAYLOAD_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_rtp_depay_finalize;
+  gobject_class->set_property = dlb_light_rtp_depay_set_property;
+  gobject_class->get_property = dlb_light_rtp_depay_get_property;
+
+  /**
+   * DlbLightRtpDepay:request-keyframe:
+   *
+   * Send a GstForceKeyUnit event upstream after packet loss and while no
+   * key frame has been received, at most every 100 ms.
+   */
+  g_object_class_install_property (gobject_class, PROP_REQUEST_KEYFRAME,
+      g_param_spec_boolean ("request-keyframe", "Request key frame",
+          "Request a key frame after packet loss and when joining a stream",
+          DEFAULT_REQUEST_KEYFRAME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightRtpDepay:concealed-frames:
+   *
+   * Number of frames pushed with strips held from earlier frames because
+   * packets were lost.
+   */
+  g_object_class_install_property (gobject_class, PROP_CONCEALED_FRAMES,
+      g_param_spec_uint64 ("concealed-frames", "Concealed frames",
+          "Number of frames with strips held because of packet loss",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightRtpDepay:keyframe-requests:
+   *
+   * Number of key frame requests sent upstream.
+   */
+  g_object_class_install_property (gobject_class, PROP_KEYFRAME_REQUESTS,
+      g_param_spec_uint64 ("keyframe-requests", "Key frame requests",
+          "Number of key frame requests sent upstream",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Dolby Light RTP Depayloader",
+      "Codec/Depayloader/Network/RTP",
+      "Extract rendered light frames from RTP packets",
+      "Dolby Support <support@dolby.com>");
+
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_rtp_depay_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_rtp_depay_src_template);
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (dlb_light_rtp_depay_change_state);
+
+  depayload_class->set_caps = GST_DEBUG_FUNCPTR (dlb_light_rtp_depay_set_caps);
+  depayload_class->handle_event = GST_DEBUG_FUNCPTR (dlb_light_rtp_depay_handle_event);
+  depayload_class->process_rtp_packet = GST_DEBUG_FUNCPTR (dlb_light_rtp_depay_process);
+}
+
+static void
+dlb_light_rtp_depay_init (DlbLightRtpDepay * depay)
+{
+  depay->request_keyframe = DEFAULT_REQUEST_KEYFRAME;
+  depay->concealed_frames = 0;
+  depay->keyframe_requests = 0;
+  depay->num_strips = 0;
+  depay->have_key = FALSE;
+  depay->in_frame = FALSE;
+  depay->last_request = 0;
+}
+
+static void
+dlb_light_rtp_depay_reset (DlbLightRtpDepay * depay)
+{
+  for (guint i = 0; i < DLB_LIGHT_RTP_DEPAY_MAX_STRIPS; i++)
+    g_clear_pointer (&depay->strip[i], g_bytes_unref);
+
+  depay->num_strips = 0;
+  depay->have_key = FALSE;
+  depay->in_frame = FALSE;
+  depay->last_request = 0;
+}
+
+static void
+dlb_light_rtp_depay_finalize (GObject * object)
+{
+  dlb_light_rtp_depay_reset (DLB_LIGHT_RTP_DEPAY (object));
+
+  G_OBJECT_CLASS (dlb_light_rtp_depay_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_rtp_depay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightRtpDepay *depay = DLB_LIGHT_RTP_DEPAY (object);
+
+  switch (prop_id) {
+    case PROP_REQUEST_KEYFRAME:
+      GST_OBJECT_LOCK (depay);
+      depay->request_keyframe = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (depay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_rtp_depay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightRtpDepay *depay = DLB_LIGHT_RTP_DEPAY (object);
+
+  GST_OBJECT_LOCK (depay);
+  switch (prop_id) {
+    case PROP_REQUEST_KEYFRAME:
+      g_value_set_boolean (value, depay->request_keyframe);
+      break;
+    case PROP_CONCEALED_FRAMES:
+      g_value_set_uint64 (value, depay->concealed_frames);
+      break;
+    case PROP_KEYFRAME_REQUESTS:
+      g_value_set_uint64 (value, depay->keyframe_requests);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (depay);
+}
+
+static GstStateChangeReturn
+dlb_light_rtp_depay_change_state (GstElement * element, GstStateChange transition)
+{
+  DlbLightRtpDepay *depay = DLB_LIGHT_RTP_DEPAY (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    GST_OBJECT_LOCK (depay);
+    depay->concealed_frames = 0;
+    depay->keyframe_requests = 0;
+    GST_OBJECT_UNLOCK (depay);
+  }
+
+  ret = GST_ELEMENT_CLASS (dlb_light_rtp_depay_parent_class)->change_state (element,
+      transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    dlb_light_rtp_depay_reset (depay);
+
+  return ret;
+}
+
+static gboolean
+dlb_light_rtp_depay_set_caps (GstRTPBaseDepayload * depayload, GstCaps * caps)
+{
+  GstCaps *srccaps;
+  gboolean ret;
+
+  depayload->clock_rate = DLB_LIGHT_RTP_CLOCK_RATE;
+
+  srccaps = gst_caps_new_simple ("application/x-lights",
+      "format", G_TYPE_STRING, "DLB", NULL);
+  ret = gst_pad_set_caps (GST_RTP_BASE_DEPAYLOAD_SRCPAD (depayload), srccaps);
+  gst_caps_unref (srccaps);
+
+  return ret;
+}
+
+static gboolean
+dlb_light_rtp_depay_handle_event (GstRTPBaseDepayload * depayload,
+    GstEvent * event)
+{
+  DlbLightRtpDepay *depay = DLB_LIGHT_RTP_DEPAY (depayload);
+
+  /* the frame being received will not be completed */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    depay->in_frame = FALSE;
+
+  return GST_RTP_BASE_DEPAYLOAD_CLASS (dlb_light_rtp_depay_parent_class)->handle_event
+      (depayload, event);
+}
+
+static void
+dlb_light_rtp_depay_request_keyframe (DlbLightRtpDepay * depay)
+{
+  gint64 now = g_get_monotonic_time ();
+  GstEvent *event;
+
+  GST_OBJECT_LOCK (depay);
+  if (!depay->request_keyframe || (depay->last_request != 0 &&
+          now - depay->last_request < KEYFRAME_REQUEST_INTERVAL)) {
+    GST_OBJECT_UNLOCK (depay);
+    return;
+  }
+  depay->keyframe_requests++;
+  GST_OBJECT_UNLOCK (depay);
+
+  depay->last_request = now;
+
+  GST_DEBUG_OBJECT (depay, "requesting key frame");
+  event = gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new (DLB_LIGHT_RTP_FORCE_KEY_UNIT,
+          "all-headers", G_TYPE_BOOLEAN, TRUE, NULL));
+  gst_pad_push_event (GST_RTP_BASE_DEPAYLOAD_SINKPAD (depay), event);
+}
+
+/* Completes the frame being received from the strip state, or returns NULL
+ * while there is no complete key frame to build on. */
+static GstBuffer *
+dlb_light_rtp_depay_finish_frame (DlbLightRtpDepay * depay)
+{
+  GstBuffer *outbuf;
+  GstMapInfo map;
+  gsize size = DLB_LIGHT_FRAME_HEADER_SIZE;
+  guint8 *data;
+
+  depay->in_frame = FALSE;
+
+  if (depay->frame_key && !depay->frame_lost) {
+    memcpy (depay->order, depay->frame_order, depay->frame_num_strips);
+    depay->num_strips = depay->frame_num_strips;
+    depay->have_key = TRUE;
+  }
+
+  if (!depay->have_key) {
+    GST_DEBUG_OBJECT (depay, "waiting for a key frame");
+    dlb_light_rtp_depay_request_keyframe (depay);
+    return NULL;
+  }
+
+  if (depay->frame_lost) {
+    GST_DEBUG_OBJECT (depay, "concealing lost packets, ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (depay->frame_pts));
+    GST_OBJECT_LOCK (depay);
+    depay->concealed_frames++;
+    GST_OBJECT_UNLOCK (depay);
+    dlb_light_rtp_depay_request_keyframe (depay);
+  }
+
+  for (guint i = 0; i < depay->num_strips; i++)
+    size += g_bytes_get_size (depay->strip[depay->order[i]]);
+
+  outbuf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT16_LE (map.data, depay->num_strips);
+  data = map.data + DLB_LIGHT_FRAME_HEADER_SIZE;
+
+  for (guint i = 0; i < depay->num_strips; i++) {
+    gsize strip_size;
+    const guint8 *strip = g_bytes_get_data (depay->strip[depay->order[i]],
+        &strip_size);
+
+    memcpy (data, strip, strip_size);
+    data += strip_size;
+  }
+  gst_buffer_unmap (outbuf, &map);
+
+  GST_BUFFER_PTS (outbuf) = depay->frame_pts;
+
+  return outbuf;
+}
+
+static GstBuffer *
+dlb_light_rtp_depay_process (GstRTPBaseDepayload * depayload, GstRTPBuffer * rtp)
+{
+  DlbLightRtpDepay *depay = DLB_LIGHT_RTP_DEPAY (depayload);
+  guint32 rtptime = gst_rtp_buffer_get_timestamp (rtp);
+  guint payload_len = gst_rtp_buffer_get_payload_len (rtp);
+  const guint8 *payload = gst_rtp_buffer_get_payload (rtp);
+  DlbLightLayoutReader reader;
+  DlbLightStrip strip;
+  guint8 flags;
+
+  if (payload_len < DLB_LIGHT_RTP_HEADER_SIZE + DLB_LIGHT_FRAME_HEADER_SIZE) {
+    GST_WARNING_OBJECT (depay, "dropping short packet (%u bytes)", payload_len);
+    return NULL;
+  }
+
+  flags = payload[0];
+  payload += DLB_LIGHT_RTP_HEADER_SIZE;
+  payload_len -= DLB_LIGHT_RTP_HEADER_SIZE;
+
+  /* the packet with the marker was lost, finish the frame with what came */
+  if (depay->in_frame && rtptime != depay->frame_rtptime) {
+    GstBuffer *outbuf;
+
+    depay->frame_lost = TRUE;
+    outbuf = dlb_light_rtp_depay_finish_frame (depay);
+    if (outbuf)
+      gst_rtp_base_depayload_push (depayload, outbuf);
+  }
+
+  if (!depay->in_frame) {
+    depay->in_frame = TRUE;
+    depay->frame_rtptime = rtptime;
+    depay->frame_pts = GST_BUFFER_PTS (rtp->buffer);
+    depay->frame_key = (flags & DLB_LIGHT_RTP_FLAG_START) &&
+        (flags & DLB_LIGHT_RTP_FLAG_KEY);
+    depay->frame_lost = !(flags & DLB_LIGHT_RTP_FLAG_START);
+    depay->frame_num_strips = 0;
+  }
+
+  /* packets were lost before this one; a key frame replaces all of it */
+  if (GST_BUFFER_IS_DISCONT (rtp->buffer) &&
+      !(depay->frame_key && (flags & DLB_LIGHT_RTP_FLAG_START)))
+    depay->frame_lost = TRUE;
+
+  dlb_light_layout_reader_init (&reader, payload, payload_len);
+  while (dlb_light_layout_reader_next (&reader, &strip)) {
+    GBytes **state = &depay->strip[strip.strip_id];
+
+    if (*state)
+      g_bytes_unref (*state);
+    *state = g_bytes_new (payload + strip.header_offset,
+        DLB_LIGHT_STRIP_HEADER_SIZE + strip.size);
+
+    if (depay->frame_key && depay->frame_num_strips < DLB_LIGHT_RTP_DEPAY_MAX_STRIPS)
+      depay->frame_order[depay->frame_num_strips++] = strip.strip_id;
+  }
+
+  if (!dlb_light_layout_reader_is_complete (&reader)) {
+    GST_WARNING_OBJECT (depay, "malformed packet (%u bytes)", payload_len);
+    depay->frame_lost = TRUE;
+  }
+
+  if (gst_rtp_buffer_get_marker (rtp))
+    return dlb_light_rtp_depay_finish_frame (depay);
+
+  return NULL;
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightrtpdepay, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightrtpdepay,
+    "RTP depayloader for rendered light frames",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
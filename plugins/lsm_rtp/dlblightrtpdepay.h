@@ -0,0 +1,79 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_RTP_DEPAY_H_
+#define _DLB_LIGHT_RTP_DEPAY_H_
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbasedepayload.h>
+
+G_BEGIN_DECLS
+
+#define DLB_TYPE_LIGHT_RTP_DEPAY \
+  (dlb_light_rtp_depay_get_type())
+#define DLB_LIGHT_RTP_DEPAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_RTP_DEPAY, DlbLightRtpDepay))
+#define DLB_LIGHT_RTP_DEPAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_RTP_DEPAY, DlbLightRtpDepayClass))
+#define DLB_IS_LIGHT_RTP_DEPAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_RTP_DEPAY))
+#define DLB_IS_LIGHT_RTP_DEPAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), DLB_TYPE_LIGHT_RTP_DEPAY))
+
+#define DLB_LIGHT_RTP_DEPAY_MAX_STRIPS (256)
+
+typedef struct _DlbLightRtpDepay DlbLightRtpDepay;
+typedef struct _DlbLightRtpDepayClass DlbLightRtpDepayClass;
+
+struct _DlbLightRtpDepay {
+  GstRTPBaseDepayload depayload;
+
+  /* protected by OBJECT_LOCK */
+  gboolean request_keyframe;
+  guint64 concealed_frames;
+  guint64 keyframe_requests;
+
+  /* streaming thread only: last state of every strip, in key frame order */
+  GBytes *strip[DLB_LIGHT_RTP_DEPAY_MAX_STRIPS];
+  guint8 order[DLB_LIGHT_RTP_DEPAY_MAX_STRIPS];
+  guint num_strips;
+  gboolean have_key;
+
+  /* frame being received */
+  gboolean in_frame;
+  guint32 frame_rtptime;
+  GstClockTime frame_pts;
+  gboolean frame_key;
+  gboolean frame_lost;
+  guint8 frame_order[DLB_LIGHT_RTP_DEPAY_MAX_STRIPS];
+  guint frame_num_strips;
+
+  gint64 last_request;
+};
+
+struct _DlbLightRtpDepayClass {
+  GstRTPBaseDepayloadClass parent_class;
+};
+
+GType dlb_light_rtp_depay_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightrtpdepay);
+G_END_DECLS
+
+#endif // _DLB_LIGHT_RTP_DEPAY_H_
@@ -0,0 +1,470 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightrtppay
+ *
+ * Payloads rendered light frames into RTP packets (encoding name
+ * X-DLB-LIGHTS, see dlblightrtp.h). Frames larger than the MTU are split at
+ * strip boundaries, so every packet can be applied on its own. Between key
+ * frames only the strips that changed are sent; a key frame is sent every
+ * #DlbLightRtpPay:key-interval frames, whenever the strip layout changes and
+ * when a receiver asks for one with a GstForceKeyUnit event, which
+ * rtpsession emits for RTCP PLI and FIR requests.
+ *
+ * |[
+ * gst-launch-1.0 ... ! dlblightning ! dlblightrtppay ! udpsink host=192.168.1.20 port=5004
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightrtppay.h"
+#include "dlblightrtp.h"
+#include "dlblightlayout.h"
+
+#include <string.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_rtp_pay_debug_category);
+#define GST_CAT_DEFAULT dlb_light_rtp_pay_debug_category
+
+enum
+{
+  PROP_0,
+  PROP_KEY_INTERVAL,
+};
+
+/* one second of 40 ms frames */
+#define DEFAULT_KEY_INTERVAL 25
+
+static GstStaticPadTemplate dlb_light_rtp_pay_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+static GstStaticPadTemplate dlb_light_rtp_pay_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtp, "
+                     " media = (string) application, "
+                     " payload = (int) [ 96, 127 ], "
+                     " clock-rate = (int) 90000, "
+                     " encoding-name = (string) X-DLB-LIGHTS; ")
+    );
+
+/* class initialization */
+G_DEFINE_TYPE_WITH_CODE (DlbLightRtpPay, dlb_light_rtp_pay, GST_TYPE_RTP_BASE_PAYLOAD,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_rtp_pay_debug_category, "dlblightrtppay", 0,
+        "debug category for dlb_light_rtp_pay element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightrtppay, "dlblightrtppay", GST_RANK_SECONDARY,
+                             DLB_TYPE_LIGHT_RTP_PAY);
+
+static void dlb_light_rtp_pay_finalize (GObject * object);
+static void dlb_light_rtp_pay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void dlb_light_rtp_pay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn dlb_light_rtp_pay_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean dlb_light_rtp_pay_set_caps (GstRTPBasePayload * payload,
+    GstCaps * caps);
+static GstFlowReturn dlb_light_rtp_pay_handle_buffer (GstRTPBasePayload * payload,
+    GstBuffer * buffer);
+static gboolean dlb_light_rtp_pay_sink_event (GstRTPBasePayload * payload,
+    GstEvent * event);
+static gboolean dlb_light_rtp_pay_src_event (GstRTPBasePayload * payload,
+    GstEvent * event);
+
+static void
+dlb_light_rtp_pay_class_init (DlbLightRtpPayClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstRTPBasePayloadClass *payload_class = GST_RTP_BASE_PAYLOAD_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_rtp_pay_finalize;
+  gobject_class->set_property = dlb_light_rtp_pay_set_property;
+  gobject_class->get_property = dlb_light_rtp_pay_get_property;
+
+  /**
+   * DlbLightRtpPay:key-interval:
+   *
+   * Number of frames from one key frame to the next. 1 sends every strip
+   * in every frame, 0 only sends key frames when the layout changes or a
+   * receiver requests one.
+   */
+  g_object_class_install_property (gobject_class, PROP_KEY_INTERVAL,
+      g_param_spec_uint ("key-interval", "Key frame interval",
+          "Frames between key frames (0 = on request only)",
+          0, G_MAXUINT, DEFAULT_KEY_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Dolby Light RTP Payloader",
+      "Codec/Payloader/Network/RTP",
+      "Payload rendered light frames into RTP packets",
+      "Dolby Support <support@dolby.com>");
+
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_rtp_pay_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_rtp_pay_src_template);
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (dlb_light_rtp_pay_change_state);
+
+  payload_class->set_caps = GST_DEBUG_FUNCPTR (dlb_light_rtp_pay_set_caps);
+  payload_class->handle_buffer = GST_DEBUG_FUNCPTR (dlb_light_rtp_pay_handle_buffer);
+  payload_class->sink_event = GST_DEBUG_FUNCPTR (dlb_light_rtp_pay_sink_event);
+  payload_class->src_event = GST_DEBUG_FUNCPTR (dlb_light_rtp_pay_src_event);
+}
+
+static void
+dlb_light_rtp_pay_init (DlbLightRtpPay * pay)
+{
+  pay->key_interval = DEFAULT_KEY_INTERVAL;
+  pay->force_key = FALSE;
+  pay->last_num_strips = 0;
+  pay->frames_since_key = 0;
+  pay->warned_oversize = FALSE;
+}
+
+static void
+dlb_light_rtp_pay_reset (DlbLightRtpPay * pay)
+{
+  for (guint i = 0; i < DLB_LIGHT_RTP_MAX_STRIPS; i++)
+    g_clear_pointer (&pay->last_strip[i], g_bytes_unref);
+
+  pay->last_num_strips = 0;
+  pay->frames_since_key = 0;
+  pay->warned_oversize = FALSE;
+  g_atomic_int_set (&pay->force_key, FALSE);
+}
+
+static void
+dlb_light_rtp_pay_finalize (GObject * object)
+{
+  dlb_light_rtp_pay_reset (DLB_LIGHT_RTP_PAY (object));
+
+  G_OBJECT_CLASS (dlb_light_rtp_pay_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_rtp_pay_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (object);
+
+  switch (prop_id) {
+    case PROP_KEY_INTERVAL:
+      GST_OBJECT_LOCK (pay);
+      pay->key_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (pay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_rtp_pay_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (object);
+
+  switch (prop_id) {
+    case PROP_KEY_INTERVAL:
+      GST_OBJECT_LOCK (pay);
+      g_value_set_uint (value, pay->key_interval);
+      GST_OBJECT_UNLOCK (pay);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static GstStateChangeReturn
+dlb_light_rtp_pay_change_state (GstElement * element, GstStateChange transition)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (dlb_light_rtp_pay_parent_class)->change_state (element,
+      transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    dlb_light_rtp_pay_reset (pay);
+
+  return ret;
+}
+
+static gboolean
+dlb_light_rtp_pay_set_caps (GstRTPBasePayload * payload, GstCaps * caps)
+{
+  gst_rtp_base_payload_set_options (payload, "application", TRUE,
+      DLB_LIGHT_RTP_ENCODING_NAME, DLB_LIGHT_RTP_CLOCK_RATE);
+
+  return gst_rtp_base_payload_set_outcaps (payload, NULL);
+}
+
+static gboolean
+dlb_light_rtp_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (payload);
+
+  /* receivers may have missed anything before the flush */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    g_atomic_int_set (&pay->force_key, TRUE);
+
+  return GST_RTP_BASE_PAYLOAD_CLASS (dlb_light_rtp_pay_parent_class)->sink_event
+      (payload, event);
+}
+
+static gboolean
+dlb_light_rtp_pay_src_event (GstRTPBasePayload * payload, GstEvent * event)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (payload);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM &&
+      gst_event_has_name (event, DLB_LIGHT_RTP_FORCE_KEY_UNIT)) {
+    GST_DEBUG_OBJECT (pay, "key frame requested");
+    g_atomic_int_set (&pay->force_key, TRUE);
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return GST_RTP_BASE_PAYLOAD_CLASS (dlb_light_rtp_pay_parent_class)->src_event
+      (payload, event);
+}
+
+static gboolean
+dlb_light_rtp_pay_strip_equals (GBytes * last, const guint8 * data, gsize size)
+{
+  gsize last_size;
+  const guint8 *last_data;
+
+  if (last == NULL)
+    return FALSE;
+
+  last_data = g_bytes_get_data (last, &last_size);
+  return last_size == size && memcmp (last_data, data, size) == 0;
+}
+
+/* Same strips, in the same order, with the same number of lights and
+ * format as the previous frame, so a delta frame can be applied to it. */
+static gboolean
+dlb_light_rtp_pay_same_layout (DlbLightRtpPay * pay, const guint8 * frame,
+    const DlbLightStrip * strips, guint num_strips)
+{
+  if (num_strips == 0 || num_strips != pay->last_num_strips)
+    return FALSE;
+
+  for (guint i = 0; i < num_strips; i++) {
+    const DlbLightStrip *strip = &strips[i];
+    GBytes *last = pay->last_strip[strip->strip_id];
+
+    if (pay->last_order[i] != strip->strip_id || last == NULL ||
+        g_bytes_get_size (last) != DLB_LIGHT_STRIP_HEADER_SIZE + strip->size ||
+        memcmp (g_bytes_get_data (last, NULL), frame + strip->header_offset,
+            DLB_LIGHT_STRIP_HEADER_SIZE) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstBuffer *
+dlb_light_rtp_pay_make_packet (DlbLightRtpPay * pay, const guint8 * frame,
+    const DlbLightStrip * strips, const guint * sent, guint count, gsize size,
+    guint8 flags, gboolean marker)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *packet;
+  guint8 *data;
+
+  packet = gst_rtp_base_payload_allocate_output_buffer (GST_RTP_BASE_PAYLOAD (pay),
+      DLB_LIGHT_RTP_HEADER_SIZE + DLB_LIGHT_FRAME_HEADER_SIZE + size, 0, 0);
+
+  gst_rtp_buffer_map (packet, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  data = gst_rtp_buffer_get_payload (&rtp);
+
+  data[0] = flags;
+  data[1] = 0;
+  GST_WRITE_UINT16_LE (data + DLB_LIGHT_RTP_HEADER_SIZE, count);
+  data += DLB_LIGHT_RTP_HEADER_SIZE + DLB_LIGHT_FRAME_HEADER_SIZE;
+
+  for (guint i = 0; i < count; i++) {
+    const DlbLightStrip *strip = &strips[sent[i]];
+    gsize strip_size = DLB_LIGHT_STRIP_HEADER_SIZE + strip->size;
+
+    memcpy (data, frame + strip->header_offset, strip_size);
+    data += strip_size;
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return packet;
+}
+
+static GstFlowReturn
+dlb_light_rtp_pay_handle_buffer (GstRTPBasePayload * payload, GstBuffer * buffer)
+{
+  DlbLightRtpPay *pay = DLB_LIGHT_RTP_PAY (payload);
+  DlbLightStrip strips[DLB_LIGHT_RTP_MAX_STRIPS];
+  guint sent[DLB_LIGHT_RTP_MAX_STRIPS];
+  guint num_strips = 0, num_sent = 0, first;
+  DlbLightLayoutReader reader;
+  GstBufferList *list;
+  GstMapInfo map;
+  gsize max_size;
+  guint key_interval;
+  gboolean key, valid;
+  guint8 flags;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    gst_buffer_unref (buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  valid = dlb_light_layout_reader_init (&reader, map.data, map.size);
+  while (valid && num_strips < DLB_LIGHT_RTP_MAX_STRIPS &&
+      dlb_light_layout_reader_next (&reader, &strips[num_strips]))
+    num_strips++;
+
+  if (!valid || !dlb_light_layout_reader_is_complete (&reader)) {
+    GST_WARNING_OBJECT (pay, "dropping malformed light frame (%zu bytes)",
+        map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_OK;
+  }
+
+  GST_OBJECT_LOCK (pay);
+  key_interval = pay->key_interval;
+  GST_OBJECT_UNLOCK (pay);
+
+  key = g_atomic_int_compare_and_exchange (&pay->force_key, TRUE, FALSE);
+  if (!dlb_light_rtp_pay_same_layout (pay, map.data, strips, num_strips))
+    key = TRUE;
+  if (key_interval > 0 && pay->frames_since_key >= key_interval)
+    key = TRUE;
+
+  for (guint i = 0; i < num_strips; i++) {
+    const DlbLightStrip *strip = &strips[i];
+
+    if (key || !dlb_light_rtp_pay_strip_equals (pay->last_strip[strip->strip_id],
+            map.data + strip->header_offset,
+            DLB_LIGHT_STRIP_HEADER_SIZE + strip->size))
+      sent[num_sent++] = i;
+  }
+
+  GST_LOG_OBJECT (pay, "%s frame, %u of %u strips, ts=%" GST_TIME_FORMAT,
+      key ? "key" : "delta", num_sent, num_strips,
+      GST_TIME_ARGS (GST_BUFFER_PTS (buffer)));
+
+  max_size = gst_rtp_buffer_calc_payload_len (GST_RTP_BASE_PAYLOAD_MTU (pay), 0, 0);
+  max_size -= MIN (max_size, DLB_LIGHT_RTP_HEADER_SIZE + DLB_LIGHT_FRAME_HEADER_SIZE);
+
+  list = gst_buffer_list_new_sized (1 + num_sent / 4);
+  flags = DLB_LIGHT_RTP_FLAG_START | (key ? DLB_LIGHT_RTP_FLAG_KEY : 0);
+  first = 0;
+
+  /* a frame without changes still goes out as an empty packet, so the
+   * receiver keeps showing frames at the sender's pace */
+  do {
+    gsize size = 0;
+    guint count = 0;
+    GstBuffer *packet;
+
+    while (first + count < num_sent) {
+      const DlbLightStrip *strip = &strips[sent[first + count]];
+      gsize strip_size = DLB_LIGHT_STRIP_HEADER_SIZE + strip->size;
+
+      if (size + strip_size > max_size) {
+        if (count > 0)
+          break;
+        if (!pay->warned_oversize) {
+          GST_WARNING_OBJECT (pay, "strip %u (%" G_GSIZE_FORMAT " bytes) does "
+              "not fit in the MTU, sending it in a single oversized packet",
+              strip->strip_id, strip_size);
+          pay->warned_oversize = TRUE;
+        }
+      }
+      size += strip_size;
+      count++;
+    }
+
+    packet = dlb_light_rtp_pay_make_packet (pay, map.data, strips,
+        sent + first, count, size, flags, first + count == num_sent);
+    GST_BUFFER_PTS (packet) = GST_BUFFER_PTS (buffer);
+    GST_BUFFER_DTS (packet) = GST_BUFFER_DTS (buffer);
+    gst_buffer_list_add (list, packet);
+
+    flags &= ~DLB_LIGHT_RTP_FLAG_START;
+    first += count;
+  } while (first < num_sent);
+
+  /* remember what the receivers now hold */
+  for (guint i = 0; i < num_sent; i++) {
+    const DlbLightStrip *strip = &strips[sent[i]];
+
+    if (pay->last_strip[strip->strip_id])
+      g_bytes_unref (pay->last_strip[strip->strip_id]);
+    pay->last_strip[strip->strip_id] = g_bytes_new (map.data + strip->header_offset,
+        DLB_LIGHT_STRIP_HEADER_SIZE + strip->size);
+  }
+
+  if (key) {
+    for (guint i = 0; i < num_strips; i++)
+      pay->last_order[i] = strips[i].strip_id;
+    pay->last_num_strips = num_strips;
+    pay->frames_since_key = 0;
+  }
+  pay->frames_since_key++;
+
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  return gst_rtp_base_payload_push_list (payload, list);
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightrtppay, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightrtppay,
+    "RTP payloader for rendered light frames",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -0,0 +1,70 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_RTP_PAY_H_
+#define _DLB_LIGHT_RTP_PAY_H_
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbasepayload.h>
+
+G_BEGIN_DECLS
+
+#define DLB_TYPE_LIGHT_RTP_PAY \
+  (dlb_light_rtp_pay_get_type())
+#define DLB_LIGHT_RTP_PAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_RTP_PAY, DlbLightRtpPay))
+#define DLB_LIGHT_RTP_PAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_RTP_PAY, DlbLightRtpPayClass))
+#define DLB_IS_LIGHT_RTP_PAY(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_RTP_PAY))
+#define DLB_IS_LIGHT_RTP_PAY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), DLB_TYPE_LIGHT_RTP_PAY))
+
+#define DLB_LIGHT_RTP_MAX_STRIPS (256)
+
+typedef struct _DlbLightRtpPay DlbLightRtpPay;
+typedef struct _DlbLightRtpPayClass DlbLightRtpPayClass;
+
+struct _DlbLightRtpPay {
+  GstRTPBasePayload payload;
+
+  /* protected by OBJECT_LOCK */
+  guint key_interval;
+
+  /* set from any thread when a key frame is requested */
+  gint force_key;
+
+  /* streaming thread only */
+  GBytes *last_strip[DLB_LIGHT_RTP_MAX_STRIPS];
+  guint8 last_order[DLB_LIGHT_RTP_MAX_STRIPS];
+  guint last_num_strips;
+  guint frames_since_key;
+  gboolean warned_oversize;
+};
+
+struct _DlbLightRtpPayClass {
+  GstRTPBasePayloadClass parent_class;
+};
+
+GType dlb_light_rtp_pay_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightrtppay);
+G_END_DECLS
+
+#endif // _DLB_LIGHT_RTP_PAY_H_
@@ -0,0 +1,653 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightappsink
+ *
+ * Hands light frames to an application that drives the lights itself,
+ * without the signals and main loop of appsink and without copies. Frames
+ * are delivered when they are due, as #DlbLightAppFrame views of the
+ * mapped buffers, in one of two ways:
+ *
+ * - a callback set with dlb_light_app_sink_set_callback(), called from the
+ *   thread showing the frame;
+ * - otherwise, a lock-free ring of #DlbLightAppSink:max-frames frames that
+ *   one application thread drains with dlb_light_app_sink_pop(). On Linux,
+ *   dlb_light_app_sink_get_fd() returns an eventfd that becomes readable
+ *   when frames are queued, to wait on with poll() next to the
+ *   application's other descriptors.
+ *
+ * A buffer list wakes the application once for all its frames, but only with
+ * #GstBaseSink:sync disabled and without
+ * #DlbLightBaseSink:async-device-write; otherwise its frames are delivered
+ * one by one when they are due.
+ *
+ * When the application falls behind and the ring is full, new frames are
+ * dropped and counted in #DlbLightAppSink:dropped. Frames queued before a
+ * flush or a stop are discarded by dlb_light_app_sink_pop().
+ *
+ * |[<!-- language="C" -->
+ * struct pollfd pfd = { dlb_light_app_sink_get_fd (sink), POLLIN, 0 };
+ * guint64 count;
+ *
+ * while (poll (&pfd, 1, -1) > 0) {
+ *   DlbLightAppFrame *frame;
+ *
+ *   read (pfd.fd, &count, sizeof (count));
+ *   while ((frame = dlb_light_app_sink_pop (sink))) {
+ *     send_to_controller (frame->data, frame->size);
+ *     dlb_light_app_frame_unref (frame);
+ *   }
+ * }
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "dlblightappsink.h"
+#include "dlblightbasesink.h"
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_app_sink_debug_category);
+#define GST_CAT_DEFAULT dlb_light_app_sink_debug_category
+
+/* slots of the ring, the upper bound of max-frames */
+#define RING_SIZE 64
+
+enum
+{
+  PROP_0,
+  PROP_MAX_FRAMES,
+  PROP_DROPPED,
+};
+
+#define DEFAULT_MAX_FRAMES 8
+
+/* A callback and its data. Every thread calling it holds a reference, so it
+ * can be replaced at any time, even from the callback itself, and @notify
+ * only runs once the last call returned. */
+typedef struct
+{
+  gint refcount;
+  DlbLightAppSinkFrameFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} DlbLightAppCallback;
+
+struct _DlbLightAppSink {
+  DlbLightBaseSink lightsink;
+
+  /* Single-producer, single-consumer ring. head is only written by the
+   * thread showing frames, tail only by the thread popping them; slots
+   * from tail to head belong to the consumer. The ring never moves, so
+   * popping is safe in any state. */
+  DlbLightAppFrame *ring[RING_SIZE];
+  gint head;
+  gint tail;
+
+  /* bumped on flush and stop, frames of older epochs are discarded */
+  gint epoch;
+
+  /* the base class shows frames from the streaming or the device thread,
+   * this keeps a single producer and protects the callback pointer. Never
+   * held while the callback runs. */
+  GMutex push_lock;
+  DlbLightAppCallback *callback;
+
+  gint fd;
+
+  /* protected by OBJECT_LOCK */
+  guint max_frames;
+  guint64 dropped;
+};
+
+struct _DlbLightAppSinkClass {
+  DlbLightBaseSinkClass parent_class;
+};
+
+/* class initialization */
+G_DEFINE_TYPE_WITH_CODE (DlbLightAppSink, dlb_light_app_sink, DLB_TYPE_LIGHT_BASE_SINK,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_app_sink_debug_category, "dlblightappsink", 0,
+        "debug category for dlb_light_app_sink element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightappsink, "dlblightappsink", GST_RANK_NONE,
+                             DLB_TYPE_LIGHT_APP_SINK);
+
+static GstStaticPadTemplate dlb_light_app_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+static void dlb_light_app_sink_finalize (GObject * object);
+static void dlb_light_app_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void dlb_light_app_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static gboolean dlb_light_app_sink_stop (GstBaseSink * bsink);
+static gboolean dlb_light_app_sink_event (GstBaseSink * bsink, GstEvent * event);
+static GstFlowReturn dlb_light_app_sink_show_frame (DlbLightBaseSink * lsink,
+    GstBuffer * buf);
+static GstFlowReturn dlb_light_app_sink_show_list (DlbLightBaseSink * lsink,
+    GstBufferList * list);
+
+static void
+dlb_light_app_sink_class_init (DlbLightAppSinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS (klass);
+  DlbLightBaseSinkClass *lightsink_class = DLB_LIGHT_BASE_SINK_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_app_sink_finalize;
+  gobject_class->set_property = dlb_light_app_sink_set_property;
+  gobject_class->get_property = dlb_light_app_sink_get_property;
+
+  /**
+   * DlbLightAppSink:max-frames:
+   *
+   * Frames queued for dlb_light_app_sink_pop() before new ones are dropped.
+   * Not used with a callback.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_FRAMES,
+      g_param_spec_uint ("max-frames", "Max frames",
+          "Frames queued for the application before new ones are dropped",
+          1, RING_SIZE, DEFAULT_MAX_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightAppSink:dropped:
+   *
+   * Frames dropped because the application did not pop them in time.
+   */
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "Dropped",
+          "Frames dropped because the queue for the application was full",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "Dolby Light App Sink",
+      "Sink/Light",
+      "Hand light frames to the application without copies",
+      "Dolby Support <support@dolby.com>");
+
+  gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
+      &dlb_light_app_sink_template);
+
+  basesink_class->stop = GST_DEBUG_FUNCPTR (dlb_light_app_sink_stop);
+  basesink_class->event = GST_DEBUG_FUNCPTR (dlb_light_app_sink_event);
+
+  lightsink_class->show_frame = dlb_light_app_sink_show_frame;
+  lightsink_class->show_list = dlb_light_app_sink_show_list;
+}
+
+static void
+dlb_light_app_sink_init (DlbLightAppSink * sink)
+{
+  memset (sink->ring, 0, sizeof (sink->ring));
+  sink->head = 0;
+  sink->tail = 0;
+  sink->epoch = 0;
+
+  g_mutex_init (&sink->push_lock);
+  sink->callback = NULL;
+
+  sink->max_frames = DEFAULT_MAX_FRAMES;
+  sink->dropped = 0;
+
+#ifdef HAVE_EVENTFD
+  sink->fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (sink->fd < 0)
+    GST_WARNING_OBJECT (sink, "could not create eventfd: %s",
+        g_strerror (errno));
+#else
+  sink->fd = -1;
+#endif
+}
+
+static void
+dlb_light_app_callback_unref (DlbLightAppCallback * callback)
+{
+  if (!g_atomic_int_dec_and_test (&callback->refcount))
+    return;
+
+  if (callback->notify)
+    callback->notify (callback->user_data);
+  g_free (callback);
+}
+
+static void
+dlb_light_app_sink_finalize (GObject * object)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (object);
+  DlbLightAppFrame *frame;
+
+  /* no consumer is left, take its place */
+  g_atomic_int_inc (&sink->epoch);
+  while ((frame = dlb_light_app_sink_pop (sink)))
+    dlb_light_app_frame_unref (frame);
+
+  if (sink->callback)
+    dlb_light_app_callback_unref (sink->callback);
+  g_mutex_clear (&sink->push_lock);
+
+#ifdef HAVE_EVENTFD
+  if (sink->fd >= 0)
+    close (sink->fd);
+#endif
+
+  G_OBJECT_CLASS (dlb_light_app_sink_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_app_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (object);
+
+  switch (prop_id) {
+    case PROP_MAX_FRAMES:
+      GST_OBJECT_LOCK (sink);
+      sink->max_frames = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (sink);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_app_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (object);
+
+  switch (prop_id) {
+    case PROP_MAX_FRAMES:
+      GST_OBJECT_LOCK (sink);
+      g_value_set_uint (value, sink->max_frames);
+      GST_OBJECT_UNLOCK (sink);
+      break;
+    case PROP_DROPPED:
+      GST_OBJECT_LOCK (sink);
+      g_value_set_uint64 (value, sink->dropped);
+      GST_OBJECT_UNLOCK (sink);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+dlb_light_app_sink_stop (GstBaseSink * bsink)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (bsink);
+
+  g_atomic_int_inc (&sink->epoch);
+
+  return GST_BASE_SINK_CLASS (dlb_light_app_sink_parent_class)->stop (bsink);
+}
+
+static gboolean
+dlb_light_app_sink_event (GstBaseSink * bsink, GstEvent * event)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (bsink);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    g_atomic_int_inc (&sink->epoch);
+
+  return GST_BASE_SINK_CLASS (dlb_light_app_sink_parent_class)->event (bsink, event);
+}
+
+static DlbLightAppFrame *
+dlb_light_app_frame_new (GstBuffer * buf, gint epoch)
+{
+  DlbLightAppFrame *frame = g_new0 (DlbLightAppFrame, 1);
+
+  if (!gst_buffer_map (buf, &frame->map, GST_MAP_READ)) {
+    g_free (frame);
+    return NULL;
+  }
+
+  frame->buffer = gst_buffer_ref (buf);
+  frame->data = frame->map.data;
+  frame->size = frame->map.size;
+  frame->pts = GST_BUFFER_PTS (buf);
+  frame->duration = GST_BUFFER_DURATION (buf);
+  frame->refcount = 1;
+  frame->epoch = epoch;
+
+  return frame;
+}
+
+/**
+ * dlb_light_app_frame_ref:
+ * @frame: a #DlbLightAppFrame
+ *
+ * Returns: (transfer full): @frame
+ */
+DlbLightAppFrame *
+dlb_light_app_frame_ref (DlbLightAppFrame * frame)
+{
+  g_return_val_if_fail (frame != NULL, NULL);
+
+  g_atomic_int_inc (&frame->refcount);
+
+  return frame;
+}
+
+/**
+ * dlb_light_app_frame_unref:
+ * @frame: (transfer full): a #DlbLightAppFrame
+ *
+ * Drops a reference to @frame, unmapping and releasing the buffer with the
+ * last one.
+ */
+void
+dlb_light_app_frame_unref (DlbLightAppFrame * frame)
+{
+  g_return_if_fail (frame != NULL);
+
+  if (!g_atomic_int_dec_and_test (&frame->refcount))
+    return;
+
+  gst_buffer_unmap (frame->buffer, &frame->map);
+  gst_buffer_unref (frame->buffer);
+  g_free (frame);
+}
+
+/* Producer side of the ring, with push_lock held. Returns FALSE when the
+ * application holds max_frames frames already. */
+static gboolean
+dlb_light_app_sink_queue (DlbLightAppSink * sink, DlbLightAppFrame * frame,
+    guint max_frames)
+{
+  guint head = (guint) g_atomic_int_get (&sink->head);
+  guint tail = (guint) g_atomic_int_get (&sink->tail);
+
+  if (head - tail >= max_frames)
+    return FALSE;
+
+  sink->ring[head % RING_SIZE] = frame;
+  /* publishes the slot, the atomic store orders it after the write above */
+  g_atomic_int_set (&sink->head, (gint) (head + 1));
+
+  return TRUE;
+}
+
+static void
+dlb_light_app_sink_wake (DlbLightAppSink * sink)
+{
+#ifdef HAVE_EVENTFD
+  guint64 one = 1;
+
+  if (sink->fd >= 0 && write (sink->fd, &one, sizeof (one)) < 0)
+    GST_WARNING_OBJECT (sink, "could not signal eventfd: %s",
+        g_strerror (errno));
+#endif
+}
+
+static DlbLightAppFrame *
+dlb_light_app_sink_map_frame (DlbLightAppSink * sink, GstBuffer * buf)
+{
+  DlbLightAppFrame *frame;
+
+  frame = dlb_light_app_frame_new (buf, g_atomic_int_get (&sink->epoch));
+  if (frame == NULL)
+    GST_ELEMENT_ERROR (sink, RESOURCE, READ, (NULL),
+        ("could not map light frame"));
+
+  return frame;
+}
+
+/* Queues @buf for dlb_light_app_sink_pop(), with push_lock held. Returns
+ * whether a frame was queued. */
+static gboolean
+dlb_light_app_sink_deliver (DlbLightAppSink * sink, GstBuffer * buf,
+    GstFlowReturn * ret)
+{
+  DlbLightAppFrame *frame;
+  guint max_frames;
+
+  frame = dlb_light_app_sink_map_frame (sink, buf);
+  if (frame == NULL) {
+    *ret = GST_FLOW_ERROR;
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (sink);
+  max_frames = sink->max_frames;
+  GST_OBJECT_UNLOCK (sink);
+
+  if (dlb_light_app_sink_queue (sink, frame, max_frames))
+    return TRUE;
+
+  GST_DEBUG_OBJECT (sink, "application is %u frames behind, dropping %"
+      GST_PTR_FORMAT, max_frames, buf);
+  dlb_light_app_frame_unref (frame);
+
+  GST_OBJECT_LOCK (sink);
+  sink->dropped++;
+  GST_OBJECT_UNLOCK (sink);
+
+  return FALSE;
+}
+
+/* Returns: (transfer full) (nullable): the callback frames are handed to,
+ * NULL when they are queued */
+static DlbLightAppCallback *
+dlb_light_app_sink_ref_callback (DlbLightAppSink * sink)
+{
+  DlbLightAppCallback *callback;
+
+  g_mutex_lock (&sink->push_lock);
+  callback = sink->callback;
+  if (callback && callback->func)
+    g_atomic_int_inc (&callback->refcount);
+  else
+    callback = NULL;
+  g_mutex_unlock (&sink->push_lock);
+
+  return callback;
+}
+
+/* Hands @buf to @callback, without any lock held so that the callback can
+ * call back into the sink */
+static GstFlowReturn
+dlb_light_app_sink_call (DlbLightAppSink * sink, DlbLightAppCallback * callback,
+    GstBuffer * buf)
+{
+  DlbLightAppFrame *frame = dlb_light_app_sink_map_frame (sink, buf);
+
+  if (frame == NULL)
+    return GST_FLOW_ERROR;
+
+  callback->func (sink, frame, callback->user_data);
+  dlb_light_app_frame_unref (frame);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+dlb_light_app_sink_show_frame (DlbLightBaseSink * lsink, GstBuffer * buf)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (lsink);
+  DlbLightAppCallback *callback = dlb_light_app_sink_ref_callback (sink);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (callback) {
+    ret = dlb_light_app_sink_call (sink, callback, buf);
+    dlb_light_app_callback_unref (callback);
+    return ret;
+  }
+
+  g_mutex_lock (&sink->push_lock);
+  if (dlb_light_app_sink_deliver (sink, buf, &ret))
+    dlb_light_app_sink_wake (sink);
+  g_mutex_unlock (&sink->push_lock);
+
+  return ret;
+}
+
+/* the application is woken once for the whole list */
+static GstFlowReturn
+dlb_light_app_sink_show_list (DlbLightBaseSink * lsink, GstBufferList * list)
+{
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (lsink);
+  DlbLightAppCallback *callback = dlb_light_app_sink_ref_callback (sink);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint len = gst_buffer_list_length (list);
+  gboolean queued = FALSE;
+
+  if (callback) {
+    for (guint i = 0; i < len && ret == GST_FLOW_OK; i++)
+      ret = dlb_light_app_sink_call (sink, callback,
+          gst_buffer_list_get (list, i));
+    dlb_light_app_callback_unref (callback);
+    return ret;
+  }
+
+  g_mutex_lock (&sink->push_lock);
+  for (guint i = 0; i < len && ret == GST_FLOW_OK; i++)
+    queued |= dlb_light_app_sink_deliver (sink, gst_buffer_list_get (list, i),
+        &ret);
+  if (queued)
+    dlb_light_app_sink_wake (sink);
+  g_mutex_unlock (&sink->push_lock);
+
+  return ret;
+}
+
+/**
+ * dlb_light_app_sink_set_callback:
+ * @sink: a #DlbLightAppSink
+ * @func: (nullable): called with every frame, or %NULL to queue the frames
+ *   for dlb_light_app_sink_pop() again
+ * @user_data: data passed to @func
+ * @notify: (nullable): destroys @user_data when the callback is replaced
+ *
+ * Sets the function the frames are handed to. Can be called from the
+ * callback itself. A frame being handed to the previous callback on another
+ * thread may still be delivered after this returns; the previous @notify is
+ * called once that call has returned.
+ */
+void
+dlb_light_app_sink_set_callback (DlbLightAppSink * sink,
+    DlbLightAppSinkFrameFunc func, gpointer user_data, GDestroyNotify notify)
+{
+  DlbLightAppCallback *callback = NULL, *old;
+
+  g_return_if_fail (DLB_IS_LIGHT_APP_SINK (sink));
+
+  if (func || notify) {
+    callback = g_new0 (DlbLightAppCallback, 1);
+    callback->refcount = 1;
+    callback->func = func;
+    callback->user_data = user_data;
+    callback->notify = notify;
+  }
+
+  g_mutex_lock (&sink->push_lock);
+  old = sink->callback;
+  sink->callback = callback;
+  g_mutex_unlock (&sink->push_lock);
+
+  if (old)
+    dlb_light_app_callback_unref (old);
+}
+
+/**
+ * dlb_light_app_sink_pop:
+ * @sink: a #DlbLightAppSink
+ *
+ * Takes the oldest queued frame, without blocking. Must always be called
+ * from the same thread, or with the calls serialized by the application.
+ *
+ * Returns: (transfer full) (nullable): the frame, release it with
+ *   dlb_light_app_frame_unref(), or %NULL when no frame is queued.
+ */
+DlbLightAppFrame *
+dlb_light_app_sink_pop (DlbLightAppSink * sink)
+{
+  g_return_val_if_fail (DLB_IS_LIGHT_APP_SINK (sink), NULL);
+
+  for (;;) {
+    guint tail = (guint) g_atomic_int_get (&sink->tail);
+    guint head = (guint) g_atomic_int_get (&sink->head);
+    DlbLightAppFrame *frame;
+
+    if (tail == head)
+      return NULL;
+
+    frame = sink->ring[tail % RING_SIZE];
+    /* hands the slot back to the producer */
+    g_atomic_int_set (&sink->tail, (gint) (tail + 1));
+
+    if (frame->epoch == g_atomic_int_get (&sink->epoch))
+      return frame;
+
+    /* queued before a flush */
+    dlb_light_app_frame_unref (frame);
+  }
+}
+
+/**
+ * dlb_light_app_sink_get_fd:
+ * @sink: a #DlbLightAppSink
+ *
+ * Returns a file descriptor that becomes readable when frames are queued.
+ * Read its 8 byte counter to reset it, then pop until no frame is left.
+ * The descriptor belongs to @sink and lives as long as it does.
+ *
+ * Returns: the eventfd, or -1 where eventfd is not available
+ */
+gint
+dlb_light_app_sink_get_fd (DlbLightAppSink * sink)
+{
+  g_return_val_if_fail (DLB_IS_LIGHT_APP_SINK (sink), -1);
+
+  return sink->fd;
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightappsink, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightappsink,
+    "Dolby Light App Sink",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
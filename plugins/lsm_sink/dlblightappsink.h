@@ -0,0 +1,104 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_APP_SINK_H_
+#define _DLB_LIGHT_APP_SINK_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define DLB_TYPE_LIGHT_APP_SINK \
+  (dlb_light_app_sink_get_type())
+#define DLB_LIGHT_APP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_APP_SINK, DlbLightAppSink))
+#define DLB_LIGHT_APP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_APP_SINK, DlbLightAppSinkClass))
+#define DLB_IS_LIGHT_APP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_APP_SINK))
+#define DLB_IS_LIGHT_APP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), DLB_TYPE_LIGHT_APP_SINK))
+
+typedef struct _DlbLightAppSink DlbLightAppSink;
+typedef struct _DlbLightAppSinkClass DlbLightAppSinkClass;
+typedef struct _DlbLightAppFrame DlbLightAppFrame;
+
+/**
+ * DlbLightAppFrame:
+ * @data: the frame, laid out as an application/x-lights buffer
+ * @size: size of @data in bytes
+ * @pts: presentation time of the frame
+ * @duration: duration of the frame
+ *
+ * Read-only view of a light frame of the pipeline. The buffer is mapped,
+ * not copied, and stays mapped until the last reference to the frame is
+ * dropped with dlb_light_app_frame_unref(). Frames can be handed on to and
+ * released from any thread.
+ */
+struct _DlbLightAppFrame {
+  const guint8 *data;
+  gsize size;
+  GstClockTime pts;
+  GstClockTime duration;
+
+  /*< private >*/
+  gint refcount;
+  gint epoch;
+  GstBuffer *buffer;
+  GstMapInfo map;
+};
+
+/**
+ * DlbLightAppSinkFrameFunc:
+ * @sink: the sink
+ * @frame: (transfer none): the frame, take a reference to keep it
+ * @user_data: the data given to dlb_light_app_sink_set_callback()
+ *
+ * Called with every frame when it is due, from the streaming thread or the
+ * device thread of the sink, without any lock of the sink held. Should
+ * return quickly; may replace itself with dlb_light_app_sink_set_callback().
+ */
+typedef void (*DlbLightAppSinkFrameFunc) (DlbLightAppSink * sink,
+    DlbLightAppFrame * frame, gpointer user_data);
+
+GST_API_EXPORT
+GType dlb_light_app_sink_get_type (void);
+
+GST_API_EXPORT
+void dlb_light_app_sink_set_callback (DlbLightAppSink * sink,
+    DlbLightAppSinkFrameFunc func, gpointer user_data, GDestroyNotify notify);
+
+GST_API_EXPORT
+DlbLightAppFrame * dlb_light_app_sink_pop (DlbLightAppSink * sink);
+
+GST_API_EXPORT
+gint dlb_light_app_sink_get_fd (DlbLightAppSink * sink);
+
+GST_API_EXPORT
+DlbLightAppFrame * dlb_light_app_frame_ref (DlbLightAppFrame * frame);
+
+GST_API_EXPORT
+void dlb_light_app_frame_unref (DlbLightAppFrame * frame);
+
+GST_ELEMENT_REGISTER_DECLARE (dlblightappsink);
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_APP_SINK_H_
@@ -24,36 +24,186 @@
 
 // This is derived from gstvideosink.c and gstaudiobasesink.c
 
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 #include "dlblightbasesink.h"
+#include "dlblightrecorder.h"
+#include "dlbtrace.h"
 
 GST_DEBUG_CATEGORY_STATIC (dlb_light_base_sink_debug);
 #define GST_CAT_DEFAULT dlb_light_base_sink_debug
 
 enum
 {
-  PROP_SHOW_PREROLL_FRAME = 1
+  PROP_SHOW_PREROLL_FRAME = 1,
+  PROP_ASYNC_DEVICE_WRITE,
+  PROP_DEVICE_QUEUE_DEPTH,
+  PROP_DEVICE_THREAD_POLICY,
+  PROP_DEVICE_THREAD_PRIORITY,
+  PROP_DEVICE_THREAD_AFFINITY,
+  PROP_DEVICE_QUEUE_LEVEL,
+  PROP_OVERWRITTEN_FRAMES,
+  PROP_DEVICE_WRITE_LATENCY,
+  PROP_MAX_DEVICE_WRITE_LATENCY,
+  PROP_PRECISE_TIMING,
+  PROP_PRECISE_TIMING_WINDOW,
+  PROP_JITTER_STATS,
+  PROP_STREAMING_THREAD_POLICY,
+  PROP_STREAMING_THREAD_PRIORITY,
+  PROP_STREAMING_THREAD_AFFINITY,
+  PROP_LOCK_MEMORY,
+  PROP_FLIGHT_RECORDER_DURATION,
+  PROP_FLIGHT_RECORDER_LOCATION,
+  PROP_FLIGHT_RECORDER_SIGNAL,
+  PROP_FLIGHT_RECORDER_LATENESS,
+  PROP_FLIGHT_RECORDER_DUMP_ON_DROP,
+};
+
+enum
+{
+  SIGNAL_DUMP_FLIGHT_RECORDER,
+  LAST_SIGNAL
 };
 
+static guint dlb_light_base_sink_signals[LAST_SIGNAL] = { 0 };
+
 #define DEFAULT_SHOW_PREROLL_FRAME TRUE
+#define DEFAULT_ASYNC_DEVICE_WRITE FALSE
+#define DEFAULT_DEVICE_QUEUE_DEPTH 1
+#define MAX_DEVICE_QUEUE_DEPTH 16
+#define DEFAULT_DEVICE_THREAD_POLICY DLB_LIGHT_THREAD_POLICY_OTHER
+#define DEFAULT_DEVICE_THREAD_PRIORITY 0
+#define DEFAULT_DEVICE_THREAD_AFFINITY NULL
+#define DEFAULT_LOCK_MEMORY FALSE
+#define DEFAULT_PRECISE_TIMING FALSE
+#define DEFAULT_PRECISE_TIMING_WINDOW (1 * GST_MSECOND)
+#define MAX_PRECISE_TIMING_WINDOW (5 * GST_MSECOND)
+#define DEFAULT_FLIGHT_RECORDER_DURATION 0
+#define MAX_FLIGHT_RECORDER_DURATION (600 * GST_SECOND)
+#define DEFAULT_FLIGHT_RECORDER_LOCATION NULL
+#define DEFAULT_FLIGHT_RECORDER_SIGNAL FALSE
+#define DEFAULT_FLIGHT_RECORDER_LATENESS 0
+#define DEFAULT_FLIGHT_RECORDER_DUMP_ON_DROP TRUE
+
+/* bounds of the busy-wait at the end of a precise wait */
+#define MIN_SPIN_TIME (20 * GST_USECOND)
+#define MAX_SPIN_TIME (500 * GST_USECOND)
+
+/* presentation error histogram, by absolute error */
+static const struct
+{
+  GstClockTime limit;
+  const gchar *name;
+} jitter_buckets[] = {
+  {50 * GST_USECOND, "below-50us"},
+  {100 * GST_USECOND, "below-100us"},
+  {250 * GST_USECOND, "below-250us"},
+  {500 * GST_USECOND, "below-500us"},
+  {1 * GST_MSECOND, "below-1ms"},
+  {2 * GST_MSECOND, "below-2ms"},
+  {5 * GST_MSECOND, "below-5ms"},
+  {GST_CLOCK_TIME_NONE, "above-5ms"},
+};
+
+#define N_JITTER_BUCKETS G_N_ELEMENTS (jitter_buckets)
 
 struct _DlbLightBaseSinkPrivate
 {
   gboolean show_preroll_frame;  /* ATOMIC */
+
+  /* device thread settings, protected by OBJECT_LOCK */
+  gboolean async_device_write;
+  guint queue_depth;
+  DlbLightThreadSettings device_settings;
+
+  /* streaming thread settings, protected by OBJECT_LOCK */
+  DlbLightThreadSettings streaming_settings;
+  gboolean lock_memory;
+
+  /* streaming thread the settings were last applied to, only used from
+   * the streaming thread */
+  GThread *streaming_thread;
+
+  /* device thread state, protected by queue_lock */
+  GMutex queue_lock;
+  GCond queue_cond;
+  GThread *device_thread;
+  gboolean device_running;
+  GstFlowReturn device_flow;
+  GstBuffer *queue[MAX_DEVICE_QUEUE_DEPTH];
+  GstClockTime queue_target[MAX_DEVICE_QUEUE_DEPTH];
+  GstClockTime queue_arrival[MAX_DEVICE_QUEUE_DEPTH];
+  guint queue_flags[MAX_DEVICE_QUEUE_DEPTH];
+  guint queue_head;
+  guint queue_len;
+  guint queue_size;
+
+  /* statistics, protected by queue_lock */
+  guint64 overwritten;
+  GstClockTime write_latency;
+  GstClockTime max_write_latency;
+
+  /* precise timing settings, nanoseconds for the window */
+  gboolean precise_timing;      /* ATOMIC */
+  gint precise_window;          /* ATOMIC */
+  /* part of the render delay added for the window, ATOMIC */
+  gint render_delay_window;
+
+  /* jitter statistics, protected by OBJECT_LOCK */
+  guint64 jitter_frames;
+  gint64 jitter_sum;
+  GstClockTime jitter_max;
+  guint64 jitter_histogram[N_JITTER_BUCKETS];
+
+  /* calibrated clock_nanosleep overshoot, only used by the presenting thread */
+  GstClockTime sleep_overshoot;
+
+  /* flight recorder settings, protected by OBJECT_LOCK */
+  GstClockTime recorder_duration;
+  gchar *recorder_location;
+  gboolean recorder_signal;
+  GstClockTime recorder_lateness;
+  gboolean recorder_dump_on_drop;
+
+  /* flight recorder, only changes in start/stop. Other threads take a
+   * reference under recorder_lock (see dlb_light_base_sink_get_recorder());
+   * the pointer is set atomically, so it can be checked for NULL without the
+   * lock. */
+  GMutex recorder_lock;
+  DlbLightRecorder *recorder;
+  /* when the last frame reached the sink pad, streaming thread only */
+  GstClockTime arrival;
 };
 
 #define _do_init \
     GST_DEBUG_CATEGORY_INIT (dlb_light_base_sink_debug, "lightbasesink", 0, "lightbasesink element");
 G_DEFINE_TYPE_WITH_CODE (DlbLightBaseSink, dlb_light_base_sink, GST_TYPE_BASE_SINK, G_ADD_PRIVATE (DlbLightBaseSink) _do_init);
 
+static void dlb_light_base_sink_finalize (GObject * object);
 static void dlb_light_base_sink_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void dlb_light_base_sink_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
+static gboolean dlb_light_base_sink_start (GstBaseSink * bsink);
+static gboolean dlb_light_base_sink_stop (GstBaseSink * bsink);
+static gboolean dlb_light_base_sink_event (GstBaseSink * bsink, GstEvent * event);
 static GstFlowReturn dlb_light_base_sink_show_preroll_frame (GstBaseSink * bsink, GstBuffer * buf);
 static GstFlowReturn dlb_light_base_sink_show_frame (GstBaseSink * bsink, GstBuffer * buf);
+static GstFlowReturn dlb_light_base_sink_show_list (GstBaseSink * bsink,
+    GstBufferList * list);
 static void dlb_light_base_sink_get_times (GstBaseSink * bsink, GstBuffer * buffer,
     GstClockTime * start, GstClockTime * end);
+static gchar *dlb_light_base_sink_dump_flight_recorder (DlbLightBaseSink * lsink);
+static GstPadProbeReturn dlb_light_base_sink_recorder_probe (GstPad * pad,
+    GstPadProbeInfo * info, gpointer user_data);
 
 /* Initing stuff */
 
@@ -67,6 +217,50 @@ dlb_light_base_sink_init (DlbLightBaseSink * lightsink)
   gst_base_sink_set_qos_enabled (GST_BASE_SINK (lightsink), TRUE);
 
   lightsink->priv = dlb_light_base_sink_get_instance_private (lightsink);
+
+  lightsink->priv->async_device_write = DEFAULT_ASYNC_DEVICE_WRITE;
+  lightsink->priv->queue_depth = DEFAULT_DEVICE_QUEUE_DEPTH;
+  lightsink->priv->device_settings.policy = DEFAULT_DEVICE_THREAD_POLICY;
+  lightsink->priv->device_settings.priority = DEFAULT_DEVICE_THREAD_PRIORITY;
+  lightsink->priv->device_settings.affinity = NULL;
+  lightsink->priv->streaming_settings.policy = DEFAULT_DEVICE_THREAD_POLICY;
+  lightsink->priv->streaming_settings.priority = DEFAULT_DEVICE_THREAD_PRIORITY;
+  lightsink->priv->streaming_settings.affinity = NULL;
+  lightsink->priv->lock_memory = DEFAULT_LOCK_MEMORY;
+  lightsink->priv->device_flow = GST_FLOW_OK;
+  lightsink->priv->precise_timing = DEFAULT_PRECISE_TIMING;
+  lightsink->priv->precise_window = DEFAULT_PRECISE_TIMING_WINDOW;
+  lightsink->priv->recorder_duration = DEFAULT_FLIGHT_RECORDER_DURATION;
+  lightsink->priv->recorder_location = DEFAULT_FLIGHT_RECORDER_LOCATION;
+  lightsink->priv->recorder_signal = DEFAULT_FLIGHT_RECORDER_SIGNAL;
+  lightsink->priv->recorder_lateness = DEFAULT_FLIGHT_RECORDER_LATENESS;
+  lightsink->priv->recorder_dump_on_drop = DEFAULT_FLIGHT_RECORDER_DUMP_ON_DROP;
+
+  g_mutex_init (&lightsink->priv->queue_lock);
+  g_cond_init (&lightsink->priv->queue_cond);
+  g_mutex_init (&lightsink->priv->recorder_lock);
+
+  /* frames are timed on arrival, before GstBaseSink waits for the clock,
+   * and the QoS events it sends upstream tell about dropped frames */
+  gst_pad_add_probe (DLB_LIGHT_BASE_SINK_PAD (lightsink),
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+      GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, dlb_light_base_sink_recorder_probe,
+      lightsink, NULL);
+}
+
+static void
+dlb_light_base_sink_finalize (GObject * object)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK (object);
+
+  g_free (lsink->priv->device_settings.affinity);
+  g_free (lsink->priv->streaming_settings.affinity);
+  g_free (lsink->priv->recorder_location);
+  g_mutex_clear (&lsink->priv->queue_lock);
+  g_cond_clear (&lsink->priv->queue_cond);
+  g_mutex_clear (&lsink->priv->recorder_lock);
+
+  G_OBJECT_CLASS (dlb_light_base_sink_parent_class)->finalize (object);
 }
 
 static void
@@ -75,6 +269,7 @@ dlb_light_base_sink_class_init (DlbLightBaseSinkClass * klass)
   GstBaseSinkClass *basesink_class = (GstBaseSinkClass *) klass;
   GObjectClass *gobject_class = (GObjectClass *) klass;
 
+  gobject_class->finalize = dlb_light_base_sink_finalize;
   gobject_class->set_property = dlb_light_base_sink_set_property;
   gobject_class->get_property = dlb_light_base_sink_get_property;
 
@@ -90,8 +285,265 @@ dlb_light_base_sink_class_init (DlbLightBaseSinkClass * klass)
           DEFAULT_SHOW_PREROLL_FRAME,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * DlbLightBaseSink:async-device-write:
+   *
+   * Whether to hand light frames to a sink-owned device thread instead of
+   * calling show_frame on the streaming thread. When the device falls
+   * behind, the oldest queued frames are overwritten by newer ones, so a
+   * slow device write never blocks upstream.
+   *
+   * Buffer lists are then queued frame by frame. A list is only shown with
+   * a single show_list call, e.g. one device write, when this is disabled
+   * and #GstBaseSink:sync is %FALSE; with sync, every frame of a list is
+   * shown on its own when it is due.
+   */
+  g_object_class_install_property (gobject_class, PROP_ASYNC_DEVICE_WRITE,
+      g_param_spec_boolean ("async-device-write", "Async device write",
+          "Write light frames to the device from a dedicated thread",
+          DEFAULT_ASYNC_DEVICE_WRITE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:device-queue-depth:
+   *
+   * Number of frames that can wait for the device thread. Once full, the
+   * oldest queued frame is replaced by the newest one.
+   */
+  g_object_class_install_property (gobject_class, PROP_DEVICE_QUEUE_DEPTH,
+      g_param_spec_uint ("device-queue-depth", "Device queue depth",
+          "Maximum number of frames waiting for the device thread",
+          1, MAX_DEVICE_QUEUE_DEPTH, DEFAULT_DEVICE_QUEUE_DEPTH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DEVICE_THREAD_POLICY,
+      g_param_spec_enum ("device-thread-policy", "Device thread policy",
+          "Scheduling policy of the device thread",
+          DLB_TYPE_LIGHT_THREAD_POLICY, DEFAULT_DEVICE_THREAD_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DEVICE_THREAD_PRIORITY,
+      g_param_spec_int ("device-thread-priority", "Device thread priority",
+          "Real-time priority of the device thread (fifo and rr policies only)",
+          0, 99, DEFAULT_DEVICE_THREAD_PRIORITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:device-thread-affinity:
+   *
+   * CPUs the device thread may run on, as a list of CPU numbers and
+   * ranges, e.g. "2" or "0,2-3". %NULL leaves the affinity untouched.
+   */
+  g_object_class_install_property (gobject_class, PROP_DEVICE_THREAD_AFFINITY,
+      g_param_spec_string ("device-thread-affinity", "Device thread affinity",
+          "CPU list the device thread is pinned to (e.g. \"0,2-3\")",
+          DEFAULT_DEVICE_THREAD_AFFINITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:streaming-thread-policy:
+   *
+   * Scheduling policy applied to the streaming thread that renders into
+   * the sink. The thread belongs to the upstream task, so the setting
+   * stays with it until it is changed again.
+   */
+  g_object_class_install_property (gobject_class, PROP_STREAMING_THREAD_POLICY,
+      g_param_spec_enum ("streaming-thread-policy", "Streaming thread policy",
+          "Scheduling policy of the streaming thread",
+          DLB_TYPE_LIGHT_THREAD_POLICY, DEFAULT_DEVICE_THREAD_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STREAMING_THREAD_PRIORITY,
+      g_param_spec_int ("streaming-thread-priority", "Streaming thread priority",
+          "Real-time priority of the streaming thread (fifo and rr policies only)",
+          0, 99, DEFAULT_DEVICE_THREAD_PRIORITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STREAMING_THREAD_AFFINITY,
+      g_param_spec_string ("streaming-thread-affinity", "Streaming thread affinity",
+          "CPU list the streaming thread is pinned to (e.g. \"0,2-3\")",
+          DEFAULT_DEVICE_THREAD_AFFINITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:lock-memory:
+   *
+   * Whether to lock the memory of the process when the sink starts, so
+   * frames and buffer pools are never paged out or faulted in while a
+   * frame is due. Needs the corresponding privilege, otherwise a warning
+   * is logged and the sink runs unlocked.
+   */
+  g_object_class_install_property (gobject_class, PROP_LOCK_MEMORY,
+      g_param_spec_boolean ("lock-memory", "Lock memory",
+          "Lock process memory to avoid page faults while rendering",
+          DEFAULT_LOCK_MEMORY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DEVICE_QUEUE_LEVEL,
+      g_param_spec_uint ("device-queue-level", "Device queue level",
+          "Number of frames currently waiting for the device thread",
+          0, MAX_DEVICE_QUEUE_DEPTH, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_OVERWRITTEN_FRAMES,
+      g_param_spec_uint64 ("overwritten-frames", "Overwritten frames",
+          "Number of queued frames replaced before reaching the device",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DEVICE_WRITE_LATENCY,
+      g_param_spec_uint64 ("device-write-latency", "Device write latency",
+          "Duration of the last device write in nanoseconds",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_DEVICE_WRITE_LATENCY,
+      g_param_spec_uint64 ("max-device-write-latency",
+          "Maximum device write latency",
+          "Longest device write since start in nanoseconds",
+          0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightBaseSink:precise-timing:
+   *
+   * Whether to present frames with sub-millisecond accuracy. The regular
+   * clock wait is shortened by #DlbLightBaseSink:precise-timing-window and
+   * the remainder is covered by an absolute high-resolution sleep followed
+   * by a short, bounded busy-wait calibrated against the observed sleep
+   * overshoot.
+   *
+   * The window is added to the #GstBaseSink:render-delay, so GstBaseSink
+   * wakes up that much earlier while its QoS and lateness handling keep
+   * working on the real frame times, and the pipeline latency accounts for
+   * it.
+   */
+  g_object_class_install_property (gobject_class, PROP_PRECISE_TIMING,
+      g_param_spec_boolean ("precise-timing", "Precise timing",
+          "Present frames with sub-millisecond accuracy",
+          DEFAULT_PRECISE_TIMING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_PRECISE_TIMING_WINDOW,
+      g_param_spec_uint64 ("precise-timing-window", "Precise timing window",
+          "How much earlier than the frame time the coarse clock wait returns, "
+          "in nanoseconds", 0, MAX_PRECISE_TIMING_WINDOW,
+          DEFAULT_PRECISE_TIMING_WINDOW,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightBaseSink:jitter-stats:
+   *
+   * Presentation error statistics of synchronised frames: the number of
+   * frames, the mean signed error and the maximum absolute error in
+   * nanoseconds (positive means late), and a histogram of absolute errors.
+   * Collected whether or not #DlbLightBaseSink:precise-timing is enabled.
+   */
+  g_object_class_install_property (gobject_class, PROP_JITTER_STATS,
+      g_param_spec_boxed ("jitter-stats", "Jitter statistics",
+          "Presentation error statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * DlbLightBaseSink:flight-recorder-duration:
+   *
+   * How much history the flight recorder keeps: the frames shown, or
+   * dropped, with their arrival and presentation times and lateness. The
+   * ring is allocated once on the first frame, so recording costs a copy
+   * of each frame and can be left enabled. It is written to
+   * #DlbLightBaseSink:flight-recorder-location by the
+   * #DlbLightBaseSink::dump-flight-recorder action signal, on SIGUSR2 (see
+   * #DlbLightBaseSink:flight-recorder-signal), or when a frame is dropped
+   * or late (see #DlbLightBaseSink:flight-recorder-dump-on-drop and
+   * #DlbLightBaseSink:flight-recorder-lateness). Every dump is announced
+   * by a "dlb-flight-recorder-dump" element message with its location.
+   * 0 disables the recorder.
+   */
+  g_object_class_install_property (gobject_class, PROP_FLIGHT_RECORDER_DURATION,
+      g_param_spec_uint64 ("flight-recorder-duration", "Flight recorder duration",
+          "History kept by the flight recorder in nanoseconds (0 = disabled)",
+          0, MAX_FLIGHT_RECORDER_DURATION, DEFAULT_FLIGHT_RECORDER_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FLIGHT_RECORDER_LOCATION,
+      g_param_spec_string ("flight-recorder-location", "Flight recorder location",
+          "Directory flight recorder dumps are written to (NULL = temporary "
+          "directory)", DEFAULT_FLIGHT_RECORDER_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:flight-recorder-signal:
+   *
+   * Whether SIGUSR2 dumps the flight recorder, e.g. with `kill -USR2` on a
+   * device where the application cannot be reached. The handler is only
+   * installed if the application does not handle the signal already. The
+   * signal is picked up within 200 ms, also when no frames flow, e.g. in a
+   * stalled pipeline.
+   */
+  g_object_class_install_property (gobject_class, PROP_FLIGHT_RECORDER_SIGNAL,
+      g_param_spec_boolean ("flight-recorder-signal", "Flight recorder signal",
+          "Dump the flight recorder on SIGUSR2",
+          DEFAULT_FLIGHT_RECORDER_SIGNAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  /**
+   * DlbLightBaseSink:flight-recorder-lateness:
+   *
+   * Dump the flight recorder when a frame is shown later than this. Dumps
+   * triggered automatically are at least a recorder duration apart. 0
+   * disables the trigger.
+   */
+  g_object_class_install_property (gobject_class, PROP_FLIGHT_RECORDER_LATENESS,
+      g_param_spec_uint64 ("flight-recorder-lateness", "Flight recorder lateness",
+          "Lateness in nanoseconds that dumps the flight recorder (0 = never)",
+          0, G_MAXUINT64, DEFAULT_FLIGHT_RECORDER_LATENESS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_FLIGHT_RECORDER_DUMP_ON_DROP,
+      g_param_spec_boolean ("flight-recorder-dump-on-drop",
+          "Flight recorder dump on drop",
+          "Dump the flight recorder when a frame is dropped as too late",
+          DEFAULT_FLIGHT_RECORDER_DUMP_ON_DROP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightBaseSink::dump-flight-recorder:
+   * @lightsink: the light sink
+   *
+   * Writes the flight recorder to a new file in
+   * #DlbLightBaseSink:flight-recorder-location.
+   *
+   * Returns: the path of the dump, or %NULL if the recorder is disabled or
+   * the dump could not be written.
+   */
+  dlb_light_base_sink_signals[SIGNAL_DUMP_FLIGHT_RECORDER] =
+      g_signal_new_class_handler ("dump-flight-recorder",
+      G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_CALLBACK (dlb_light_base_sink_dump_flight_recorder), NULL, NULL, NULL,
+      G_TYPE_STRING, 0);
+
+  basesink_class->start = GST_DEBUG_FUNCPTR (dlb_light_base_sink_start);
+  basesink_class->stop = GST_DEBUG_FUNCPTR (dlb_light_base_sink_stop);
+  basesink_class->event = GST_DEBUG_FUNCPTR (dlb_light_base_sink_event);
   basesink_class->render = GST_DEBUG_FUNCPTR (dlb_light_base_sink_show_frame);
   basesink_class->preroll = GST_DEBUG_FUNCPTR (dlb_light_base_sink_show_preroll_frame);
+  basesink_class->render_list = GST_DEBUG_FUNCPTR (dlb_light_base_sink_show_list);
   basesink_class->get_times = GST_DEBUG_FUNCPTR (dlb_light_base_sink_get_times);
 }
 
@@ -104,6 +556,7 @@ dlb_light_base_sink_get_times (GstBaseSink * bsink, GstBuffer * buffer,
   timestamp = GST_BUFFER_DTS_OR_PTS (buffer);
   if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
     *start = timestamp;
+
     if (GST_BUFFER_DURATION_IS_VALID (buffer)) {
       *end = timestamp + GST_BUFFER_DURATION (buffer);
     } else if (bsink->segment.rate < 0) {
@@ -116,6 +569,566 @@ dlb_light_base_sink_get_times (GstBaseSink * bsink, GstBuffer * buffer,
   }
 }
 
+/* Precise timing */
+
+/* GstBaseSink returns from its clock wait the render delay before a frame
+ * is due, so the precise timing window is added to it and waited out in
+ * dlb_light_base_sink_precise_wait. Only called from set_property. */
+static void
+dlb_light_base_sink_update_render_delay (DlbLightBaseSink * lsink)
+{
+  GstBaseSink *bsink = GST_BASE_SINK_CAST (lsink);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GstClockTime delay, added, window = 0;
+
+  if (g_atomic_int_get (&priv->precise_timing))
+    window = g_atomic_int_get (&priv->precise_window);
+
+  added = g_atomic_int_get (&priv->render_delay_window);
+  if (window == added)
+    return;
+
+  delay = gst_base_sink_get_render_delay (bsink);
+  delay = (delay > added ? delay - added : 0) + window;
+  g_atomic_int_set (&priv->render_delay_window, window);
+  gst_base_sink_set_render_delay (bsink, delay);
+}
+
+/* The clock time at which GstBaseSink would release @buf, or
+ * GST_CLOCK_TIME_NONE when the frame is not synchronised. */
+static GstClockTime
+dlb_light_base_sink_get_target (DlbLightBaseSink * lsink, GstBuffer * buf)
+{
+  GstBaseSink *bsink = GST_BASE_SINK_CAST (lsink);
+  GstClockTime timestamp, target, render_delay, window;
+  GstClockTimeDiff ts_offset;
+
+  if (!gst_base_sink_get_sync (bsink))
+    return GST_CLOCK_TIME_NONE;
+
+  timestamp = GST_BUFFER_DTS_OR_PTS (buf);
+  if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+    return GST_CLOCK_TIME_NONE;
+
+  if (bsink->segment.rate < 0 && GST_BUFFER_DURATION_IS_VALID (buf))
+    timestamp += GST_BUFFER_DURATION (buf);
+
+  target = gst_segment_to_running_time (&bsink->segment, GST_FORMAT_TIME, timestamp);
+  if (!GST_CLOCK_TIME_IS_VALID (target))
+    return GST_CLOCK_TIME_NONE;
+
+  /* same adjustments GstBaseSink applies before waiting on the clock,
+   * except for the part of the render delay that precise timing waits out */
+  target += gst_base_sink_get_latency (bsink);
+  ts_offset = gst_base_sink_get_ts_offset (bsink);
+  if (ts_offset < 0)
+    target = ((GstClockTime) -ts_offset < target) ? target + ts_offset : 0;
+  else
+    target += ts_offset;
+  render_delay = gst_base_sink_get_render_delay (bsink);
+  window = g_atomic_int_get (&lsink->priv->render_delay_window);
+  render_delay = (render_delay > window) ? render_delay - window : 0;
+  target = (target > render_delay) ? target - render_delay : 0;
+
+  return target + gst_element_get_base_time (GST_ELEMENT_CAST (lsink));
+}
+
+static void
+dlb_light_base_sink_precise_wait (DlbLightBaseSink * lsink, GstClock * clock,
+    GstClockTime target, GstClockTime window)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GstClockTime now, remaining, spin, spin_deadline;
+
+  now = gst_clock_get_time (clock);
+  if (now >= target)
+    return;
+
+  /* the coarse wait is only shortened by the window, anything further away
+   * means the frame was not synchronised and must not be held up here */
+  remaining = target - now;
+  if (remaining > window + MAX_SPIN_TIME)
+    return;
+
+  spin = CLAMP (priv->sleep_overshoot + MIN_SPIN_TIME, MIN_SPIN_TIME, MAX_SPIN_TIME);
+
+  if (remaining > spin) {
+#ifdef HAVE_CLOCK_NANOSLEEP
+    struct timespec mono, wake;
+    GstClockTime deadline, woke;
+
+    clock_gettime (CLOCK_MONOTONIC, &mono);
+    deadline = GST_TIMESPEC_TO_TIME (mono) + remaining - spin;
+    GST_TIME_TO_TIMESPEC (deadline, wake);
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+
+    clock_gettime (CLOCK_MONOTONIC, &mono);
+    woke = GST_TIMESPEC_TO_TIME (mono);
+
+    /* moving average of how late the kernel wakes us up */
+    priv->sleep_overshoot = (7 * priv->sleep_overshoot +
+        (woke > deadline ? woke - deadline : 0)) / 8;
+#else
+    g_usleep ((remaining - spin) / GST_USECOND);
+#endif
+  }
+
+  /* spin out the rest, bounded in case the clock does not advance */
+  spin_deadline = gst_util_get_timestamp () + spin + MAX_SPIN_TIME;
+  while (gst_clock_get_time (clock) < target &&
+      gst_util_get_timestamp () < spin_deadline);
+}
+
+static void
+dlb_light_base_sink_record_jitter (DlbLightBaseSink * lsink, GstClockTimeDiff error)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GstClockTime abs_error = (GstClockTime) ABS (error);
+  guint i = 0;
+
+  while (abs_error >= jitter_buckets[i].limit)
+    i++;
+
+  GST_OBJECT_LOCK (lsink);
+  priv->jitter_frames++;
+  priv->jitter_sum += error;
+  priv->jitter_max = MAX (priv->jitter_max, abs_error);
+  priv->jitter_histogram[i]++;
+  GST_OBJECT_UNLOCK (lsink);
+}
+
+/* call with OBJECT_LOCK held */
+static GstStructure *
+dlb_light_base_sink_get_jitter_stats (DlbLightBaseSink * lsink)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GstStructure *stats;
+
+  stats = gst_structure_new ("dlb-light-jitter-stats",
+      "frames", G_TYPE_UINT64, priv->jitter_frames,
+      "mean-error", G_TYPE_INT64,
+      priv->jitter_frames ? priv->jitter_sum / (gint64) priv->jitter_frames : 0,
+      "max-error", G_TYPE_UINT64, priv->jitter_max, NULL);
+
+  for (guint i = 0; i < N_JITTER_BUCKETS; i++)
+    gst_structure_set (stats, jitter_buckets[i].name, G_TYPE_UINT64,
+        priv->jitter_histogram[i], NULL);
+
+  return stats;
+}
+
+/* Returns: (transfer full) (nullable): a reference to the flight recorder,
+ * which stays usable if the sink is stopped meanwhile. */
+static DlbLightRecorder *
+dlb_light_base_sink_get_recorder (DlbLightBaseSink * lsink)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightRecorder *recorder = NULL;
+
+  if (g_atomic_pointer_get (&priv->recorder) == NULL)
+    return NULL;
+
+  g_mutex_lock (&priv->recorder_lock);
+  if (priv->recorder)
+    recorder = dlb_light_recorder_ref (priv->recorder);
+  g_mutex_unlock (&priv->recorder_lock);
+
+  return recorder;
+}
+
+/* Wait for the exact presentation time when precise timing is enabled,
+ * record the presentation error and write the frame to the device. */
+static GstFlowReturn
+dlb_light_base_sink_present (DlbLightBaseSink * lsink, GstBuffer * buf,
+    GstClockTime target, GstClockTime arrival, guint record_flags)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightRecorder *recorder;
+  GstClock *clock = NULL;
+  gboolean precise = FALSE;
+  GstClockTime window = 0, max_lateness = 0, presented;
+  GstClockTimeDiff lateness = GST_CLOCK_STIME_NONE;
+  GstFlowReturn ret;
+
+  if (GST_CLOCK_TIME_IS_VALID (target)) {
+    precise = g_atomic_int_get (&priv->precise_timing);
+    window = g_atomic_int_get (&priv->render_delay_window);
+
+    GST_OBJECT_LOCK (lsink);
+    max_lateness = priv->recorder_lateness;
+    if (GST_ELEMENT_CLOCK (lsink))
+      clock = gst_object_ref (GST_ELEMENT_CLOCK (lsink));
+    GST_OBJECT_UNLOCK (lsink);
+  }
+
+  if (clock) {
+    if (precise)
+      dlb_light_base_sink_precise_wait (lsink, clock, target, window);
+    lateness = GST_CLOCK_DIFF (target, gst_clock_get_time (clock));
+    dlb_light_base_sink_record_jitter (lsink, lateness);
+    DLB_TRACE (clock_wait, lsink, GST_BUFFER_PTS (buf), target, lateness);
+    gst_object_unref (clock);
+  }
+
+  DLB_TRACE (show_frame_start, lsink, GST_BUFFER_PTS (buf),
+      gst_buffer_get_size (buf));
+  presented = gst_util_get_timestamp ();
+  ret = DLB_LIGHT_BASE_SINK_GET_CLASS (lsink)->show_frame (lsink, buf);
+  DLB_TRACE (show_frame_end, lsink, GST_BUFFER_PTS (buf), ret);
+
+  recorder = dlb_light_base_sink_get_recorder (lsink);
+  if (recorder) {
+    dlb_light_recorder_record (recorder, buf, arrival, presented, lateness,
+        record_flags);
+    if (max_lateness > 0 && GST_CLOCK_STIME_IS_VALID (lateness) &&
+        lateness > (GstClockTimeDiff) max_lateness)
+      dlb_light_recorder_trigger (recorder, "late frame");
+    dlb_light_recorder_unref (recorder);
+  }
+
+  return ret;
+}
+
+/* Device thread */
+
+/* call with queue_lock held */
+static void
+dlb_light_base_sink_flush_queue (DlbLightBaseSink * lsink)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+
+  while (priv->queue_len > 0) {
+    gst_buffer_unref (priv->queue[priv->queue_head]);
+    priv->queue[priv->queue_head] = NULL;
+    priv->queue_head = (priv->queue_head + 1) % priv->queue_size;
+    priv->queue_len--;
+  }
+  priv->queue_head = 0;
+}
+
+static gpointer
+dlb_light_base_sink_device_thread (gpointer data)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (data);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightThreadSettings settings;
+
+  GST_OBJECT_LOCK (lsink);
+  settings = priv->device_settings;
+  settings.affinity = g_strdup (settings.affinity);
+  GST_OBJECT_UNLOCK (lsink);
+
+  dlb_light_thread_settings_apply (&settings, GST_OBJECT_CAST (lsink), "device");
+  g_free (settings.affinity);
+
+  GST_DEBUG_OBJECT (lsink, "device thread started");
+
+  g_mutex_lock (&priv->queue_lock);
+  while (TRUE) {
+    GstBuffer *buf;
+    GstClockTime target, arrival, start, latency;
+    GstFlowReturn ret;
+    guint flags;
+
+    while (priv->device_running && priv->queue_len == 0)
+      g_cond_wait (&priv->queue_cond, &priv->queue_lock);
+
+    if (!priv->device_running)
+      break;
+
+    buf = priv->queue[priv->queue_head];
+    target = priv->queue_target[priv->queue_head];
+    arrival = priv->queue_arrival[priv->queue_head];
+    flags = priv->queue_flags[priv->queue_head];
+    priv->queue[priv->queue_head] = NULL;
+    priv->queue_head = (priv->queue_head + 1) % priv->queue_size;
+    priv->queue_len--;
+    g_mutex_unlock (&priv->queue_lock);
+
+    GST_LOG_OBJECT (lsink, "writing frame, ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
+
+    start = gst_util_get_timestamp ();
+    ret = dlb_light_base_sink_present (lsink, buf, target, arrival, flags);
+    latency = gst_util_get_timestamp () - start;
+    gst_buffer_unref (buf);
+
+    g_mutex_lock (&priv->queue_lock);
+    priv->write_latency = latency;
+    priv->max_write_latency = MAX (priv->max_write_latency, latency);
+    if (ret != GST_FLOW_OK && priv->device_flow == GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (lsink, "device write returned %s", gst_flow_get_name (ret));
+      priv->device_flow = ret;
+    }
+  }
+  g_mutex_unlock (&priv->queue_lock);
+
+  GST_DEBUG_OBJECT (lsink, "device thread stopped");
+
+  return NULL;
+}
+
+/* The streaming thread is owned by upstream and can change across state
+ * changes, so the settings are (re)applied whenever a new one shows up. */
+static void
+dlb_light_base_sink_apply_streaming_settings (DlbLightBaseSink * lsink)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightThreadSettings settings;
+
+  if (G_LIKELY (priv->streaming_thread == g_thread_self ()))
+    return;
+
+  priv->streaming_thread = g_thread_self ();
+
+  GST_OBJECT_LOCK (lsink);
+  settings = priv->streaming_settings;
+  settings.affinity = g_strdup (settings.affinity);
+  GST_OBJECT_UNLOCK (lsink);
+
+  if (settings.policy != DLB_LIGHT_THREAD_POLICY_OTHER || settings.affinity)
+    dlb_light_thread_settings_apply (&settings, GST_OBJECT_CAST (lsink),
+        "streaming");
+  g_free (settings.affinity);
+}
+
+/* Hand a frame to the device, either directly or through the device thread.
+ * When the device thread lags behind, the oldest queued frame is dropped in
+ * favour of the new one. */
+static GstFlowReturn
+dlb_light_base_sink_submit (DlbLightBaseSink * lsink, GstBuffer * buf,
+    GstClockTime target, guint record_flags)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GstBuffer *stale = NULL;
+  GstFlowReturn ret;
+  GstClockTime arrival = priv->arrival;
+  guint tail;
+
+  dlb_light_base_sink_apply_streaming_settings (lsink);
+
+  /* device_thread only changes in start/stop, while not streaming */
+  if (priv->device_thread == NULL)
+    return dlb_light_base_sink_present (lsink, buf, target, arrival,
+        record_flags);
+
+  g_mutex_lock (&priv->queue_lock);
+  ret = priv->device_flow;
+  if (priv->queue_len == priv->queue_size) {
+    stale = priv->queue[priv->queue_head];
+    priv->queue[priv->queue_head] = NULL;
+    priv->queue_head = (priv->queue_head + 1) % priv->queue_size;
+    priv->queue_len--;
+    priv->overwritten++;
+  }
+  tail = (priv->queue_head + priv->queue_len) % priv->queue_size;
+  priv->queue[tail] = gst_buffer_ref (buf);
+  priv->queue_target[tail] = target;
+  priv->queue_arrival[tail] = arrival;
+  priv->queue_flags[tail] = record_flags;
+  priv->queue_len++;
+  g_cond_signal (&priv->queue_cond);
+  g_mutex_unlock (&priv->queue_lock);
+
+  if (stale) {
+    GST_LOG_OBJECT (lsink, "device busy, overwriting frame ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (stale)));
+    gst_buffer_unref (stale);
+  }
+
+  return ret;
+}
+
+static gboolean
+dlb_light_base_sink_start (GstBaseSink * bsink)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (bsink);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  GError *error = NULL;
+  gboolean async, lock_memory, recorder_signal;
+  GstClockTime recorder_duration;
+  gchar *recorder_location;
+  guint depth;
+
+  GST_OBJECT_LOCK (lsink);
+  async = priv->async_device_write;
+  depth = priv->queue_depth;
+  lock_memory = priv->lock_memory;
+  recorder_duration = priv->recorder_duration;
+  recorder_location = g_strdup (priv->recorder_location);
+  recorder_signal = priv->recorder_signal;
+  priv->jitter_frames = 0;
+  priv->jitter_sum = 0;
+  priv->jitter_max = 0;
+  memset (priv->jitter_histogram, 0, sizeof (priv->jitter_histogram));
+  GST_OBJECT_UNLOCK (lsink);
+
+  priv->sleep_overshoot = 0;
+  priv->streaming_thread = NULL;
+  priv->arrival = GST_CLOCK_TIME_NONE;
+
+  if (lock_memory)
+    dlb_light_lock_memory (GST_OBJECT_CAST (lsink));
+
+  if (recorder_duration > 0) {
+    DlbLightRecorder *recorder = dlb_light_recorder_new (GST_ELEMENT_CAST (lsink),
+        recorder_duration, recorder_location, recorder_signal);
+
+    g_mutex_lock (&priv->recorder_lock);
+    g_atomic_pointer_set (&priv->recorder, recorder);
+    g_mutex_unlock (&priv->recorder_lock);
+  }
+  g_free (recorder_location);
+
+  g_mutex_lock (&priv->queue_lock);
+  priv->device_flow = GST_FLOW_OK;
+  priv->queue_head = 0;
+  priv->queue_len = 0;
+  priv->queue_size = depth;
+  priv->overwritten = 0;
+  priv->write_latency = 0;
+  priv->max_write_latency = 0;
+  priv->device_running = async;
+  g_mutex_unlock (&priv->queue_lock);
+
+  if (!async)
+    return TRUE;
+
+  if (DLB_LIGHT_BASE_SINK_GET_CLASS (lsink)->show_frame == NULL) {
+    GST_WARNING_OBJECT (lsink, "no show_frame implementation, not starting device thread");
+    return TRUE;
+  }
+
+  priv->device_thread = g_thread_try_new ("lightdevice",
+      dlb_light_base_sink_device_thread, lsink, &error);
+  if (priv->device_thread == NULL) {
+    GST_ELEMENT_ERROR (lsink, RESOURCE, FAILED, (NULL),
+        ("Could not create device thread: %s", error->message));
+    g_clear_error (&error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+dlb_light_base_sink_stop (GstBaseSink * bsink)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (bsink);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightRecorder *recorder;
+
+  if (priv->device_thread) {
+    g_mutex_lock (&priv->queue_lock);
+    priv->device_running = FALSE;
+    dlb_light_base_sink_flush_queue (lsink);
+    g_cond_signal (&priv->queue_cond);
+    g_mutex_unlock (&priv->queue_lock);
+
+    g_thread_join (priv->device_thread);
+    priv->device_thread = NULL;
+  }
+
+  g_mutex_lock (&priv->recorder_lock);
+  recorder = priv->recorder;
+  g_atomic_pointer_set (&priv->recorder, NULL);
+  g_mutex_unlock (&priv->recorder_lock);
+  if (recorder)
+    dlb_light_recorder_unref (recorder);
+
+  return TRUE;
+}
+
+/* Action signal handler */
+static gchar *
+dlb_light_base_sink_dump_flight_recorder (DlbLightBaseSink * lsink)
+{
+  DlbLightRecorder *recorder = dlb_light_base_sink_get_recorder (lsink);
+  gchar *path;
+
+  if (recorder == NULL) {
+    GST_DEBUG_OBJECT (lsink, "flight recorder disabled, nothing to dump");
+    return NULL;
+  }
+
+  path = dlb_light_recorder_dump (recorder, "requested");
+  dlb_light_recorder_unref (recorder);
+
+  return path;
+}
+
+/* Frames are timed as they arrive. GstBaseSink drops a frame when it is
+ * later than max-lateness and tells upstream with a QoS event carrying that
+ * lateness. Upstream events can be sent from any thread, so the recorder is
+ * only used through a reference. */
+static GstPadProbeReturn
+dlb_light_base_sink_recorder_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (user_data);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightRecorder *recorder;
+  GstEvent *event;
+  GstClockTimeDiff diff;
+  GstClockTime timestamp;
+  gint64 max_lateness;
+  gboolean dump_on_drop;
+
+  if (g_atomic_pointer_get (&priv->recorder) == NULL)
+    return GST_PAD_PROBE_OK;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) &
+      (GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST)) {
+    priv->arrival = gst_util_get_timestamp ();
+    return GST_PAD_PROBE_OK;
+  }
+
+  event = GST_PAD_PROBE_INFO_EVENT (info);
+  if (GST_EVENT_TYPE (event) != GST_EVENT_QOS)
+    return GST_PAD_PROBE_OK;
+
+  gst_event_parse_qos (event, NULL, NULL, &diff, &timestamp);
+  max_lateness = gst_base_sink_get_max_lateness (GST_BASE_SINK_CAST (lsink));
+  if (max_lateness < 0 || diff <= max_lateness)
+    return GST_PAD_PROBE_OK;
+
+  GST_OBJECT_LOCK (lsink);
+  dump_on_drop = priv->recorder_dump_on_drop;
+  GST_OBJECT_UNLOCK (lsink);
+
+  recorder = dlb_light_base_sink_get_recorder (lsink);
+  if (recorder) {
+    dlb_light_recorder_record_drop (recorder, timestamp, diff);
+    if (dump_on_drop)
+      dlb_light_recorder_trigger (recorder, "dropped frame");
+    dlb_light_recorder_unref (recorder);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+dlb_light_base_sink_event (GstBaseSink * bsink, GstEvent * event)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (bsink);
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    /* frames queued before the flush are stale */
+    g_mutex_lock (&priv->queue_lock);
+    if (priv->queue_size > 0)
+      dlb_light_base_sink_flush_queue (lsink);
+    priv->device_flow = GST_FLOW_OK;
+    g_mutex_unlock (&priv->queue_lock);
+  } else if (GST_EVENT_TYPE (event) == GST_EVENT_GAP) {
+    /* GstBaseSink has already prerolled and synced on the gap; nothing is
+     * shown for it and the lights hold the last frame */
+    GST_LOG_OBJECT (lsink, "holding last frame over %" GST_PTR_FORMAT, event);
+  }
+
+  return GST_BASE_SINK_CLASS (dlb_light_base_sink_parent_class)->event (bsink, event);
+}
+
 static GstFlowReturn
 dlb_light_base_sink_show_preroll_frame (GstBaseSink * bsink, GstBuffer * buf)
 {
@@ -146,7 +1159,8 @@ dlb_light_base_sink_show_preroll_frame (GstBaseSink * bsink, GstBuffer * buf)
   GST_LOG_OBJECT (bsink, "rendering frame, ts=%" GST_TIME_FORMAT,
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
 
-  return klass->show_frame (DLB_LIGHT_BASE_SINK_CAST (bsink), buf);
+  return dlb_light_base_sink_submit (DLB_LIGHT_BASE_SINK_CAST (bsink), buf,
+      GST_CLOCK_TIME_NONE, DLB_LIGHT_RECORD_PREROLL);
 }
 
 static GstFlowReturn
@@ -168,7 +1182,100 @@ dlb_light_base_sink_show_frame (GstBaseSink * bsink, GstBuffer * buf)
   GST_LOG_OBJECT (bsink, "rendering frame, ts=%" GST_TIME_FORMAT,
       GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buf)));
 
-  return klass->show_frame (DLB_LIGHT_BASE_SINK_CAST (bsink), buf);
+  return dlb_light_base_sink_submit (DLB_LIGHT_BASE_SINK_CAST (bsink), buf,
+      dlb_light_base_sink_get_target (DLB_LIGHT_BASE_SINK_CAST (bsink), buf), 0);
+}
+
+/* GstBaseSink only waits for the first frame of a list, the following ones
+ * wait here for their own running time. */
+static GstFlowReturn
+dlb_light_base_sink_wait_frame (DlbLightBaseSink * lsink, GstBuffer * buf)
+{
+  GstBaseSink *bsink = GST_BASE_SINK_CAST (lsink);
+  GstClockTime start = GST_CLOCK_TIME_NONE, end = GST_CLOCK_TIME_NONE;
+  GstClockTime running_time;
+  GstClockTimeDiff jitter = 0;
+  GstFlowReturn ret;
+
+  dlb_light_base_sink_get_times (bsink, buf, &start, &end);
+  if (bsink->segment.rate < 0)
+    start = end;
+
+  if (!GST_CLOCK_TIME_IS_VALID (start))
+    return GST_FLOW_OK;
+
+  running_time = gst_segment_to_running_time (&bsink->segment, GST_FORMAT_TIME,
+      start);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_FLOW_OK;
+
+  ret = gst_base_sink_wait (bsink, running_time, &jitter);
+  DLB_TRACE (clock_wait, lsink, GST_BUFFER_PTS (buf), running_time, jitter);
+
+  return ret;
+}
+
+/* Write a whole list with show_list. All its frames are presented at once,
+ * which is only right when they are not synchronised. */
+static GstFlowReturn
+dlb_light_base_sink_present_list (DlbLightBaseSink * lsink,
+    GstBufferList * list)
+{
+  DlbLightBaseSinkPrivate *priv = lsink->priv;
+  DlbLightRecorder *recorder;
+  GstClockTime presented;
+  GstFlowReturn ret;
+
+  dlb_light_base_sink_apply_streaming_settings (lsink);
+
+  GST_LOG_OBJECT (lsink, "rendering a list of %u frames",
+      gst_buffer_list_length (list));
+
+  presented = gst_util_get_timestamp ();
+  ret = DLB_LIGHT_BASE_SINK_GET_CLASS (lsink)->show_list (lsink, list);
+
+  recorder = dlb_light_base_sink_get_recorder (lsink);
+  if (recorder) {
+    for (guint i = 0; i < gst_buffer_list_length (list); i++)
+      dlb_light_recorder_record (recorder, gst_buffer_list_get (list, i),
+          priv->arrival, presented, GST_CLOCK_STIME_NONE, 0);
+    dlb_light_recorder_unref (recorder);
+  }
+
+  return ret;
+}
+
+/* Lists are handed to show_list when there is nothing to time per frame,
+ * otherwise every frame is presented on its own, on time. */
+static GstFlowReturn
+dlb_light_base_sink_show_list (GstBaseSink * bsink, GstBufferList * list)
+{
+  DlbLightBaseSink *lsink = DLB_LIGHT_BASE_SINK_CAST (bsink);
+  DlbLightBaseSinkClass *klass = DLB_LIGHT_BASE_SINK_GET_CLASS (lsink);
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean sync;
+  guint len;
+
+  sync = gst_base_sink_get_sync (bsink);
+  len = gst_buffer_list_length (list);
+
+  /* device_thread only changes in start/stop, while not streaming */
+  if (klass->show_list != NULL && !sync && lsink->priv->device_thread == NULL)
+    return dlb_light_base_sink_present_list (lsink, list);
+
+  for (guint i = 0; i < len && ret == GST_FLOW_OK; i++) {
+    GstBuffer *buf = gst_buffer_list_get (list, i);
+
+    if (i > 0 && sync) {
+      ret = dlb_light_base_sink_wait_frame (lsink, buf);
+      if (ret != GST_FLOW_OK)
+        break;
+    }
+
+    ret = dlb_light_base_sink_show_frame (bsink, buf);
+  }
+
+  return ret;
 }
 
 static void
@@ -184,6 +1291,89 @@ dlb_light_base_sink_set_property (GObject * object, guint prop_id,
       g_atomic_int_set (&lsink->priv->show_preroll_frame,
           g_value_get_boolean (value));
       break;
+    case PROP_ASYNC_DEVICE_WRITE:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->async_device_write = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_QUEUE_DEPTH:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->queue_depth = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_POLICY:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->device_settings.policy = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_PRIORITY:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->device_settings.priority = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_AFFINITY:
+      GST_OBJECT_LOCK (lsink);
+      g_free (lsink->priv->device_settings.affinity);
+      lsink->priv->device_settings.affinity = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_POLICY:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->streaming_settings.policy = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_PRIORITY:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->streaming_settings.priority = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_AFFINITY:
+      GST_OBJECT_LOCK (lsink);
+      g_free (lsink->priv->streaming_settings.affinity);
+      lsink->priv->streaming_settings.affinity = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_LOCK_MEMORY:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->lock_memory = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_PRECISE_TIMING:
+      g_atomic_int_set (&lsink->priv->precise_timing,
+          g_value_get_boolean (value));
+      dlb_light_base_sink_update_render_delay (lsink);
+      break;
+    case PROP_PRECISE_TIMING_WINDOW:
+      g_atomic_int_set (&lsink->priv->precise_window,
+          g_value_get_uint64 (value));
+      dlb_light_base_sink_update_render_delay (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_DURATION:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->recorder_duration = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_LOCATION:
+      GST_OBJECT_LOCK (lsink);
+      g_free (lsink->priv->recorder_location);
+      lsink->priv->recorder_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_SIGNAL:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->recorder_signal = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_LATENESS:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->recorder_lateness = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_DUMP_ON_DROP:
+      GST_OBJECT_LOCK (lsink);
+      lsink->priv->recorder_dump_on_drop = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -203,6 +1393,109 @@ dlb_light_base_sink_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value,
           g_atomic_int_get (&lsink->priv->show_preroll_frame));
       break;
+    case PROP_ASYNC_DEVICE_WRITE:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_boolean (value, lsink->priv->async_device_write);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_QUEUE_DEPTH:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_uint (value, lsink->priv->queue_depth);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_POLICY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_enum (value, lsink->priv->device_settings.policy);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_PRIORITY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_int (value, lsink->priv->device_settings.priority);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_THREAD_AFFINITY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_string (value, lsink->priv->device_settings.affinity);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_POLICY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_enum (value, lsink->priv->streaming_settings.policy);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_PRIORITY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_int (value, lsink->priv->streaming_settings.priority);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_STREAMING_THREAD_AFFINITY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_string (value, lsink->priv->streaming_settings.affinity);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_LOCK_MEMORY:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_boolean (value, lsink->priv->lock_memory);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_PRECISE_TIMING:
+      g_value_set_boolean (value,
+          g_atomic_int_get (&lsink->priv->precise_timing));
+      break;
+    case PROP_PRECISE_TIMING_WINDOW:
+      g_value_set_uint64 (value,
+          g_atomic_int_get (&lsink->priv->precise_window));
+      break;
+    case PROP_FLIGHT_RECORDER_DURATION:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_uint64 (value, lsink->priv->recorder_duration);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_LOCATION:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_string (value, lsink->priv->recorder_location);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_SIGNAL:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_boolean (value, lsink->priv->recorder_signal);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_LATENESS:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_uint64 (value, lsink->priv->recorder_lateness);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_FLIGHT_RECORDER_DUMP_ON_DROP:
+      GST_OBJECT_LOCK (lsink);
+      g_value_set_boolean (value, lsink->priv->recorder_dump_on_drop);
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_JITTER_STATS:
+      GST_OBJECT_LOCK (lsink);
+      g_value_take_boxed (value, dlb_light_base_sink_get_jitter_stats (lsink));
+      GST_OBJECT_UNLOCK (lsink);
+      break;
+    case PROP_DEVICE_QUEUE_LEVEL:
+      g_mutex_lock (&lsink->priv->queue_lock);
+      g_value_set_uint (value, lsink->priv->queue_len);
+      g_mutex_unlock (&lsink->priv->queue_lock);
+      break;
+    case PROP_OVERWRITTEN_FRAMES:
+      g_mutex_lock (&lsink->priv->queue_lock);
+      g_value_set_uint64 (value, lsink->priv->overwritten);
+      g_mutex_unlock (&lsink->priv->queue_lock);
+      break;
+    case PROP_DEVICE_WRITE_LATENCY:
+      g_mutex_lock (&lsink->priv->queue_lock);
+      g_value_set_uint64 (value, lsink->priv->write_latency);
+      g_mutex_unlock (&lsink->priv->queue_lock);
+      break;
+    case PROP_MAX_DEVICE_WRITE_LATENCY:
+      g_mutex_lock (&lsink->priv->queue_lock);
+      g_value_set_uint64 (value, lsink->priv->max_write_latency);
+      g_mutex_unlock (&lsink->priv->queue_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -24,6 +24,7 @@
 // This is derived from gstaudiobasesinksink.h and gstaudiobasesink.h
 
 #include <gst/base/gstbasesink.h>
+#include "dlblightsched.h"
 
 G_BEGIN_DECLS
 
@@ -64,6 +65,14 @@ struct _DlbLightBaseSink {
 /**
  * DlbLightBaseSinkClass:
  * @parent_class: the parent class.
+ * @show_frame: render a light frame to the device. Called from the streaming
+ *     thread, or from the device thread when
+ *     #DlbLightBaseSink:async-device-write is enabled.
+ * @show_list: optional, render a whole list of light frames at once, e.g.
+ *     with a single write. Only called from the streaming thread, for the
+ *     buffer lists that need no per-frame timing: when #GstBaseSink:sync is
+ *     %FALSE and #DlbLightBaseSink:async-device-write is disabled. Otherwise
+ *     every frame of a list is rendered with @show_frame.
  *
  * #DlbLightBaseSink class. Override the vmethod to implement
  * functionality.
@@ -72,9 +81,10 @@ struct _DlbLightBaseSinkClass {
   GstBaseSinkClass     parent_class;
 
   GstFlowReturn  (*show_frame) (DlbLightBaseSink *light_sink, GstBuffer *buf);
+  GstFlowReturn  (*show_list)  (DlbLightBaseSink *light_sink, GstBufferList *list);
 
   /*< private >*/
-  gpointer _gst_reserved[GST_PADDING];
+  gpointer _gst_reserved[GST_PADDING - 1];
 };
 
 #define DLB_LIGHT_API GST_API_EXPORT
@@ -0,0 +1,636 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightdemux
+ *
+ * Splits rendered light frames into one stream per light strip, so every
+ * fixture can be driven by its own sink, queue and thread. Strips can be
+ * bundled on a single pad with the #DlbLightDemux:groups property, e.g.
+ * `{"front": [1, 2], "rear": [3]}` creates the pads group_front and
+ * group_rear, while strips not listed get a strip_%u pad each.
+ *
+ * Output buffers are valid application/x-lights frames. Only the two byte
+ * strip count is newly allocated, the strip headers and payload share the
+ * memory of the input frame.
+ *
+ * The pads are created for the strips of the first valid frame, after which
+ * no-more-pads is signalled. Strips first appearing in a later frame are
+ * dropped unless their group already has a pad. Pads without data in a
+ * frame get a GAP event for its duration instead.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightdemux.h"
+#include "dlblightmeta.h"
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_demux_debug_category);
+#define GST_CAT_DEFAULT dlb_light_demux_debug_category
+
+enum
+{
+  PROP_0,
+  PROP_GROUPS,
+};
+
+typedef struct
+{
+  gsize offset;
+  gsize size;
+  guint16 num_strips;
+} DlbLightDemuxRange;
+
+static GstStaticPadTemplate dlb_light_demux_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+static GstStaticPadTemplate dlb_light_demux_strip_template =
+    GST_STATIC_PAD_TEMPLATE ("strip_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+static GstStaticPadTemplate dlb_light_demux_group_template =
+    GST_STATIC_PAD_TEMPLATE ("group_%s",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+/* class initialization */
+G_DEFINE_TYPE_WITH_CODE (DlbLightDemux, dlb_light_demux, GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_demux_debug_category, "dlblightdemux", 0,
+        "debug category for dlb_light_demux element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightdemux, "dlblightdemux", GST_RANK_NONE,
+                             DLB_TYPE_LIGHT_DEMUX);
+
+static void dlb_light_demux_finalize (GObject * object);
+static void dlb_light_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void dlb_light_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn dlb_light_demux_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean dlb_light_demux_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static GstFlowReturn dlb_light_demux_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf);
+
+static void
+dlb_light_demux_class_init (DlbLightDemuxClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_demux_finalize;
+  gobject_class->set_property = dlb_light_demux_set_property;
+  gobject_class->get_property = dlb_light_demux_get_property;
+
+  /**
+   * DlbLightDemux:groups:
+   *
+   * JSON object mapping group names to arrays of strip ids. All strips of a
+   * group are pushed together on the group_<name> pad.
+   */
+  g_object_class_install_property (gobject_class, PROP_GROUPS,
+      g_param_spec_string ("groups", "Strip groups",
+          "JSON object mapping group names to arrays of strip ids", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Dolby Light Strip Demuxer",
+      "Demuxer/Light",
+      "Split rendered light frames into per-strip streams",
+      "Dolby Support <support@dolby.com>");
+
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_demux_sink_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_demux_strip_template);
+  gst_element_class_add_static_pad_template (element_class,
+      &dlb_light_demux_group_template);
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (dlb_light_demux_change_state);
+}
+
+static void
+dlb_light_demux_init (DlbLightDemux * demux)
+{
+  demux->sinkpad = gst_pad_new_from_static_template (&dlb_light_demux_sink_template, "sink");
+  gst_pad_set_chain_function (demux->sinkpad, GST_DEBUG_FUNCPTR (dlb_light_demux_chain));
+  gst_pad_set_event_function (demux->sinkpad, GST_DEBUG_FUNCPTR (dlb_light_demux_sink_event));
+  gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
+
+  demux->flowcombiner = gst_flow_combiner_new ();
+  demux->groups = NULL;
+  demux->streams = NULL;
+  demux->pads_announced = FALSE;
+}
+
+static void
+dlb_light_demux_clear_groups (DlbLightDemux * demux)
+{
+  for (guint i = 0; i < DLB_LIGHT_DEMUX_MAX_STRIPS; i++)
+    g_clear_pointer (&demux->group_of_strip[i], g_free);
+}
+
+static void
+dlb_light_demux_finalize (GObject * object)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (object);
+
+  dlb_light_demux_clear_groups (demux);
+  gst_flow_combiner_free (demux->flowcombiner);
+  g_free (demux->groups);
+
+  G_OBJECT_CLASS (dlb_light_demux_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_GROUPS:
+      GST_OBJECT_LOCK (demux);
+      g_free (demux->groups);
+      demux->groups = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_GROUPS:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_string (value, demux->groups);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+dlb_light_demux_is_valid_group_name (const gchar * name)
+{
+  if (name == NULL || *name == '\0')
+    return FALSE;
+
+  for (const gchar * c = name; *c; c++) {
+    if (!g_ascii_isalnum (*c) && *c != '-' && *c != '_')
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+dlb_light_demux_parse_groups (DlbLightDemux * demux)
+{
+  JsonParser *parser;
+  JsonNode *root;
+  JsonObject *object;
+  GList *members;
+  GError *error = NULL;
+  gchar *groups;
+  gboolean ret = TRUE;
+
+  dlb_light_demux_clear_groups (demux);
+
+  GST_OBJECT_LOCK (demux);
+  groups = g_strdup (demux->groups);
+  GST_OBJECT_UNLOCK (demux);
+
+  if (groups == NULL)
+    return TRUE;
+
+  parser = json_parser_new ();
+  if (!json_parser_load_from_data (parser, groups, -1, &error)) {
+    GST_ELEMENT_ERROR (demux, RESOURCE, SETTINGS, (NULL),
+        ("Could not parse strip groups: %s", error->message));
+    g_clear_error (&error);
+    ret = FALSE;
+    goto done;
+  }
+
+  root = json_parser_get_root (parser);
+  if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root)) {
+    GST_ELEMENT_ERROR (demux, RESOURCE, SETTINGS, (NULL),
+        ("Strip groups must be a JSON object"));
+    ret = FALSE;
+    goto done;
+  }
+
+  object = json_node_get_object (root);
+  members = json_object_get_members (object);
+
+  for (GList * l = members; l != NULL && ret; l = l->next) {
+    const gchar *name = l->data;
+    JsonNode *node = json_object_get_member (object, name);
+    JsonArray *ids;
+
+    if (!dlb_light_demux_is_valid_group_name (name) || !JSON_NODE_HOLDS_ARRAY (node)) {
+      GST_ELEMENT_ERROR (demux, RESOURCE, SETTINGS, (NULL),
+          ("Invalid strip group '%s'", name));
+      ret = FALSE;
+      break;
+    }
+
+    ids = json_node_get_array (node);
+    for (guint i = 0; i < json_array_get_length (ids); i++) {
+      gint64 id = json_array_get_int_element (ids, i);
+
+      if (id < 0 || id >= DLB_LIGHT_DEMUX_MAX_STRIPS || demux->group_of_strip[id] != NULL) {
+        GST_ELEMENT_ERROR (demux, RESOURCE, SETTINGS, (NULL),
+            ("Invalid or duplicate strip id %" G_GINT64_FORMAT " in group '%s'",
+                id, name));
+        ret = FALSE;
+        break;
+      }
+      demux->group_of_strip[id] = g_strdup (name);
+      GST_DEBUG_OBJECT (demux, "strip %" G_GINT64_FORMAT " in group %s", id, name);
+    }
+  }
+
+  g_list_free (members);
+
+done:
+  g_object_unref (parser);
+  g_free (groups);
+
+  if (!ret)
+    dlb_light_demux_clear_groups (demux);
+
+  return ret;
+}
+
+typedef struct
+{
+  DlbLightDemux *demux;
+  DlbLightDemuxStream *stream;
+} DlbLightDemuxStickyData;
+
+static gboolean
+dlb_light_demux_forward_sticky (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  DlbLightDemuxStickyData *data = user_data;
+  DlbLightDemuxStream *stream = data->stream;
+
+  if (GST_EVENT_TYPE (*event) == GST_EVENT_STREAM_START) {
+    GstEvent *ev;
+    gchar *stream_id;
+    guint group_id;
+
+    /* every output pad needs its own stream id */
+    stream_id = gst_pad_create_stream_id (stream->pad, GST_ELEMENT_CAST (data->demux),
+        stream->name);
+    ev = gst_event_new_stream_start (stream_id);
+    if (gst_event_parse_group_id (*event, &group_id))
+      gst_event_set_group_id (ev, group_id);
+    gst_pad_push_event (stream->pad, ev);
+    g_free (stream_id);
+  } else {
+    gst_pad_push_event (stream->pad, gst_event_ref (*event));
+  }
+
+  return TRUE;
+}
+
+static DlbLightDemuxStream *
+dlb_light_demux_get_stream (DlbLightDemux * demux, guint8 strip_id)
+{
+  DlbLightDemuxStickyData sticky;
+  DlbLightDemuxStream *stream = demux->stream_of_strip[strip_id];
+  const gchar *group = demux->group_of_strip[strip_id];
+  GstPadTemplate *templ;
+  gchar *padname;
+
+  if (stream != NULL)
+    return stream;
+
+  /* another strip of the same group may have created the pad already */
+  for (GList * l = demux->streams; group && l != NULL; l = l->next) {
+    DlbLightDemuxStream *other = l->data;
+    if (g_strcmp0 (other->name, group) == 0) {
+      demux->stream_of_strip[strip_id] = other;
+      return other;
+    }
+  }
+
+  if (demux->pads_announced) {
+    if (!demux->strip_ignored[strip_id]) {
+      GST_WARNING_OBJECT (demux, "dropping strip %u, not in the first frame",
+          strip_id);
+      demux->strip_ignored[strip_id] = TRUE;
+    }
+    return NULL;
+  }
+
+  if (group) {
+    templ = gst_static_pad_template_get (&dlb_light_demux_group_template);
+    padname = g_strdup_printf ("group_%s", group);
+  } else {
+    templ = gst_static_pad_template_get (&dlb_light_demux_strip_template);
+    padname = g_strdup_printf ("strip_%u", strip_id);
+  }
+
+  stream = g_new0 (DlbLightDemuxStream, 1);
+  stream->ranges = g_array_new (FALSE, FALSE, sizeof (DlbLightDemuxRange));
+  stream->name = group ? g_strdup (group) : g_strdup_printf ("%u", strip_id);
+  stream->pad = gst_pad_new_from_template (templ, padname);
+  gst_object_unref (templ);
+  g_free (padname);
+
+  GST_DEBUG_OBJECT (demux, "creating pad %s:%s", GST_DEBUG_PAD_NAME (stream->pad));
+
+  gst_pad_use_fixed_caps (stream->pad);
+  gst_pad_set_active (stream->pad, TRUE);
+
+  sticky.demux = demux;
+  sticky.stream = stream;
+  gst_pad_sticky_events_foreach (demux->sinkpad, dlb_light_demux_forward_sticky, &sticky);
+
+  gst_element_add_pad (GST_ELEMENT_CAST (demux), stream->pad);
+  gst_flow_combiner_add_pad (demux->flowcombiner, stream->pad);
+
+  demux->streams = g_list_append (demux->streams, stream);
+  demux->stream_of_strip[strip_id] = stream;
+
+  return stream;
+}
+
+static void
+dlb_light_demux_remove_streams (DlbLightDemux * demux)
+{
+  for (GList * l = demux->streams; l != NULL; l = l->next) {
+    DlbLightDemuxStream *stream = l->data;
+
+    gst_flow_combiner_remove_pad (demux->flowcombiner, stream->pad);
+    gst_pad_set_active (stream->pad, FALSE);
+    gst_element_remove_pad (GST_ELEMENT_CAST (demux), stream->pad);
+    g_array_free (stream->ranges, TRUE);
+    g_free (stream->name);
+    g_free (stream);
+  }
+
+  g_list_free (demux->streams);
+  demux->streams = NULL;
+  memset (demux->stream_of_strip, 0, sizeof (demux->stream_of_strip));
+  demux->pads_announced = FALSE;
+  memset (demux->strip_ignored, 0, sizeof (demux->strip_ignored));
+}
+
+/* Assign a strip to its output stream, merging it with the previous strip
+ * of that stream when the two are adjacent in the input. */
+static void
+dlb_light_demux_add_strip (DlbLightDemux * demux, const DlbLightStrip * strip)
+{
+  DlbLightDemuxStream *stream;
+  DlbLightDemuxRange *last;
+  gsize end = strip->offset + strip->size;
+
+  stream = dlb_light_demux_get_stream (demux, strip->strip_id);
+  if (stream == NULL)
+    return;
+
+  last = stream->ranges->len ?
+      &g_array_index (stream->ranges, DlbLightDemuxRange, stream->ranges->len - 1) : NULL;
+
+  if (last && last->offset + last->size == strip->header_offset) {
+    last->size = end - last->offset;
+    last->num_strips++;
+  } else {
+    DlbLightDemuxRange range;
+
+    range.offset = strip->header_offset;
+    range.size = end - strip->header_offset;
+    range.num_strips = 1;
+    g_array_append_val (stream->ranges, range);
+  }
+}
+
+static gboolean
+dlb_light_demux_collect (DlbLightDemux * demux, GstBuffer * buf)
+{
+  DlbLightLayoutMeta *meta;
+  DlbLightLayoutReader reader;
+  DlbLightStrip strip;
+  GstMapInfo map;
+
+  /* the renderer's strip table saves walking the frame */
+  meta = dlb_buffer_get_light_layout_meta (buf);
+  if (meta && meta->layout->frame_size == gst_buffer_get_size (buf)) {
+    for (guint i = 0; i < meta->layout->num_strips; i++)
+      dlb_light_demux_add_strip (demux, &meta->layout->strips[i]);
+    return TRUE;
+  }
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ)) {
+    GST_WARNING_OBJECT (demux, "could not map input buffer");
+    return FALSE;
+  }
+
+  /* the whole frame is checked before any pad is created for it */
+  if (!dlb_light_layout_reader_init (&reader, map.data, map.size)) {
+    gst_buffer_unmap (buf, &map);
+    return FALSE;
+  }
+
+  while (dlb_light_layout_reader_next (&reader, &strip));
+  if (!dlb_light_layout_reader_is_complete (&reader)) {
+    gst_buffer_unmap (buf, &map);
+    return FALSE;
+  }
+
+  dlb_light_layout_reader_init (&reader, map.data, map.size);
+  while (dlb_light_layout_reader_next (&reader, &strip))
+    dlb_light_demux_add_strip (demux, &strip);
+  gst_buffer_unmap (buf, &map);
+
+  return TRUE;
+}
+
+/* Keeps downstream of a pad without data in this frame from waiting. */
+static void
+dlb_light_demux_push_gap (DlbLightDemux * demux, DlbLightDemuxStream * stream,
+    GstBuffer * inbuf)
+{
+  if (!GST_BUFFER_PTS_IS_VALID (inbuf))
+    return;
+
+  gst_pad_push_event (stream->pad, gst_event_new_gap (GST_BUFFER_PTS (inbuf),
+          GST_BUFFER_DURATION (inbuf)));
+}
+
+static GstFlowReturn
+dlb_light_demux_push_stream (DlbLightDemux * demux, DlbLightDemuxStream * stream,
+    GstBuffer * inbuf)
+{
+  GstBuffer *outbuf;
+  guint16 num_strips = 0;
+  guint8 header[2];
+
+  for (guint i = 0; i < stream->ranges->len; i++)
+    num_strips += g_array_index (stream->ranges, DlbLightDemuxRange, i).num_strips;
+
+  GST_WRITE_UINT16_LE (header, num_strips);
+  outbuf = gst_buffer_new_allocate (NULL, sizeof (header), NULL);
+  gst_buffer_fill (outbuf, 0, header, sizeof (header));
+  gst_buffer_copy_into (outbuf, inbuf,
+      GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+
+  for (guint i = 0; i < stream->ranges->len; i++) {
+    DlbLightDemuxRange *range = &g_array_index (stream->ranges, DlbLightDemuxRange, i);
+
+    outbuf = gst_buffer_append (outbuf, gst_buffer_copy_region (inbuf,
+            GST_BUFFER_COPY_MEMORY, range->offset, range->size));
+  }
+  g_array_set_size (stream->ranges, 0);
+
+  return gst_pad_push (stream->pad, outbuf);
+}
+
+static GstFlowReturn
+dlb_light_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (parent);
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean valid;
+
+  valid = dlb_light_demux_collect (demux, buf);
+
+  if (valid && !demux->pads_announced && demux->streams) {
+    gst_element_no_more_pads (GST_ELEMENT_CAST (demux));
+    demux->pads_announced = TRUE;
+  }
+
+  for (GList * l = demux->streams; l != NULL; l = l->next) {
+    DlbLightDemuxStream *stream = l->data;
+
+    if (!valid || stream->ranges->len == 0) {
+      g_array_set_size (stream->ranges, 0);
+      dlb_light_demux_push_gap (demux, stream, buf);
+      continue;
+    }
+
+    ret = dlb_light_demux_push_stream (demux, stream, buf);
+    ret = gst_flow_combiner_update_pad_flow (demux->flowcombiner, stream->pad, ret);
+  }
+
+  if (!valid)
+    GST_WARNING_OBJECT (demux, "dropping malformed light frame ts=%" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+
+  gst_buffer_unref (buf);
+  return ret;
+}
+
+static gboolean
+dlb_light_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (parent);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:{
+      DlbLightDemuxStickyData sticky;
+
+      sticky.demux = demux;
+      for (GList * l = demux->streams; l != NULL; l = l->next) {
+        sticky.stream = l->data;
+        dlb_light_demux_forward_sticky (pad, &event, &sticky);
+      }
+      gst_event_unref (event);
+      return TRUE;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      gst_flow_combiner_reset (demux->flowcombiner);
+      break;
+    case GST_EVENT_EOS:
+      if (demux->streams == NULL)
+        GST_ELEMENT_ERROR (demux, STREAM, DEMUX, (NULL),
+            ("No light strips found before end of stream"));
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstStateChangeReturn
+dlb_light_demux_change_state (GstElement * element, GstStateChange transition)
+{
+  DlbLightDemux *demux = DLB_LIGHT_DEMUX (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    if (!dlb_light_demux_parse_groups (demux))
+      return GST_STATE_CHANGE_FAILURE;
+    gst_flow_combiner_reset (demux->flowcombiner);
+  }
+
+  ret = GST_ELEMENT_CLASS (dlb_light_demux_parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    dlb_light_demux_remove_streams (demux);
+
+  return ret;
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightdemux, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightdemux,
+    "Dolby Light Strip Demuxer",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -0,0 +1,82 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_DEMUX_H_
+#define _DLB_LIGHT_DEMUX_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+
+G_BEGIN_DECLS
+
+#define DLB_TYPE_LIGHT_DEMUX \
+  (dlb_light_demux_get_type())
+#define DLB_LIGHT_DEMUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_DEMUX, DlbLightDemux))
+#define DLB_LIGHT_DEMUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_DEMUX, DlbLightDemuxClass))
+#define DLB_IS_LIGHT_DEMUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_DEMUX))
+#define DLB_IS_LIGHT_DEMUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), DLB_TYPE_LIGHT_DEMUX))
+
+#define DLB_LIGHT_DEMUX_MAX_STRIPS (256)
+
+typedef struct _DlbLightDemux DlbLightDemux;
+typedef struct _DlbLightDemuxClass DlbLightDemuxClass;
+typedef struct _DlbLightDemuxStream DlbLightDemuxStream;
+
+struct _DlbLightDemuxStream {
+  GstPad *pad;
+  gchar *name;
+
+  /* regions of the current input frame going to this pad */
+  GArray *ranges;
+};
+
+struct _DlbLightDemux {
+  GstElement element;
+
+  GstPad *sinkpad;
+  GstFlowCombiner *flowcombiner;
+
+  /* JSON group definition, protected by OBJECT_LOCK */
+  gchar *groups;
+
+  /* strip id -> group name, built from groups on start */
+  gchar *group_of_strip[DLB_LIGHT_DEMUX_MAX_STRIPS];
+
+  /* strip id -> output stream, streaming thread only */
+  DlbLightDemuxStream *stream_of_strip[DLB_LIGHT_DEMUX_MAX_STRIPS];
+  GList *streams;
+  gboolean pads_announced;
+  /* strips first seen after no-more-pads, dropped */
+  gboolean strip_ignored[DLB_LIGHT_DEMUX_MAX_STRIPS];
+};
+
+struct _DlbLightDemuxClass {
+  GstElementClass parent_class;
+};
+
+GType dlb_light_demux_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightdemux);
+G_END_DECLS
+
+#endif // _DLB_LIGHT_DEMUX_H_
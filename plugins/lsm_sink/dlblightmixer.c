@@ -0,0 +1,759 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/**
+ * SECTION:element-dlblightmixer
+ *
+ * Mixes several streams of rendered light frames into one, for example a
+ * content track with the house lights, or an override from show control on
+ * top of both. All inputs must have the same strip layout, frames that do
+ * not match the layout of the bottom layer are left out.
+ *
+ * Inputs are synchronized by running time and one frame is produced per
+ * #DlbLightMixer:frame-period. Each input holds its last frame until a newer
+ * one starts, so sparse inputs and inputs sending GAP events keep their
+ * lights up. The frames are layered by the #DlbLightMixerPad:priority of
+ * their pads, lowest first, and blended onto the layers below with the
+ * pad's #DlbLightMixerPad:blend mode and #DlbLightMixerPad:alpha. Alpha
+ * changes are faded in over #DlbLightMixerPad:fade-duration.
+ *
+ * ## Example launch line
+ * |[
+ * gst-launch-1.0 dlblightmixer name=mix ! dlblighttextsink \
+ *     filesrc location=content.lsm ! dlblsmparse ! dlblightning ! mix. \
+ *     filesrc location=house.lsm ! dlblsmparse ! dlblightning ! mix.
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "dlblightmixer.h"
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (dlb_light_mixer_debug_category);
+#define GST_CAT_DEFAULT dlb_light_mixer_debug_category
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_PRIORITY,
+  PROP_PAD_BLEND,
+  PROP_PAD_ALPHA,
+  PROP_PAD_FADE_DURATION,
+};
+
+enum
+{
+  PROP_0,
+  PROP_FRAME_PERIOD,
+};
+
+#define DEFAULT_PAD_PRIORITY 0
+#define DEFAULT_PAD_BLEND DLB_LIGHT_BLEND_ALPHA
+#define DEFAULT_PAD_ALPHA 1.0
+#define DEFAULT_PAD_FADE_DURATION 0
+#define DEFAULT_FRAME_PERIOD_US 40000
+
+/* one input of an output frame, taken under the element lock */
+typedef struct
+{
+  DlbLightMixerPad *pad;
+  GstBuffer *frame;
+  guint priority;
+  guint index;
+  DlbLightBlendMode blend;
+  guint alpha;
+} DlbLightMixerLayer;
+
+static GstStaticPadTemplate dlb_light_mixer_sink_template =
+    GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+static GstStaticPadTemplate dlb_light_mixer_src_template =
+    GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-lights, "
+                     " format = (string) { DLB }; ")
+    );
+
+/* pad */
+G_DEFINE_TYPE (DlbLightMixerPad, dlb_light_mixer_pad, GST_TYPE_AGGREGATOR_PAD);
+
+static void
+dlb_light_mixer_pad_reset (DlbLightMixerPad * pad)
+{
+  gst_clear_buffer (&pad->current);
+  pad->current_end = GST_CLOCK_TIME_NONE;
+  pad->seen_end = GST_CLOCK_TIME_NONE;
+  pad->fade_start = GST_CLOCK_TIME_NONE;
+  pad->layout_warned = FALSE;
+}
+
+static void
+dlb_light_mixer_pad_finalize (GObject * object)
+{
+  dlb_light_mixer_pad_reset (DLB_LIGHT_MIXER_PAD (object));
+
+  G_OBJECT_CLASS (dlb_light_mixer_pad_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_mixer_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightMixerPad *pad = DLB_LIGHT_MIXER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (prop_id) {
+    case PROP_PAD_PRIORITY:
+      pad->priority = g_value_get_uint (value);
+      break;
+    case PROP_PAD_BLEND:
+      pad->blend = g_value_get_enum (value);
+      break;
+    case PROP_PAD_ALPHA:
+      pad->alpha = g_value_get_double (value);
+      break;
+    case PROP_PAD_FADE_DURATION:
+      pad->fade_duration = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+dlb_light_mixer_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightMixerPad *pad = DLB_LIGHT_MIXER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (prop_id) {
+    case PROP_PAD_PRIORITY:
+      g_value_set_uint (value, pad->priority);
+      break;
+    case PROP_PAD_BLEND:
+      g_value_set_enum (value, pad->blend);
+      break;
+    case PROP_PAD_ALPHA:
+      g_value_set_double (value, pad->alpha);
+      break;
+    case PROP_PAD_FADE_DURATION:
+      g_value_set_uint64 (value, pad->fade_duration);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static GstFlowReturn
+dlb_light_mixer_pad_flush (GstAggregatorPad * aggpad, GstAggregator * agg)
+{
+  dlb_light_mixer_pad_reset (DLB_LIGHT_MIXER_PAD (aggpad));
+
+  return GST_FLOW_OK;
+}
+
+static void
+dlb_light_mixer_pad_class_init (DlbLightMixerPadClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstAggregatorPadClass *aggpad_class = GST_AGGREGATOR_PAD_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_mixer_pad_finalize;
+  gobject_class->set_property = dlb_light_mixer_pad_set_property;
+  gobject_class->get_property = dlb_light_mixer_pad_get_property;
+
+  aggpad_class->flush = GST_DEBUG_FUNCPTR (dlb_light_mixer_pad_flush);
+
+  /**
+   * DlbLightMixerPad:priority:
+   *
+   * Layer of the input, higher priorities are blended on top of lower
+   * ones. Pads with the same priority are layered in the order they were
+   * requested.
+   */
+  g_object_class_install_property (gobject_class, PROP_PAD_PRIORITY,
+      g_param_spec_uint ("priority", "Priority",
+          "Layer of the input, higher priorities are blended on top",
+          0, G_MAXUINT, DEFAULT_PAD_PRIORITY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightMixerPad:blend:
+   *
+   * How the lights of the input are combined with the layers below.
+   */
+  g_object_class_install_property (gobject_class, PROP_PAD_BLEND,
+      g_param_spec_enum ("blend", "Blend mode",
+          "How the lights are combined with the layers below",
+          DLB_TYPE_LIGHT_BLEND_MODE, DEFAULT_PAD_BLEND,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightMixerPad:alpha:
+   *
+   * Opacity of the input. Can be driven by a #GstControlSource for
+   * cues, or changed directly with a #DlbLightMixerPad:fade-duration.
+   */
+  g_object_class_install_property (gobject_class, PROP_PAD_ALPHA,
+      g_param_spec_double ("alpha", "Alpha", "Opacity of the input",
+          0.0, 1.0, DEFAULT_PAD_ALPHA,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_CONTROLLABLE | GST_PARAM_MUTABLE_PLAYING));
+
+  /**
+   * DlbLightMixerPad:fade-duration:
+   *
+   * Time over which a change of #DlbLightMixerPad:alpha is faded in, in
+   * running time. 0 applies changes with the next frame.
+   */
+  g_object_class_install_property (gobject_class, PROP_PAD_FADE_DURATION,
+      g_param_spec_uint64 ("fade-duration", "Fade duration",
+          "Time over which alpha changes are faded in (0 = at once)",
+          0, G_MAXUINT64, DEFAULT_PAD_FADE_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+}
+
+static void
+dlb_light_mixer_pad_init (DlbLightMixerPad * pad)
+{
+  pad->priority = DEFAULT_PAD_PRIORITY;
+  pad->blend = DEFAULT_PAD_BLEND;
+  pad->alpha = DEFAULT_PAD_ALPHA;
+  pad->fade_duration = DEFAULT_PAD_FADE_DURATION;
+
+  pad->current = NULL;
+  pad->level = DEFAULT_PAD_ALPHA;
+  pad->fade_from = DEFAULT_PAD_ALPHA;
+  pad->fade_to = DEFAULT_PAD_ALPHA;
+  dlb_light_mixer_pad_reset (pad);
+}
+
+/* Takes the queued frames that start before @end, the newest becoming the
+ * current frame. Frames and gaps lasting past @end stay queued for the next
+ * output frame, which also keeps the pad from looking starved. Returns
+ * whether a frame starting before @end may still arrive. */
+static gboolean
+dlb_light_mixer_pad_update (DlbLightMixerPad * pad, GstClockTime start,
+    GstClockTime end, GstClockTime frame_period)
+{
+  GstAggregatorPad *aggpad = GST_AGGREGATOR_PAD (pad);
+  GstBuffer *buf;
+
+  while ((buf = gst_aggregator_pad_peek_buffer (aggpad))) {
+    GstClockTime pts = GST_BUFFER_PTS (buf);
+    GstClockTime buf_start, buf_end = GST_CLOCK_TIME_NONE;
+
+    buf_start = gst_segment_to_running_time (&aggpad->segment,
+        GST_FORMAT_TIME, pts);
+    if (!GST_CLOCK_TIME_IS_VALID (buf_start)) {
+      GST_LOG_OBJECT (pad, "dropping untimed or clipped %" GST_PTR_FORMAT, buf);
+      gst_aggregator_pad_drop_buffer (aggpad);
+      gst_buffer_unref (buf);
+      continue;
+    }
+
+    if (buf_start >= end) {
+      /* for a later output frame, nothing else can come before it */
+      gst_buffer_unref (buf);
+      return FALSE;
+    }
+
+    if (GST_BUFFER_DURATION_IS_VALID (buf))
+      buf_end = gst_segment_to_running_time (&aggpad->segment,
+          GST_FORMAT_TIME, pts + GST_BUFFER_DURATION (buf));
+    if (!GST_CLOCK_TIME_IS_VALID (buf_end))
+      buf_end = buf_start + frame_period;
+
+    /* GAP events are queued as empty buffers, the lights stay as they are */
+    if (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_GAP) ||
+        gst_buffer_get_size (buf) > 0) {
+      gst_buffer_replace (&pad->current, buf);
+      pad->current_end = buf_end;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID (pad->seen_end) || buf_end > pad->seen_end)
+      pad->seen_end = buf_end;
+
+    if (buf_end > end) {
+      gst_buffer_unref (buf);
+      return FALSE;
+    }
+
+    gst_aggregator_pad_drop_buffer (aggpad);
+    gst_buffer_unref (buf);
+  }
+
+  if (gst_aggregator_pad_is_eos (aggpad)) {
+    /* the last frame is shown until it ends */
+    if (pad->current && pad->current_end <= start)
+      gst_clear_buffer (&pad->current);
+    return FALSE;
+  }
+
+  return !GST_CLOCK_TIME_IS_VALID (pad->seen_end) || pad->seen_end < end;
+}
+
+/* The alpha applied at @now, following changes of the alpha property over
+ * the fade duration. Starts at the alpha property without a fade. */
+static guint
+dlb_light_mixer_pad_get_alpha (DlbLightMixerPad * pad, gdouble alpha,
+    GstClockTime fade_duration, GstClockTime now)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (pad->fade_start)) {
+    pad->level = pad->fade_from = pad->fade_to = alpha;
+    pad->fade_start = now;
+  } else if (alpha != pad->fade_to) {
+    GST_DEBUG_OBJECT (pad, "fading from %f to %f", pad->level, alpha);
+    pad->fade_from = pad->level;
+    pad->fade_to = alpha;
+    pad->fade_start = now;
+  }
+
+  if (fade_duration == 0 || now >= pad->fade_start + fade_duration)
+    pad->level = pad->fade_to;
+  else
+    pad->level = pad->fade_from + (pad->fade_to - pad->fade_from) *
+        (now - pad->fade_start) / (gdouble) fade_duration;
+
+  return (guint) (pad->level * DLB_LIGHT_BLEND_ALPHA_OPAQUE + 0.5);
+}
+
+/* mixer */
+G_DEFINE_TYPE_WITH_CODE (DlbLightMixer, dlb_light_mixer, GST_TYPE_AGGREGATOR,
+    GST_DEBUG_CATEGORY_INIT (dlb_light_mixer_debug_category, "dlblightmixer", 0,
+        "debug category for dlb_light_mixer element"));
+GST_ELEMENT_REGISTER_DEFINE (dlblightmixer, "dlblightmixer", GST_RANK_NONE,
+                             DLB_TYPE_LIGHT_MIXER);
+
+static void dlb_light_mixer_finalize (GObject * object);
+static void dlb_light_mixer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void dlb_light_mixer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static gboolean dlb_light_mixer_start (GstAggregator * agg);
+static gboolean dlb_light_mixer_stop (GstAggregator * agg);
+static GstFlowReturn dlb_light_mixer_aggregate (GstAggregator * agg,
+    gboolean timeout);
+
+static void
+dlb_light_mixer_class_init (DlbLightMixerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstAggregatorClass *agg_class = GST_AGGREGATOR_CLASS (klass);
+
+  gobject_class->finalize = dlb_light_mixer_finalize;
+  gobject_class->set_property = dlb_light_mixer_set_property;
+  gobject_class->get_property = dlb_light_mixer_get_property;
+
+  /**
+   * DlbLightMixer:frame-period:
+   *
+   * Period of the output frames in microseconds, normally the frame period
+   * of the inputs.
+   */
+  g_object_class_install_property (gobject_class, PROP_FRAME_PERIOD,
+      g_param_spec_uint ("frame-period", "Frame period",
+          "Period of the output frames in microseconds",
+          1000, 1000000, DEFAULT_FRAME_PERIOD_US,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Dolby Light Mixer",
+      "Mixer/Light",
+      "Blend rendered light streams with priorities and fades",
+      "Dolby Support <support@dolby.com>");
+
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &dlb_light_mixer_sink_template, DLB_TYPE_LIGHT_MIXER_PAD);
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &dlb_light_mixer_src_template, GST_TYPE_AGGREGATOR_PAD);
+
+  agg_class->start = GST_DEBUG_FUNCPTR (dlb_light_mixer_start);
+  agg_class->stop = GST_DEBUG_FUNCPTR (dlb_light_mixer_stop);
+  agg_class->aggregate = GST_DEBUG_FUNCPTR (dlb_light_mixer_aggregate);
+  agg_class->get_next_time = gst_aggregator_simple_get_next_time;
+}
+
+static void
+dlb_light_mixer_init (DlbLightMixer * mixer)
+{
+  mixer->frame_period_us = DEFAULT_FRAME_PERIOD_US;
+  mixer->frame_period = DEFAULT_FRAME_PERIOD_US * GST_USECOND;
+  mixer->layout = NULL;
+  mixer->layers = g_array_new (FALSE, FALSE, sizeof (DlbLightMixerLayer));
+}
+
+static void
+dlb_light_mixer_finalize (GObject * object)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (object);
+
+  g_clear_pointer (&mixer->layout, dlb_light_layout_unref);
+  g_array_free (mixer->layers, TRUE);
+
+  G_OBJECT_CLASS (dlb_light_mixer_parent_class)->finalize (object);
+}
+
+static void
+dlb_light_mixer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (object);
+
+  switch (prop_id) {
+    case PROP_FRAME_PERIOD:
+      GST_OBJECT_LOCK (mixer);
+      mixer->frame_period_us = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (mixer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+dlb_light_mixer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (object);
+
+  switch (prop_id) {
+    case PROP_FRAME_PERIOD:
+      GST_OBJECT_LOCK (mixer);
+      g_value_set_uint (value, mixer->frame_period_us);
+      GST_OBJECT_UNLOCK (mixer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+dlb_light_mixer_reset_pad (GstElement * element, GstPad * pad,
+    gpointer user_data)
+{
+  dlb_light_mixer_pad_reset (DLB_LIGHT_MIXER_PAD (pad));
+
+  return TRUE;
+}
+
+static gboolean
+dlb_light_mixer_start (GstAggregator * agg)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (agg);
+
+  GST_OBJECT_LOCK (mixer);
+  mixer->frame_period = mixer->frame_period_us * GST_USECOND;
+  GST_OBJECT_UNLOCK (mixer);
+
+  /* a frame needs the inputs starting within its period */
+  gst_aggregator_set_latency (agg, mixer->frame_period, mixer->frame_period);
+
+  return TRUE;
+}
+
+static gboolean
+dlb_light_mixer_stop (GstAggregator * agg)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (agg);
+
+  gst_element_foreach_sink_pad (GST_ELEMENT_CAST (agg),
+      dlb_light_mixer_reset_pad, NULL);
+  g_clear_pointer (&mixer->layout, dlb_light_layout_unref);
+
+  return TRUE;
+}
+
+static gint
+dlb_light_mixer_compare_layers (gconstpointer a, gconstpointer b)
+{
+  const DlbLightMixerLayer *la = a, *lb = b;
+
+  if (la->priority != lb->priority)
+    return la->priority < lb->priority ? -1 : 1;
+
+  return la->index < lb->index ? -1 : la->index > lb->index;
+}
+
+/* Updates the pads for the output frame from @start to @end and collects
+ * the layers to blend, bottom first. Returns the flow to end the frame
+ * with, or GST_FLOW_OK to mix it. */
+static GstFlowReturn
+dlb_light_mixer_collect (DlbLightMixer * mixer, GstClockTime start,
+    GstClockTime end, GstClockTime stream_time, gboolean timeout)
+{
+  gboolean need_data = FALSE;
+  gboolean all_eos = TRUE;
+  guint index = 0;
+
+  GST_OBJECT_LOCK (mixer);
+  for (GList * l = GST_ELEMENT_CAST (mixer)->sinkpads; l; l = l->next, index++) {
+    DlbLightMixerPad *pad = l->data;
+    DlbLightMixerLayer layer;
+    GstClockTime fade_duration;
+    gdouble alpha;
+
+    if (dlb_light_mixer_pad_update (pad, start, end, mixer->frame_period))
+      need_data = TRUE;
+    if (!gst_aggregator_pad_is_eos (GST_AGGREGATOR_PAD (pad)))
+      all_eos = FALSE;
+
+    if (GST_CLOCK_TIME_IS_VALID (stream_time))
+      gst_object_sync_values (GST_OBJECT_CAST (pad), stream_time);
+
+    GST_OBJECT_LOCK (pad);
+    layer.priority = pad->priority;
+    layer.blend = pad->blend;
+    alpha = pad->alpha;
+    fade_duration = pad->fade_duration;
+    GST_OBJECT_UNLOCK (pad);
+
+    layer.alpha = dlb_light_mixer_pad_get_alpha (pad, alpha, fade_duration,
+        start);
+    if (pad->current == NULL || layer.alpha == 0)
+      continue;
+
+    layer.pad = gst_object_ref (pad);
+    layer.frame = gst_buffer_ref (pad->current);
+    layer.index = index;
+    g_array_append_val (mixer->layers, layer);
+  }
+  GST_OBJECT_UNLOCK (mixer);
+
+  if (need_data && !timeout)
+    return GST_AGGREGATOR_FLOW_NEED_DATA;
+  if (all_eos && mixer->layers->len == 0)
+    return GST_FLOW_EOS;
+
+  g_array_sort (mixer->layers, dlb_light_mixer_compare_layers);
+
+  return GST_FLOW_OK;
+}
+
+static void
+dlb_light_mixer_clear_layers (DlbLightMixer * mixer)
+{
+  for (guint i = 0; i < mixer->layers->len; i++) {
+    DlbLightMixerLayer *layer = &g_array_index (mixer->layers,
+        DlbLightMixerLayer, i);
+
+    gst_buffer_unref (layer->frame);
+    gst_object_unref (layer->pad);
+  }
+  g_array_set_size (mixer->layers, 0);
+}
+
+/* Takes the layout of the bottom layer, from its meta when it has one */
+static gboolean
+dlb_light_mixer_set_layout (DlbLightMixer * mixer, GstBuffer * frame,
+    const GstMapInfo * map)
+{
+  DlbLightLayoutMeta *meta = dlb_buffer_get_light_layout_meta (frame);
+  DlbLightLayout *layout;
+
+  if (mixer->layout && dlb_light_layout_matches (mixer->layout, map->data,
+          map->size))
+    return TRUE;
+
+  if (meta && meta->layout->frame_size == map->size)
+    layout = dlb_light_layout_ref (meta->layout);
+  else
+    layout = dlb_light_layout_new_from_data (map->data, map->size);
+
+  if (layout == NULL)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (mixer, "new layout with %u strips", layout->num_strips);
+  g_clear_pointer (&mixer->layout, dlb_light_layout_unref);
+  mixer->layout = layout;
+
+  return TRUE;
+}
+
+/* An output frame with the strips of the layout, all lights off */
+static GstBuffer *
+dlb_light_mixer_new_frame (DlbLightMixer * mixer)
+{
+  DlbLightLayout *layout = mixer->layout;
+  GstBuffer *outbuf;
+  GstMapInfo map;
+
+  outbuf = gst_buffer_new_allocate (NULL, layout->frame_size, NULL);
+  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+
+  GST_WRITE_UINT16_LE (map.data, layout->num_strips);
+  for (guint i = 0; i < layout->num_strips; i++) {
+    const DlbLightStrip *strip = &layout->strips[i];
+    guint8 *header = map.data + strip->header_offset;
+
+    header[0] = strip->strip_id;
+    GST_WRITE_UINT16_LE (header + 1, strip->num_lights);
+    header[3] = strip->format;
+  }
+  gst_buffer_unmap (outbuf, &map);
+
+  dlb_buffer_add_light_layout_meta (outbuf, layout);
+
+  return outbuf;
+}
+
+static GstBuffer *
+dlb_light_mixer_mix (DlbLightMixer * mixer)
+{
+  GstBuffer *outbuf = NULL;
+  GstMapInfo outmap;
+
+  for (guint i = 0; i < mixer->layers->len; i++) {
+    DlbLightMixerLayer *layer = &g_array_index (mixer->layers,
+        DlbLightMixerLayer, i);
+    GstMapInfo map;
+
+    if (!gst_buffer_map (layer->frame, &map, GST_MAP_READ)) {
+      GST_WARNING_OBJECT (layer->pad, "could not map frame");
+      continue;
+    }
+
+    if (outbuf == NULL) {
+      if (!dlb_light_mixer_set_layout (mixer, layer->frame, &map)) {
+        GST_WARNING_OBJECT (layer->pad, "invalid light frame");
+        gst_buffer_unmap (layer->frame, &map);
+        continue;
+      }
+      outbuf = dlb_light_mixer_new_frame (mixer);
+      gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE);
+    } else if (!dlb_light_layout_matches (mixer->layout, map.data, map.size)) {
+      if (!layer->pad->layout_warned)
+        GST_WARNING_OBJECT (layer->pad, "strip layout differs from the layer "
+            "below, not mixed");
+      layer->pad->layout_warned = TRUE;
+      gst_buffer_unmap (layer->frame, &map);
+      continue;
+    }
+
+    GST_LOG_OBJECT (layer->pad, "blending with alpha %u/%u", layer->alpha,
+        DLB_LIGHT_BLEND_ALPHA_OPAQUE);
+    for (guint s = 0; s < mixer->layout->num_strips; s++) {
+      const DlbLightStrip *strip = &mixer->layout->strips[s];
+
+      dlb_light_blend_values (layer->blend, outmap.data + strip->offset,
+          map.data + strip->offset, strip->size, layer->alpha);
+    }
+    gst_buffer_unmap (layer->frame, &map);
+  }
+
+  if (outbuf)
+    gst_buffer_unmap (outbuf, &outmap);
+  else if (mixer->layout)
+    outbuf = dlb_light_mixer_new_frame (mixer);
+
+  return outbuf;
+}
+
+static GstFlowReturn
+dlb_light_mixer_aggregate (GstAggregator * agg, gboolean timeout)
+{
+  DlbLightMixer *mixer = DLB_LIGHT_MIXER (agg);
+  GstSegment *segment = &GST_AGGREGATOR_PAD (agg->srcpad)->segment;
+  GstClockTime position, start, end, stream_time;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+
+  GST_OBJECT_LOCK (agg);
+  position = segment->position;
+  if (!GST_CLOCK_TIME_IS_VALID (position) || position < segment->start)
+    position = segment->start;
+  start = gst_segment_to_running_time (segment, GST_FORMAT_TIME, position);
+  stream_time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, position);
+  GST_OBJECT_UNLOCK (agg);
+
+  if (!GST_CLOCK_TIME_IS_VALID (start)) {
+    GST_DEBUG_OBJECT (mixer, "position %" GST_TIME_FORMAT " is past the "
+        "segment", GST_TIME_ARGS (position));
+    return GST_FLOW_EOS;
+  }
+  end = start + mixer->frame_period;
+
+  ret = dlb_light_mixer_collect (mixer, start, end, stream_time, timeout);
+  if (ret != GST_FLOW_OK) {
+    dlb_light_mixer_clear_layers (mixer);
+    return ret;
+  }
+
+  outbuf = dlb_light_mixer_mix (mixer);
+  dlb_light_mixer_clear_layers (mixer);
+
+  if (!gst_pad_has_current_caps (agg->srcpad)) {
+    GstCaps *caps = gst_caps_new_simple ("application/x-lights",
+        "format", G_TYPE_STRING, "DLB", NULL);
+
+    gst_aggregator_set_src_caps (agg, caps);
+    gst_caps_unref (caps);
+  }
+
+  GST_OBJECT_LOCK (agg);
+  segment->position = position + mixer->frame_period;
+  GST_OBJECT_UNLOCK (agg);
+
+  /* nothing to show before the first frame of any input */
+  if (outbuf == NULL)
+    return GST_FLOW_OK;
+
+  GST_BUFFER_PTS (outbuf) = position;
+  GST_BUFFER_DURATION (outbuf) = mixer->frame_period;
+
+  return gst_aggregator_finish_buffer (agg, outbuf);
+}
+
+#ifndef DLB_PLUGINS_BUNDLE
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return GST_ELEMENT_REGISTER (dlblightmixer, plugin);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    dlblightmixer,
+    "Dolby Light Mixer",
+    plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
@@ -0,0 +1,108 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_MIXER_H_
+#define _DLB_LIGHT_MIXER_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstaggregator.h>
+
+#include "dlblightblend.h"
+#include "dlblightmeta.h"
+
+G_BEGIN_DECLS
+
+#define DLB_TYPE_LIGHT_MIXER_PAD \
+  (dlb_light_mixer_pad_get_type())
+#define DLB_LIGHT_MIXER_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_MIXER_PAD, DlbLightMixerPad))
+#define DLB_LIGHT_MIXER_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_MIXER_PAD, DlbLightMixerPadClass))
+#define DLB_IS_LIGHT_MIXER_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_MIXER_PAD))
+
+#define DLB_TYPE_LIGHT_MIXER \
+  (dlb_light_mixer_get_type())
+#define DLB_LIGHT_MIXER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), DLB_TYPE_LIGHT_MIXER, DlbLightMixer))
+#define DLB_LIGHT_MIXER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), DLB_TYPE_LIGHT_MIXER, DlbLightMixerClass))
+#define DLB_IS_LIGHT_MIXER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), DLB_TYPE_LIGHT_MIXER))
+#define DLB_IS_LIGHT_MIXER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), DLB_TYPE_LIGHT_MIXER))
+
+typedef struct _DlbLightMixerPad DlbLightMixerPad;
+typedef struct _DlbLightMixerPadClass DlbLightMixerPadClass;
+typedef struct _DlbLightMixer DlbLightMixer;
+typedef struct _DlbLightMixerClass DlbLightMixerClass;
+
+struct _DlbLightMixerPad {
+  GstAggregatorPad parent;
+
+  /* protected by OBJECT_LOCK */
+  guint priority;
+  DlbLightBlendMode blend;
+  gdouble alpha;
+  GstClockTime fade_duration;
+
+  /* frame shown until a newer one starts, streaming thread only */
+  GstBuffer *current;
+  GstClockTime current_end;
+
+  /* running time up to which the input is known */
+  GstClockTime seen_end;
+
+  /* alpha actually applied, fading towards the alpha property */
+  gdouble level;
+  gdouble fade_from;
+  gdouble fade_to;
+  GstClockTime fade_start;
+
+  gboolean layout_warned;
+};
+
+struct _DlbLightMixerPadClass {
+  GstAggregatorPadClass parent_class;
+};
+
+struct _DlbLightMixer {
+  GstAggregator parent;
+
+  /* protected by OBJECT_LOCK */
+  guint frame_period_us;
+
+  /* streaming thread only */
+  GstClockTime frame_period;
+  DlbLightLayout *layout;
+  GPtrArray *layers;
+};
+
+struct _DlbLightMixerClass {
+  GstAggregatorClass parent_class;
+};
+
+GType dlb_light_mixer_pad_get_type (void);
+GType dlb_light_mixer_get_type (void);
+GST_ELEMENT_REGISTER_DECLARE (dlblightmixer);
+
+G_END_DECLS
+
+#endif // _DLB_LIGHT_MIXER_H_
@@ -0,0 +1,544 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Flight recorder: the last frames shown by a light sink and their timing,
+ * kept in a ring allocated once so recording can stay enabled in
+ * production. The ring is sized from the first frame and written out as
+ * text when a dump is triggered.
+ *
+ * Dumps requested from the streaming or device thread (late frames, drops)
+ * or by SIGUSR2 are written by a helper thread; the ring is only locked while
+ * it is copied to a second ring, allocated with the first dump. The helper
+ * thread also polls for signals, so a stalled pipeline still dumps. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_SIGACTION
+#include <signal.h>
+#endif
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include "dlblightrecorder.h"
+
+#ifndef GST_DISABLE_GST_DEBUG
+#define GST_CAT_DEFAULT ensure_debug_category ()
+
+static GstDebugCategory *
+ensure_debug_category (void)
+{
+  static gsize cat = 0;
+
+  if (g_once_init_enter (&cat)) {
+    gsize _cat = (gsize) _gst_debug_category_new ("lightrecorder", 0,
+        "light flight recorder");
+    g_once_init_leave (&cat, _cat);
+  }
+
+  return (GstDebugCategory *) cat;
+}
+#endif
+
+/* frame period assumed when the first frame has no duration */
+#define DEFAULT_FRAME_PERIOD (40 * GST_MSECOND)
+#define MIN_RECORDS 2
+#define MAX_RECORDS 65536
+#define MIN_SLOT_SIZE 64
+/* how often the dump thread checks for SIGUSR2 */
+#define SIGNAL_POLL_INTERVAL (200 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct
+{
+  GstClockTime pts;
+  GstClockTime arrival;
+  GstClockTime presented;
+  GstClockTimeDiff lateness;
+  guint32 size;
+  guint32 flags;
+} DlbLightRecord;
+
+typedef struct
+{
+  DlbLightRecord *records;
+  guint8 *data;
+  guint head;
+  guint len;
+} DlbLightRing;
+
+struct _DlbLightRecorder
+{
+  gint ref_count;
+
+  GstElement *element;
+  GstClockTime duration;
+  gchar *location;
+  gboolean on_signal;
+
+  /* ring, allocated on the first frame */
+  GMutex lock;
+  DlbLightRing ring;
+  guint n_records;
+  gsize slot_size;
+  guint seen_signals;
+
+  /* copy of the ring being written out, protected by dump_lock */
+  GMutex dump_lock;
+  DlbLightRing snapshot;
+  guint dumps;
+
+  /* dump thread, protected by lock */
+  GCond cond;
+  GThread *thread;
+  gboolean running;
+  const gchar *pending;
+  GstClockTime last_trigger;
+};
+
+#ifdef HAVE_SIGACTION
+/* SIGUSR2 count, only incremented by the handler */
+static volatile sig_atomic_t dump_signals;
+
+static void
+dlb_light_recorder_signal_handler (int signum)
+{
+  dump_signals++;
+}
+
+static gpointer
+dlb_light_recorder_install_handler (gpointer data)
+{
+  struct sigaction action, old;
+
+  if (sigaction (SIGUSR2, NULL, &old) == 0 && old.sa_handler != SIG_DFL) {
+    GST_WARNING ("SIGUSR2 already handled by the application, flight "
+        "recorder dumps on signal disabled");
+    return GINT_TO_POINTER (FALSE);
+  }
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = dlb_light_recorder_signal_handler;
+  sigemptyset (&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+
+  return GINT_TO_POINTER (sigaction (SIGUSR2, &action, NULL) == 0);
+}
+#endif
+
+/* call with the lock held */
+static void
+dlb_light_recorder_check_signal (DlbLightRecorder * recorder)
+{
+#ifdef HAVE_SIGACTION
+  guint signals;
+
+  if (!recorder->on_signal)
+    return;
+
+  signals = dump_signals;
+  if (G_UNLIKELY (signals != recorder->seen_signals)) {
+    recorder->seen_signals = signals;
+    recorder->pending = "signal";
+  }
+#endif
+}
+
+static gpointer
+dlb_light_recorder_thread (gpointer data)
+{
+  DlbLightRecorder *recorder = data;
+
+  g_mutex_lock (&recorder->lock);
+  while (TRUE) {
+    const gchar *reason;
+
+    while (recorder->running && recorder->pending == NULL) {
+      if (recorder->on_signal) {
+        g_cond_wait_until (&recorder->cond, &recorder->lock,
+            g_get_monotonic_time () + SIGNAL_POLL_INTERVAL);
+        dlb_light_recorder_check_signal (recorder);
+      } else {
+        g_cond_wait (&recorder->cond, &recorder->lock);
+      }
+    }
+
+    if (!recorder->running)
+      break;
+
+    reason = recorder->pending;
+    recorder->pending = NULL;
+    g_mutex_unlock (&recorder->lock);
+
+    g_free (dlb_light_recorder_dump (recorder, reason));
+
+    g_mutex_lock (&recorder->lock);
+  }
+  g_mutex_unlock (&recorder->lock);
+
+  return NULL;
+}
+
+/**
+ * dlb_light_recorder_new:
+ * @element: the sink, used to name the dumps and post their messages
+ * @duration: how much history to keep
+ * @location: (nullable): directory of the dumps, the temporary directory if
+ *     %NULL
+ * @on_signal: also dump on SIGUSR2
+ *
+ * Returns: (transfer full): a new #DlbLightRecorder, or NULL if its dump
+ * thread could not be started.
+ */
+DlbLightRecorder *
+dlb_light_recorder_new (GstElement * element, GstClockTime duration,
+    const gchar * location, gboolean on_signal)
+{
+  DlbLightRecorder *recorder = g_new0 (DlbLightRecorder, 1);
+  GError *error = NULL;
+
+  recorder->ref_count = 1;
+  recorder->element = element;
+  recorder->duration = duration;
+  recorder->location = g_strdup (location ? location : g_get_tmp_dir ());
+  recorder->last_trigger = GST_CLOCK_TIME_NONE;
+  g_mutex_init (&recorder->lock);
+  g_mutex_init (&recorder->dump_lock);
+  g_cond_init (&recorder->cond);
+
+  if (on_signal) {
+#ifdef HAVE_SIGACTION
+    static GOnce handler_once = G_ONCE_INIT;
+
+    g_once (&handler_once, dlb_light_recorder_install_handler, NULL);
+    recorder->on_signal = GPOINTER_TO_INT (handler_once.retval);
+    recorder->seen_signals = dump_signals;
+#else
+    GST_WARNING_OBJECT (element, "flight recorder dumps on signal not "
+        "supported on this platform");
+#endif
+  }
+
+  recorder->running = TRUE;
+  recorder->thread = g_thread_try_new ("lightrecorder",
+      dlb_light_recorder_thread, recorder, &error);
+  if (recorder->thread == NULL) {
+    GST_WARNING_OBJECT (element, "could not start flight recorder thread: %s",
+        error->message);
+    g_clear_error (&error);
+    recorder->running = FALSE;
+    dlb_light_recorder_unref (recorder);
+    return NULL;
+  }
+
+  return recorder;
+}
+
+DlbLightRecorder *
+dlb_light_recorder_ref (DlbLightRecorder * recorder)
+{
+  g_atomic_int_inc (&recorder->ref_count);
+
+  return recorder;
+}
+
+/* The last reference stops the dump thread, so it must not be dropped from
+ * that thread. */
+void
+dlb_light_recorder_unref (DlbLightRecorder * recorder)
+{
+  if (!g_atomic_int_dec_and_test (&recorder->ref_count))
+    return;
+
+  if (recorder->thread) {
+    g_mutex_lock (&recorder->lock);
+    recorder->running = FALSE;
+    g_cond_signal (&recorder->cond);
+    g_mutex_unlock (&recorder->lock);
+    g_thread_join (recorder->thread);
+  }
+
+  g_free (recorder->ring.records);
+  g_free (recorder->ring.data);
+  g_free (recorder->snapshot.records);
+  g_free (recorder->snapshot.data);
+  g_mutex_clear (&recorder->lock);
+  g_mutex_clear (&recorder->dump_lock);
+  g_cond_clear (&recorder->cond);
+  g_free (recorder->location);
+  g_free (recorder);
+}
+
+/* call with the lock held */
+static void
+dlb_light_recorder_allocate (DlbLightRecorder * recorder, GstBuffer * buf)
+{
+  GstClockTime period = DEFAULT_FRAME_PERIOD;
+  gsize size = buf ? gst_buffer_get_size (buf) : 0;
+
+  if (buf && GST_BUFFER_DURATION_IS_VALID (buf) && GST_BUFFER_DURATION (buf) > 0)
+    period = GST_BUFFER_DURATION (buf);
+
+  recorder->n_records = CLAMP (gst_util_uint64_scale_ceil (recorder->duration,
+          1, period), MIN_RECORDS, MAX_RECORDS);
+  recorder->slot_size = GST_ROUND_UP_8 (MAX (size, MIN_SLOT_SIZE));
+
+  recorder->ring.records = g_new0 (DlbLightRecord, recorder->n_records);
+  recorder->ring.data = g_malloc0 (recorder->n_records * recorder->slot_size);
+
+  GST_DEBUG_OBJECT (recorder->element, "flight recorder keeps %u frames of "
+      "up to %" G_GSIZE_FORMAT " bytes", recorder->n_records,
+      recorder->slot_size);
+}
+
+/* call with the lock held */
+static DlbLightRecord *
+dlb_light_recorder_next (DlbLightRecorder * recorder, guint8 ** data)
+{
+  DlbLightRing *ring = &recorder->ring;
+  guint index;
+
+  if (ring->len < recorder->n_records) {
+    index = (ring->head + ring->len) % recorder->n_records;
+    ring->len++;
+  } else {
+    index = ring->head;
+    ring->head = (ring->head + 1) % recorder->n_records;
+  }
+
+  *data = ring->data + index * recorder->slot_size;
+  return &ring->records[index];
+}
+
+/**
+ * dlb_light_recorder_record:
+ * @recorder: a #DlbLightRecorder
+ * @buf: the frame shown
+ * @arrival: monotonic time the frame reached the sink
+ * @presented: monotonic time the frame was handed to the device
+ * @lateness: how late the frame was shown, GST_CLOCK_STIME_NONE if it was not
+ *     synchronised
+ * @flags: #DlbLightRecordFlags
+ *
+ * Records a frame. Only copies, the ring is allocated on the first call.
+ */
+void
+dlb_light_recorder_record (DlbLightRecorder * recorder, GstBuffer * buf,
+    GstClockTime arrival, GstClockTime presented, GstClockTimeDiff lateness,
+    guint flags)
+{
+  DlbLightRecord *record;
+  guint8 *data;
+  gsize size = gst_buffer_get_size (buf);
+
+  g_mutex_lock (&recorder->lock);
+  if (G_UNLIKELY (recorder->ring.records == NULL))
+    dlb_light_recorder_allocate (recorder, buf);
+
+  record = dlb_light_recorder_next (recorder, &data);
+  record->pts = GST_BUFFER_PTS (buf);
+  record->arrival = arrival;
+  record->presented = presented;
+  record->lateness = lateness;
+  record->size = size;
+  record->flags = flags;
+  if (size > recorder->slot_size)
+    record->flags |= DLB_LIGHT_RECORD_TRUNCATED;
+  gst_buffer_extract (buf, 0, data, MIN (size, recorder->slot_size));
+  g_mutex_unlock (&recorder->lock);
+}
+
+/* Records a frame the sink dropped before showing it */
+void
+dlb_light_recorder_record_drop (DlbLightRecorder * recorder,
+    GstClockTime timestamp, GstClockTimeDiff lateness)
+{
+  DlbLightRecord *record;
+  guint8 *data;
+
+  g_mutex_lock (&recorder->lock);
+  if (G_UNLIKELY (recorder->ring.records == NULL))
+    dlb_light_recorder_allocate (recorder, NULL);
+
+  record = dlb_light_recorder_next (recorder, &data);
+  record->pts = timestamp;
+  record->arrival = gst_util_get_timestamp ();
+  record->presented = GST_CLOCK_TIME_NONE;
+  record->lateness = lateness;
+  record->size = 0;
+  record->flags = DLB_LIGHT_RECORD_DROPPED;
+  g_mutex_unlock (&recorder->lock);
+}
+
+/**
+ * dlb_light_recorder_trigger:
+ * @recorder: a #DlbLightRecorder
+ * @reason: (not nullable): static string saying why, written to the dump
+ *
+ * Requests a dump from the dump thread, without blocking. Triggers are
+ * ignored for the ring duration after the last one, so a burst of late
+ * frames produces one dump covering it.
+ */
+void
+dlb_light_recorder_trigger (DlbLightRecorder * recorder, const gchar * reason)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+
+  g_mutex_lock (&recorder->lock);
+  if (!GST_CLOCK_TIME_IS_VALID (recorder->last_trigger) ||
+      now - recorder->last_trigger >= recorder->duration) {
+    recorder->last_trigger = now;
+    recorder->pending = reason;
+    g_cond_signal (&recorder->cond);
+  }
+  g_mutex_unlock (&recorder->lock);
+}
+
+static void
+dlb_light_recorder_write_time (FILE * file, GstClockTime time)
+{
+  if (GST_CLOCK_TIME_IS_VALID (time))
+    fprintf (file, " %" G_GUINT64_FORMAT, (guint64) time);
+  else
+    fputs (" -", file);
+}
+
+/* call with dump_lock held */
+static gboolean
+dlb_light_recorder_write (DlbLightRecorder * recorder, FILE * file,
+    const gchar * reason, GstClockTime now)
+{
+  DlbLightRing *ring = &recorder->snapshot;
+
+  fprintf (file, "# flight recorder of %s\n",
+      GST_OBJECT_NAME (recorder->element));
+  fprintf (file, "# reason: %s\n", reason);
+  fprintf (file, "# dump time: %" G_GUINT64_FORMAT " ns (monotonic)\n",
+      (guint64) now);
+  fprintf (file, "# frames: %u\n", ring->len);
+  fputs ("# pts arrival presented lateness flags size data\n", file);
+
+  for (guint i = 0; i < ring->len; i++) {
+    guint index = (ring->head + i) % recorder->n_records;
+    DlbLightRecord *record = &ring->records[index];
+    const guint8 *data = ring->data + index * recorder->slot_size;
+    gsize kept = MIN (record->size, recorder->slot_size);
+
+    dlb_light_recorder_write_time (file, record->pts);
+    dlb_light_recorder_write_time (file, record->arrival);
+    dlb_light_recorder_write_time (file, record->presented);
+    if (GST_CLOCK_STIME_IS_VALID (record->lateness))
+      fprintf (file, " %" G_GINT64_FORMAT, (gint64) record->lateness);
+    else
+      fputs (" -", file);
+    fprintf (file, " %c%c%c %u ",
+        (record->flags & DLB_LIGHT_RECORD_PREROLL) ? 'p' : '-',
+        (record->flags & DLB_LIGHT_RECORD_DROPPED) ? 'd' : '-',
+        (record->flags & DLB_LIGHT_RECORD_TRUNCATED) ? 't' : '-',
+        record->size);
+    for (gsize j = 0; j < kept; j++)
+      fprintf (file, "%02x", data[j]);
+    fputc ('\n', file);
+  }
+
+  return !ferror (file);
+}
+
+/**
+ * dlb_light_recorder_dump:
+ * @recorder: a #DlbLightRecorder
+ * @reason: why the dump was requested, written to the dump
+ *
+ * Writes the recorded frames to a new file in the dump location and posts
+ * a "dlb-flight-recorder-dump" element message with its path.
+ *
+ * Returns: (transfer full) (nullable): the path of the dump, or NULL if it
+ * could not be written.
+ */
+gchar *
+dlb_light_recorder_dump (DlbLightRecorder * recorder, const gchar * reason)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  gchar *name, *path;
+  gboolean written;
+  guint frames;
+  FILE *file;
+
+  g_mutex_lock (&recorder->dump_lock);
+
+  g_mutex_lock (&recorder->lock);
+  recorder->snapshot.head = recorder->ring.head;
+  recorder->snapshot.len = recorder->ring.len;
+  if (recorder->ring.records && recorder->snapshot.records == NULL) {
+    /* allocated with the first dump, the ring size never changes */
+    recorder->snapshot.records = g_new0 (DlbLightRecord, recorder->n_records);
+    recorder->snapshot.data = g_malloc0 (recorder->n_records *
+        recorder->slot_size);
+  }
+  if (recorder->ring.records) {
+    memcpy (recorder->snapshot.records, recorder->ring.records,
+        recorder->n_records * sizeof (DlbLightRecord));
+    memcpy (recorder->snapshot.data, recorder->ring.data,
+        recorder->n_records * recorder->slot_size);
+  }
+  g_mutex_unlock (&recorder->lock);
+
+#ifdef G_OS_UNIX
+  name = g_strdup_printf ("dlblight-%s-%d-%u.txt",
+      GST_OBJECT_NAME (recorder->element), (gint) getpid (), recorder->dumps++);
+#else
+  name = g_strdup_printf ("dlblight-%s-%u.txt",
+      GST_OBJECT_NAME (recorder->element), recorder->dumps++);
+#endif
+  path = g_build_filename (recorder->location, name, NULL);
+  g_free (name);
+
+  file = g_fopen (path, "w");
+  written = file != NULL &&
+      dlb_light_recorder_write (recorder, file, reason, now);
+  if (file && fclose (file) != 0)
+    written = FALSE;
+  frames = recorder->snapshot.len;
+
+  g_mutex_unlock (&recorder->dump_lock);
+
+  if (!written) {
+    GST_WARNING_OBJECT (recorder->element, "could not write flight recorder "
+        "dump %s", path);
+    g_free (path);
+    return NULL;
+  }
+
+  GST_INFO_OBJECT (recorder->element, "flight recorder dumped %u frames to %s "
+      "(%s)", frames, path, reason);
+  gst_element_post_message (recorder->element,
+      gst_message_new_element (GST_OBJECT_CAST (recorder->element),
+          gst_structure_new ("dlb-flight-recorder-dump",
+              "location", G_TYPE_STRING, path,
+              "reason", G_TYPE_STRING, reason,
+              "frames", G_TYPE_UINT, frames, NULL)));
+
+  return path;
+}
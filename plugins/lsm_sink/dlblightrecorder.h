@@ -0,0 +1,59 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _DLB_LIGHT_RECORDER_H_
+#define _DLB_LIGHT_RECORDER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _DlbLightRecorder DlbLightRecorder;
+
+/**
+ * DlbLightRecordFlags:
+ * @DLB_LIGHT_RECORD_PREROLL: the frame was shown during preroll
+ * @DLB_LIGHT_RECORD_DROPPED: the frame was dropped as too late, no data
+ * @DLB_LIGHT_RECORD_TRUNCATED: only the start of the frame was kept
+ */
+typedef enum
+{
+  DLB_LIGHT_RECORD_PREROLL = (1 << 0),
+  DLB_LIGHT_RECORD_DROPPED = (1 << 1),
+  DLB_LIGHT_RECORD_TRUNCATED = (1 << 2),
+} DlbLightRecordFlags;
+
+DlbLightRecorder *dlb_light_recorder_new (GstElement * element,
+    GstClockTime duration, const gchar * location, gboolean on_signal);
+DlbLightRecorder *dlb_light_recorder_ref (DlbLightRecorder * recorder);
+void dlb_light_recorder_unref (DlbLightRecorder * recorder);
+void dlb_light_recorder_record (DlbLightRecorder * recorder, GstBuffer * buf,
+    GstClockTime arrival, GstClockTime presented, GstClockTimeDiff lateness,
+    guint flags);
+void dlb_light_recorder_record_drop (DlbLightRecorder * recorder,
+    GstClockTime timestamp, GstClockTimeDiff lateness);
+void dlb_light_recorder_trigger (DlbLightRecorder * recorder,
+    const gchar * reason);
+gchar *dlb_light_recorder_dump (DlbLightRecorder * recorder,
+    const gchar * reason);
+
+G_END_DECLS
+
+#endif /* _DLB_LIGHT_RECORDER_H_ */
@@ -19,10 +19,8 @@
  ******************************************************************************/
 
 #include "dlblighttextsink.h"
-#include "dlb_lightscapes.h"
+#include "dlblightmeta.h"
 
-#include <assert.h>
-#include <gst/base/gstbytereader.h>
 #include <stdint.h>
 
 #ifdef HAVE_CONFIG_H
@@ -47,10 +45,33 @@ static GstStaticPadTemplate dlb_light_text_sink_template =
                      " format = (string) { DLB }; ")
     );
 
+static void
+dlb_light_text_sink_log_strip (DlbLightTextSink * self, const guint8 * frame,
+    const DlbLightStrip * strip)
+{
+  const guint8 *light = frame + strip->offset;
+
+  GST_INFO_OBJECT(self, "[LSM] Strip %u [%u lights, fmt %u]:", strip->strip_id, strip->num_lights, strip->format);
+  for (uint16_t j = 0; j < strip->num_lights; j++) {
+      switch (strip->format) {
+          case DLB_LIGHT_FORMAT_RGB:
+              GST_INFO_OBJECT(self, "[LSM]     %3u %3u %3u", light[0], light[1], light[2]);
+              break;
+          case DLB_LIGHT_FORMAT_RGBW:
+              GST_INFO_OBJECT(self, "[LSM]     %3u %3u %3u %3u", light[0], light[1], light[2], light[3]);
+              break;
+          case DLB_LIGHT_FORMAT_RGBWW:
+              GST_INFO_OBJECT(self, "[LSM]     %3u %3u %3u %3u %3u", light[0], light[1], light[2], light[3], light[4]);
+              break;
+      }
+      light += dlb_light_format_bytes_per_light (strip->format);
+  }
+}
+
 static GstFlowReturn
 dlb_light_text_sink_show_frame (DlbLightBaseSink * lsink, GstBuffer * buf)
 {
-  GstByteReader reader;
+  DlbLightLayoutMeta *meta;
   GstMapInfo map;
   DlbLightTextSink *self = DLB_LIGHT_TEXT_SINK (lsink);
   GST_DEBUG_OBJECT (self, "show frame");
@@ -58,31 +79,28 @@ dlb_light_text_sink_show_frame (DlbLightBaseSink * lsink, GstBuffer * buf)
   if (!buf)
     return GST_FLOW_ERROR;
 
-  gst_buffer_map (buf, &map, GST_MAP_READ);
-  gst_byte_reader_init (&reader, map.data, map.size);
-
-  uint16_t num_light_arrs;
-  assert(gst_byte_reader_get_uint16_le(&reader, &num_light_arrs));
-  GST_INFO_OBJECT(self, "[LSM] # light arrays: %u", num_light_arrs);
-  for (uint16_t i = 0; i < num_light_arrs; i++) {
-      uint8_t strip_id, out_fmt;
-      uint16_t strip_lights;
-      assert(gst_byte_reader_get_uint8(&reader, &strip_id) &&
-             gst_byte_reader_get_uint16_le(&reader, &strip_lights) &&
-             gst_byte_reader_get_uint8(&reader, &out_fmt));
-      GST_INFO_OBJECT(self, "[LSM] Strip %u [%u lights, fmt %u]:", strip_id, strip_lights, out_fmt);
-      for (uint16_t j = 0; j < strip_lights; j++) {
-          uint8_t r, g, b;
-          if (out_fmt == LS_OUTPUT_COLOR_FORMAT_RGB) {
-              assert(gst_byte_reader_get_uint8(&reader, &r) &&
-                     gst_byte_reader_get_uint8(&reader, &g) &&
-                     gst_byte_reader_get_uint8(&reader, &b));
-          } else {
-              GST_INFO_OBJECT(self, "[LSM]     UNKNOWN OUTPUT FORMAT");
-              continue;
-          }
-          GST_INFO_OBJECT(self, "[LSM]     %3u %3u %3u", r, g, b);
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ))
+    return GST_FLOW_ERROR;
+
+  meta = dlb_buffer_get_light_layout_meta (buf);
+  if (meta && meta->layout->frame_size == map.size) {
+      GST_INFO_OBJECT(self, "[LSM] # light arrays: %u", meta->layout->num_strips);
+      for (guint i = 0; i < meta->layout->num_strips; i++)
+          dlb_light_text_sink_log_strip (self, map.data, &meta->layout->strips[i]);
+  } else {
+      DlbLightLayoutReader reader;
+      DlbLightStrip strip;
+
+      gboolean valid = dlb_light_layout_reader_init (&reader, map.data, map.size);
+
+      if (valid) {
+          GST_INFO_OBJECT(self, "[LSM] # light arrays: %u", reader.num_strips);
+          while (dlb_light_layout_reader_next (&reader, &strip))
+              dlb_light_text_sink_log_strip (self, map.data, &strip);
+          valid = dlb_light_layout_reader_is_complete (&reader);
       }
+      if (!valid)
+          GST_WARNING_OBJECT(self, "[LSM] malformed light frame (%zu bytes)", map.size);
   }
 
   gst_buffer_unmap (buf, &map);
@@ -90,6 +108,19 @@ dlb_light_text_sink_show_frame (DlbLightBaseSink * lsink, GstBuffer * buf)
   return GST_FLOW_OK;
 }
 
+static GstFlowReturn
+dlb_light_text_sink_show_list (DlbLightBaseSink * lsink, GstBufferList * list)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint len = gst_buffer_list_length (list);
+
+  GST_INFO_OBJECT (lsink, "[LSM] # frames: %u", len);
+  for (guint i = 0; i < len && ret == GST_FLOW_OK; i++)
+    ret = dlb_light_text_sink_show_frame (lsink, gst_buffer_list_get (list, i));
+
+  return ret;
+}
+
 static void
 dlb_light_text_sink_init (DlbLightTextSink * sink)
 {
@@ -111,8 +142,10 @@ dlb_light_text_sink_class_init (DlbLightTextSinkClass * klass)
       &dlb_light_text_sink_template);
 
   lightsink_class->show_frame = dlb_light_text_sink_show_frame;
+  lightsink_class->show_list = dlb_light_text_sink_show_list;
 }
 
+#ifndef DLB_PLUGINS_BUNDLE
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
@@ -124,3 +157,4 @@ GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
     dlblighttextsink,
     "Dolby Text Light Sink",
     plugin_init, VERSION, LICENSE, PACKAGE, ORIGIN)
+#endif
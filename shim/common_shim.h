@@ -36,6 +36,7 @@
 
 
 #include <assert.h>
+#include <stdio.h>
 
 static inline void *
 get_proc_address (void *lib, const char *name)
@@ -65,6 +66,22 @@ open_dynamic_lib (const char *name)
   return lib;
 }
 
+/* Describes the last failure of open_dynamic_lib or get_proc_address. */
+static inline const char *
+dynamic_lib_error (void)
+{
+#if defined(HAVE_DLADDR)
+  const char *error = dlerror ();
+
+  return error ? error : "unknown error";
+#elif defined(HAVE_WINAPI)
+  static char error[32];
+
+  snprintf (error, sizeof (error), "error %lu", (unsigned long) GetLastError ());
+  return error;
+#endif
+}
+
 static inline int
 close_dynamic_lib(void* lib)
 {
@@ -22,6 +22,10 @@
 #include "config.h"
 #endif
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "dlb_lightscapes.h"
 #include "common_shim.h"
 
@@ -36,20 +40,205 @@ typedef struct dlb_lightscapes_dispatch_table_s
 
 static dlb_lightscapes_dispatch_table dispatch_table;
 
+/* CPU feature detection */
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#if defined(__GNUC__)
+static int
+cpu_has_avx2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+}
+
+static int
+cpu_has_avx512 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512bw") &&
+      __builtin_cpu_supports ("avx512vl");
+}
+#elif defined(_MSC_VER)
+#include <intrin.h>
+
+/* also checks that the OS saves the extended register state */
+static int
+cpu_has_leaf7_ebx_bits (unsigned bits, unsigned long long xcr0_mask)
+{
+  int info[4];
+
+  __cpuid (info, 1);
+  if (!(info[2] & (1 << 27)))   /* OSXSAVE */
+    return 0;
+  if ((_xgetbv (0) & xcr0_mask) != xcr0_mask)
+    return 0;
+
+  __cpuidex (info, 7, 0);
+  return ((unsigned) info[1] & bits) == bits;
+}
+
+static int
+cpu_has_avx2 (void)
+{
+  return cpu_has_leaf7_ebx_bits (1u << 5, 0x6);
+}
+
+static int
+cpu_has_avx512 (void)
+{
+  /* AVX512F, AVX512BW, AVX512VL */
+  return cpu_has_leaf7_ebx_bits ((1u << 16) | (1u << 30) | (1u << 31), 0xe6);
+}
+#else
+static int cpu_has_avx2 (void) { return 0; }
+static int cpu_has_avx512 (void) { return 0; }
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+
+static int
+cpu_has_sve (void)
+{
+  return (getauxval (AT_HWCAP) & HWCAP_SVE) != 0;
+}
+#else
+static int cpu_has_sve (void) { return 0; }
+#endif
+
+/* Advanced SIMD is mandatory on AArch64 */
+static int cpu_has_neon (void) { return 1; }
+#endif
+
+static int cpu_any (void) { return 1; }
+
+typedef struct dlb_lightscapes_variant_s
+{
+  const char *name;
+  const char *suffix;           /* inserted before the library extension */
+  int (*supported) (void);
+} dlb_lightscapes_variant;
+
+/* fastest first, the generic build is always last */
+static const dlb_lightscapes_variant variants[] = {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  {"avx512", "-avx512", cpu_has_avx512},
+  {"avx2", "-avx2", cpu_has_avx2},
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  {"sve", "-sve", cpu_has_sve},
+  {"neon", "-neon", cpu_has_neon},
+#endif
+  {"generic", "", cpu_any},
+};
+
+static const char *selected_variant = NULL;
+static char last_error[512];
+
+static int
+variant_library_path (char *path, size_t path_size, const char *libname,
+    const char *suffix)
+{
+  const char *base = strrchr (libname, '/');
+  const char *ext = strrchr (base ? base : libname, '.');
+  size_t stem = ext ? (size_t) (ext - libname) : strlen (libname);
+  int len;
+
+  len = snprintf (path, path_size, "%.*s%s%s", (int) stem, libname, suffix,
+      ext ? ext : "");
+
+  return len > 0 && (size_t) len < path_size;
+}
+
+static void *
+try_open_library (const char *path)
+{
+  void *lib;
+
+  lib = open_dynamic_lib (path);
+  if (!lib) {
+    snprintf (last_error, sizeof (last_error), "%s", dynamic_lib_error ());
+    return NULL;
+  }
+
+  dispatch_table.new = get_proc_address (lib, "dlb_lsr_new");
+  dispatch_table.free = get_proc_address (lib, "dlb_lsr_free");
+  dispatch_table.process = get_proc_address (lib, "dlb_lsr_process");
+  dispatch_table.reset = get_proc_address (lib, "dlb_lsr_reset");
+  dispatch_table.get_max_output_size = get_proc_address (lib, "dlb_lsr_get_max_output_size");
+
+  /* an incomplete build is as good as a missing one */
+  if (!dispatch_table.new || !dispatch_table.free || !dispatch_table.process ||
+      !dispatch_table.reset || !dispatch_table.get_max_output_size) {
+    snprintf (last_error, sizeof (last_error), "%s: missing entry points",
+        path);
+    memset (&dispatch_table, 0, sizeof (dispatch_table));
+    close_dynamic_lib (lib);
+    return NULL;
+  }
+
+  return lib;
+}
+
+static void *
+try_open_variant (const dlb_lightscapes_variant * variant)
+{
+  char path[4096];
+
+  if (!variant_library_path (path, sizeof (path), DLB_LIGHTSCAPES_LIBNAME,
+          variant->suffix))
+    return NULL;
+
+  return try_open_library (path);
+}
+
+/* Opens the fastest library build the host CPU supports. Setting
+ * DLB_LIGHTSCAPES_VARIANT restricts the search to that one variant. Builds
+ * with DLB_LIGHTSCAPES_TEST_OVERRIDE, never release builds, also let
+ * DLB_LIGHTSCAPES_LIBRARY replace the search by the given library, the
+ * stand-in backend of the test suite. */
 int
 dlb_lightscapes_try_open_dynlib (void)
 {
-  void *liblightscapes = open_dynamic_lib (DLB_LIGHTSCAPES_LIBNAME);
-  if (!liblightscapes)
-    return 1;
+  const char *forced = getenv ("DLB_LIGHTSCAPES_VARIANT");
+#ifdef DLB_LIGHTSCAPES_TEST_OVERRIDE
+  const char *library = getenv ("DLB_LIGHTSCAPES_LIBRARY");
+
+  if (library && *library) {
+    if (!try_open_library (library))
+      return 1;
+    selected_variant = "custom";
+    return 0;
+  }
+#endif
+
+  for (size_t i = 0; i < sizeof (variants) / sizeof (variants[0]); i++) {
+    if (forced && *forced && strcmp (forced, variants[i].name) != 0)
+      continue;
+    if (!variants[i].supported ())
+      continue;
+    if (try_open_variant (&variants[i])) {
+      selected_variant = variants[i].name;
+      return 0;
+    }
+  }
 
-  dispatch_table.new = get_proc_address (liblightscapes, "dlb_lsr_new");
-  dispatch_table.free = get_proc_address (liblightscapes, "dlb_lsr_free");
-  dispatch_table.process = get_proc_address (liblightscapes, "dlb_lsr_process");
-  dispatch_table.reset = get_proc_address (liblightscapes, "dlb_lsr_reset");
-  dispatch_table.get_max_output_size = get_proc_address (liblightscapes, "dlb_lsr_get_max_output_size");
+  return 1;
+}
 
-  return 0;
+const char *
+dlb_lightscapes_get_variant (void)
+{
+  return selected_variant;
+}
+
+/* The reason the last dlb_lightscapes_try_open_dynlib() failed. */
+const char *
+dlb_lightscapes_get_error (void)
+{
+  return last_error[0] ? last_error : "no compatible library build";
 }
 
 dlb_lsr *
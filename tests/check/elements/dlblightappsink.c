@@ -0,0 +1,282 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_EVENTFD
+#include <unistd.h>
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+#include "dlblightappsink.h"
+
+/* Unsynchronised and without the preroll frame, so every pushed frame is
+ * delivered once, right away */
+static GstHarness *
+setup_app_sink (guint max_frames)
+{
+  GstElement *sink = gst_element_factory_make ("dlblightappsink", NULL);
+  GstHarness *h;
+
+  g_object_set (sink, "sync", FALSE, "show-preroll-frame", FALSE,
+      "max-frames", max_frames, NULL);
+  h = gst_harness_new_with_element (sink, "sink", NULL);
+  gst_object_unref (sink);
+
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+
+  return h;
+}
+
+GST_START_TEST (test_app_sink_pop)
+{
+  GstHarness *h = setup_app_sink (8);
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (h->element);
+  GstBuffer *bufs[3];
+
+  fail_unless (dlb_light_app_sink_pop (sink) == NULL);
+
+  for (guint i = 0; i < 3; i++) {
+    bufs[i] = lsm_test_make_light_frame (i, i * LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_int (gst_harness_push (h, gst_buffer_ref (bufs[i])),
+        GST_FLOW_OK);
+  }
+
+#ifdef HAVE_EVENTFD
+  {
+    guint64 count = 0;
+
+    fail_unless (dlb_light_app_sink_get_fd (sink) >= 0);
+    fail_unless_equals_int (read (dlb_light_app_sink_get_fd (sink), &count,
+            sizeof (count)), sizeof (count));
+    fail_unless_equals_uint64 (count, 3);
+  }
+#endif
+
+  for (guint i = 0; i < 3; i++) {
+    DlbLightAppFrame *frame = dlb_light_app_sink_pop (sink);
+    GstMapInfo map;
+
+    fail_unless (frame != NULL);
+    fail_unless_equals_uint64 (frame->pts, i * LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_uint64 (frame->duration, LSM_TEST_FRAME_PERIOD);
+
+    /* a view of the pushed buffer, not a copy */
+    fail_unless (gst_buffer_map (bufs[i], &map, GST_MAP_READ));
+    fail_unless (frame->data == map.data);
+    fail_unless_equals_int (frame->size, map.size);
+    gst_buffer_unmap (bufs[i], &map);
+
+    dlb_light_app_frame_unref (frame);
+    gst_buffer_unref (bufs[i]);
+  }
+
+  fail_unless (dlb_light_app_sink_pop (sink) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* The newest frames are dropped while the application is behind */
+GST_START_TEST (test_app_sink_drops_when_full)
+{
+  GstHarness *h = setup_app_sink (2);
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (h->element);
+  DlbLightAppFrame *frame;
+  guint64 dropped;
+
+  for (guint i = 0; i < 4; i++)
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, i * LSM_TEST_FRAME_PERIOD)),
+        GST_FLOW_OK);
+
+  g_object_get (h->element, "dropped", &dropped, NULL);
+  fail_unless_equals_uint64 (dropped, 2);
+
+  for (guint i = 0; i < 2; i++) {
+    frame = dlb_light_app_sink_pop (sink);
+    fail_unless (frame != NULL);
+    fail_unless_equals_uint64 (frame->pts, i * LSM_TEST_FRAME_PERIOD);
+    dlb_light_app_frame_unref (frame);
+  }
+  fail_unless (dlb_light_app_sink_pop (sink) == NULL);
+
+  /* room again */
+  gst_harness_push (h, lsm_test_make_light_frame (4, 4 * LSM_TEST_FRAME_PERIOD));
+  frame = dlb_light_app_sink_pop (sink);
+  fail_unless (frame != NULL);
+  fail_unless_equals_uint64 (frame->pts, 4 * LSM_TEST_FRAME_PERIOD);
+  dlb_light_app_frame_unref (frame);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+keep_frame (DlbLightAppSink * sink, DlbLightAppFrame * frame,
+    gpointer user_data)
+{
+  GPtrArray *frames = user_data;
+
+  g_ptr_array_add (frames, dlb_light_app_frame_ref (frame));
+}
+
+GST_START_TEST (test_app_sink_callback)
+{
+  GstHarness *h = setup_app_sink (8);
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (h->element);
+  GPtrArray *frames;
+
+  frames = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      dlb_light_app_frame_unref);
+  dlb_light_app_sink_set_callback (sink, keep_frame, frames, NULL);
+
+  for (guint i = 0; i < 3; i++)
+    gst_harness_push (h, lsm_test_make_light_frame (i,
+            i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless_equals_int (frames->len, 3);
+  for (guint i = 0; i < 3; i++) {
+    DlbLightAppFrame *frame = g_ptr_array_index (frames, i);
+
+    fail_unless_equals_uint64 (frame->pts, i * LSM_TEST_FRAME_PERIOD);
+  }
+  fail_unless (dlb_light_app_sink_pop (sink) == NULL);
+
+  /* back to the ring */
+  dlb_light_app_sink_set_callback (sink, NULL, NULL, NULL);
+  gst_harness_push (h, lsm_test_make_light_frame (3, 3 * LSM_TEST_FRAME_PERIOD));
+  fail_unless_equals_int (frames->len, 3);
+  dlb_light_app_frame_unref (dlb_light_app_sink_pop (sink));
+
+  gst_harness_teardown (h);
+
+  /* the frames outlive the pipeline */
+  g_ptr_array_unref (frames);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  guint calls;
+  gboolean released;
+} OneShot;
+
+static void
+one_shot_release (gpointer user_data)
+{
+  ((OneShot *) user_data)->released = TRUE;
+}
+
+/* takes a single frame, then hands the next ones back to the ring */
+static void
+one_shot_frame (DlbLightAppSink * sink, DlbLightAppFrame * frame,
+    gpointer user_data)
+{
+  OneShot *shot = user_data;
+
+  shot->calls++;
+  dlb_light_app_sink_set_callback (sink, NULL, NULL, NULL);
+  /* still running, so the data is still in use */
+  fail_if (shot->released);
+}
+
+/* The callback runs without the sink locks, so it can replace itself */
+GST_START_TEST (test_app_sink_callback_replaces_itself)
+{
+  GstHarness *h = setup_app_sink (8);
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (h->element);
+  OneShot shot = { 0, FALSE };
+
+  dlb_light_app_sink_set_callback (sink, one_shot_frame, &shot,
+      one_shot_release);
+
+  for (guint i = 0; i < 3; i++)
+    gst_harness_push (h, lsm_test_make_light_frame (i,
+            i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless_equals_int (shot.calls, 1);
+  fail_unless (shot.released);
+  for (guint i = 1; i < 3; i++) {
+    DlbLightAppFrame *frame = dlb_light_app_sink_pop (sink);
+
+    fail_unless (frame != NULL);
+    fail_unless_equals_uint64 (frame->pts, i * LSM_TEST_FRAME_PERIOD);
+    dlb_light_app_frame_unref (frame);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_app_sink_flush)
+{
+  GstHarness *h = setup_app_sink (8);
+  DlbLightAppSink *sink = DLB_LIGHT_APP_SINK (h->element);
+  GstSegment segment;
+  DlbLightAppFrame *frame;
+
+  for (guint i = 0; i < 2; i++)
+    gst_harness_push (h, lsm_test_make_light_frame (i,
+            i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  fail_unless (dlb_light_app_sink_pop (sink) == NULL);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+  gst_harness_push (h, lsm_test_make_light_frame (2, 0));
+  frame = dlb_light_app_sink_pop (sink);
+  fail_unless (frame != NULL);
+  fail_unless_equals_uint64 (frame->pts, 0);
+  dlb_light_app_frame_unref (frame);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightappsink_suite (void)
+{
+  Suite *s = suite_create ("dlblightappsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_app_sink_pop);
+  tcase_add_test (tc_chain, test_app_sink_drops_when_full);
+  tcase_add_test (tc_chain, test_app_sink_callback);
+  tcase_add_test (tc_chain, test_app_sink_callback_replaces_itself);
+  tcase_add_test (tc_chain, test_app_sink_flush);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightappsink);
@@ -0,0 +1,217 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+
+static gchar *config_path;
+
+static void
+setup (void)
+{
+  config_path = lsm_test_write_config ();
+}
+
+static void
+teardown (void)
+{
+  g_unlink (config_path);
+  g_clear_pointer (&config_path, g_free);
+}
+
+static GstElement *
+setup_light_bin (GstElement ** sink)
+{
+  GstElement *bin = gst_element_factory_make ("dlblightbin", NULL);
+
+  fail_unless (bin != NULL);
+
+  *sink = gst_element_factory_make ("fakesink", "out");
+  g_object_set (*sink, "sync", FALSE, NULL);
+  g_object_set (bin, "config", config_path, "light-sink", *sink, NULL);
+
+  return bin;
+}
+
+static void
+check_queue (GstElement * bin, const gchar * name, guint frames)
+{
+  GstElement *queue = gst_bin_get_by_name (GST_BIN (bin), name);
+  guint64 max_time;
+  guint max_buffers, max_bytes;
+
+  fail_unless (queue != NULL);
+  g_object_get (queue, "max-size-buffers", &max_buffers,
+      "max-size-time", &max_time, "max-size-bytes", &max_bytes, NULL);
+  fail_unless_equals_int (max_buffers, frames);
+  fail_unless_equals_uint64 (max_time, frames * LSM_TEST_FRAME_PERIOD);
+  fail_unless_equals_int (max_bytes, 0);
+  gst_object_unref (queue);
+}
+
+static void
+count_frame (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  g_atomic_int_inc ((gint *) user_data);
+}
+
+GST_START_TEST (test_light_bin_layout)
+{
+  GstElement *sink, *bin = setup_light_bin (&sink);
+  GstElement *lightning, *child;
+  GstPad *pad, *peer;
+
+  fail_unless_equals_int (gst_element_set_state (bin, GST_STATE_READY),
+      GST_STATE_CHANGE_SUCCESS);
+
+  child = gst_bin_get_by_name (GST_BIN (bin), "parse");
+  fail_unless (child != NULL);
+  gst_object_unref (child);
+
+  /* renderer and sink are on either side of the device queue */
+  lightning = gst_bin_get_by_name (GST_BIN (bin), "lightning");
+  fail_unless (lightning != NULL);
+  pad = gst_element_get_static_pad (lightning, "src");
+  peer = gst_pad_get_peer (pad);
+  child = gst_pad_get_parent_element (peer);
+  fail_unless_equals_string (GST_OBJECT_NAME (child), "device-queue");
+  gst_object_unref (child);
+  gst_object_unref (peer);
+  gst_object_unref (pad);
+  gst_object_unref (lightning);
+
+  pad = gst_element_get_static_pad (sink, "sink");
+  peer = gst_pad_get_peer (pad);
+  child = gst_pad_get_parent_element (peer);
+  fail_unless_equals_string (GST_OBJECT_NAME (child), "device-queue");
+  gst_object_unref (child);
+  gst_object_unref (peer);
+  gst_object_unref (pad);
+
+  check_queue (bin, "input-queue", 25);
+  check_queue (bin, "device-queue", 2);
+
+  g_object_set (bin, "input-queue-frames", 10, "device-queue-frames", 3, NULL);
+  check_queue (bin, "input-queue", 10);
+  check_queue (bin, "device-queue", 3);
+
+  /* the sink leaves the bin again in NULL */
+  fail_unless_equals_int (gst_element_set_state (bin, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  child = gst_bin_get_by_name (GST_BIN (bin), "out");
+  fail_unless (child == NULL);
+
+  gst_object_unref (bin);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_light_bin_proxies_properties)
+{
+  GstElement *sink, *bin = setup_light_bin (&sink);
+  GstElement *lightning, *parse;
+  gchar *config;
+  gfloat lightness;
+  guint64 gap_threshold;
+
+  g_object_set (bin, "lightness", 0.5f, "gap-threshold", GST_SECOND, NULL);
+
+  lightning = gst_bin_get_by_name (GST_BIN (bin), "lightning");
+  parse = gst_bin_get_by_name (GST_BIN (bin), "parse");
+
+  g_object_get (lightning, "config", &config, "lightness", &lightness, NULL);
+  fail_unless_equals_string (config, config_path);
+  fail_unless_equals_float (lightness, 0.5f);
+  g_free (config);
+
+  g_object_get (parse, "gap-threshold", &gap_threshold, NULL);
+  fail_unless_equals_uint64 (gap_threshold, GST_SECOND);
+
+  g_object_set (lightning, "lightness", 0.25f, NULL);
+  g_object_get (bin, "lightness", &lightness, NULL);
+  fail_unless_equals_float (lightness, 0.25f);
+
+  gst_object_unref (parse);
+  gst_object_unref (lightning);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_light_bin_plays_frames)
+{
+  GstElement *sink, *bin = setup_light_bin (&sink);
+  GstHarness *h;
+  gint frames = 0;
+
+  g_object_set (sink, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (count_frame), &frames);
+  g_object_set (bin, "input-queue-frames", 5, NULL);
+
+  h = gst_harness_new_with_element (bin, "sink", NULL);
+  gst_harness_set_src_caps (h,
+      lsm_test_make_stream_caps (LSM_TEST_MAX_OBJECTS,
+          LSM_TEST_FRAME_PERIOD_MS));
+
+  for (guint i = 0; i < 10; i++)
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD)),
+        GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  /* the frames cross two queues to the sink */
+  for (guint i = 0; i < 500 && g_atomic_int_get (&frames) < 10; i++)
+    g_usleep (10 * 1000);
+  fail_unless_equals_int (g_atomic_int_get (&frames), 10);
+
+  /* sized from the negotiated frame period */
+  check_queue (bin, "input-queue", 5);
+  check_queue (bin, "device-queue", 2);
+
+  gst_harness_teardown (h);
+  gst_object_unref (bin);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightbin_suite (void)
+{
+  Suite *s = suite_create ("dlblightbin");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_light_bin_layout);
+  tcase_add_test (tc_chain, test_light_bin_proxies_properties);
+  tcase_add_test (tc_chain, test_light_bin_plays_frames);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightbin);
@@ -0,0 +1,311 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+
+/* RGB strips of two lights */
+#define STRIP_LIGHTS 2
+#define STRIP_SIZE (4 + STRIP_LIGHTS * 3)
+
+/* What reached the sink pad linked to one of the demuxer's pads */
+typedef struct
+{
+  gchar *name;
+  GstPad *sinkpad;
+  GQueue buffers;
+  GQueue gaps;
+} DemuxOutput;
+
+typedef struct
+{
+  GstHarness *h;
+  GPtrArray *outputs;
+  gboolean no_more_pads;
+} DemuxTest;
+
+/* A frame with one strip per id, the lights of each filled with its id */
+static GstBuffer *
+make_strips_frame (const guint8 * ids, guint n_strips, GstClockTime pts)
+{
+  gsize size = 2 + n_strips * STRIP_SIZE;
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, size, NULL);
+  GstMapInfo map;
+  guint8 *strip;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT16_LE (map.data, n_strips);
+  strip = map.data + 2;
+  for (guint i = 0; i < n_strips; i++) {
+    strip[0] = ids[i];
+    GST_WRITE_UINT16_LE (strip + 1, STRIP_LIGHTS);
+    strip[3] = 0;
+    memset (strip + 4, ids[i], STRIP_LIGHTS * 3);
+    strip += STRIP_SIZE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+static GstFlowReturn
+output_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  DemuxOutput *output = gst_pad_get_element_private (pad);
+
+  g_queue_push_tail (&output->buffers, buf);
+  return GST_FLOW_OK;
+}
+
+static gboolean
+output_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  DemuxOutput *output = gst_pad_get_element_private (pad);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_GAP)
+    g_queue_push_tail (&output->gaps, event);
+  else
+    gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* Emitted from the streaming thread, which is the test thread here */
+static void
+pad_added (GstElement * element, GstPad * pad, DemuxTest * test)
+{
+  DemuxOutput *output = g_new0 (DemuxOutput, 1);
+
+  output->name = gst_pad_get_name (pad);
+  output->sinkpad = gst_pad_new (output->name, GST_PAD_SINK);
+  gst_pad_set_element_private (output->sinkpad, output);
+  gst_pad_set_chain_function (output->sinkpad, output_chain);
+  gst_pad_set_event_function (output->sinkpad, output_event);
+  gst_pad_set_active (output->sinkpad, TRUE);
+  fail_unless_equals_int (gst_pad_link (pad, output->sinkpad),
+      GST_PAD_LINK_OK);
+
+  g_ptr_array_add (test->outputs, output);
+}
+
+static void
+no_more_pads (GstElement * element, DemuxTest * test)
+{
+  fail_if (test->no_more_pads);
+  test->no_more_pads = TRUE;
+}
+
+static void
+demux_output_free (DemuxOutput * output)
+{
+  GstMiniObject *obj;
+
+  while ((obj = g_queue_pop_head (&output->buffers)))
+    gst_mini_object_unref (obj);
+  while ((obj = g_queue_pop_head (&output->gaps)))
+    gst_mini_object_unref (obj);
+  gst_pad_set_active (output->sinkpad, FALSE);
+  gst_object_unref (output->sinkpad);
+  g_free (output->name);
+  g_free (output);
+}
+
+static void
+setup_demux (DemuxTest * test)
+{
+  test->h = gst_harness_new_with_padnames ("dlblightdemux", "sink", NULL);
+  test->outputs = g_ptr_array_new_with_free_func
+      ((GDestroyNotify) demux_output_free);
+  test->no_more_pads = FALSE;
+
+  g_signal_connect (test->h->element, "pad-added", G_CALLBACK (pad_added),
+      test);
+  g_signal_connect (test->h->element, "no-more-pads",
+      G_CALLBACK (no_more_pads), test);
+  gst_harness_set_src_caps_str (test->h, LSM_TEST_LIGHT_CAPS);
+}
+
+static void
+teardown_demux (DemuxTest * test)
+{
+  gst_harness_teardown (test->h);
+  g_ptr_array_unref (test->outputs);
+}
+
+static DemuxOutput *
+get_output (DemuxTest * test, const gchar * name)
+{
+  for (guint i = 0; i < test->outputs->len; i++) {
+    DemuxOutput *output = g_ptr_array_index (test->outputs, i);
+
+    if (g_strcmp0 (output->name, name) == 0)
+      return output;
+  }
+
+  fail ("no pad %s", name);
+  return NULL;
+}
+
+/* Checks that the next buffer of @output holds the single strip @id */
+static void
+check_strip (DemuxOutput * output, guint8 id, GstClockTime pts)
+{
+  GstBuffer *buf = g_queue_pop_head (&output->buffers);
+  GstBuffer *expected;
+  GstMapInfo map;
+
+  fail_unless (buf != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), pts);
+
+  expected = make_strips_frame (&id, 1, pts);
+  gst_buffer_map (expected, &map, GST_MAP_READ);
+  fail_unless_equals_int (gst_buffer_get_size (buf), map.size);
+  fail_unless (gst_buffer_memcmp (buf, 0, map.data, map.size) == 0);
+  gst_buffer_unmap (expected, &map);
+
+  gst_buffer_unref (expected);
+  gst_buffer_unref (buf);
+}
+
+/* A malformed frame creates no pads, the first valid one creates a pad per
+ * strip and signals no-more-pads */
+GST_START_TEST (test_demux_pads_on_first_valid_frame)
+{
+  static const guint8 ids[] = { 1, 2 };
+  DemuxTest test;
+  GstBuffer *buf;
+
+  setup_demux (&test);
+
+  /* the second strip is cut short */
+  buf = make_strips_frame (ids, 2, 0);
+  gst_buffer_resize (buf, 0, gst_buffer_get_size (buf) - 1);
+  fail_unless_equals_int (gst_harness_push (test.h, buf), GST_FLOW_OK);
+  fail_unless_equals_int (test.outputs->len, 0);
+  fail_if (test.no_more_pads);
+
+  fail_unless_equals_int (gst_harness_push (test.h,
+          make_strips_frame (ids, 2, LSM_TEST_FRAME_PERIOD)), GST_FLOW_OK);
+  fail_unless_equals_int (test.outputs->len, 2);
+  fail_unless (test.no_more_pads);
+
+  check_strip (get_output (&test, "strip_1"), 1, LSM_TEST_FRAME_PERIOD);
+  check_strip (get_output (&test, "strip_2"), 2, LSM_TEST_FRAME_PERIOD);
+
+  teardown_demux (&test);
+}
+
+GST_END_TEST;
+
+/* Pads without data in a frame get a GAP for it, and strips first seen
+ * after no-more-pads get no pad */
+GST_START_TEST (test_demux_gap_for_missing_strip)
+{
+  static const guint8 ids[] = { 1, 2 };
+  static const guint8 later_ids[] = { 1, 3 };
+  DemuxTest test;
+  DemuxOutput *strip_1, *strip_2;
+  GstClockTime pts, duration;
+  GstEvent *gap;
+
+  setup_demux (&test);
+
+  fail_unless_equals_int (gst_harness_push (test.h,
+          make_strips_frame (ids, 2, 0)), GST_FLOW_OK);
+  strip_1 = get_output (&test, "strip_1");
+  strip_2 = get_output (&test, "strip_2");
+  check_strip (strip_1, 1, 0);
+  check_strip (strip_2, 2, 0);
+
+  pts = LSM_TEST_FRAME_PERIOD;
+  fail_unless_equals_int (gst_harness_push (test.h,
+          make_strips_frame (later_ids, 2, pts)), GST_FLOW_OK);
+  fail_unless_equals_int (test.outputs->len, 2);
+
+  check_strip (strip_1, 1, pts);
+  fail_unless (g_queue_is_empty (&strip_1->gaps));
+
+  fail_unless (g_queue_is_empty (&strip_2->buffers));
+  gap = g_queue_pop_head (&strip_2->gaps);
+  fail_unless (gap != NULL);
+  gst_event_parse_gap (gap, &pts, &duration);
+  fail_unless_equals_uint64 (pts, LSM_TEST_FRAME_PERIOD);
+  fail_unless_equals_uint64 (duration, LSM_TEST_FRAME_PERIOD);
+  gst_event_unref (gap);
+
+  teardown_demux (&test);
+}
+
+GST_END_TEST;
+
+/* A malformed frame after the pads exist is a GAP on every pad */
+GST_START_TEST (test_demux_drops_invalid_frame)
+{
+  static const guint8 ids[] = { 1, 2 };
+  DemuxTest test;
+  GstBuffer *buf;
+
+  setup_demux (&test);
+
+  fail_unless_equals_int (gst_harness_push (test.h,
+          make_strips_frame (ids, 2, 0)), GST_FLOW_OK);
+
+  buf = make_strips_frame (ids, 2, LSM_TEST_FRAME_PERIOD);
+  gst_buffer_resize (buf, 0, gst_buffer_get_size (buf) - 1);
+  fail_unless_equals_int (gst_harness_push (test.h, buf), GST_FLOW_OK);
+
+  for (guint i = 0; i < test.outputs->len; i++) {
+    DemuxOutput *output = g_ptr_array_index (test.outputs, i);
+
+    fail_unless_equals_int (g_queue_get_length (&output->buffers), 1);
+    fail_unless_equals_int (g_queue_get_length (&output->gaps), 1);
+  }
+
+  teardown_demux (&test);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightdemux_suite (void)
+{
+  Suite *s = suite_create ("dlblightdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_demux_pads_on_first_valid_frame);
+  tcase_add_test (tc_chain, test_demux_gap_for_missing_strip);
+  tcase_add_test (tc_chain, test_demux_drops_invalid_frame);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightdemux);
@@ -0,0 +1,261 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+#include "dlblightblend.h"
+
+/* one RGB strip, long enough for the vector kernels and a scalar tail */
+#define NUM_LIGHTS 10
+#define FRAME_SIZE (2 + 4 + NUM_LIGHTS * 3)
+
+static GstBuffer *
+make_frame (guint8 value, GstClockTime pts)
+{
+  guint8 frame[FRAME_SIZE] = { 1, 0, 0, NUM_LIGHTS, 0, 0 };
+  GstBuffer *buf;
+
+  memset (frame + 6, value, FRAME_SIZE - 6);
+  buf = gst_buffer_new_allocate (NULL, sizeof (frame), NULL);
+  gst_buffer_fill (buf, 0, frame, sizeof (frame));
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+/* Pulls an output frame and checks all its lights have @value */
+static void
+pull_frame (GstHarness * h, guint8 value, GstClockTime pts)
+{
+  GstBuffer *buf = gst_harness_pull (h);
+  GstMapInfo map;
+
+  fail_unless (buf != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), pts);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.size, FRAME_SIZE);
+  fail_unless_equals_int (map.data[3], NUM_LIGHTS);
+  for (gsize i = 6; i < map.size; i++)
+    fail_unless_equals_int (map.data[i], value);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+}
+
+static void
+set_pad (GstHarness * h, const gchar * name, const gchar * first, ...)
+{
+  GstPad *pad = gst_element_get_static_pad (h->element, name);
+  va_list args;
+
+  fail_unless (pad != NULL);
+  va_start (args, first);
+  g_object_set_valist (G_OBJECT (pad), first, args);
+  va_end (args);
+  gst_object_unref (pad);
+}
+
+static GstHarness *
+setup_mixer (GstHarness ** top)
+{
+  GstHarness *h = gst_harness_new_with_padnames ("dlblightmixer", "sink_0",
+      "src");
+
+  *top = gst_harness_new_with_element (h->element, "sink_1", NULL);
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+  gst_harness_set_src_caps_str (*top, LSM_TEST_LIGHT_CAPS);
+
+  return h;
+}
+
+static void
+blend_reference (DlbLightBlendMode mode, guint8 * dst, const guint8 * src,
+    gsize size, guint alpha)
+{
+  for (gsize i = 0; i < size; i++) {
+    guint s = (src[i] * alpha + 128) >> 8;
+
+    switch (mode) {
+      case DLB_LIGHT_BLEND_ALPHA:
+        dst[i] = (dst[i] * (256 - alpha) + src[i] * alpha + 128) >> 8;
+        break;
+      case DLB_LIGHT_BLEND_MAX:
+        dst[i] = MAX (dst[i], s);
+        break;
+      case DLB_LIGHT_BLEND_ADD:
+        dst[i] = MIN (dst[i] + s, 255);
+        break;
+    }
+  }
+}
+
+/* The vector kernels and their scalar tails agree with the plain formulas
+ * for every alpha, size and alignment */
+GST_START_TEST (test_mixer_blend_kernels)
+{
+  GRand *rand = g_rand_new_with_seed (42);
+  guint8 src[80], dst[80], ref[80];
+
+  for (gint mode = DLB_LIGHT_BLEND_ALPHA; mode <= DLB_LIGHT_BLEND_ADD; mode++) {
+    for (guint alpha = 0; alpha <= DLB_LIGHT_BLEND_ALPHA_OPAQUE; alpha++) {
+      gsize offset = g_rand_int_range (rand, 0, 8);
+      gsize size = g_rand_int_range (rand, 0, sizeof (src) - 8);
+
+      for (gsize i = 0; i < sizeof (src); i++) {
+        src[i] = g_rand_int (rand);
+        dst[i] = ref[i] = g_rand_int (rand);
+      }
+
+      blend_reference (mode, ref + offset, src + offset, size, alpha);
+      dlb_light_blend_values (mode, dst + offset, src + offset, size, alpha);
+      fail_unless (memcmp (dst, ref, sizeof (dst)) == 0,
+          "mode %d, alpha %u, size %" G_GSIZE_FORMAT, mode, alpha, size);
+    }
+  }
+
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mixer_priority_alpha)
+{
+  GstHarness *top;
+  GstHarness *h = setup_mixer (&top);
+
+  /* sink_1 is requested last but goes below sink_0 */
+  set_pad (h, "sink_0", "priority", 1, "alpha", 0.5, NULL);
+
+  gst_harness_push (h, make_frame (200, 0));
+  gst_harness_push (top, make_frame (100, 0));
+  pull_frame (h, 150, 0);
+
+  /* opaque on top */
+  set_pad (h, "sink_0", "alpha", 1.0, NULL);
+  gst_harness_push (h, make_frame (200, LSM_TEST_FRAME_PERIOD));
+  gst_harness_push (top, make_frame (100, LSM_TEST_FRAME_PERIOD));
+  pull_frame (h, 200, LSM_TEST_FRAME_PERIOD);
+
+  gst_harness_teardown (top);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mixer_blend_modes)
+{
+  GstHarness *top;
+  GstHarness *h = setup_mixer (&top);
+
+  set_pad (h, "sink_1", "priority", 1, "blend", DLB_LIGHT_BLEND_ADD, NULL);
+  gst_harness_push (h, make_frame (100, 0));
+  gst_harness_push (top, make_frame (200, 0));
+  pull_frame (h, 255, 0);
+
+  set_pad (h, "sink_1", "blend", DLB_LIGHT_BLEND_MAX, NULL);
+  gst_harness_push (h, make_frame (100, LSM_TEST_FRAME_PERIOD));
+  gst_harness_push (top, make_frame (50, LSM_TEST_FRAME_PERIOD));
+  pull_frame (h, 100, LSM_TEST_FRAME_PERIOD);
+
+  gst_harness_teardown (top);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* An input with a hole keeps its last frame up */
+GST_START_TEST (test_mixer_holds_sparse_input)
+{
+  GstHarness *top;
+  GstHarness *h = setup_mixer (&top);
+
+  set_pad (h, "sink_1", "priority", 1, "blend", DLB_LIGHT_BLEND_MAX, NULL);
+
+  gst_harness_push (h, make_frame (10, 0));
+  gst_harness_push (top, make_frame (200, 0));
+  pull_frame (h, 200, 0);
+
+  fail_unless (gst_harness_push_event (top,
+          gst_event_new_gap (LSM_TEST_FRAME_PERIOD,
+              2 * LSM_TEST_FRAME_PERIOD)));
+  for (guint i = 1; i < 3; i++) {
+    gst_harness_push (h, make_frame (10, i * LSM_TEST_FRAME_PERIOD));
+    pull_frame (h, 200, i * LSM_TEST_FRAME_PERIOD);
+  }
+
+  gst_harness_teardown (top);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mixer_fade)
+{
+  GstHarness *top;
+  GstHarness *h = setup_mixer (&top);
+
+  set_pad (h, "sink_1", "priority", 1, "alpha", 0.0, NULL);
+
+  gst_harness_push (h, make_frame (0, 0));
+  gst_harness_push (top, make_frame (200, 0));
+  pull_frame (h, 0, 0);
+
+  /* faded in over two frames, starting with the next one */
+  set_pad (h, "sink_1", "alpha", 1.0, "fade-duration",
+      2 * LSM_TEST_FRAME_PERIOD, NULL);
+  for (guint i = 1; i < 4; i++) {
+    gst_harness_push (h, make_frame (0, i * LSM_TEST_FRAME_PERIOD));
+    gst_harness_push (top, make_frame (200, i * LSM_TEST_FRAME_PERIOD));
+  }
+  pull_frame (h, 0, LSM_TEST_FRAME_PERIOD);
+  pull_frame (h, 100, 2 * LSM_TEST_FRAME_PERIOD);
+  pull_frame (h, 200, 3 * LSM_TEST_FRAME_PERIOD);
+
+  gst_harness_teardown (top);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightmixer_suite (void)
+{
+  Suite *s = suite_create ("dlblightmixer");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_mixer_blend_kernels);
+  tcase_add_test (tc_chain, test_mixer_priority_alpha);
+  tcase_add_test (tc_chain, test_mixer_blend_modes);
+  tcase_add_test (tc_chain, test_mixer_holds_sparse_input);
+  tcase_add_test (tc_chain, test_mixer_fade);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightmixer);
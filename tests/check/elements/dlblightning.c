@@ -0,0 +1,677 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "dlblightmeta.h"
+#include "../lsmtestutils.h"
+
+/* output of the stand-in renderer: 8 RGB and 4 RGBW lights */
+#define FAKE_OUTPUT_SIZE (2 + (4 + 8 * 3) + (4 + 4 * 4))
+
+static gchar *config_path;
+
+static void
+setup (void)
+{
+  config_path = lsm_test_write_config ();
+}
+
+static void
+teardown (void)
+{
+  g_unlink (config_path);
+  g_clear_pointer (&config_path, g_free);
+}
+
+/* The harness starts the element right away, so properties read on start
+ * are set on the element before it is wrapped. */
+static GstHarness *
+setup_lightning_full (GstAllocator * allocator, const gchar * first_property,
+    ...)
+{
+  GstElement *element = gst_element_factory_make ("dlblightning", NULL);
+  GstHarness *h;
+  va_list args;
+
+  g_object_set (element, "config", config_path, NULL);
+  va_start (args, first_property);
+  g_object_set_valist (G_OBJECT (element), first_property, args);
+  va_end (args);
+
+  h = gst_harness_new_with_element (element, "sink", "src");
+  gst_object_unref (element);
+  if (allocator)
+    gst_harness_set_propose_allocator (h, gst_object_ref (allocator), NULL);
+  gst_harness_set_src_caps_str (h, LSM_TEST_PARSED_CAPS);
+
+  return h;
+}
+
+static GstHarness *
+setup_lightning (GstAllocator * allocator)
+{
+  return setup_lightning_full (allocator, NULL);
+}
+
+static gboolean
+buffers_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo map;
+  gboolean equal;
+
+  if (gst_buffer_get_size (a) != gst_buffer_get_size (b))
+    return FALSE;
+
+  gst_buffer_map (a, &map, GST_MAP_READ);
+  equal = gst_buffer_memcmp (b, 0, map.data, map.size) == 0;
+  gst_buffer_unmap (a, &map);
+
+  return equal;
+}
+
+GST_START_TEST (test_lightning_renders_frames)
+{
+  GstHarness *h = setup_lightning (NULL);
+
+  for (guint i = 0; i < 10; i++)
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD)),
+        GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 10);
+
+  for (guint i = 0; i < 10; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    DlbLightLayoutMeta *meta = dlb_buffer_get_light_layout_meta (buf);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_int (gst_buffer_get_size (buf), FAKE_OUTPUT_SIZE);
+
+    fail_unless (meta != NULL);
+    fail_unless_equals_int (meta->layout->frame_size, FAKE_OUTPUT_SIZE);
+    fail_unless_equals_int (meta->layout->num_strips, 2);
+    fail_unless_equals_int (meta->layout->strips[0].format,
+        DLB_LIGHT_FORMAT_RGB);
+    fail_unless_equals_int (meta->layout->strips[0].num_lights, 8);
+    fail_unless_equals_int (meta->layout->strips[1].format,
+        DLB_LIGHT_FORMAT_RGBW);
+    fail_unless_equals_int (meta->layout->strips[1].num_lights, 4);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* The stand-in renderer carries state from frame to frame, so the same
+ * input only renders the same output again after a reset. */
+GST_START_TEST (test_lightning_reset_on_flush)
+{
+  GstHarness *h = setup_lightning (NULL);
+  GstBuffer *first, *second, *after_flush;
+  GstSegment segment;
+
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+  gst_harness_push (h, lsm_test_make_frame (0, 4, LSM_TEST_FRAME_PERIOD));
+  first = gst_harness_pull (h);
+  second = gst_harness_pull (h);
+  fail_if (buffers_equal (first, second));
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+  after_flush = gst_harness_pull (h);
+  fail_unless (buffers_equal (first, after_flush));
+
+  gst_buffer_unref (first);
+  gst_buffer_unref (second);
+  gst_buffer_unref (after_flush);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* After a seek the frames in front of the new position come in flagged
+ * DECODE_ONLY. They only build up the renderer state, so the first visible
+ * frames match a run that played from the start. */
+GST_START_TEST (test_lightning_seek_warmup)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning (NULL);
+  const guint frames = 12, warmup = 5;
+  GstSegment segment;
+  guint64 recovery;
+
+  /* stale state from the old position */
+  for (guint i = 0; i < 8; i++)
+    gst_harness_push (h, lsm_test_make_frame (100 + i, 4,
+            (100 + i) * LSM_TEST_FRAME_PERIOD));
+  while (gst_harness_buffers_in_queue (h) > 0)
+    gst_buffer_unref (gst_harness_pull (h));
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  segment.start = warmup * LSM_TEST_FRAME_PERIOD;
+  segment.time = segment.start;
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  for (guint i = 0; i < frames; i++) {
+    GstBuffer *frame = lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD);
+
+    gst_harness_push (ref, gst_buffer_copy (frame));
+    if (i < warmup)
+      GST_BUFFER_FLAG_SET (frame, GST_BUFFER_FLAG_DECODE_ONLY);
+    gst_harness_push (h, frame);
+  }
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), frames - warmup);
+  for (guint i = 0; i < frames; i++) {
+    GstBuffer *expected = gst_harness_pull (ref);
+    GstBuffer *buf;
+
+    if (i < warmup) {
+      gst_buffer_unref (expected);
+      continue;
+    }
+
+    buf = gst_harness_pull (h);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless (buffers_equal (expected, buf));
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  g_object_get (h->element, "seek-recovery-time", &recovery, NULL);
+  fail_unless (recovery > 0);
+
+  gst_harness_teardown (ref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_lightning_render_cache)
+{
+  GstHarness *h = setup_lightning_full (NULL,
+      "render-cache-size", (guint64) 64 * 1024, NULL);
+  GstBuffer *bufs[3];
+  guint64 hits, misses;
+
+  for (guint i = 0; i < G_N_ELEMENTS (bufs); i++) {
+    gst_harness_push (h, lsm_test_make_frame (7, 4, i * LSM_TEST_FRAME_PERIOD));
+    bufs[i] = gst_harness_pull (h);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (bufs[i]),
+        i * LSM_TEST_FRAME_PERIOD);
+  }
+
+  g_object_get (h->element, "render-cache-hits", &hits,
+      "render-cache-misses", &misses, NULL);
+  fail_unless_equals_uint64 (hits, 2);
+  fail_unless_equals_uint64 (misses, 1);
+  fail_unless (buffers_equal (bufs[0], bufs[1]));
+  fail_unless (buffers_equal (bufs[0], bufs[2]));
+
+  for (guint i = 0; i < G_N_ELEMENTS (bufs); i++)
+    gst_buffer_unref (bufs[i]);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A cache hit is not seen by the renderer, the next frame is rendered from
+ * a clean state instead of the state before the hit */
+GST_START_TEST (test_lightning_render_cache_reset)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning_full (NULL,
+      "render-cache-size", (guint64) 64 * 1024, NULL);
+  GstBuffer *expected, *buf;
+  guint64 hits;
+
+  gst_harness_push (ref, lsm_test_make_frame (8, 4, 0));
+  expected = gst_harness_pull (ref);
+
+  gst_harness_push (h, lsm_test_make_frame (7, 4, 0));
+  gst_harness_push (h, lsm_test_make_frame (7, 4, LSM_TEST_FRAME_PERIOD));
+  gst_harness_push (h, lsm_test_make_frame (8, 4, 2 * LSM_TEST_FRAME_PERIOD));
+  gst_buffer_unref (gst_harness_pull (h));
+  gst_buffer_unref (gst_harness_pull (h));
+  buf = gst_harness_pull (h);
+
+  g_object_get (h->element, "render-cache-hits", &hits, NULL);
+  fail_unless_equals_uint64 (hits, 1);
+  fail_unless (buffers_equal (buf, expected));
+
+  gst_buffer_unref (buf);
+  gst_buffer_unref (expected);
+  gst_harness_teardown (h);
+  gst_harness_teardown (ref);
+}
+
+GST_END_TEST;
+
+/* Frames are held back by the queue depth and come out unchanged */
+GST_START_TEST (test_lightning_render_ahead)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning_full (NULL, "render-ahead", 3, NULL);
+  const guint frames = 10;
+
+  for (guint i = 0; i < frames; i++) {
+    gst_harness_push (ref, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  }
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), frames - 3);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), frames);
+
+  for (guint i = 0; i < frames; i++) {
+    GstBuffer *expected = gst_harness_pull (ref);
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless (buffers_equal (expected, buf));
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (ref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A flush drops the frames rendered ahead, rendering starts over after it */
+GST_START_TEST (test_lightning_render_ahead_flush)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning_full (NULL, "render-ahead", 3, NULL);
+  GstBuffer *expected, *buf;
+  GstSegment segment;
+
+  for (guint i = 0; i < 5; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+  gst_buffer_unref (gst_harness_pull (h));
+  gst_buffer_unref (gst_harness_pull (h));
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  gst_harness_push (ref, lsm_test_make_frame (0, 4, 0));
+  expected = gst_harness_pull (ref);
+
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+  buf = gst_harness_pull (h);
+  fail_unless (buffers_equal (expected, buf));
+
+  gst_buffer_unref (expected);
+  gst_buffer_unref (buf);
+  gst_harness_teardown (ref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstPadProbeReturn
+count_lists (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_atomic_int_inc ((gint *) user_data);
+  return GST_PAD_PROBE_OK;
+}
+
+/* A list is rendered in one pass and pushed on as a list, with the same
+ * output as rendering the frames one by one */
+GST_START_TEST (test_lightning_buffer_list)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning (NULL);
+  const guint frames = 10;
+  GstBufferList *list;
+  gint lists = 0;
+
+  gst_pad_add_probe (h->sinkpad, GST_PAD_PROBE_TYPE_BUFFER_LIST, count_lists,
+      &lists, NULL);
+
+  /* the first buffer goes through negotiation on its own */
+  gst_harness_push (ref, lsm_test_make_frame (0, 4, 0));
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+
+  list = gst_buffer_list_new_sized (frames);
+  for (guint i = 1; i < frames; i++) {
+    gst_harness_push (ref, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_buffer_list_add (list,
+        lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  }
+  fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+
+  fail_unless_equals_int (g_atomic_int_get (&lists), 1);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), frames);
+
+  for (guint i = 0; i < frames; i++) {
+    GstBuffer *expected = gst_harness_pull (ref);
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless (buffers_equal (expected, buf));
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (ref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A discontinuity in a list goes through the base class, buffer by buffer */
+GST_START_TEST (test_lightning_buffer_list_discont)
+{
+  GstHarness *h = setup_lightning (NULL);
+  GstBufferList *list;
+  GstBuffer *buf;
+  gint lists = 0;
+
+  gst_pad_add_probe (h->sinkpad, GST_PAD_PROBE_TYPE_BUFFER_LIST, count_lists,
+      &lists, NULL);
+
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+
+  list = gst_buffer_list_new_sized (3);
+  for (guint i = 1; i < 4; i++) {
+    buf = lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD);
+    if (i == 2)
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DISCONT);
+    gst_buffer_list_add (list, buf);
+  }
+  fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+
+  fail_unless_equals_int (g_atomic_int_get (&lists), 0);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 4);
+
+  for (guint i = 0; i < 4; i++) {
+    buf = gst_harness_pull (h);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    if (i == 2)
+      fail_unless (GST_BUFFER_IS_DISCONT (buf));
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A lightness change applies from the next frame to be rendered: the frames
+ * rendered ahead keep the old lightness, and the renderer sees every frame
+ * once, as when rendering on the streaming thread. */
+GST_START_TEST (test_lightning_render_ahead_lightness)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  GstHarness *h = setup_lightning_full (NULL, "render-ahead", 3, NULL);
+  const guint frames = 8;
+  guint level = 0;
+
+  for (guint i = 0; i < 4; i++) {
+    gst_harness_push (ref, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  }
+
+  while (level < 3) {
+    g_usleep (1000);
+    g_object_get (h->element, "render-ahead-level", &level, NULL);
+  }
+
+  g_object_set (ref->element, "lightness", 0.5f, NULL);
+  g_object_set (h->element, "lightness", 0.5f, NULL);
+  for (guint i = 4; i < frames; i++) {
+    gst_harness_push (ref, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), frames);
+
+  for (guint i = 0; i < frames; i++) {
+    GstBuffer *expected = gst_harness_pull (ref);
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless (buffers_equal (expected, buf), "frame %u differs from the "
+        "streaming thread rendering", i);
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (ref);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Renders a few frames and compares them with a run without prewarm */
+static void
+check_prewarm (GstHarness * h, gboolean expect_prewarmed)
+{
+  GstHarness *ref = setup_lightning (NULL);
+  gboolean prewarmed;
+
+  for (guint i = 0; i < 3; i++) {
+    GstBuffer *expected, *buf;
+
+    gst_harness_push (ref, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    expected = gst_harness_pull (ref);
+    buf = gst_harness_pull (h);
+    fail_unless (buffers_equal (expected, buf));
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  g_object_get (h->element, "renderer-prewarmed", &prewarmed, NULL);
+  fail_unless_equals_int (prewarmed, expect_prewarmed);
+
+  gst_harness_teardown (ref);
+}
+
+GST_START_TEST (test_lightning_prewarm)
+{
+  GstHarness *h = setup_lightning_full (NULL, "prewarm", TRUE,
+      "expected-max-objects", LSM_TEST_MAX_OBJECTS,
+      "expected-color-space", 0,
+      "expected-frame-period", (gint) LSM_TEST_FRAME_PERIOD_MS * 1000, NULL);
+
+  check_prewarm (h, TRUE);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_lightning_prewarm_hint)
+{
+  gchar *hint_path = NULL;
+  gchar *hint = g_strdup_printf ("[stream]\nmax-objects=%d\ncolor-space=0\n"
+      "frame-period=%d\n", LSM_TEST_MAX_OBJECTS,
+      (gint) LSM_TEST_FRAME_PERIOD_MS * 1000);
+  gint fd = g_file_open_tmp ("dlblightning-hint-XXXXXX.ini", &hint_path, NULL);
+  GstHarness *h;
+
+  fail_unless (fd >= 0);
+  g_close (fd, NULL);
+  fail_unless (g_file_set_contents (hint_path, hint, -1, NULL));
+
+  h = setup_lightning_full (NULL, "prewarm", TRUE, "prewarm-hint", hint_path,
+      NULL);
+  check_prewarm (h, TRUE);
+
+  gst_harness_teardown (h);
+  g_unlink (hint_path);
+  g_free (hint_path);
+  g_free (hint);
+}
+
+GST_END_TEST;
+
+/* A renderer prewarmed for other parameters is not used */
+GST_START_TEST (test_lightning_prewarm_mismatch)
+{
+  GstHarness *h = setup_lightning_full (NULL, "prewarm", TRUE,
+      "expected-max-objects", LSM_TEST_MAX_OBJECTS / 2,
+      "expected-color-space", 0,
+      "expected-frame-period", (gint) LSM_TEST_FRAME_PERIOD_MS * 1000, NULL);
+
+  check_prewarm (h, FALSE);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_lightning_allocations)
+{
+  GstAllocator *allocator = lsm_test_counting_allocator_new ();
+  GstHarness *h = setup_lightning (allocator);
+  const guint frames = 50;
+  guint64 allocations;
+
+  for (guint i = 0; i < frames; i++) {
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+
+  allocations = lsm_test_counting_allocator_get_count (allocator);
+  fail_unless (allocations > 0, "proposed allocator was not used");
+  lsm_test_check_baseline ("dlblightning", "allocations-per-frame",
+      (gdouble) allocations / frames);
+
+  gst_harness_teardown (h);
+  gst_object_unref (allocator);
+}
+
+GST_END_TEST;
+
+/* Two elements rendering at once on the one shared pool each get the output
+ * of their own renderer */
+typedef struct
+{
+  GstHarness *h;
+  guint seed;
+  guint frames;
+} PoolStream;
+
+static gpointer
+push_pool_stream (gpointer data)
+{
+  PoolStream *stream = data;
+
+  for (guint i = 0; i < stream->frames; i++)
+    gst_harness_push (stream->h, lsm_test_make_frame (stream->seed + i, 4,
+            i * LSM_TEST_FRAME_PERIOD));
+
+  return NULL;
+}
+
+GST_START_TEST (test_lightning_shared_render_pool)
+{
+  PoolStream streams[2];
+  GThread *threads[2];
+  const guint frames = 30;
+
+  for (guint s = 0; s < G_N_ELEMENTS (streams); s++) {
+    streams[s].h = setup_lightning_full (NULL, "shared-render-pool", TRUE,
+        NULL);
+    streams[s].seed = s * 1000;
+    streams[s].frames = frames;
+  }
+
+  for (guint s = 0; s < G_N_ELEMENTS (streams); s++)
+    threads[s] = g_thread_new ("pool-stream", push_pool_stream, &streams[s]);
+  for (guint s = 0; s < G_N_ELEMENTS (streams); s++)
+    g_thread_join (threads[s]);
+
+  for (guint s = 0; s < G_N_ELEMENTS (streams); s++) {
+    GstHarness *ref = setup_lightning (NULL);
+
+    fail_unless_equals_int (gst_harness_buffers_in_queue (streams[s].h),
+        frames);
+    for (guint i = 0; i < frames; i++) {
+      GstBuffer *expected, *buf;
+
+      gst_harness_push (ref, lsm_test_make_frame (streams[s].seed + i, 4,
+              i * LSM_TEST_FRAME_PERIOD));
+      expected = gst_harness_pull (ref);
+      buf = gst_harness_pull (streams[s].h);
+
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+          i * LSM_TEST_FRAME_PERIOD);
+      fail_unless (buffers_equal (expected, buf));
+      gst_buffer_unref (expected);
+      gst_buffer_unref (buf);
+    }
+    gst_harness_teardown (ref);
+    gst_harness_teardown (streams[s].h);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightning_suite (void)
+{
+  Suite *s = suite_create ("dlblightning");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_lightning_renders_frames);
+  tcase_add_test (tc_chain, test_lightning_reset_on_flush);
+  tcase_add_test (tc_chain, test_lightning_seek_warmup);
+  tcase_add_test (tc_chain, test_lightning_render_cache);
+  tcase_add_test (tc_chain, test_lightning_render_cache_reset);
+  tcase_add_test (tc_chain, test_lightning_render_ahead);
+  tcase_add_test (tc_chain, test_lightning_render_ahead_flush);
+  tcase_add_test (tc_chain, test_lightning_render_ahead_lightness);
+  tcase_add_test (tc_chain, test_lightning_buffer_list);
+  tcase_add_test (tc_chain, test_lightning_buffer_list_discont);
+  tcase_add_test (tc_chain, test_lightning_prewarm);
+  tcase_add_test (tc_chain, test_lightning_prewarm_hint);
+  tcase_add_test (tc_chain, test_lightning_prewarm_mismatch);
+  tcase_add_test (tc_chain, test_lightning_allocations);
+  tcase_add_test (tc_chain, test_lightning_shared_render_pool);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightning);
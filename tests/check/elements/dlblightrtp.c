@@ -0,0 +1,267 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include "../lsmtestutils.h"
+
+#define NUM_STRIPS 3
+#define LIGHTS_PER_STRIP 10
+#define STRIP_SIZE (4 + LIGHTS_PER_STRIP * 3)
+
+/* with 12 bytes of RTP header and 4 of payload header, only one strip of
+ * 34 bytes fits in a packet */
+#define TEST_MTU 80
+
+/* NUM_STRIPS RGB strips, every light of strip i set to values[i] */
+static GstBuffer *
+make_lights (const guint8 values[NUM_STRIPS], guint index)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, 2 + NUM_STRIPS * STRIP_SIZE,
+      NULL);
+  GstMapInfo map;
+  guint8 *strip;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT16_LE (map.data, NUM_STRIPS);
+  strip = map.data + 2;
+  for (guint i = 0; i < NUM_STRIPS; i++) {
+    strip[0] = i;
+    GST_WRITE_UINT16_LE (strip + 1, LIGHTS_PER_STRIP);
+    strip[3] = 0;
+    memset (strip + 4, values[i], STRIP_SIZE - 4);
+    strip += STRIP_SIZE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = index * LSM_TEST_FRAME_PERIOD;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+static void
+assert_lights (GstBuffer * buf, const guint8 values[NUM_STRIPS])
+{
+  GstBuffer *expected = make_lights (values, 0);
+  GstMapInfo map;
+
+  gst_buffer_map (expected, &map, GST_MAP_READ);
+  fail_unless_equals_int (gst_buffer_get_size (buf), map.size);
+  fail_unless (gst_buffer_memcmp (buf, 0, map.data, map.size) == 0);
+  gst_buffer_unmap (expected, &map);
+  gst_buffer_unref (expected);
+}
+
+static void
+setup (GstHarness ** pay, GstHarness ** depay, guint key_interval)
+{
+  GstCaps *caps;
+
+  *pay = gst_harness_new ("dlblightrtppay");
+  g_object_set ((*pay)->element, "mtu", TEST_MTU,
+      "key-interval", key_interval, NULL);
+  gst_harness_set_src_caps_str (*pay, LSM_TEST_LIGHT_CAPS);
+
+  caps = gst_pad_get_current_caps ((*pay)->sinkpad);
+  fail_unless (caps != NULL);
+
+  *depay = gst_harness_new ("dlblightrtpdepay");
+  gst_harness_set_src_caps (*depay, caps);
+}
+
+/* Sends one frame across, dropping the packet at index @drop (-1 for none),
+ * and returns the number of packets the frame took. */
+static guint
+send_frame (GstHarness * pay, GstHarness * depay, GstBuffer * frame, gint drop)
+{
+  guint packets;
+
+  fail_unless_equals_int (gst_harness_push (pay, frame), GST_FLOW_OK);
+  packets = gst_harness_buffers_in_queue (pay);
+
+  for (guint i = 0; i < packets; i++) {
+    GstBuffer *packet = gst_harness_pull (pay);
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+
+    fail_unless (gst_rtp_buffer_map (packet, GST_MAP_READ, &rtp));
+    fail_unless_equals_int (gst_rtp_buffer_get_marker (&rtp), i == packets - 1);
+    gst_rtp_buffer_unmap (&rtp);
+
+    if ((gint) i == drop)
+      gst_buffer_unref (packet);
+    else
+      fail_unless_equals_int (gst_harness_push (depay, packet), GST_FLOW_OK);
+  }
+
+  return packets;
+}
+
+static gboolean
+forward_keyframe_request (GstHarness * pay, GstHarness * depay)
+{
+  GstEvent *event;
+
+  while ((event = gst_harness_try_pull_upstream_event (depay))) {
+    if (gst_event_has_name (event, "GstForceKeyUnit")) {
+      gst_harness_push_upstream_event (pay, event);
+      return TRUE;
+    }
+    gst_event_unref (event);
+  }
+
+  return FALSE;
+}
+
+GST_START_TEST (test_rtp_split_at_strip_boundaries)
+{
+  static const guint8 values[NUM_STRIPS] = { 10, 20, 30 };
+  GstHarness *pay, *depay;
+  GstBuffer *buf;
+
+  setup (&pay, &depay, 1);
+
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (values, 0), -1),
+      NUM_STRIPS);
+
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, values);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (pay);
+  gst_harness_teardown (depay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_rtp_delta_frames_and_concealment)
+{
+  static const guint8 key[NUM_STRIPS] = { 10, 20, 30 };
+  static const guint8 delta[NUM_STRIPS] = { 10, 21, 30 };
+  static const guint8 sent[NUM_STRIPS] = { 11, 21, 31 };
+  static const guint8 held[NUM_STRIPS] = { 10, 21, 31 };
+  GstHarness *pay, *depay;
+  GstBuffer *buf;
+  guint64 concealed;
+
+  /* key frames on request only */
+  setup (&pay, &depay, 0);
+
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (key, 0), -1),
+      NUM_STRIPS);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, key);
+  gst_buffer_unref (buf);
+
+  /* only the changed strip is sent */
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (delta, 1), -1), 1);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, delta);
+  gst_buffer_unref (buf);
+
+  /* an unchanged frame still ticks */
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (delta, 2), -1), 1);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, delta);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 2 * LSM_TEST_FRAME_PERIOD);
+  gst_buffer_unref (buf);
+
+  /* losing strip 0 holds its previous state */
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (sent, 3), 0), 2);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, held);
+  gst_buffer_unref (buf);
+
+  g_object_get (depay->element, "concealed-frames", &concealed, NULL);
+  fail_unless_equals_uint64 (concealed, 1);
+
+  /* the loss triggers a key frame request, which resyncs the receiver */
+  fail_unless (forward_keyframe_request (pay, depay));
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (sent, 4), -1),
+      NUM_STRIPS);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, sent);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (pay);
+  gst_harness_teardown (depay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_rtp_late_joiner)
+{
+  static const guint8 first[NUM_STRIPS] = { 1, 2, 3 };
+  static const guint8 second[NUM_STRIPS] = { 4, 2, 3 };
+  GstHarness *pay, *depay;
+  GstBuffer *buf;
+  guint64 requests;
+
+  setup (&pay, &depay, 0);
+
+  /* the receiver joins after the key frame */
+  fail_unless_equals_int (gst_harness_push (pay, make_lights (first, 0)),
+      GST_FLOW_OK);
+  while (gst_harness_buffers_in_queue (pay) > 0)
+    gst_buffer_unref (gst_harness_pull (pay));
+
+  send_frame (pay, depay, make_lights (second, 1), -1);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (depay), 0);
+
+  g_object_get (depay->element, "keyframe-requests", &requests, NULL);
+  fail_unless_equals_uint64 (requests, 1);
+
+  fail_unless (forward_keyframe_request (pay, depay));
+  fail_unless_equals_int (send_frame (pay, depay, make_lights (second, 2), -1),
+      NUM_STRIPS);
+  buf = gst_harness_pull (depay);
+  assert_lights (buf, second);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (pay);
+  gst_harness_teardown (depay);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightrtp_suite (void)
+{
+  Suite *s = suite_create ("dlblightrtp");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_rtp_split_at_strip_boundaries);
+  tcase_add_test (tc_chain, test_rtp_delta_frames_and_concealment);
+  tcase_add_test (tc_chain, test_rtp_late_joiner);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightrtp);
@@ -0,0 +1,558 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+
+static GstHarness *
+setup_text_sink (void)
+{
+  GstHarness *h = gst_harness_new ("dlblighttextsink");
+
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+
+  return h;
+}
+
+/* The recorder is set up on start, so it is configured before the harness
+ * starts the element. Preroll is not shown, so every frame is recorded
+ * once. */
+static GstHarness *
+setup_recording_text_sink (const gchar * location)
+{
+  GstElement *sink = gst_element_factory_make ("dlblighttextsink", NULL);
+  GstHarness *h;
+
+  g_object_set (sink, "show-preroll-frame", FALSE,
+      "flight-recorder-duration", GST_SECOND,
+      "flight-recorder-location", location, NULL);
+  h = gst_harness_new_with_element (sink, "sink", NULL);
+  gst_object_unref (sink);
+
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+
+  return h;
+}
+
+/* Returns the frame lines of a dump, checking its header */
+static gchar **
+read_dump (const gchar * path)
+{
+  gchar *contents = NULL;
+  gchar **lines, **frames;
+  guint n = 0;
+
+  fail_unless (g_file_get_contents (path, &contents, NULL, NULL));
+  fail_unless (g_str_has_prefix (contents, "# flight recorder of "));
+
+  lines = g_strsplit (contents, "\n", -1);
+  frames = g_new0 (gchar *, g_strv_length (lines) + 1);
+  for (guint i = 0; lines[i]; i++)
+    if (lines[i][0] != '#' && lines[i][0] != '\0')
+      frames[n++] = g_strdup (lines[i]);
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return frames;
+}
+
+static void
+remove_dumps (const gchar * location)
+{
+  GDir *dir = g_dir_open (location, 0, NULL);
+  const gchar *name;
+
+  while ((name = g_dir_read_name (dir))) {
+    gchar *path = g_build_filename (location, name, NULL);
+
+    g_unlink (path);
+    g_free (path);
+  }
+  g_dir_close (dir);
+  g_rmdir (location);
+}
+
+static GstStructure *
+get_jitter_stats (GstHarness * h)
+{
+  GstStructure *stats = NULL;
+
+  g_object_get (h->element, "jitter-stats", &stats, NULL);
+  fail_unless (stats != NULL);
+
+  return stats;
+}
+
+/* The test clock is moved to each frame's presentation time before the
+ * frame is pushed, so the sink never blocks and every frame must be shown
+ * exactly on time. */
+GST_START_TEST (test_text_sink_presents_on_time)
+{
+  GstHarness *h = setup_text_sink ();
+  GstStructure *stats;
+  GstSample *sample = NULL;
+  guint64 frames, max_error;
+  gint64 mean_error;
+
+  for (guint i = 0; i < 25; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    gst_harness_set_time (h, pts);
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, pts)), GST_FLOW_OK);
+  }
+
+  stats = get_jitter_stats (h);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless (gst_structure_get_int64 (stats, "mean-error", &mean_error));
+  fail_unless (gst_structure_get_uint64 (stats, "max-error", &max_error));
+  fail_unless_equals_uint64 (frames, 25);
+  fail_unless_equals_int64 (mean_error, 0);
+  fail_unless_equals_uint64 (max_error, 0);
+  gst_structure_free (stats);
+
+  g_object_get (h->element, "last-sample", &sample, NULL);
+  fail_unless (sample != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (gst_sample_get_buffer (sample)),
+      24 * LSM_TEST_FRAME_PERIOD);
+  gst_sample_unref (sample);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* The precise timing window shortens the clock wait through the render
+ * delay, while frames are still timed against their real timestamps */
+GST_START_TEST (test_text_sink_precise_timing)
+{
+  GstHarness *h = setup_text_sink ();
+  GstStructure *stats;
+  guint64 frames, max_error, delay;
+
+  g_object_set (h->element, "render-delay", 2 * GST_MSECOND,
+      "precise-timing", TRUE, NULL);
+  g_object_get (h->element, "render-delay", &delay, NULL);
+  fail_unless_equals_uint64 (delay, 3 * GST_MSECOND);
+
+  g_object_set (h->element, "precise-timing-window", 4 * GST_MSECOND, NULL);
+  g_object_get (h->element, "render-delay", &delay, NULL);
+  fail_unless_equals_uint64 (delay, 6 * GST_MSECOND);
+
+  /* presented at the time the user render delay asks for */
+  for (guint i = 1; i <= 5; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    gst_harness_set_time (h, pts - 2 * GST_MSECOND);
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, pts)), GST_FLOW_OK);
+  }
+
+  stats = get_jitter_stats (h);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless (gst_structure_get_uint64 (stats, "max-error", &max_error));
+  fail_unless_equals_uint64 (frames, 5);
+  fail_unless_equals_uint64 (max_error, 0);
+  gst_structure_free (stats);
+
+  g_object_set (h->element, "precise-timing", FALSE, NULL);
+  g_object_get (h->element, "render-delay", &delay, NULL);
+  fail_unless_equals_uint64 (delay, 2 * GST_MSECOND);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_text_sink_accepts_malformed_frames)
+{
+  GstHarness *h = setup_text_sink ();
+  GstBuffer *buf = lsm_test_make_light_frame (0, 0);
+  GstStructure *stats;
+  guint64 frames;
+
+  /* truncate the last light: logged as malformed, not an error */
+  gst_buffer_resize (buf, 0, gst_buffer_get_size (buf) - 1);
+  fail_unless_equals_int (gst_harness_push (h, buf), GST_FLOW_OK);
+
+  stats = get_jitter_stats (h);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless_equals_uint64 (frames, 1);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_text_sink_flight_recorder_dump)
+{
+  gchar *location = g_dir_make_tmp ("dlblight-XXXXXX", NULL);
+  GstHarness *h = setup_recording_text_sink (location);
+  gchar *path = NULL;
+  gchar **frames;
+
+  for (guint i = 0; i < 5; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    gst_harness_set_time (h, pts);
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, pts)), GST_FLOW_OK);
+  }
+
+  g_signal_emit_by_name (h->element, "dump-flight-recorder", &path);
+  fail_unless (path != NULL);
+  fail_unless (g_str_has_prefix (path, location));
+
+  /* pts arrival presented lateness flags size data */
+  frames = read_dump (path);
+  fail_unless_equals_int (g_strv_length (frames), 5);
+  for (guint i = 0; i < 5; i++) {
+    gchar **fields = g_strsplit (frames[i], " ", -1);
+
+    fail_unless_equals_int (g_strv_length (fields), 8);
+    fail_unless_equals_uint64 (g_ascii_strtoull (fields[1], NULL, 10),
+        i * LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_string (fields[4], "0");
+    g_strfreev (fields);
+  }
+  g_strfreev (frames);
+
+  gst_harness_teardown (h);
+  g_free (path);
+  remove_dumps (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+/* A frame dropped as too late is recorded and dumps the recorder */
+GST_START_TEST (test_text_sink_flight_recorder_dump_on_drop)
+{
+  gchar *location = g_dir_make_tmp ("dlblight-XXXXXX", NULL);
+  GstHarness *h = setup_recording_text_sink (location);
+  GstClockTime pts = 3 * LSM_TEST_FRAME_PERIOD;
+  gboolean found = FALSE;
+  GDir *dir;
+
+  for (guint i = 0; i < 3; i++) {
+    gst_harness_set_time (h, i * LSM_TEST_FRAME_PERIOD);
+    gst_harness_push (h, lsm_test_make_light_frame (i,
+            i * LSM_TEST_FRAME_PERIOD));
+  }
+
+  gst_harness_set_time (h, pts + 100 * GST_MSECOND);
+  gst_harness_push (h, lsm_test_make_light_frame (3, pts));
+
+  /* written by the dump thread */
+  for (guint i = 0; i < 500 && !found; i++) {
+    const gchar *name;
+
+    g_usleep (10 * 1000);
+    dir = g_dir_open (location, 0, NULL);
+    name = g_dir_read_name (dir);
+    if (name) {
+      gchar *path = g_build_filename (location, name, NULL);
+      gchar **frames;
+
+      /* the dump may still be being written */
+      g_usleep (100 * 1000);
+      frames = read_dump (path);
+      fail_unless_equals_int (g_strv_length (frames), 4);
+      fail_unless (strstr (frames[3], " -d- ") != NULL);
+      g_strfreev (frames);
+      g_free (path);
+      found = TRUE;
+    }
+    g_dir_close (dir);
+  }
+  fail_unless (found, "no dump written for the dropped frame");
+
+  gst_harness_teardown (h);
+  remove_dumps (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+/* Dumps the flight recorder once it holds @n frames, which the device
+ * thread records after showing them */
+static gchar **
+dump_frames (GstHarness * h, guint n)
+{
+  gchar **frames = NULL;
+
+  for (guint i = 0; i < 500; i++) {
+    gchar *path = NULL;
+
+    g_signal_emit_by_name (h->element, "dump-flight-recorder", &path);
+    fail_unless (path != NULL);
+    frames = read_dump (path);
+    g_unlink (path);
+    g_free (path);
+
+    if (g_strv_length (frames) >= n)
+      break;
+    g_strfreev (frames);
+    frames = NULL;
+    g_usleep (10 * 1000);
+  }
+  fail_unless (frames != NULL, "the device thread did not show %u frames", n);
+
+  return frames;
+}
+
+/* With a queue deep enough for the whole stream, the device thread shows
+ * every frame, in order */
+GST_START_TEST (test_text_sink_device_thread_in_order)
+{
+  gchar *location = g_dir_make_tmp ("dlblight-XXXXXX", NULL);
+  GstElement *sink = gst_element_factory_make ("dlblighttextsink", NULL);
+  guint64 overwritten = G_MAXUINT64;
+  gchar **frames;
+  GstHarness *h;
+
+  g_object_set (sink, "show-preroll-frame", FALSE,
+      "async-device-write", TRUE, "device-queue-depth", 16,
+      "flight-recorder-duration", GST_SECOND,
+      "flight-recorder-location", location, NULL);
+  h = gst_harness_new_with_element (sink, "sink", NULL);
+  gst_object_unref (sink);
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+
+  for (guint i = 0; i < 10; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    gst_harness_set_time (h, pts);
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, pts)), GST_FLOW_OK);
+  }
+
+  frames = dump_frames (h, 10);
+  fail_unless_equals_int (g_strv_length (frames), 10);
+  for (guint i = 0; i < 10; i++) {
+    gchar **fields = g_strsplit (frames[i], " ", -1);
+
+    fail_unless_equals_uint64 (g_ascii_strtoull (fields[1], NULL, 10),
+        i * LSM_TEST_FRAME_PERIOD);
+    g_strfreev (fields);
+  }
+  g_strfreev (frames);
+
+  g_object_get (h->element, "overwritten-frames", &overwritten, NULL);
+  fail_unless_equals_uint64 (overwritten, 0);
+
+  gst_harness_teardown (h);
+  remove_dumps (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+/* Real-time scheduling and pinning are best effort: whether or not the
+ * test may use them, and with an invalid CPU list, the frames are shown */
+GST_START_TEST (test_text_sink_thread_settings)
+{
+  gchar *location = g_dir_make_tmp ("dlblight-XXXXXX", NULL);
+  GstElement *sink = gst_element_factory_make ("dlblighttextsink", NULL);
+  gchar **frames;
+  GstHarness *h;
+
+  g_object_set (sink, "show-preroll-frame", FALSE,
+      "async-device-write", TRUE, "device-queue-depth", 16,
+      "device-thread-priority", 10, "device-thread-affinity", "0",
+      "streaming-thread-priority", 5, "streaming-thread-affinity", "3-1",
+      "flight-recorder-duration", GST_SECOND,
+      "flight-recorder-location", location, NULL);
+  gst_util_set_object_arg (G_OBJECT (sink), "device-thread-policy", "fifo");
+  gst_util_set_object_arg (G_OBJECT (sink), "streaming-thread-policy", "rr");
+  h = gst_harness_new_with_element (sink, "sink", NULL);
+  gst_object_unref (sink);
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, LSM_TEST_LIGHT_CAPS);
+
+  for (guint i = 0; i < 5; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    gst_harness_set_time (h, pts);
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_light_frame (i, pts)), GST_FLOW_OK);
+  }
+
+  frames = dump_frames (h, 5);
+  fail_unless_equals_int (g_strv_length (frames), 5);
+  g_strfreev (frames);
+
+  gst_harness_teardown (h);
+  remove_dumps (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+static gpointer
+push_list_thread (gpointer data)
+{
+  GstHarness *h = data;
+  GstBufferList *list = gst_buffer_list_new_sized (5);
+
+  for (guint i = 0; i < 5; i++)
+    gst_buffer_list_add (list,
+        lsm_test_make_light_frame (i, i * LSM_TEST_FRAME_PERIOD));
+
+  return GINT_TO_POINTER (gst_pad_push_list (h->srcpad, list));
+}
+
+/* The frames of a list are still presented on time, one by one */
+GST_START_TEST (test_text_sink_buffer_list)
+{
+  GstHarness *h = setup_text_sink ();
+  GstStructure *stats;
+  guint64 frames, max_error;
+  GThread *thread;
+
+  thread = g_thread_new ("push-list", push_list_thread, h);
+
+  /* the first frame is due at once, each of the others waits */
+  for (guint i = 1; i < 5; i++)
+    fail_unless (gst_harness_crank_single_clock_wait (h));
+
+  fail_unless_equals_int (GPOINTER_TO_INT (g_thread_join (thread)),
+      GST_FLOW_OK);
+
+  stats = get_jitter_stats (h);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless (gst_structure_get_uint64 (stats, "max-error", &max_error));
+  fail_unless_equals_uint64 (frames, 5);
+  fail_unless_equals_uint64 (max_error, 0);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Without sync the whole list goes to show_list, every frame recorded */
+GST_START_TEST (test_text_sink_buffer_list_unsynced)
+{
+  gchar *location = g_dir_make_tmp ("dlblight-XXXXXX", NULL);
+  GstHarness *h = setup_recording_text_sink (location);
+  GstBufferList *list = gst_buffer_list_new_sized (5);
+  gchar *path = NULL;
+  gchar **frames;
+
+  g_object_set (h->element, "sync", FALSE, NULL);
+
+  for (guint i = 0; i < 5; i++)
+    gst_buffer_list_add (list,
+        lsm_test_make_light_frame (i, i * LSM_TEST_FRAME_PERIOD));
+  fail_unless_equals_int (gst_pad_push_list (h->srcpad, list), GST_FLOW_OK);
+
+  g_signal_emit_by_name (h->element, "dump-flight-recorder", &path);
+  fail_unless (path != NULL);
+
+  frames = read_dump (path);
+  fail_unless_equals_int (g_strv_length (frames), 5);
+  for (guint i = 0; i < 5; i++) {
+    gchar **fields = g_strsplit (frames[i], " ", -1);
+
+    fail_unless_equals_uint64 (g_ascii_strtoull (fields[1], NULL, 10),
+        i * LSM_TEST_FRAME_PERIOD);
+    g_strfreev (fields);
+  }
+  g_strfreev (frames);
+
+  gst_harness_teardown (h);
+  g_free (path);
+  remove_dumps (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+/* A GAP prerolls the sink and the last frame stays up over it */
+GST_START_TEST (test_text_sink_holds_over_gap)
+{
+  GstHarness *h = setup_text_sink ();
+  GstSample *sample = NULL;
+  GstStructure *stats;
+  guint64 frames;
+
+  fail_unless_equals_int (gst_harness_push (h,
+          lsm_test_make_light_frame (0, 0)), GST_FLOW_OK);
+
+  gst_harness_set_time (h, GST_SECOND);
+  fail_unless (gst_harness_push_event (h,
+          gst_event_new_gap (LSM_TEST_FRAME_PERIOD,
+              GST_SECOND - LSM_TEST_FRAME_PERIOD)));
+
+  stats = get_jitter_stats (h);
+  fail_unless (gst_structure_get_uint64 (stats, "frames", &frames));
+  fail_unless_equals_uint64 (frames, 1);
+  gst_structure_free (stats);
+
+  g_object_get (h->element, "last-sample", &sample, NULL);
+  fail_unless (sample != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (gst_sample_get_buffer (sample)),
+      0);
+  gst_sample_unref (sample);
+
+  fail_unless_equals_int (gst_harness_push (h,
+          lsm_test_make_light_frame (1, GST_SECOND)), GST_FLOW_OK);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblighttextsink_suite (void)
+{
+  Suite *s = suite_create ("dlblighttextsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_text_sink_presents_on_time);
+  tcase_add_test (tc_chain, test_text_sink_precise_timing);
+  tcase_add_test (tc_chain, test_text_sink_accepts_malformed_frames);
+  tcase_add_test (tc_chain, test_text_sink_flight_recorder_dump);
+  tcase_add_test (tc_chain, test_text_sink_flight_recorder_dump_on_drop);
+  tcase_add_test (tc_chain, test_text_sink_device_thread_in_order);
+  tcase_add_test (tc_chain, test_text_sink_thread_settings);
+  tcase_add_test (tc_chain, test_text_sink_buffer_list);
+  tcase_add_test (tc_chain, test_text_sink_buffer_list_unsynced);
+  tcase_add_test (tc_chain, test_text_sink_holds_over_gap);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblighttextsink);
@@ -0,0 +1,501 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+
+static GstHarness *
+setup_parse (void)
+{
+  GstHarness *h = gst_harness_new ("dlblsmparse");
+
+  gst_harness_set_src_caps (h,
+      lsm_test_make_stream_caps (LSM_TEST_MAX_OBJECTS,
+          LSM_TEST_FRAME_PERIOD_MS));
+
+  return h;
+}
+
+static void
+push_segment (GstHarness * h, gdouble rate, GstSegmentFlags flags)
+{
+  GstSegment segment;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  segment.rate = rate;
+  segment.flags = flags;
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+}
+
+/* the harness reports itself live, answer like a file source instead */
+static GstPadProbeReturn
+answer_not_live (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstQuery *query = GST_PAD_PROBE_INFO_QUERY (info);
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY)
+    return GST_PAD_PROBE_OK;
+
+  gst_query_set_latency (query, FALSE, 0, GST_CLOCK_TIME_NONE);
+  return GST_PAD_PROBE_HANDLED;
+}
+
+static GstPadProbeReturn
+count_lists (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_atomic_int_inc ((gint *) user_data);
+  return GST_PAD_PROBE_OK;
+}
+
+/* Pulls events until the first GAP, NULL if there is none */
+static GstEvent *
+pull_gap (GstHarness * h)
+{
+  GstEvent *event;
+
+  while ((event = gst_harness_try_pull_event (h))) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_GAP)
+      return event;
+    gst_event_unref (event);
+  }
+
+  return NULL;
+}
+
+static GstHarness *
+setup_batching_parse (guint frames_per_list, gboolean live, gint * lists)
+{
+  GstHarness *h = setup_parse ();
+
+  g_object_set (h->element, "frames-per-list", frames_per_list, NULL);
+  if (!live)
+    gst_pad_add_probe (h->srcpad, GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
+        answer_not_live, NULL, NULL);
+  gst_pad_add_probe (h->sinkpad, GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      count_lists, lists, NULL);
+
+  return h;
+}
+
+GST_START_TEST (test_parse_timestamps)
+{
+  GstHarness *h = setup_parse ();
+  GstStructure *s;
+  GstCaps *caps;
+  gint value;
+
+  for (guint i = 0; i < 25; i++)
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD)),
+        GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), 25);
+
+  for (guint i = 0; i < 25; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buf),
+        LSM_TEST_FRAME_PERIOD);
+    fail_unless_equals_int (gst_buffer_get_size (buf),
+        2 + 4 * LSM_TEST_OBJECT_SIZE);
+    gst_buffer_unref (buf);
+  }
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless (gst_structure_has_name (s, "application/x-lsm"));
+  fail_unless (gst_structure_get_int (s, "max-objects", &value));
+  fail_unless_equals_int (value, LSM_TEST_MAX_OBJECTS);
+  fail_unless (gst_structure_get_int (s, "frame-period", &value));
+  fail_unless_equals_int (value, LSM_TEST_FRAME_PERIOD_MS * 1000);
+  gst_caps_unref (caps);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_drops_invalid_frames)
+{
+  GstHarness *h = setup_parse ();
+  guint i;
+
+  for (i = 0; i < 3; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+  gst_harness_push (h, lsm_test_make_frame (i, LSM_TEST_MAX_OBJECTS + 1,
+          i * LSM_TEST_FRAME_PERIOD));
+  for (i = 4; i < 7; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), 6);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_decimate_fast_forward)
+{
+  GstHarness *h = setup_parse ();
+  GstClockTime last = GST_CLOCK_TIME_NONE;
+  guint received;
+
+  push_segment (h, 4.0, GST_SEGMENT_FLAG_NONE);
+
+  /* 1.6 s of stream time is 400 ms of running time at 4x */
+  for (guint i = 0; i < 40; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+
+  received = gst_harness_buffers_in_queue (h);
+  fail_unless (received >= 10 && received <= 11,
+      "expected about one frame per period, got %u", received);
+
+  /* running time is stream time / 4 */
+  for (guint i = 0; i < received; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+    GstClockTime running_time = GST_BUFFER_PTS (buf) / 4;
+
+    if (GST_CLOCK_TIME_IS_VALID (last))
+      fail_unless (running_time - last >= LSM_TEST_FRAME_PERIOD / 2);
+    last = running_time;
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_trickmode_drops_skip_frames)
+{
+  GstHarness *h = setup_parse ();
+
+  push_segment (h, 1.0, GST_SEGMENT_FLAG_TRICKMODE);
+
+  for (guint i = 0; i < 20; i++) {
+    GstClockTime pts = i * LSM_TEST_FRAME_PERIOD;
+
+    if (i % 2)
+      gst_harness_push (h, lsm_test_make_skip_frame (pts));
+    else
+      gst_harness_push (h, lsm_test_make_frame (i, 4, pts));
+  }
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 10);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_decimate_disabled)
+{
+  GstHarness *h = setup_parse ();
+
+  g_object_set (h->element, "decimate", FALSE, NULL);
+  push_segment (h, 4.0, GST_SEGMENT_FLAG_NONE);
+
+  for (guint i = 0; i < 40; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 40);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* Objects of differing sizes, each record holding its size, its gain and
+ * then its index in every other byte */
+static GstBuffer *
+make_objects_frame (const guint8 * sizes, const guint8 * gains, guint n,
+    GstClockTime pts)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  gsize size = 2, offset = 2;
+
+  for (guint i = 0; i < n; i++)
+    size += sizes[i];
+
+  buf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  map.data[0] = 0;
+  map.data[1] = n;
+  for (guint i = 0; i < n; i++) {
+    map.data[offset] = sizes[i];
+    map.data[offset + 1] = gains[i];
+    memset (map.data + offset + 2, i, sizes[i] - 2);
+    offset += sizes[i];
+  }
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+/* Reports the renderer is late and the parser drops the two least
+ * significant objects */
+static GstHarness *
+setup_culling_parse (void)
+{
+  GstHarness *h = setup_parse ();
+  guint limit;
+
+  g_object_set (h->element, "adaptive-quality", TRUE, NULL);
+  gst_harness_push (h, lsm_test_make_frame (0, LSM_TEST_MAX_OBJECTS, 0));
+  gst_buffer_unref (gst_harness_pull (h));
+
+  gst_harness_push_upstream_event (h,
+      gst_event_new_qos (GST_QOS_TYPE_UNDERFLOW, 0.9, 10 * GST_MSECOND, 0));
+  g_object_get (h->element, "object-limit", &limit, NULL);
+  fail_unless_equals_int (limit, LSM_TEST_MAX_OBJECTS - 2);
+
+  return h;
+}
+
+GST_START_TEST (test_parse_cull_least_significant)
+{
+  GstHarness *h = setup_culling_parse ();
+  guint8 sizes[LSM_TEST_MAX_OBJECTS], gains[LSM_TEST_MAX_OBJECTS];
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint64 culled;
+  gsize offset = 2;
+  guint kept = 0;
+
+  for (guint i = 0; i < LSM_TEST_MAX_OBJECTS; i++) {
+    sizes[i] = 2 + (i * 7) % 11;
+    gains[i] = 100 + i;
+  }
+  /* the faintest object sits in the middle of the frame, of the two next
+   * faintest the later one goes */
+  gains[3] = 5;
+  gains[9] = 7;
+  gains[LSM_TEST_MAX_OBJECTS - 1] = 7;
+
+  gst_harness_push (h, make_objects_frame (sizes, gains,
+          LSM_TEST_MAX_OBJECTS, LSM_TEST_FRAME_PERIOD));
+  buf = gst_harness_pull (h);
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.data[1], LSM_TEST_MAX_OBJECTS - 2);
+  for (guint i = 0; i < LSM_TEST_MAX_OBJECTS; i++) {
+    if (i == 3 || i == LSM_TEST_MAX_OBJECTS - 1)
+      continue;
+
+    fail_unless (offset + sizes[i] <= map.size);
+    fail_unless_equals_int (map.data[offset], sizes[i]);
+    fail_unless_equals_int (map.data[offset + 1], gains[i]);
+    for (guint b = 2; b < sizes[i]; b++)
+      fail_unless_equals_int (map.data[offset + b], i);
+    offset += sizes[i];
+    kept++;
+  }
+  fail_unless_equals_int (kept, LSM_TEST_MAX_OBJECTS - 2);
+  fail_unless_equals_int (offset, map.size);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  g_object_get (h->element, "culled-objects", &culled, NULL);
+  fail_unless_equals_uint64 (culled, 2);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* A record running past the end of the frame stops the walk, the frame goes
+ * on as it came in */
+GST_START_TEST (test_parse_cull_unparsable_frame)
+{
+  GstHarness *h = setup_culling_parse ();
+  guint8 sizes[LSM_TEST_MAX_OBJECTS], gains[LSM_TEST_MAX_OBJECTS];
+  GstBuffer *frame, *buf;
+  GstMapInfo map;
+  guint64 culled;
+
+  for (guint i = 0; i < LSM_TEST_MAX_OBJECTS; i++) {
+    sizes[i] = 2 + i % 3;
+    gains[i] = i;
+  }
+  frame = make_objects_frame (sizes, gains, LSM_TEST_MAX_OBJECTS,
+      LSM_TEST_FRAME_PERIOD);
+  gst_buffer_map (frame, &map, GST_MAP_WRITE);
+  map.data[2 + sizes[0]] = 200;
+  gst_buffer_unmap (frame, &map);
+
+  gst_harness_push (h, gst_buffer_ref (frame));
+  buf = gst_harness_pull (h);
+
+  gst_buffer_map (frame, &map, GST_MAP_READ);
+  fail_unless_equals_int (gst_buffer_get_size (buf), map.size);
+  fail_unless (gst_buffer_memcmp (buf, 0, map.data, map.size) == 0);
+  gst_buffer_unmap (frame, &map);
+
+  g_object_get (h->element, "culled-objects", &culled, NULL);
+  fail_unless_equals_uint64 (culled, 0);
+
+  gst_buffer_unref (frame);
+  gst_buffer_unref (buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_buffer_lists)
+{
+  gint lists = 0;
+  GstHarness *h = setup_batching_parse (5, FALSE, &lists);
+
+  for (guint i = 0; i < 12; i++)
+    fail_unless_equals_int (gst_harness_push (h,
+            lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD)),
+        GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), 10);
+  fail_unless_equals_int (g_atomic_int_get (&lists), 2);
+
+  /* the last two frames go out ahead of the EOS */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 12);
+
+  for (guint i = 0; i < 12; i++) {
+    GstBuffer *buf = gst_harness_pull (h);
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), i * LSM_TEST_FRAME_PERIOD);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_buffer_lists_live)
+{
+  gint lists = 0;
+  GstHarness *h = setup_batching_parse (5, TRUE, &lists);
+
+  for (guint i = 0; i < 12; i++)
+    gst_harness_push (h, lsm_test_make_frame (i, 4, i * LSM_TEST_FRAME_PERIOD));
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), 12);
+  fail_unless_equals_int (g_atomic_int_get (&lists), 0);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_gap_between_frames)
+{
+  GstHarness *h = setup_parse ();
+  GstClockTime timestamp, duration;
+  GstEvent *gap;
+
+  gst_harness_push (h, lsm_test_make_frame (0, 4, 0));
+  gst_harness_push (h, lsm_test_make_frame (1, 4, LSM_TEST_FRAME_PERIOD));
+  fail_unless (pull_gap (h) == NULL);
+
+  /* a second without lights */
+  gst_harness_push (h, lsm_test_make_frame (2, 4, GST_SECOND));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 3);
+
+  gap = pull_gap (h);
+  fail_unless (gap != NULL);
+  gst_event_parse_gap (gap, &timestamp, &duration);
+  fail_unless_equals_uint64 (timestamp, 2 * LSM_TEST_FRAME_PERIOD);
+  fail_unless_equals_uint64 (duration, GST_SECOND - 2 * LSM_TEST_FRAME_PERIOD);
+  gst_event_unref (gap);
+
+  /* disabled */
+  g_object_set (h->element, "gap-threshold", G_GUINT64_CONSTANT (0), NULL);
+  gst_harness_push (h, lsm_test_make_frame (3, 4, 2 * GST_SECOND));
+  fail_unless (pull_gap (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* The source caps are known from the init box, so a stream that starts
+ * with a hole still lets the sink preroll */
+GST_START_TEST (test_parse_gap_before_first_frame)
+{
+  GstHarness *h = setup_parse ();
+  GstEvent *gap;
+  GstCaps *caps;
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_gap (0, GST_SECOND)));
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  gst_caps_unref (caps);
+
+  gap = pull_gap (h);
+  fail_unless (gap != NULL);
+  gst_event_unref (gap);
+
+  /* upstream signalled the hole already */
+  gst_harness_push (h, lsm_test_make_frame (0, 4, GST_SECOND));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 1);
+  fail_unless (pull_gap (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblsmparse_suite (void)
+{
+  Suite *s = suite_create ("dlblsmparse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_timestamps);
+  tcase_add_test (tc_chain, test_parse_drops_invalid_frames);
+  tcase_add_test (tc_chain, test_parse_decimate_fast_forward);
+  tcase_add_test (tc_chain, test_parse_trickmode_drops_skip_frames);
+  tcase_add_test (tc_chain, test_parse_decimate_disabled);
+  tcase_add_test (tc_chain, test_parse_cull_least_significant);
+  tcase_add_test (tc_chain, test_parse_cull_unparsable_frame);
+  tcase_add_test (tc_chain, test_parse_buffer_lists);
+  tcase_add_test (tc_chain, test_parse_buffer_lists_live);
+  tcase_add_test (tc_chain, test_parse_gap_between_frames);
+  tcase_add_test (tc_chain, test_parse_gap_before_first_frame);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblsmparse);
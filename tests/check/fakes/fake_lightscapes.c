@@ -0,0 +1,116 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Deterministic stand-in for the Lightscapes renderer, implementing the
+ * interface the shim loads. Every frame has an RGB strip of 8 lights and an
+ * RGBW strip of 4 lights. The light values depend on the input bytes, the
+ * lightness and a frame counter, the counter standing in for the temporal
+ * state of the real renderer: it is cleared by dlb_lsr_reset(). */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dlb_lightscapes.h"
+
+#define RGB_LIGHTS 8
+#define RGBW_LIGHTS 4
+#define OUTPUT_SIZE (2 + (4 + RGB_LIGHTS * 3) + (4 + RGBW_LIGHTS * 4))
+
+struct dlb_lsr_s
+{
+  unsigned frames;
+};
+
+dlb_lsr *
+dlb_lsr_new (const dlb_lsr_init_info * info)
+{
+  if (info == NULL || info->serialized_conf == NULL ||
+      info->serialized_conf_size == 0)
+    return NULL;
+
+  return calloc (1, sizeof (dlb_lsr));
+}
+
+void
+dlb_lsr_free (dlb_lsr * self)
+{
+  free (self);
+}
+
+void
+dlb_lsr_reset (dlb_lsr * self)
+{
+  self->frames = 0;
+}
+
+size_t
+dlb_lsr_get_max_output_size (dlb_lsr * self)
+{
+  (void) self;
+  return OUTPUT_SIZE;
+}
+
+static unsigned char *
+write_strip (unsigned char *out, unsigned char id, unsigned lights,
+    unsigned char format, unsigned bpp, unsigned seed, float lightness)
+{
+  out[0] = id;
+  out[1] = lights & 0xff;
+  out[2] = lights >> 8;
+  out[3] = format;
+  out += 4;
+
+  for (unsigned i = 0; i < lights * bpp; i++)
+    *out++ = (unsigned char) (((seed + i * 7) & 0xff) * lightness);
+
+  return out;
+}
+
+void
+dlb_lsr_process (dlb_lsr * self, size_t inbuf_size, unsigned char *inbuf,
+    size_t *outbuf_size, unsigned char *outbuf,
+    float *a_zone_immersion_levels, int *a_zone_low_immersion,
+    float global_lightness)
+{
+  unsigned seed = 0;
+  unsigned char *out = outbuf;
+
+  (void) a_zone_immersion_levels;
+  (void) a_zone_low_immersion;
+
+  if (*outbuf_size < OUTPUT_SIZE) {
+    *outbuf_size = 0;
+    return;
+  }
+
+  for (size_t i = 0; i < inbuf_size; i++)
+    seed = seed * 31 + inbuf[i];
+  seed += self->frames++ * 3;
+
+  out[0] = 2;
+  out[1] = 0;
+  out += 2;
+  out = write_strip (out, 0, RGB_LIGHTS, LS_OUTPUT_COLOR_FORMAT_RGB, 3, seed,
+      global_lightness);
+  out = write_strip (out, 1, RGBW_LIGHTS, LS_OUTPUT_COLOR_FORMAT_RGBW, 4, seed,
+      global_lightness);
+
+  *outbuf_size = out - outbuf;
+}
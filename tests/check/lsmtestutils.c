@@ -0,0 +1,249 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
+
+#include <time.h>
+
+#include <glib/gstdio.h>
+#include <gst/base/gstbytewriter.h>
+#include <gst/check/gstcheck.h>
+
+#include "lsmtestutils.h"
+
+/* Box header skipped by the parser before the LSM configuration */
+#define INIT_BOX_HEADER_SIZE 12
+
+GstCaps *
+lsm_test_make_stream_caps (guint8 max_objects, guint32 frame_period_ms)
+{
+  GstByteWriter writer;
+  GstBuffer *init_box;
+  GstCaps *caps;
+
+  gst_byte_writer_init (&writer);
+  gst_byte_writer_fill (&writer, 0, INIT_BOX_HEADER_SIZE);
+  gst_byte_writer_put_uint8 (&writer, 0);       /* version */
+  gst_byte_writer_put_uint32_be (&writer, frame_period_ms);
+  gst_byte_writer_put_uint8 (&writer, max_objects);
+  gst_byte_writer_put_uint8 (&writer, 0);       /* color space */
+  init_box = gst_byte_writer_reset_and_get_buffer (&writer);
+
+  caps = gst_caps_new_simple ("application/octet-stream",
+      "uri", G_TYPE_STRING, "urn:oid:1.2.6.1.4.6729.1.3",
+      "uri-init-box", GST_TYPE_BUFFER, init_box, NULL);
+  gst_buffer_unref (init_box);
+
+  return caps;
+}
+
+/* Object records start with their size and gain, the rest is filled from a
+ * small LCG seeded with the frame index: the same index always gives the
+ * same frame. */
+GstBuffer *
+lsm_test_make_frame (guint index, guint8 num_objects, GstClockTime pts)
+{
+  gsize size = 2 + num_objects * LSM_TEST_OBJECT_SIZE;
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, size, NULL);
+  guint32 state = index * 2654435761u + 1;
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  map.data[0] = 0;
+  map.data[1] = num_objects;
+  for (gsize i = 2; i < size; i++) {
+    state = state * 1664525u + 1013904223u;
+    map.data[i] = state >> 24;
+  }
+  for (gsize i = 2; i < size; i += LSM_TEST_OBJECT_SIZE)
+    map.data[i] = LSM_TEST_OBJECT_SIZE;
+  gst_buffer_unmap (buf, &map);
+
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+GstBuffer *
+lsm_test_make_skip_frame (GstClockTime pts)
+{
+  static const guint8 skip[2] = { 1, 0 };
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, sizeof (skip), NULL);
+
+  gst_buffer_fill (buf, 0, skip, sizeof (skip));
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+/* One RGB strip of four lights */
+GstBuffer *
+lsm_test_make_light_frame (guint index, GstClockTime pts)
+{
+  guint8 frame[2 + 4 + 4 * 3] = { 1, 0, 0, 4, 0, 0 };
+  GstBuffer *buf;
+
+  for (gsize i = 6; i < sizeof (frame); i++)
+    frame[i] = (index + i) & 0xff;
+
+  buf = gst_buffer_new_allocate (NULL, sizeof (frame), NULL);
+  gst_buffer_fill (buf, 0, frame, sizeof (frame));
+  GST_BUFFER_PTS (buf) = pts;
+  GST_BUFFER_DURATION (buf) = LSM_TEST_FRAME_PERIOD;
+
+  return buf;
+}
+
+/* The stand-in renderer only needs a non-empty configuration */
+gchar *
+lsm_test_write_config (void)
+{
+  static const gchar config[] = "dlb-lightscapes-test-config";
+  GError *error = NULL;
+  gchar *path = NULL;
+  gint fd;
+
+  fd = g_file_open_tmp ("dlblightning-XXXXXX.conf", &path, &error);
+  fail_unless (fd >= 0, "could not create config: %s",
+      error ? error->message : "unknown");
+  g_close (fd, NULL);
+
+  fail_unless (g_file_set_contents (path, config, sizeof (config), &error),
+      "could not write config: %s", error ? error->message : "unknown");
+
+  return path;
+}
+
+/* Counting allocator: hands out system memory, so only allocations are
+ * seen here and the memory is released by the system allocator. */
+
+typedef struct
+{
+  GstAllocator parent;
+  gint count;
+} LsmTestCountingAllocator;
+
+typedef struct
+{
+  GstAllocatorClass parent_class;
+} LsmTestCountingAllocatorClass;
+
+static GType lsm_test_counting_allocator_get_type (void);
+G_DEFINE_TYPE (LsmTestCountingAllocator, lsm_test_counting_allocator,
+    GST_TYPE_ALLOCATOR);
+
+static GstMemory *
+lsm_test_counting_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  LsmTestCountingAllocator *self = (LsmTestCountingAllocator *) allocator;
+
+  g_atomic_int_inc (&self->count);
+  return gst_allocator_alloc (NULL, size, params);
+}
+
+static void
+lsm_test_counting_allocator_class_init (LsmTestCountingAllocatorClass * klass)
+{
+  GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS (klass);
+
+  allocator_class->alloc = lsm_test_counting_allocator_alloc;
+}
+
+static void
+lsm_test_counting_allocator_init (LsmTestCountingAllocator * self)
+{
+  GST_ALLOCATOR_CAST (self)->mem_type = "LsmTestCounting";
+}
+
+GstAllocator *
+lsm_test_counting_allocator_new (void)
+{
+  return g_object_new (lsm_test_counting_allocator_get_type (), NULL);
+}
+
+guint64
+lsm_test_counting_allocator_get_count (GstAllocator * allocator)
+{
+  return g_atomic_int_get (&((LsmTestCountingAllocator *) allocator)->count);
+}
+
+GstClockTime
+lsm_test_thread_cpu_time (void)
+{
+  struct timespec ts;
+
+  fail_unless (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0);
+  return GST_TIMESPEC_TO_TIME (ts);
+}
+
+/* Compare @value against the upper bound stored under @group/@key in the
+ * file named by DLB_TESTS_BASELINES, allowing the percentage given by the
+ * optional "@key-tolerance" entry. With DLB_TESTS_UPDATE_BASELINES=1 the
+ * measured value is written back instead. */
+void
+lsm_test_check_baseline (const gchar * group, const gchar * key,
+    gdouble value)
+{
+  const gchar *path = g_getenv ("DLB_TESTS_BASELINES");
+  GKeyFile *baselines;
+  GError *error = NULL;
+  gchar *tolerance_key;
+  gdouble limit, tolerance;
+
+  GST_INFO ("%s.%s = %f", group, key, value);
+
+  if (path == NULL)
+    return;
+
+  baselines = g_key_file_new ();
+  fail_unless (g_key_file_load_from_file (baselines, path,
+          G_KEY_FILE_KEEP_COMMENTS, &error), "could not load %s: %s", path,
+      error ? error->message : "unknown");
+
+  if (g_strcmp0 (g_getenv ("DLB_TESTS_UPDATE_BASELINES"), "1") == 0) {
+    g_key_file_set_double (baselines, group, key, value);
+    fail_unless (g_key_file_save_to_file (baselines, path, &error),
+        "could not save %s: %s", path, error ? error->message : "unknown");
+    g_key_file_free (baselines);
+    return;
+  }
+
+  limit = g_key_file_get_double (baselines, group, key, &error);
+  fail_unless (error == NULL, "no baseline for %s.%s", group, key);
+
+  tolerance_key = g_strdup_printf ("%s-tolerance", key);
+  tolerance = g_key_file_get_double (baselines, group, tolerance_key, NULL);
+  g_free (tolerance_key);
+
+  fail_unless (value <= limit * (1.0 + tolerance / 100.0),
+      "%s.%s regressed: %f, baseline %f (+%.0f%%)", group, key, value, limit,
+      tolerance);
+
+  g_key_file_free (baselines);
+}
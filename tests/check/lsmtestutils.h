@@ -0,0 +1,57 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+#ifndef _LSM_TEST_UTILS_H_
+#define _LSM_TEST_UTILS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define LSM_TEST_FRAME_PERIOD_MS 40
+#define LSM_TEST_FRAME_PERIOD (LSM_TEST_FRAME_PERIOD_MS * GST_MSECOND)
+#define LSM_TEST_MAX_OBJECTS 16
+#define LSM_TEST_OBJECT_SIZE 8
+
+#define LSM_TEST_PARSED_CAPS "application/x-lsm, parsed = (boolean) true, " \
+    "lsm-version = (int) 0, max-objects = (int) 16, color-space = (int) 0, " \
+    "frame-period = (int) 40000"
+
+#define LSM_TEST_LIGHT_CAPS "application/x-lights, format = (string) DLB"
+
+GstCaps *       lsm_test_make_stream_caps   (guint8 max_objects,
+                                             guint32 frame_period_ms);
+GstBuffer *     lsm_test_make_frame         (guint index, guint8 num_objects,
+                                             GstClockTime pts);
+GstBuffer *     lsm_test_make_skip_frame    (GstClockTime pts);
+GstBuffer *     lsm_test_make_light_frame   (guint index, GstClockTime pts);
+gchar *         lsm_test_write_config       (void);
+
+GstAllocator *  lsm_test_counting_allocator_new       (void);
+guint64         lsm_test_counting_allocator_get_count (GstAllocator * allocator);
+
+GstClockTime    lsm_test_thread_cpu_time    (void);
+void            lsm_test_check_baseline     (const gchar * group,
+                                             const gchar * key,
+                                             gdouble value);
+
+G_END_DECLS
+
+#endif /* _LSM_TEST_UTILS_H_ */
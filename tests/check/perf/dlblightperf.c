@@ -0,0 +1,133 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+
+/* Processing time regression checks. Each element runs alone in a harness,
+ * so everything it does happens on the test thread and is measured with the
+ * thread's CPU clock, which is not disturbed by other load on the machine.
+ * The best of a few runs is compared against baselines.ini. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#include "../lsmtestutils.h"
+
+#define PERF_FRAMES 1000
+#define PERF_RUNS 5
+
+static gdouble
+run_frames (GstHarness * h, guint8 num_objects)
+{
+  GstBuffer *frames[PERF_FRAMES];
+  GstClockTime start, elapsed;
+
+  /* build the input up front so only the element is measured */
+  for (guint i = 0; i < PERF_FRAMES; i++)
+    frames[i] = lsm_test_make_frame (i, num_objects, i * LSM_TEST_FRAME_PERIOD);
+
+  start = lsm_test_thread_cpu_time ();
+  for (guint i = 0; i < PERF_FRAMES; i++) {
+    fail_unless_equals_int (gst_harness_push (h, frames[i]), GST_FLOW_OK);
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+  elapsed = lsm_test_thread_cpu_time () - start;
+
+  return (gdouble) elapsed / PERF_FRAMES;
+}
+
+static gdouble
+best_of_runs (GstHarness * (*setup) (gpointer), gpointer data,
+    guint8 num_objects)
+{
+  gdouble best = G_MAXDOUBLE;
+
+  for (guint run = 0; run < PERF_RUNS; run++) {
+    GstHarness *h = setup (data);
+
+    best = MIN (best, run_frames (h, num_objects));
+    fail_unless_equals_int (gst_harness_buffers_received (h), PERF_FRAMES);
+    gst_harness_teardown (h);
+  }
+
+  return best;
+}
+
+static GstHarness *
+setup_parse (gpointer data)
+{
+  GstHarness *h = gst_harness_new ("dlblsmparse");
+
+  gst_harness_set_src_caps (h,
+      lsm_test_make_stream_caps (LSM_TEST_MAX_OBJECTS,
+          LSM_TEST_FRAME_PERIOD_MS));
+
+  return h;
+}
+
+static GstHarness *
+setup_lightning (gpointer data)
+{
+  GstHarness *h = gst_harness_new ("dlblightning");
+
+  g_object_set (h->element, "config", (const gchar *) data, NULL);
+  gst_harness_set_src_caps_str (h, LSM_TEST_PARSED_CAPS);
+
+  return h;
+}
+
+GST_START_TEST (test_perf_parse)
+{
+  lsm_test_check_baseline ("dlblsmparse", "ns-per-frame",
+      best_of_runs (setup_parse, NULL, LSM_TEST_MAX_OBJECTS));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_perf_lightning)
+{
+  gchar *config = lsm_test_write_config ();
+
+  lsm_test_check_baseline ("dlblightning", "ns-per-frame",
+      best_of_runs (setup_lightning, config, LSM_TEST_MAX_OBJECTS));
+
+  g_unlink (config);
+  g_free (config);
+}
+
+GST_END_TEST;
+
+static Suite *
+dlblightperf_suite (void)
+{
+  Suite *s = suite_create ("dlblightperf");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_perf_parse);
+  tcase_add_test (tc_chain, test_perf_lightning);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dlblightperf);
@@ -0,0 +1,621 @@
+/*******************************************************************************
+
+ * Dolby Lightscapes GStreamer Plugins
+ * Copyright (C) 2024, Dolby Laboratories
+
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ ******************************************************************************/
+/* dlb-light-render: renders a whole LSM track offline. The track is read
+ * as a stream and cut into segments of --segment frames, which a pool of
+ * --jobs threads renders in parallel, each segment with a dlblightning
+ * instance of its own. A segment first renders the overlap frames before
+ * it as warm-up frames, which dlblightning renders and drops, so the
+ * renderer state at every seam is the one serial rendering would have.
+ * Finished segments are sent to the output in order and released, and
+ * reading stalls while too many segments are pending, so memory stays
+ * bounded by the number of jobs rather than the length of the track.
+ * --verify renders the track serially as well, handing every segment's
+ * frames to the serial renderer as the segment is written and comparing
+ * the outputs frame by frame, so the serial renderer never holds more than
+ * a segment either.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#define DEFAULT_OVERLAP 100
+#define DEFAULT_SEGMENT 1500
+
+/* Parsed LSM frames held between the reader and the renderers */
+#define READ_AHEAD 64
+/* Longest wait for a serially rendered frame before giving up */
+#define SERIAL_TIMEOUT (10 * GST_SECOND)
+
+typedef struct
+{
+  guint index;
+  GPtrArray *frames;            /* warm-up frames, then the frames rendered */
+  guint warmup;                 /* number of warm-up frames */
+  GPtrArray *input;             /* --verify: the frames rendered, no warm-up */
+  GstCaps *caps;
+  GPtrArray *output;
+  GError *error;
+  gboolean done;                /* protected by Renderer.lock */
+} Segment;
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  GThreadPool *pool;
+  GQueue pending;               /* segments not written yet, in order */
+  GstCaps *caps;                /* input caps, set before the first segment */
+  guint frames;
+  guint segments;
+
+  GstElement *writer;
+  GstElement *writer_src;
+  gboolean writer_caps;
+  guint written;
+
+  /* --verify */
+  GstElement *serial;
+  GstElement *serial_src;
+  GstElement *serial_sink;
+} Renderer;
+
+static gchar *config = NULL;
+static gint jobs = 0;
+static gint overlap = DEFAULT_OVERLAP;
+static gint segment_length = DEFAULT_SEGMENT;
+static gchar *output = NULL;
+static gchar *sink = NULL;
+static gboolean verify = FALSE;
+
+static GOptionEntry entries[] = {
+  {"config", 'c', 0, G_OPTION_ARG_FILENAME, &config,
+      "Serialized Lightscapes configuration file", "FILE"},
+  {"jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+      "Segments rendered in parallel (default: number of processors)", "N"},
+  {"overlap", 0, 0, G_OPTION_ARG_INT, &overlap,
+      "Warm-up frames rendered before each segment (default: 100)", "FRAMES"},
+  {"segment", 0, 0, G_OPTION_ARG_INT, &segment_length,
+      "Frames rendered per segment (default: 1500)", "FRAMES"},
+  {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Write the rendered frames to FILE", "FILE"},
+  {"sink", 0, 0, G_OPTION_ARG_STRING, &sink,
+      "Send the rendered frames to a pipeline description instead", "DESC"},
+  {"verify", 0, 0, G_OPTION_ARG_NONE, &verify,
+      "Render serially too and check that the outputs are identical", NULL},
+  {NULL}
+};
+
+/* Returns FALSE and sets error if the pipeline posted an error. */
+static gboolean
+check_bus (GstElement * pipeline, GError ** error)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (msg == NULL)
+    return TRUE;
+
+  gst_message_parse_error (msg, error, NULL);
+  gst_message_unref (msg);
+  return FALSE;
+}
+
+/* Waits for the pipeline to finish and returns FALSE and sets error if it
+ * posted an error instead. */
+static gboolean
+wait_eos (GstElement * pipeline, GError ** error)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+  gboolean ret;
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  ret = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+  if (!ret)
+    gst_message_parse_error (msg, error, NULL);
+  gst_message_unref (msg);
+
+  return ret;
+}
+
+/* appsrc ! dlblightning ! appsink, with the renderer configured */
+static GstElement *
+render_pipeline_new (GstCaps * caps, GstElement ** src, GstElement ** appsink,
+    GError ** error)
+{
+  GstElement *pipeline, *render;
+
+  pipeline = gst_parse_launch ("appsrc name=src format=time ! "
+      "dlblightning name=render ! appsink name=out sync=false", error);
+  if (pipeline == NULL)
+    return NULL;
+
+  *src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  *appsink = gst_bin_get_by_name (GST_BIN (pipeline), "out");
+  render = gst_bin_get_by_name (GST_BIN (pipeline), "render");
+  g_object_set (*src, "caps", caps, NULL);
+  g_object_set (render, "config", config, NULL);
+  gst_object_unref (render);
+
+  return pipeline;
+}
+
+static Segment *
+segment_new (guint index)
+{
+  Segment *segment = g_new0 (Segment, 1);
+
+  segment->index = index;
+  segment->frames = g_ptr_array_new_with_free_func
+      ((GDestroyNotify) gst_buffer_unref);
+  if (verify)
+    segment->input = g_ptr_array_new_with_free_func
+        ((GDestroyNotify) gst_buffer_unref);
+
+  return segment;
+}
+
+/* Starts the segment after this one, with the last frames of this one as
+ * its warm-up frames. */
+static Segment *
+segment_new_after (Segment * segment)
+{
+  Segment *next = segment_new (segment->index + 1);
+  guint len = segment->frames->len;
+
+  next->warmup = MIN (len, (guint) MAX (overlap, 0));
+  for (guint i = len - next->warmup; i < len; i++)
+    g_ptr_array_add (next->frames,
+        gst_buffer_ref (g_ptr_array_index (segment->frames, i)));
+
+  return next;
+}
+
+static void
+segment_free (Segment * segment)
+{
+  g_clear_pointer (&segment->frames, g_ptr_array_unref);
+  g_clear_pointer (&segment->input, g_ptr_array_unref);
+  g_clear_pointer (&segment->output, g_ptr_array_unref);
+  gst_clear_caps (&segment->caps);
+  g_clear_error (&segment->error);
+  g_free (segment);
+}
+
+/* Runs in a pool thread, with a pipeline and renderer of its own. */
+static void
+render_segment (gpointer data, gpointer user_data)
+{
+  Segment *segment = data;
+  Renderer *renderer = user_data;
+  GstElement *pipeline, *src, *appsink;
+  GstSample *sample;
+
+  pipeline = render_pipeline_new (renderer->caps, &src, &appsink,
+      &segment->error);
+  if (pipeline == NULL)
+    goto done;
+
+  segment->output = g_ptr_array_new_with_free_func
+      ((GDestroyNotify) gst_buffer_unref);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  for (guint i = 0; i < segment->frames->len; i++) {
+    GstBuffer *frame = g_ptr_array_index (segment->frames, i);
+
+    if (i < segment->warmup) {
+      frame = gst_buffer_copy (frame);
+      GST_BUFFER_FLAG_SET (frame, GST_BUFFER_FLAG_DECODE_ONLY);
+    } else {
+      gst_buffer_ref (frame);
+    }
+
+    if (gst_app_src_push_buffer (GST_APP_SRC (src), frame) != GST_FLOW_OK)
+      break;
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  while ((sample = gst_app_sink_pull_sample (GST_APP_SINK (appsink)))) {
+    if (segment->caps == NULL)
+      segment->caps = gst_caps_ref (gst_sample_get_caps (sample));
+    g_ptr_array_add (segment->output,
+        gst_buffer_ref (gst_sample_get_buffer (sample)));
+    gst_sample_unref (sample);
+  }
+
+  check_bus (pipeline, &segment->error);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (appsink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+done:
+  g_mutex_lock (&renderer->lock);
+  /* the next segment holds its own references to its warm-up frames */
+  g_clear_pointer (&segment->frames, g_ptr_array_unref);
+  segment->done = TRUE;
+  g_cond_broadcast (&renderer->cond);
+  g_mutex_unlock (&renderer->lock);
+}
+
+static gboolean
+buffers_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo map;
+  gboolean equal;
+
+  if (gst_buffer_get_size (a) != gst_buffer_get_size (b) ||
+      GST_BUFFER_PTS (a) != GST_BUFFER_PTS (b))
+    return FALSE;
+
+  gst_buffer_map (a, &map, GST_MAP_READ);
+  equal = gst_buffer_memcmp (b, 0, map.data, map.size) == 0;
+  gst_buffer_unmap (a, &map);
+
+  return equal;
+}
+
+/* Compares a frame of the segment at offset with the next serially
+ * rendered frame. */
+static gboolean
+verify_frame (Renderer * renderer, Segment * segment, guint offset,
+    GError ** error)
+{
+  GstBuffer *frame = g_ptr_array_index (segment->output, offset);
+  GstSample *sample;
+  gboolean equal;
+
+  sample = gst_app_sink_try_pull_sample (GST_APP_SINK (renderer->serial_sink),
+      SERIAL_TIMEOUT);
+  if (sample == NULL) {
+    if (check_bus (renderer->serial, error))
+      g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+          "parallel rendering has more than the %u serial frames",
+          renderer->written);
+    return FALSE;
+  }
+
+  equal = buffers_equal (frame, gst_sample_get_buffer (sample));
+  gst_sample_unref (sample);
+
+  if (!equal) {
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+        "frame %u differs from serial rendering, in segment %u at %u frames "
+        "after the seam, try a longer --overlap", renderer->written,
+        segment->index, offset);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+write_segment (Renderer * renderer, Segment * segment, GError ** error)
+{
+  if (segment->error) {
+    g_propagate_error (error, segment->error);
+    segment->error = NULL;
+    return FALSE;
+  }
+
+  if (!check_bus (renderer->writer, error))
+    return FALSE;
+
+  if (!renderer->writer_caps && segment->caps) {
+    g_object_set (renderer->writer_src, "caps", segment->caps, NULL);
+    renderer->writer_caps = TRUE;
+  }
+
+  /* the serial renderer gets the frames of one segment at a time, so it is
+   * never more than a segment ahead of the writer */
+  if (verify) {
+    for (guint i = 0; i < segment->input->len; i++)
+      gst_app_src_push_buffer (GST_APP_SRC (renderer->serial_src),
+          gst_buffer_ref (g_ptr_array_index (segment->input, i)));
+    g_ptr_array_set_size (segment->input, 0);
+  }
+
+  for (guint i = 0; i < segment->output->len; i++) {
+    if (verify && !verify_frame (renderer, segment, i, error))
+      return FALSE;
+
+    gst_app_src_push_buffer (GST_APP_SRC (renderer->writer_src),
+        gst_buffer_ref (g_ptr_array_index (segment->output, i)));
+    renderer->written++;
+  }
+
+  return TRUE;
+}
+
+/* Writes the finished segments at the head of the queue, in order, and
+ * waits for the head segment while more than limit segments are pending. */
+static gboolean
+write_segments (Renderer * renderer, guint limit, GError ** error)
+{
+  Segment *segment;
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&renderer->lock);
+  while (ret && (segment = g_queue_peek_head (&renderer->pending))) {
+    if (!segment->done) {
+      if (renderer->pending.length <= limit)
+        break;
+      g_cond_wait (&renderer->cond, &renderer->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&renderer->pending);
+    g_mutex_unlock (&renderer->lock);
+
+    ret = write_segment (renderer, segment, error);
+    segment_free (segment);
+
+    g_mutex_lock (&renderer->lock);
+  }
+  g_mutex_unlock (&renderer->lock);
+
+  return ret;
+}
+
+static void
+render_segment_push (Renderer * renderer, Segment * segment)
+{
+  g_mutex_lock (&renderer->lock);
+  g_queue_push_tail (&renderer->pending, segment);
+  g_mutex_unlock (&renderer->lock);
+  renderer->segments++;
+
+  g_thread_pool_push (renderer->pool, segment, NULL);
+}
+
+static gboolean
+writer_start (Renderer * renderer, GError ** error)
+{
+  gchar *desc;
+
+  if (sink)
+    desc = g_strdup_printf ("appsrc name=src format=time ! %s", sink);
+  else
+    desc = g_strdup ("appsrc name=src format=time ! filesink name=file");
+
+  renderer->writer = gst_parse_launch (desc, error);
+  g_free (desc);
+  if (renderer->writer == NULL)
+    return FALSE;
+
+  if (!sink) {
+    GstElement *file = gst_bin_get_by_name (GST_BIN (renderer->writer),
+        "file");
+
+    g_object_set (file, "location", output, NULL);
+    gst_object_unref (file);
+  }
+
+  renderer->writer_src = gst_bin_get_by_name (GST_BIN (renderer->writer),
+      "src");
+  gst_element_set_state (renderer->writer, GST_STATE_PLAYING);
+
+  return TRUE;
+}
+
+/* Reads the track, hands every full segment to the pool and writes the
+ * finished ones while reading. */
+static gboolean
+render_track (Renderer * renderer, const gchar * location, GError ** error)
+{
+  GstElement *pipeline, *src, *appsink;
+  Segment *segment, *next;
+  GstSample *sample;
+  gboolean ret = TRUE;
+
+  pipeline = gst_parse_launch ("filesrc name=src ! qtdemux ! dlblsmparse ! "
+      "appsink name=frames sync=false", error);
+  if (pipeline == NULL)
+    return FALSE;
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  appsink = gst_bin_get_by_name (GST_BIN (pipeline), "frames");
+  g_object_set (src, "location", location, NULL);
+  g_object_set (appsink, "max-buffers", READ_AHEAD, NULL);
+
+  segment = segment_new (0);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  while ((sample = gst_app_sink_pull_sample (GST_APP_SINK (appsink)))) {
+    GstBuffer *frame = gst_sample_get_buffer (sample);
+
+    if (renderer->caps == NULL) {
+      renderer->caps = gst_caps_ref (gst_sample_get_caps (sample));
+
+      if (verify) {
+        renderer->serial = render_pipeline_new (renderer->caps,
+            &renderer->serial_src, &renderer->serial_sink, error);
+        if (renderer->serial == NULL) {
+          gst_sample_unref (sample);
+          ret = FALSE;
+          break;
+        }
+        gst_element_set_state (renderer->serial, GST_STATE_PLAYING);
+      }
+    }
+
+    g_ptr_array_add (segment->frames, gst_buffer_ref (frame));
+    if (verify)
+      g_ptr_array_add (segment->input, gst_buffer_ref (frame));
+    gst_sample_unref (sample);
+    renderer->frames++;
+
+    if (segment->frames->len - segment->warmup < (guint) segment_length)
+      continue;
+
+    next = segment_new_after (segment);
+    render_segment_push (renderer, segment);
+    segment = next;
+
+    /* keep a segment queued for every job while the others render */
+    ret = write_segments (renderer, 2 * jobs, error);
+    if (!ret)
+      break;
+  }
+
+  if (ret)
+    ret = check_bus (pipeline, error);
+  if (ret && renderer->caps == NULL) {
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_DEMUX,
+        "no LSM frames in %s", location);
+    ret = FALSE;
+  }
+
+  if (ret && segment->frames->len > segment->warmup)
+    render_segment_push (renderer, segment);
+  else
+    segment_free (segment);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (appsink);
+  gst_object_unref (src);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *ctx;
+  GError *error = NULL;
+  Renderer renderer = { 0, };
+  gint64 start;
+  int ret = 1;
+
+  ctx = g_option_context_new ("INPUT - render an LSM track offline");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    goto done;
+  }
+
+  if (argc != 2 || config == NULL || (output == NULL && sink == NULL) ||
+      segment_length <= 0) {
+    gchar *help = g_option_context_get_help (ctx, TRUE, NULL);
+
+    g_printerr ("%s", help);
+    g_free (help);
+    goto done;
+  }
+
+  if (jobs <= 0)
+    jobs = g_get_num_processors ();
+
+  g_mutex_init (&renderer.lock);
+  g_cond_init (&renderer.cond);
+  g_queue_init (&renderer.pending);
+  renderer.pool = g_thread_pool_new (render_segment, &renderer, jobs, FALSE,
+      NULL);
+
+  if (!writer_start (&renderer, &error)) {
+    g_printerr ("could not write the output: %s\n", error->message);
+    goto done;
+  }
+
+  start = g_get_monotonic_time ();
+  if (!render_track (&renderer, argv[1], &error) ||
+      !write_segments (&renderer, 0, &error)) {
+    g_printerr ("rendering %s failed: %s\n", argv[1], error->message);
+    goto done;
+  }
+
+  if (!renderer.writer_caps) {
+    g_printerr ("the renderer produced no frames\n");
+    goto done;
+  }
+
+  if (verify) {
+    GstSample *sample;
+
+    gst_app_src_end_of_stream (GST_APP_SRC (renderer.serial_src));
+    sample = gst_app_sink_pull_sample (GST_APP_SINK (renderer.serial_sink));
+    if (sample) {
+      g_printerr ("parallel rendering has %u frames, serial rendering more\n",
+          renderer.written);
+      gst_sample_unref (sample);
+      goto done;
+    }
+    if (!check_bus (renderer.serial, &error)) {
+      g_printerr ("serial rendering failed: %s\n", error->message);
+      goto done;
+    }
+    g_print ("verified %u frames against serial rendering\n",
+        renderer.written);
+  }
+
+  gst_app_src_end_of_stream (GST_APP_SRC (renderer.writer_src));
+  if (!wait_eos (renderer.writer, &error)) {
+    g_printerr ("could not write the output: %s\n", error->message);
+    goto done;
+  }
+
+  g_print ("rendered %u frames in %u segments in %.3f s\n", renderer.frames,
+      renderer.segments,
+      (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC);
+
+  ret = 0;
+
+done:
+  if (renderer.pool) {
+    /* drops the segments not started yet and waits for the running ones */
+    g_thread_pool_free (renderer.pool, TRUE, TRUE);
+    while (!g_queue_is_empty (&renderer.pending))
+      segment_free (g_queue_pop_head (&renderer.pending));
+    g_cond_clear (&renderer.cond);
+    g_mutex_clear (&renderer.lock);
+  }
+  if (renderer.serial) {
+    gst_element_set_state (renderer.serial, GST_STATE_NULL);
+    gst_object_unref (renderer.serial_sink);
+    gst_object_unref (renderer.serial_src);
+    gst_object_unref (renderer.serial);
+  }
+  if (renderer.writer) {
+    gst_element_set_state (renderer.writer, GST_STATE_NULL);
+    gst_clear_object (&renderer.writer_src);
+    gst_object_unref (renderer.writer);
+  }
+  gst_clear_caps (&renderer.caps);
+  g_clear_error (&error);
+  g_option_context_free (ctx);
+
+  return ret;
+}